@@ -98,17 +98,19 @@
 #include <stdlib.h>
 
 #include "netdissect.h"
+#include "netdissect-alloc.h"
 #include "addrtoname.h"
 #include "addrtostr.h"
-#include "ethertype.h"
-#include "llc.h"
 #include "extract.h"
 #include "oui.h"
 
 /*
  * hash tables for whatever-to-name translations
  *
- * ndo_error() called on strdup(3) failure with S_ERR_ND_MEM_ALLOC status
+ * They are in a structure hanging off the netdissect_options structure,
+ * with the entries chained to them and the names in an arena that goes
+ * with it; ndo_error() is called with S_ERR_ND_MEM_ALLOC status if
+ * memory runs out.
  */
 
 #define HASHNAMESIZE 4096
@@ -119,55 +121,30 @@ struct hnamemem {
 	struct hnamemem *nxt;
 };
 
-static struct hnamemem hnametable[HASHNAMESIZE];
-static struct hnamemem tporttable[HASHNAMESIZE];
-static struct hnamemem uporttable[HASHNAMESIZE];
-static struct hnamemem eprototable[HASHNAMESIZE];
-static struct hnamemem dnaddrtable[HASHNAMESIZE];
-static struct hnamemem ipxsaptable[HASHNAMESIZE];
-
-#ifdef _WIN32
+#if defined(_WIN32) && defined(AF_INET6)
 /*
- * fake gethostbyaddr for Win2k/XP
- * gethostbyaddr() returns incorrect value when AF_INET6 is passed
- * to 3rd argument.
- *
- * h_name in struct hostent is only valid.
+ * gethostbyaddr() on Win2k/XP returns incorrect value when AF_INET6 is
+ * passed to 3rd argument, so look IPv6 addresses up with getnameinfo().
+ * The result is put in the caller's hostent and buffer, of which only
+ * h_name is valid.
  */
 static struct hostent *
-win32_gethostbyaddr(const char *addr, int len, int type)
+win32_ip6_gethostbyaddr(const nd_ipv6 addr, struct hostent *host,
+    char *hname, size_t hnamelen)
 {
-	static struct hostent host;
-	static char hostbuf[NI_MAXHOST];
-	char hname[NI_MAXHOST];
+	struct sockaddr_in6 addr6;
 
-	host.h_name = hostbuf;
-	switch (type) {
-	case AF_INET:
-		return gethostbyaddr(addr, len, type);
-		break;
-#ifdef AF_INET6
-	case AF_INET6: {
-		struct sockaddr_in6 addr6;
-		memset(&addr6, 0, sizeof(addr6));
-		addr6.sin6_family = AF_INET6;
-		memcpy(&addr6.sin6_addr, addr, len);
-		if (getnameinfo((struct sockaddr *)&addr6, sizeof(addr6),
-		    hname, sizeof(hname), NULL, 0, 0)) {
-			return NULL;
-		} else {
-			strlcpy(host.h_name, hname, NI_MAXHOST);
-			return &host;
-		}
-		break;
-	}
-#endif /* AF_INET6 */
-	default:
+	memset(&addr6, 0, sizeof(addr6));
+	addr6.sin6_family = AF_INET6;
+	memcpy(&addr6.sin6_addr, addr, sizeof(nd_ipv6));
+	if (getnameinfo((struct sockaddr *)&addr6, sizeof(addr6),
+	    hname, (DWORD)hnamelen, NULL, 0, 0))
 		return NULL;
-	}
+	memset(host, 0, sizeof(*host));
+	host->h_name = hname;
+	return host;
 }
-#define gethostbyaddr win32_gethostbyaddr
-#endif /* _WIN32 */
+#endif /* _WIN32 && AF_INET6 */
 
 struct h6namemem {
 	nd_ipv6 addr;
@@ -175,8 +152,6 @@ struct h6namemem {
 	struct h6namemem *nxt;
 };
 
-static struct h6namemem h6nametable[HASHNAMESIZE];
-
 struct enamemem {
 	u_short e_addr0;
 	u_short e_addr1;
@@ -186,9 +161,6 @@ struct enamemem {
 	struct enamemem *e_nxt;
 };
 
-static struct enamemem enametable[HASHNAMESIZE];
-static struct enamemem nsaptable[HASHNAMESIZE];
-
 struct bsnamemem {
 	u_short bs_addr0;
 	u_short bs_addr1;
@@ -199,30 +171,80 @@ struct bsnamemem {
 	struct bsnamemem *bs_nxt;
 };
 
-static struct bsnamemem bytestringtable[HASHNAMESIZE];
+struct nd_name_tables {
+	struct hnamemem hnametable[HASHNAMESIZE];
+	struct hnamemem tporttable[HASHNAMESIZE];
+	struct hnamemem uporttable[HASHNAMESIZE];
+	struct hnamemem dnaddrtable[HASHNAMESIZE];
+	struct hnamemem ipxsaptable[HASHNAMESIZE];
+	struct h6namemem h6nametable[HASHNAMESIZE];
+	struct enamemem enametable[HASHNAMESIZE];
+	struct enamemem nsaptable[HASHNAMESIZE];
+	struct bsnamemem bytestringtable[HASHNAMESIZE];
+
+	/*
+	 * The name databases are loaded on first use rather than at
+	 * startup, as most captures need few or none of them.
+	 */
+	int etherarray_loaded;
+	int servarray_loaded;
+	int ipxsaparray_loaded;
+
+	/* See init_addrtoname(). */
+	uint32_t f_netmask;
+	uint32_t f_localnet;
 
-struct protoidmem {
-	uint32_t p_oui;
-	u_short p_proto;
-	const char *p_name;
-	struct protoidmem *p_nxt;
+	struct nd_arena *names;		/* chained entries and names */
 };
 
-static struct protoidmem protoidtable[HASHNAMESIZE];
+static void init_etherarray(netdissect_options *);
+static void init_servarray(netdissect_options *);
+static void init_ipxsaparray(netdissect_options *);
 
 /*
- * A faster replacement for inet_ntoa().
+ * Return the tables of ndo, allocating them the first time.
  */
-const char *
-intoa(uint32_t addr)
+static struct nd_name_tables *
+name_tables(netdissect_options *ndo)
+{
+	if (ndo->ndo_name_tables == NULL) {
+		ndo->ndo_name_tables = (struct nd_name_tables *)calloc(1,
+		    sizeof(*ndo->ndo_name_tables));
+		if (ndo->ndo_name_tables == NULL)
+			(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
+			    "%s: calloc", __func__);
+	}
+	return ndo->ndo_name_tables;
+}
+
+/* Return zeroed memory that lasts as long as the tables. */
+static void *
+name_alloc(netdissect_options *ndo, size_t size)
+{
+	return nd_arena_alloc(ndo, &name_tables(ndo)->names, size);
+}
+
+static char *
+name_strdup(netdissect_options *ndo, const char *s)
+{
+	return nd_arena_strdup(ndo, &name_tables(ndo)->names, s);
+}
+
+#define INTOA_BUFSIZE	sizeof(".xxx.xxx.xxx.xxx")
+
+/*
+ * A faster replacement for inet_ntoa(), formatting into buf, of
+ * INTOA_BUFSIZE bytes.
+ */
+static const char *
+intoa_buf(uint32_t addr, char *buf)
 {
 	char *cp;
 	u_int byte;
 	int n;
-	static char buf[sizeof(".xxx.xxx.xxx.xxx")];
 
 	addr = ntohl(addr);
-	cp = buf + sizeof(buf);
+	cp = buf + INTOA_BUFSIZE;
 	*--cp = '\0';
 
 	n = 4;
@@ -243,8 +265,25 @@ intoa(uint32_t addr)
 	return cp + 1;
 }
 
-static uint32_t f_netmask;
-static uint32_t f_localnet;
+const char *
+intoa(uint32_t addr)
+{
+	static ND_THREAD_LOCAL char buf[INTOA_BUFSIZE];
+
+	return intoa_buf(addr, buf);
+}
+
+/*
+ * Like intoa(), but with the string in the scratch space of ndo.
+ */
+const char *
+nd_intoa(netdissect_options *ndo, uint32_t addr)
+{
+	char buf[INTOA_BUFSIZE];
+
+	return nd_scratch_strdup(ndo, intoa_buf(addr, buf));
+}
+
 #ifdef HAVE_CASPER
 cap_channel_t *capdns;
 #endif
@@ -270,18 +309,20 @@ cap_channel_t *capdns;
 const char *
 ipaddr_string(netdissect_options *ndo, const u_char *ap)
 {
+	struct nd_name_tables *nt = name_tables(ndo);
 	struct hostent *hp;
 	uint32_t addr;
 	struct hnamemem *p;
+	char buf[INTOA_BUFSIZE];
 
 	memcpy(&addr, ap, sizeof(addr));
-	p = &hnametable[addr & (HASHNAMESIZE-1)];
+	p = &nt->hnametable[addr & (HASHNAMESIZE-1)];
 	for (; p->nxt; p = p->nxt) {
 		if (p->addr == addr)
 			return (p->name);
 	}
 	p->addr = addr;
-	p->nxt = newhnamemem(ndo);
+	p->nxt = (struct hnamemem *)name_alloc(ndo, sizeof(*p));
 
 	/*
 	 * Print names unless:
@@ -292,7 +333,7 @@ ipaddr_string(netdissect_options *ndo, const u_char *ap)
 	 * Both addr and f_netmask and f_localnet are in network byte order.
 	 */
 	if (!ndo->ndo_nflag &&
-	    (addr & f_netmask) == f_localnet) {
+	    (addr & nt->f_netmask) == nt->f_localnet) {
 #ifdef HAVE_CASPER
 		if (capdns != NULL) {
 			hp = cap_gethostbyaddr(capdns, (char *)&addr, 4,
@@ -301,25 +342,19 @@ ipaddr_string(netdissect_options *ndo, const u_char *ap)
 #endif
 			hp = gethostbyaddr((char *)&addr, 4, AF_INET);
 		if (hp) {
-			char *dotp;
+			char *name, *dotp;
 
-			p->name = strdup(hp->h_name);
-			if (p->name == NULL)
-				(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-					"%s: strdup(hp->h_name)", __func__);
+			p->name = name = name_strdup(ndo, hp->h_name);
 			if (ndo->ndo_Nflag) {
 				/* Remove domain qualifications */
-				dotp = strchr(p->name, '.');
+				dotp = strchr(name, '.');
 				if (dotp)
 					*dotp = '\0';
 			}
 			return (p->name);
 		}
 	}
-	p->name = strdup(intoa(addr));
-	if (p->name == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-				  "%s: strdup(intoa(addr))", __func__);
+	p->name = name_strdup(ndo, intoa_buf(addr, buf));
 	return (p->name);
 }
 
@@ -341,15 +376,19 @@ ip6addr_string(netdissect_options *ndo, const u_char *ap)
 	struct h6namemem *p;
 	const char *cp;
 	char ntop_buf[INET6_ADDRSTRLEN];
+#if defined(_WIN32) && defined(AF_INET6)
+	struct hostent host;
+	char hname[NI_MAXHOST];
+#endif
 
 	memcpy(&addr, ap, sizeof(addr));
-	p = &h6nametable[addr.addra.d & (HASHNAMESIZE-1)];
+	p = &name_tables(ndo)->h6nametable[addr.addra.d & (HASHNAMESIZE-1)];
 	for (; p->nxt; p = p->nxt) {
 		if (memcmp(&p->addr, &addr, sizeof(addr)) == 0)
 			return (p->name);
 	}
 	memcpy(p->addr, addr.addr, sizeof(nd_ipv6));
-	p->nxt = newh6namemem(ndo);
+	p->nxt = (struct h6namemem *)name_alloc(ndo, sizeof(*p));
 
 	/*
 	 * Do not print names if -n was given.
@@ -362,15 +401,17 @@ ip6addr_string(netdissect_options *ndo, const u_char *ap)
 			    sizeof(addr), AF_INET6);
 		} else
 #endif
+#ifdef _WIN32
+			hp = win32_ip6_gethostbyaddr(addr.addr, &host, hname,
+			    sizeof(hname));
+#else
 			hp = gethostbyaddr((char *)&addr, sizeof(addr),
 			    AF_INET6);
+#endif
 		if (hp) {
 			char *dotp;
 
-			p->name = strdup(hp->h_name);
-			if (p->name == NULL)
-				(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-					"%s: strdup(hp->h_name)", __func__);
+			p->name = name_strdup(ndo, hp->h_name);
 			if (ndo->ndo_Nflag) {
 				/* Remove domain qualifications */
 				dotp = strchr(p->name, '.');
@@ -382,10 +423,7 @@ ip6addr_string(netdissect_options *ndo, const u_char *ap)
 	}
 #endif /* AF_INET6 */
 	cp = addrtostr6(ap, ntop_buf, sizeof(ntop_buf));
-	p->name = strdup(cp);
-	if (p->name == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-				  "%s: strdup(cp)", __func__);
+	p->name = name_strdup(ndo, cp);
 	return (p->name);
 }
 
@@ -438,7 +476,7 @@ lookup_emem(netdissect_options *ndo, const u_char *ep)
 	j = (ep[2] << 8) | ep[3];
 	i = (ep[4] << 8) | ep[5];
 
-	tp = &enametable[(i ^ j) & (HASHNAMESIZE-1)];
+	tp = &name_tables(ndo)->enametable[(i ^ j) & (HASHNAMESIZE-1)];
 	while (tp->e_nxt)
 		if (tp->e_addr0 == i &&
 		    tp->e_addr1 == j &&
@@ -449,9 +487,7 @@ lookup_emem(netdissect_options *ndo, const u_char *ep)
 	tp->e_addr0 = (u_short)i;
 	tp->e_addr1 = (u_short)j;
 	tp->e_addr2 = (u_short)k;
-	tp->e_nxt = (struct enamemem *)calloc(1, sizeof(*tp));
-	if (tp->e_nxt == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC, "%s: calloc", __func__);
+	tp->e_nxt = (struct enamemem *)name_alloc(ndo, sizeof(*tp));
 
 	return tp;
 }
@@ -479,7 +515,7 @@ lookup_bytestring(netdissect_options *ndo, const u_char *bs,
 	} else
 		i = j = k = 0;
 
-	tp = &bytestringtable[(i ^ j) & (HASHNAMESIZE-1)];
+	tp = &name_tables(ndo)->bytestringtable[(i ^ j) & (HASHNAMESIZE-1)];
 	while (tp->bs_nxt)
 		if (nlen == tp->bs_nbytes &&
 		    tp->bs_addr0 == i &&
@@ -494,17 +530,10 @@ lookup_bytestring(netdissect_options *ndo, const u_char *bs,
 	tp->bs_addr1 = (u_short)j;
 	tp->bs_addr2 = (u_short)k;
 
-	tp->bs_bytes = (u_char *) calloc(1, nlen);
-	if (tp->bs_bytes == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-				  "%s: calloc", __func__);
-
+	tp->bs_bytes = (u_char *)name_alloc(ndo, nlen);
 	memcpy(tp->bs_bytes, bs, nlen);
 	tp->bs_nbytes = nlen;
-	tp->bs_nxt = (struct bsnamemem *)calloc(1, sizeof(*tp));
-	if (tp->bs_nxt == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-				  "%s: calloc", __func__);
+	tp->bs_nxt = (struct bsnamemem *)name_alloc(ndo, sizeof(*tp));
 
 	return tp;
 }
@@ -527,7 +556,7 @@ lookup_nsap(netdissect_options *ndo, const u_char *nsap,
 	} else
 		i = j = k = 0;
 
-	tp = &nsaptable[(i ^ j) & (HASHNAMESIZE-1)];
+	tp = &name_tables(ndo)->nsaptable[(i ^ j) & (HASHNAMESIZE-1)];
 	while (tp->e_nxt)
 		if (nsap_length == tp->e_nsap[0] &&
 		    tp->e_addr0 == i &&
@@ -541,42 +570,10 @@ lookup_nsap(netdissect_options *ndo, const u_char *nsap,
 	tp->e_addr0 = (u_short)i;
 	tp->e_addr1 = (u_short)j;
 	tp->e_addr2 = (u_short)k;
-	tp->e_nsap = (u_char *)malloc(nsap_length + 1);
-	if (tp->e_nsap == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC, "%s: malloc", __func__);
+	tp->e_nsap = (u_char *)name_alloc(ndo, nsap_length + 1);
 	tp->e_nsap[0] = (u_char)nsap_length;	/* guaranteed < ISONSAP_MAX_LENGTH */
 	memcpy((char *)&tp->e_nsap[1], (const char *)nsap, nsap_length);
-	tp->e_nxt = (struct enamemem *)calloc(1, sizeof(*tp));
-	if (tp->e_nxt == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC, "%s: calloc", __func__);
-
-	return tp;
-}
-
-/* Find the hash node that corresponds the protoid 'pi'. */
-
-static struct protoidmem *
-lookup_protoid(netdissect_options *ndo, const u_char *pi)
-{
-	u_int i, j;
-	struct protoidmem *tp;
-
-	/* 5 octets won't be aligned */
-	i = (((pi[0] << 8) + pi[1]) << 8) + pi[2];
-	j =   (pi[3] << 8) + pi[4];
-	/* XXX should be endian-insensitive, but do big-endian testing  XXX */
-
-	tp = &protoidtable[(i ^ j) & (HASHNAMESIZE-1)];
-	while (tp->p_nxt)
-		if (tp->p_oui == i && tp->p_proto == j)
-			return tp;
-		else
-			tp = tp->p_nxt;
-	tp->p_oui = i;
-	tp->p_proto = (u_short)j;
-	tp->p_nxt = (struct protoidmem *)calloc(1, sizeof(*tp));
-	if (tp->p_nxt == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC, "%s: calloc", __func__);
+	tp->e_nxt = (struct enamemem *)name_alloc(ndo, sizeof(*tp));
 
 	return tp;
 }
@@ -590,6 +587,8 @@ mac48_string(netdissect_options *ndo, const uint8_t *ep)
 	int oui;
 	char buf[BUFSIZE];
 
+	if (!name_tables(ndo)->etherarray_loaded && !ndo->ndo_nflag)
+		init_etherarray(ndo);
 	tp = lookup_emem(ndo, ep);
 	if (tp->e_name)
 		return (tp->e_name);
@@ -605,10 +604,7 @@ mac48_string(netdissect_options *ndo, const uint8_t *ep)
 
 		memcpy (&ea, ep, MAC48_LEN);
 		if (ether_ntohost(buf2, &ea) == 0) {
-			tp->e_name = strdup(buf2);
-			if (tp->e_name == NULL)
-				(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-					"%s: strdup(buf2)", __func__);
+			tp->e_name = name_strdup(ndo, buf2);
 			return (tp->e_name);
 		}
 	}
@@ -623,13 +619,10 @@ mac48_string(netdissect_options *ndo, const uint8_t *ep)
 
 	if (!ndo->ndo_nflag) {
 		snprintf(cp, BUFSIZE - (2 + 5*3), " (oui %s)",
-		    tok2str(oui_values, "Unknown", oui));
+		    nd_tok2str(ndo, oui_values, "Unknown", oui));
 	} else
 		*cp = '\0';
-	tp->e_name = strdup(buf);
-	if (tp->e_name == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-				  "%s: strdup(buf)", __func__);
+	tp->e_name = name_strdup(ndo, buf);
 	return (tp->e_name);
 }
 
@@ -664,10 +657,7 @@ eui64le_string(netdissect_options *ndo, const uint8_t *ep)
 
 	*cp = '\0';
 
-	tp->bs_name = strdup(buf);
-	if (tp->bs_name == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-				  "%s: strdup(buf)", __func__);
+	tp->bs_name = name_strdup(ndo, buf);
 
 	return (tp->bs_name);
 }
@@ -693,10 +683,7 @@ linkaddr_string(netdissect_options *ndo, const uint8_t *ep,
 	if (tp->bs_name)
 		return (tp->bs_name);
 
-	tp->bs_name = cp = (char *)malloc(len*3);
-	if (tp->bs_name == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-				  "%s: malloc", __func__);
+	tp->bs_name = cp = (char *)name_alloc(ndo, len*3);
 	cp = octet_to_hex(cp, *ep++);
 	for (i = len-1; i > 0 ; --i) {
 		*cp++ = ':';
@@ -722,10 +709,7 @@ isonsap_string(netdissect_options *ndo, const uint8_t *nsap,
 	if (tp->e_name)
 		return tp->e_name;
 
-	tp->e_name = cp = (char *)malloc(sizeof("xx.xxxx.xxxx.xxxx.xxxx.xxxx.xxxx.xxxx.xxxx.xxxx.xx"));
-	if (cp == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-				  "%s: malloc", __func__);
+	tp->e_name = cp = (char *)name_alloc(ndo, sizeof("xx.xxxx.xxxx.xxxx.xxxx.xxxx.xxxx.xxxx.xxxx.xxxx.xx"));
 
 	for (nsap_idx = 0; nsap_idx < nsap_length; nsap_idx++) {
 		cp = octet_to_hex(cp, *nsap++);
@@ -741,61 +725,64 @@ isonsap_string(netdissect_options *ndo, const uint8_t *nsap,
 const char *
 tcpport_string(netdissect_options *ndo, u_short port)
 {
+	struct nd_name_tables *nt = name_tables(ndo);
 	struct hnamemem *tp;
 	uint32_t i = port;
 	char buf[sizeof("00000")];
 
-	for (tp = &tporttable[i & (HASHNAMESIZE-1)]; tp->nxt; tp = tp->nxt)
+	if (!nt->servarray_loaded && !ndo->ndo_nflag)
+		init_servarray(ndo);
+	for (tp = &nt->tporttable[i & (HASHNAMESIZE-1)]; tp->nxt; tp = tp->nxt)
 		if (tp->addr == i)
 			return (tp->name);
 
 	tp->addr = i;
-	tp->nxt = newhnamemem(ndo);
+	tp->nxt = (struct hnamemem *)name_alloc(ndo, sizeof(*tp));
 
 	(void)snprintf(buf, sizeof(buf), "%u", i);
-	tp->name = strdup(buf);
-	if (tp->name == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-				  "%s: strdup(buf)", __func__);
+	tp->name = name_strdup(ndo, buf);
 	return (tp->name);
 }
 
 const char *
 udpport_string(netdissect_options *ndo, u_short port)
 {
+	struct nd_name_tables *nt = name_tables(ndo);
 	struct hnamemem *tp;
 	uint32_t i = port;
 	char buf[sizeof("00000")];
 
-	for (tp = &uporttable[i & (HASHNAMESIZE-1)]; tp->nxt; tp = tp->nxt)
+	if (!nt->servarray_loaded && !ndo->ndo_nflag)
+		init_servarray(ndo);
+	for (tp = &nt->uporttable[i & (HASHNAMESIZE-1)]; tp->nxt; tp = tp->nxt)
 		if (tp->addr == i)
 			return (tp->name);
 
 	tp->addr = i;
-	tp->nxt = newhnamemem(ndo);
+	tp->nxt = (struct hnamemem *)name_alloc(ndo, sizeof(*tp));
 
 	(void)snprintf(buf, sizeof(buf), "%u", i);
-	tp->name = strdup(buf);
-	if (tp->name == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-				  "%s: strdup(buf)", __func__);
+	tp->name = name_strdup(ndo, buf);
 	return (tp->name);
 }
 
 const char *
 ipxsap_string(netdissect_options *ndo, u_short port)
 {
+	struct nd_name_tables *nt = name_tables(ndo);
 	char *cp;
 	struct hnamemem *tp;
 	uint32_t i = port;
 	char buf[sizeof("0000")];
 
-	for (tp = &ipxsaptable[i & (HASHNAMESIZE-1)]; tp->nxt; tp = tp->nxt)
+	if (!nt->ipxsaparray_loaded && !ndo->ndo_nflag)
+		init_ipxsaparray(ndo);
+	for (tp = &nt->ipxsaptable[i & (HASHNAMESIZE-1)]; tp->nxt; tp = tp->nxt)
 		if (tp->addr == i)
 			return (tp->name);
 
 	tp->addr = i;
-	tp->nxt = newhnamemem(ndo);
+	tp->nxt = (struct hnamemem *)name_alloc(ndo, sizeof(*tp));
 
 	cp = buf;
 	port = ntohs(port);
@@ -804,28 +791,27 @@ ipxsap_string(netdissect_options *ndo, u_short port)
 	*cp++ = hex[port >> 4 & 0xf];
 	*cp++ = hex[port & 0xf];
 	*cp++ = '\0';
-	tp->name = strdup(buf);
-	if (tp->name == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-				  "%s: strdup(buf)", __func__);
+	tp->name = name_strdup(ndo, buf);
 	return (tp->name);
 }
 
 static void
 init_servarray(netdissect_options *ndo)
 {
+	struct nd_name_tables *nt = name_tables(ndo);
 	struct servent *sv;
 	struct hnamemem *table;
 	int i;
 	char buf[sizeof("0000000000")];
 
+	nt->servarray_loaded = 1;
 	while ((sv = getservent()) != NULL) {
 		int port = ntohs(sv->s_port);
 		i = port & (HASHNAMESIZE-1);
 		if (strcmp(sv->s_proto, "tcp") == 0)
-			table = &tporttable[i];
+			table = &nt->tporttable[i];
 		else if (strcmp(sv->s_proto, "udp") == 0)
-			table = &uporttable[i];
+			table = &nt->uporttable[i];
 		else
 			continue;
 
@@ -833,103 +819,17 @@ init_servarray(netdissect_options *ndo)
 			table = table->nxt;
 		if (ndo->ndo_nflag) {
 			(void)snprintf(buf, sizeof(buf), "%d", port);
-			table->name = strdup(buf);
+			table->name = name_strdup(ndo, buf);
 		} else
-			table->name = strdup(sv->s_name);
-		if (table->name == NULL)
-			(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-					  "%s: strdup", __func__);
+			table->name = name_strdup(ndo, sv->s_name);
 
 		table->addr = port;
-		table->nxt = newhnamemem(ndo);
+		table->nxt = (struct hnamemem *)name_alloc(ndo,
+		    sizeof(*table));
 	}
 	endservent();
 }
 
-static const struct eproto {
-	const char *s;
-	u_short p;
-} eproto_db[] = {
-	{ "aarp", ETHERTYPE_AARP },
-	{ "arp", ETHERTYPE_ARP },
-	{ "atalk", ETHERTYPE_ATALK },
-	{ "decnet", ETHERTYPE_DN },
-	{ "ip", ETHERTYPE_IP },
-	{ "ip6", ETHERTYPE_IPV6 },
-	{ "lat", ETHERTYPE_LAT },
-	{ "loopback", ETHERTYPE_LOOPBACK },
-	{ "mopdl", ETHERTYPE_MOPDL },
-	{ "moprc", ETHERTYPE_MOPRC },
-	{ "rarp", ETHERTYPE_REVARP },
-	{ "sca", ETHERTYPE_SCA },
-	{ (char *)0, 0 }
-};
-
-static void
-init_eprotoarray(netdissect_options *ndo)
-{
-	int i;
-	struct hnamemem *table;
-
-	for (i = 0; eproto_db[i].s; i++) {
-		int j = htons(eproto_db[i].p) & (HASHNAMESIZE-1);
-		table = &eprototable[j];
-		while (table->name)
-			table = table->nxt;
-		table->name = eproto_db[i].s;
-		table->addr = htons(eproto_db[i].p);
-		table->nxt = newhnamemem(ndo);
-	}
-}
-
-static const struct protoidlist {
-	const u_char protoid[5];
-	const char *name;
-} protoidlist[] = {
-	{{ 0x00, 0x00, 0x0c, 0x01, 0x07 }, "CiscoMLS" },
-	{{ 0x00, 0x00, 0x0c, 0x20, 0x00 }, "CiscoCDP" },
-	{{ 0x00, 0x00, 0x0c, 0x20, 0x01 }, "CiscoCGMP" },
-	{{ 0x00, 0x00, 0x0c, 0x20, 0x03 }, "CiscoVTP" },
-	{{ 0x00, 0xe0, 0x2b, 0x00, 0xbb }, "ExtremeEDP" },
-	{{ 0x00, 0x00, 0x00, 0x00, 0x00 }, NULL }
-};
-
-/*
- * SNAP proto IDs with org code 0:0:0 are actually encapsulated Ethernet
- * types.
- */
-static void
-init_protoidarray(netdissect_options *ndo)
-{
-	int i;
-	struct protoidmem *tp;
-	const struct protoidlist *pl;
-	u_char protoid[5];
-
-	protoid[0] = 0;
-	protoid[1] = 0;
-	protoid[2] = 0;
-	for (i = 0; eproto_db[i].s; i++) {
-		u_short etype = htons(eproto_db[i].p);
-
-		memcpy((char *)&protoid[3], (char *)&etype, 2);
-		tp = lookup_protoid(ndo, protoid);
-		tp->p_name = strdup(eproto_db[i].s);
-		if (tp->p_name == NULL)
-			(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-				"%s: strdup(eproto_db[i].s)", __func__);
-	}
-	/* Hardwire some SNAP proto ID names */
-	for (pl = protoidlist; pl->name != NULL; ++pl) {
-		tp = lookup_protoid(ndo, pl->protoid);
-		/* Don't override existing name */
-		if (tp->p_name != NULL)
-			continue;
-
-		tp->p_name = pl->name;
-	}
-}
-
 static const struct etherlist {
 	const nd_mac48 addr;
 	const char *name;
@@ -962,16 +862,16 @@ init_etherarray(netdissect_options *ndo)
 #else
 	struct pcap_etherent *ep;
 	FILE *fp;
+#endif
 
+	name_tables(ndo)->etherarray_loaded = 1;
+#ifndef USE_ETHER_NTOHOST
 	/* Suck in entire ethers file */
 	fp = fopen(PCAP_ETHERS_FILE, "r");
 	if (fp != NULL) {
 		while ((ep = pcap_next_etherent(fp)) != NULL) {
 			tp = lookup_emem(ndo, ep->addr);
-			tp->e_name = strdup(ep->name);
-			if (tp->e_name == NULL)
-				(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-					"%s: strdup(ep->addr)", __func__);
+			tp->e_name = name_strdup(ndo, ep->name);
 		}
 		(void)fclose(fp);
 	}
@@ -992,10 +892,7 @@ init_etherarray(netdissect_options *ndo)
 		struct ether_addr ea;
 		memcpy (&ea, el->addr, MAC48_LEN);
 		if (ether_ntohost(name, &ea) == 0) {
-			tp->e_name = strdup(name);
-			if (tp->e_name == NULL)
-				(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-					"%s: strdup(name)", __func__);
+			tp->e_name = name_strdup(ndo, name);
 			continue;
 		}
 #endif
@@ -1226,17 +1123,20 @@ static const struct ipxsap_ent {
 static void
 init_ipxsaparray(netdissect_options *ndo)
 {
+	struct nd_name_tables *nt = name_tables(ndo);
 	int i;
 	struct hnamemem *table;
 
+	nt->ipxsaparray_loaded = 1;
 	for (i = 0; ipxsap_db[i].s != NULL; i++) {
 		u_int j = htons(ipxsap_db[i].v) & (HASHNAMESIZE-1);
-		table = &ipxsaptable[j];
+		table = &nt->ipxsaptable[j];
 		while (table->name)
 			table = table->nxt;
 		table->name = ipxsap_db[i].s;
 		table->addr = htons(ipxsap_db[i].v);
-		table->nxt = newhnamemem(ndo);
+		table->nxt = (struct hnamemem *)name_alloc(ndo,
+		    sizeof(*table));
 	}
 }
 
@@ -1245,25 +1145,50 @@ init_ipxsaparray(netdissect_options *ndo)
  * non-local IP addresses to numeric addresses if ndo->ndo_fflag is true
  * (i.e., to prevent blocking on the nameserver).  localnet is the IP address
  * of the local network, mask is its subnet mask, both in network byte order.
+ * The ethers, services and IPX SAP tables are loaded on first use.
  */
 void
 init_addrtoname(netdissect_options *ndo, uint32_t localnet, uint32_t mask)
 {
 	if (ndo->ndo_fflag) {
-		f_localnet = localnet;
-		f_netmask = mask;
+		name_tables(ndo)->f_localnet = localnet;
+		name_tables(ndo)->f_netmask = mask;
 	}
+}
+
+/*
+ * Free the tables and the names in them.
+ */
+void
+free_addrtoname(netdissect_options *ndo)
+{
+	if (ndo->ndo_name_tables == NULL)
+		return;
+	nd_arena_free(&ndo->ndo_name_tables->names);
+	free(ndo->ndo_name_tables);
+	ndo->ndo_name_tables = NULL;
+}
+
+/*
+ * Load the name databases now rather than on first use.  This is for
+ * callers that are about to lose access to the files they come from,
+ * e.g. by chrooting or entering a sandbox.
+ */
+void
+load_addrtoname_tables(netdissect_options *ndo)
+{
 	if (ndo->ndo_nflag)
 		/*
 		 * Simplest way to suppress names.
 		 */
 		return;
 
-	init_etherarray(ndo);
-	init_servarray(ndo);
-	init_eprotoarray(ndo);
-	init_protoidarray(ndo);
-	init_ipxsaparray(ndo);
+	if (!name_tables(ndo)->etherarray_loaded)
+		init_etherarray(ndo);
+	if (!name_tables(ndo)->servarray_loaded)
+		init_servarray(ndo);
+	if (!name_tables(ndo)->ipxsaparray_loaded)
+		init_ipxsaparray(ndo);
 }
 
 const char *
@@ -1271,66 +1196,42 @@ dnaddr_string(netdissect_options *ndo, u_short dnaddr)
 {
 	struct hnamemem *tp;
 
-	for (tp = &dnaddrtable[dnaddr & (HASHNAMESIZE-1)]; tp->nxt != NULL;
-	     tp = tp->nxt)
+	for (tp = &name_tables(ndo)->dnaddrtable[dnaddr & (HASHNAMESIZE-1)];
+	     tp->nxt != NULL; tp = tp->nxt)
 		if (tp->addr == dnaddr)
 			return (tp->name);
 
 	tp->addr = dnaddr;
-	tp->nxt = newhnamemem(ndo);
-	tp->name = dnnum_string(ndo, dnaddr);
+	tp->nxt = (struct hnamemem *)name_alloc(ndo, sizeof(*tp));
+	tp->name = name_strdup(ndo, dnnum_string(ndo, dnaddr));
 
 	return(tp->name);
 }
 
-/* Return a zero'ed hnamemem struct and cuts down on calloc() overhead */
+/*
+ * Return a zeroed hnamemem struct, for the hash tables of printers;
+ * unlike the entries of the tables here, it is theirs to keep.
+ */
 struct hnamemem *
 newhnamemem(netdissect_options *ndo)
 {
 	struct hnamemem *p;
-	static struct hnamemem *ptr = NULL;
-	static u_int num = 0;
-
-	if (num  == 0) {
-		num = 64;
-		ptr = (struct hnamemem *)calloc(num, sizeof (*ptr));
-		if (ptr == NULL)
-			(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-					  "%s: calloc", __func__);
-	}
-	--num;
-	p = ptr++;
-	return (p);
-}
-
-/* Return a zero'ed h6namemem struct and cuts down on calloc() overhead */
-struct h6namemem *
-newh6namemem(netdissect_options *ndo)
-{
-	struct h6namemem *p;
-	static struct h6namemem *ptr = NULL;
-	static u_int num = 0;
 
-	if (num  == 0) {
-		num = 64;
-		ptr = (struct h6namemem *)calloc(num, sizeof (*ptr));
-		if (ptr == NULL)
-			(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-					  "%s: calloc", __func__);
-	}
-	--num;
-	p = ptr++;
+	p = (struct hnamemem *)calloc(1, sizeof(*p));
+	if (p == NULL)
+		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
+				  "%s: calloc", __func__);
 	return (p);
 }
 
 /* Represent TCI part of the 802.1Q 4-octet tag as text. */
 const char *
-ieee8021q_tci_string(const uint16_t tci)
+ieee8021q_tci_string(netdissect_options *ndo, const uint16_t tci)
 {
-	static char buf[128];
+	char buf[128];
 	snprintf(buf, sizeof(buf), "vlan %u, p %u%s",
 	         tci & 0xfff,
 	         tci >> 13,
 	         (tci & 0x1000) ? ", DEI" : "");
-	return buf;
+	return nd_scratch_strdup(ndo, buf);
 }
@@ -58,11 +58,13 @@ extern const char *ipxsap_string(netdissect_options *, u_short);
 extern const char *ipaddr_string(netdissect_options *, const u_char *);
 extern const char *ip6addr_string(netdissect_options *, const u_char *);
 extern const char *intoa(uint32_t);
+extern const char *nd_intoa(netdissect_options *, uint32_t);
 
 extern void init_addrtoname(netdissect_options *, uint32_t, uint32_t);
+extern void load_addrtoname_tables(netdissect_options *);
+extern void free_addrtoname(netdissect_options *);
 extern struct hnamemem *newhnamemem(netdissect_options *);
-extern struct h6namemem *newh6namemem(netdissect_options *);
-extern const char * ieee8021q_tci_string(const uint16_t);
+extern const char * ieee8021q_tci_string(netdissect_options *, const uint16_t);
 
 /* macro(s) and inline function(s) with setjmp/longjmp logic to call
  * the X_string() function(s) after bounds checking.
@@ -106,7 +106,10 @@ addrtostr6 (const void *src, char *dst, size_t size)
   const u_char *srcaddr = (const u_char *)src;
   char *dp;
   size_t space_left, added_space;
-  int snprintfed;
+  static const char hexdigits[] = "0123456789abcdef";
+  char hex[4];
+  size_t nhex;
+  u_int word;
   struct {
     int base;
     int len;
@@ -184,15 +187,21 @@ addrtostr6 (const void *src, char *dst, size_t size)
       space_left -= added_space;
       break;
     }
-    snprintfed = snprintf (dp, space_left, "%x", words[i]);
-    if (snprintfed < 0)
-        return (NULL);
-    if ((size_t) snprintfed >= space_left) {
+    /* Format the word as with "%x", without the overhead of snprintf().
+     */
+    nhex = 0;
+    word = words[i];
+    do {
+      hex[nhex++] = hexdigits[word & 0xf];
+      word >>= 4;
+    } while (word != 0);
+    if (nhex >= space_left) {
         errno = ENOSPC;
         return (NULL);
     }
-    dp += snprintfed;
-    space_left -= snprintfed;
+    space_left -= nhex;
+    while (nhex != 0)
+      *dp++ = hex[--nhex];
   }
 
   /* Was it a trailing run of 0x00's?
@@ -0,0 +1,592 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ *
+ * Evaluation of filter programs by tcpdump, for reading savefiles.
+ *
+ * libpcap filters the packets it reads from a savefile with its BPF
+ * interpreter, which decodes each instruction again for every packet.
+ * Here the program is decoded once: each instruction gets an operation
+ * that a single switch dispatches on, the jumps get the indices of
+ * their targets, jumps to jumps are followed beforehand, and a load
+ * from the packet followed by a conditional jump on the loaded value
+ * (which is most of what pcap_compile() generates) becomes a single
+ * operation.  The result is the same as with bpf_filter().
+ */
+
+#include <config.h>
+
+#include "netdissect-stdinc.h"
+
+#include <pcap.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "netdissect.h"
+#include "extract.h"
+#include "bpf_fast.h"
+
+#ifndef BPF_MOD
+#define BPF_MOD		0x90
+#endif
+#ifndef BPF_XOR
+#define BPF_XOR		0xa0
+#endif
+
+enum bf_op {
+	BF_RET_K,
+	BF_RET_A,
+	BF_LD_W_ABS,
+	BF_LD_H_ABS,
+	BF_LD_B_ABS,
+	BF_LD_W_IND,
+	BF_LD_H_IND,
+	BF_LD_B_IND,
+	BF_LD_W_LEN,
+	BF_LD_IMM,
+	BF_LD_MEM,
+	BF_LDX_W_LEN,
+	BF_LDX_IMM,
+	BF_LDX_MEM,
+	BF_LDX_MSH,
+	BF_ST,
+	BF_STX,
+	BF_JA,
+	BF_JEQ_K,
+	BF_JGT_K,
+	BF_JGE_K,
+	BF_JSET_K,
+	BF_JEQ_X,
+	BF_JGT_X,
+	BF_JGE_X,
+	BF_JSET_X,
+	BF_ADD_K,
+	BF_SUB_K,
+	BF_MUL_K,
+	BF_DIV_K,
+	BF_MOD_K,
+	BF_AND_K,
+	BF_OR_K,
+	BF_XOR_K,
+	BF_LSH_K,
+	BF_RSH_K,
+	BF_ADD_X,
+	BF_SUB_X,
+	BF_MUL_X,
+	BF_DIV_X,
+	BF_MOD_X,
+	BF_AND_X,
+	BF_OR_X,
+	BF_XOR_X,
+	BF_LSH_X,
+	BF_RSH_X,
+	BF_NEG,
+	BF_TAX,
+	BF_TXA,
+	/*
+	 * A load from the packet followed by a conditional jump on A; the
+	 * order is that of the loads above, each with the jumps above.
+	 */
+	BF_LD_W_ABS_JEQ,
+	BF_LD_W_ABS_JGT,
+	BF_LD_W_ABS_JGE,
+	BF_LD_W_ABS_JSET,
+	BF_LD_H_ABS_JEQ,
+	BF_LD_H_ABS_JGT,
+	BF_LD_H_ABS_JGE,
+	BF_LD_H_ABS_JSET,
+	BF_LD_B_ABS_JEQ,
+	BF_LD_B_ABS_JGT,
+	BF_LD_B_ABS_JGE,
+	BF_LD_B_ABS_JSET,
+	BF_LD_W_IND_JEQ,
+	BF_LD_W_IND_JGT,
+	BF_LD_W_IND_JGE,
+	BF_LD_W_IND_JSET,
+	BF_LD_H_IND_JEQ,
+	BF_LD_H_IND_JGT,
+	BF_LD_H_IND_JGE,
+	BF_LD_H_IND_JSET,
+	BF_LD_B_IND_JEQ,
+	BF_LD_B_IND_JGT,
+	BF_LD_B_IND_JGE,
+	BF_LD_B_IND_JSET
+};
+
+struct bf_insn {
+	uint32_t op;
+	uint32_t k;
+	uint32_t cmp;			/* for a load and jump, the jump's k */
+	uint32_t jt;			/* indices of the instructions jumped to */
+	uint32_t jf;
+};
+
+struct bpf_fast {
+	struct bf_insn *insns;
+	int uses_mem;			/* whether the scratch memory is used */
+};
+
+/*
+ * Decode an instruction, or return -1 if it isn't a valid one, or not
+ * one we handle; libpcap is then left to deal with the program.  The
+ * checks are those of bpf_validate().
+ */
+static int
+bf_decode(const struct bpf_insn *bi, u_int i, u_int len, struct bf_insn *ins)
+{
+	static const uint8_t alu_ops[16] = {
+		BF_ADD_K, BF_SUB_K, BF_MUL_K, BF_DIV_K, BF_OR_K, BF_AND_K,
+		BF_LSH_K, BF_RSH_K, 0, BF_MOD_K, BF_XOR_K, 0, 0, 0, 0, 0
+	};
+	u_int op;
+
+	ins->k = bi->k;
+	ins->cmp = 0;
+	ins->jt = ins->jf = i + 1;
+	switch (bi->code) {
+	case BPF_RET|BPF_K:
+		op = BF_RET_K;
+		break;
+	case BPF_RET|BPF_A:
+		op = BF_RET_A;
+		break;
+	case BPF_LD|BPF_W|BPF_ABS:
+	case BPF_LD|BPF_H|BPF_ABS:
+	case BPF_LD|BPF_B|BPF_ABS:
+		/*
+		 * Offsets this large are for the Linux extensions that
+		 * load packet metadata; leave those to libpcap.
+		 */
+		if (bi->k >= 0x80000000U)
+			return -1;
+		op = bi->code == (BPF_LD|BPF_W|BPF_ABS) ? BF_LD_W_ABS :
+		    bi->code == (BPF_LD|BPF_H|BPF_ABS) ? BF_LD_H_ABS :
+		    BF_LD_B_ABS;
+		break;
+	case BPF_LD|BPF_W|BPF_IND:
+		op = BF_LD_W_IND;
+		break;
+	case BPF_LD|BPF_H|BPF_IND:
+		op = BF_LD_H_IND;
+		break;
+	case BPF_LD|BPF_B|BPF_IND:
+		op = BF_LD_B_IND;
+		break;
+	case BPF_LD|BPF_W|BPF_LEN:
+		op = BF_LD_W_LEN;
+		break;
+	case BPF_LDX|BPF_W|BPF_LEN:
+		op = BF_LDX_W_LEN;
+		break;
+	case BPF_LD|BPF_IMM:
+		op = BF_LD_IMM;
+		break;
+	case BPF_LDX|BPF_IMM:
+		op = BF_LDX_IMM;
+		break;
+	case BPF_LDX|BPF_MSH|BPF_B:
+		op = BF_LDX_MSH;
+		break;
+	case BPF_LD|BPF_MEM:
+	case BPF_LDX|BPF_MEM:
+	case BPF_ST:
+	case BPF_STX:
+		if (bi->k >= BPF_MEMWORDS)
+			return -1;
+		op = bi->code == (BPF_LD|BPF_MEM) ? BF_LD_MEM :
+		    bi->code == (BPF_LDX|BPF_MEM) ? BF_LDX_MEM :
+		    bi->code == BPF_ST ? BF_ST : BF_STX;
+		break;
+	case BPF_JMP|BPF_JA:
+		if (bi->k >= len - (i + 1))
+			return -1;
+		ins->jt = ins->jf = i + 1 + bi->k;
+		op = BF_JA;
+		break;
+	case BPF_JMP|BPF_JEQ|BPF_K:
+	case BPF_JMP|BPF_JGT|BPF_K:
+	case BPF_JMP|BPF_JGE|BPF_K:
+	case BPF_JMP|BPF_JSET|BPF_K:
+	case BPF_JMP|BPF_JEQ|BPF_X:
+	case BPF_JMP|BPF_JGT|BPF_X:
+	case BPF_JMP|BPF_JGE|BPF_X:
+	case BPF_JMP|BPF_JSET|BPF_X:
+		if (i + 1 + bi->jt >= len || i + 1 + bi->jf >= len)
+			return -1;
+		ins->jt = i + 1 + bi->jt;
+		ins->jf = i + 1 + bi->jf;
+		op = (BPF_SRC(bi->code) == BPF_X ? BF_JEQ_X : BF_JEQ_K) +
+		    (BPF_OP(bi->code) - BPF_JEQ) / BPF_JEQ;
+		break;
+	case BPF_ALU|BPF_NEG:
+		op = BF_NEG;
+		break;
+	case BPF_MISC|BPF_TAX:
+		op = BF_TAX;
+		break;
+	case BPF_MISC|BPF_TXA:
+		op = BF_TXA;
+		break;
+	default:
+		if (BPF_CLASS(bi->code) != BPF_ALU ||
+		    (bi->code & ~(BPF_OP(0xff)|BPF_SRC(0xff)|BPF_CLASS(0xff))) != 0)
+			return -1;
+		op = alu_ops[BPF_OP(bi->code) >> 4];
+		if (op == 0)
+			return -1;
+		if (BPF_SRC(bi->code) == BPF_K) {
+			if ((op == BF_DIV_K || op == BF_MOD_K) && bi->k == 0)
+				return -1;
+			if ((op == BF_LSH_K || op == BF_RSH_K) && bi->k >= 32)
+				return -1;
+		} else
+			op += BF_ADD_X - BF_ADD_K;
+		break;
+	}
+	ins->op = op;
+	return 0;
+}
+
+/*
+ * Prepare a program compiled by pcap_compile() for bpf_fast_filter(),
+ * or return NULL if libpcap has to run it.
+ */
+struct bpf_fast *
+bpf_fast_compile(const struct bpf_program *fcode)
+{
+	struct bpf_fast *prog;
+	struct bf_insn *ins, *next;
+	u_int len = fcode->bf_len;
+	u_int i;
+
+	if (len == 0 || fcode->bf_insns == NULL ||
+	    BPF_CLASS(fcode->bf_insns[len - 1].code) != BPF_RET)
+		return NULL;
+	prog = (struct bpf_fast *)calloc(1, sizeof(*prog));
+	if (prog == NULL)
+		return NULL;
+	prog->insns = (struct bf_insn *)calloc(len, sizeof(*prog->insns));
+	if (prog->insns == NULL) {
+		free(prog);
+		return NULL;
+	}
+	for (i = 0; i < len; i++) {
+		if (bf_decode(&fcode->bf_insns[i], i, len,
+		    &prog->insns[i]) < 0) {
+			bpf_fast_free(prog);
+			return NULL;
+		}
+		if (prog->insns[i].op == BF_LD_MEM ||
+		    prog->insns[i].op == BF_LDX_MEM)
+			prog->uses_mem = 1;
+	}
+
+	/*
+	 * Jumps only go forward, so going backward the targets of the
+	 * jumps to an unconditional jump have already been followed.
+	 */
+	for (i = len; i-- > 0;) {
+		ins = &prog->insns[i];
+		if (ins->op < BF_JA || ins->op > BF_JSET_X)
+			continue;
+		if (prog->insns[ins->jt].op == BF_JA)
+			ins->jt = prog->insns[ins->jt].jt;
+		if (prog->insns[ins->jf].op == BF_JA)
+			ins->jf = prog->insns[ins->jf].jt;
+	}
+
+	/*
+	 * Fuse the loads with the jumps that follow them.  The jump is
+	 * left in place, as other jumps may go to it.
+	 */
+	for (i = 0; i + 1 < len; i++) {
+		ins = &prog->insns[i];
+		next = &prog->insns[i + 1];
+		if (ins->op < BF_LD_W_ABS || ins->op > BF_LD_B_IND ||
+		    next->op < BF_JEQ_K || next->op > BF_JSET_K)
+			continue;
+		ins->op = BF_LD_W_ABS_JEQ + (ins->op - BF_LD_W_ABS) * 4 +
+		    (next->op - BF_JEQ_K);
+		ins->cmp = next->k;
+		ins->jt = next->jt;
+		ins->jf = next->jf;
+	}
+	return prog;
+}
+
+void
+bpf_fast_free(struct bpf_fast *prog)
+{
+	if (prog != NULL) {
+		free(prog->insns);
+		free(prog);
+	}
+}
+
+/*
+ * The loads from the packet; as with bpf_filter(), a load beyond the
+ * captured data rejects the packet.
+ */
+#define LOAD_ABS(size, extract) \
+	k = ins->k; \
+	if (k > buflen || (size) > buflen - k) \
+		return 0; \
+	A = extract(p + k)
+#define LOAD_IND(size, extract) \
+	k = X + ins->k; \
+	if (ins->k > buflen || X > buflen - ins->k || (size) > buflen - k) \
+		return 0; \
+	A = extract(p + k)
+#define JUMP(cond) \
+	pc = (cond) ? ins->jt : ins->jf; \
+	break
+
+/* The four conditional jumps for each load. */
+#define LOAD_AND_JUMP(op, load, size, extract) \
+	case op ## _JEQ: \
+		load(size, extract); \
+		JUMP(A == ins->cmp); \
+	case op ## _JGT: \
+		load(size, extract); \
+		JUMP(A > ins->cmp); \
+	case op ## _JGE: \
+		load(size, extract); \
+		JUMP(A >= ins->cmp); \
+	case op ## _JSET: \
+		load(size, extract); \
+		JUMP((A & ins->cmp) != 0)
+
+/*
+ * Run the program on a packet of wirelen bytes of which buflen were
+ * captured; return 0 if the packet is rejected, and the snapshot
+ * length given by the program otherwise, as bpf_filter() does.
+ */
+u_int
+bpf_fast_filter(const struct bpf_fast *prog, const u_char *p, u_int wirelen,
+		u_int buflen)
+{
+	const struct bf_insn *ins;
+	uint32_t A = 0, X = 0, k;
+	uint32_t mem[BPF_MEMWORDS];
+	u_int pc = 0;
+
+	if (prog->uses_mem)
+		memset(mem, 0, sizeof(mem));
+	for (;;) {
+		ins = &prog->insns[pc++];
+		switch (ins->op) {
+
+		case BF_RET_K:
+			return ins->k;
+
+		case BF_RET_A:
+			return A;
+
+		case BF_LD_W_ABS:
+			LOAD_ABS(4, EXTRACT_BE_U_4);
+			break;
+
+		case BF_LD_H_ABS:
+			LOAD_ABS(2, EXTRACT_BE_U_2);
+			break;
+
+		case BF_LD_B_ABS:
+			LOAD_ABS(1, EXTRACT_U_1);
+			break;
+
+		case BF_LD_W_IND:
+			LOAD_IND(4, EXTRACT_BE_U_4);
+			break;
+
+		case BF_LD_H_IND:
+			LOAD_IND(2, EXTRACT_BE_U_2);
+			break;
+
+		case BF_LD_B_IND:
+			LOAD_IND(1, EXTRACT_U_1);
+			break;
+
+		case BF_LD_W_LEN:
+			A = wirelen;
+			break;
+
+		case BF_LD_IMM:
+			A = ins->k;
+			break;
+
+		case BF_LD_MEM:
+			A = mem[ins->k];
+			break;
+
+		case BF_LDX_W_LEN:
+			X = wirelen;
+			break;
+
+		case BF_LDX_IMM:
+			X = ins->k;
+			break;
+
+		case BF_LDX_MEM:
+			X = mem[ins->k];
+			break;
+
+		case BF_LDX_MSH:
+			k = ins->k;
+			if (k >= buflen)
+				return 0;
+			X = (EXTRACT_U_1(p + k) & 0xf) << 2;
+			break;
+
+		case BF_ST:
+			mem[ins->k] = A;
+			break;
+
+		case BF_STX:
+			mem[ins->k] = X;
+			break;
+
+		case BF_JA:
+			pc = ins->jt;
+			break;
+
+		case BF_JEQ_K:
+			JUMP(A == ins->k);
+
+		case BF_JGT_K:
+			JUMP(A > ins->k);
+
+		case BF_JGE_K:
+			JUMP(A >= ins->k);
+
+		case BF_JSET_K:
+			JUMP((A & ins->k) != 0);
+
+		case BF_JEQ_X:
+			JUMP(A == X);
+
+		case BF_JGT_X:
+			JUMP(A > X);
+
+		case BF_JGE_X:
+			JUMP(A >= X);
+
+		case BF_JSET_X:
+			JUMP((A & X) != 0);
+
+		case BF_ADD_K:
+			A += ins->k;
+			break;
+
+		case BF_SUB_K:
+			A -= ins->k;
+			break;
+
+		case BF_MUL_K:
+			A *= ins->k;
+			break;
+
+		case BF_DIV_K:
+			A /= ins->k;
+			break;
+
+		case BF_MOD_K:
+			A %= ins->k;
+			break;
+
+		case BF_AND_K:
+			A &= ins->k;
+			break;
+
+		case BF_OR_K:
+			A |= ins->k;
+			break;
+
+		case BF_XOR_K:
+			A ^= ins->k;
+			break;
+
+		case BF_LSH_K:
+			A <<= ins->k;
+			break;
+
+		case BF_RSH_K:
+			A >>= ins->k;
+			break;
+
+		case BF_ADD_X:
+			A += X;
+			break;
+
+		case BF_SUB_X:
+			A -= X;
+			break;
+
+		case BF_MUL_X:
+			A *= X;
+			break;
+
+		case BF_DIV_X:
+			if (X == 0)
+				return 0;
+			A /= X;
+			break;
+
+		case BF_MOD_X:
+			if (X == 0)
+				return 0;
+			A %= X;
+			break;
+
+		case BF_AND_X:
+			A &= X;
+			break;
+
+		case BF_OR_X:
+			A |= X;
+			break;
+
+		case BF_XOR_X:
+			A ^= X;
+			break;
+
+		case BF_LSH_X:
+			A = X < 32 ? A << X : 0;
+			break;
+
+		case BF_RSH_X:
+			A = X < 32 ? A >> X : 0;
+			break;
+
+		case BF_NEG:
+			A = 0U - A;
+			break;
+
+		case BF_TAX:
+			X = A;
+			break;
+
+		case BF_TXA:
+			A = X;
+			break;
+
+		LOAD_AND_JUMP(BF_LD_W_ABS, LOAD_ABS, 4, EXTRACT_BE_U_4);
+		LOAD_AND_JUMP(BF_LD_H_ABS, LOAD_ABS, 2, EXTRACT_BE_U_2);
+		LOAD_AND_JUMP(BF_LD_B_ABS, LOAD_ABS, 1, EXTRACT_U_1);
+		LOAD_AND_JUMP(BF_LD_W_IND, LOAD_IND, 4, EXTRACT_BE_U_4);
+		LOAD_AND_JUMP(BF_LD_H_IND, LOAD_IND, 2, EXTRACT_BE_U_2);
+		LOAD_AND_JUMP(BF_LD_B_IND, LOAD_IND, 1, EXTRACT_U_1);
+
+		default:
+			/* bpf_fast_compile() produces no other operations. */
+			return 0;
+		}
+	}
+}
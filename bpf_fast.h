@@ -0,0 +1,26 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ *
+ * Evaluation of filter programs by tcpdump, for reading savefiles.
+ */
+
+#ifndef tcpdump_bpf_fast_h
+#define tcpdump_bpf_fast_h
+
+struct bpf_fast;
+
+extern struct bpf_fast *bpf_fast_compile(const struct bpf_program *);
+extern u_int bpf_fast_filter(const struct bpf_fast *, const u_char *, u_int,
+			     u_int);
+extern void bpf_fast_free(struct bpf_fast *);
+
+#endif /* tcpdump_bpf_fast_h */
@@ -23,6 +23,7 @@
 
 
 #include "netdissect.h"
+#include "extract.h"
 
 /*
  * CRC-10 table generated using the following Python snippet:
@@ -93,6 +94,40 @@ verify_crc10_cksum(uint16_t accum, const u_char *p, int length)
     return accum;
 }
 
+/*
+ * Add the bytes of a block to the Fletcher sums: c0 is the sum of the
+ * bytes and c1 the sum of the successive values of c0.
+ *
+ * For eight bytes b0 ... b7, c1 grows by 8 * c0 + 8 * b0 + 7 * b1 + ...
+ * + b7 and c0 by b0 + ... + b7; both sums of the bytes are computed in
+ * 16-bit lanes of a 64-bit word, with a multiplication adding the lanes
+ * into the top one.  The reduction modulo 255 is left to the end, as
+ * c0 and c1 can't overflow for anything the size of a packet.
+ */
+static void
+osi_cksum_add(const uint8_t *p, int len, uint32_t *c0p, uint64_t *c1p)
+{
+    uint32_t c0 = *c0p;
+    uint64_t c1 = *c1p;
+    uint64_t x, even, pairs;
+
+    for (; len >= 8; p += 8, len -= 8) {
+        x = EXTRACT_LE_U_8(p);
+        even = x & 0x00FF00FF00FF00FFULL;		/* b0, b2, b4, b6 */
+        pairs = even + ((x >> 8) & 0x00FF00FF00FF00FFULL);
+        c1 += 8 * (uint64_t)c0 +
+            ((pairs * 0x0007000500030001ULL) >> 48) +
+            ((even * 0x0001000100010001ULL) >> 48);
+        c0 += (uint32_t)((pairs * 0x0001000100010001ULL) >> 48);
+    }
+    for (; len > 0; len--) {
+        c0 += *p++;
+        c1 += c0;
+    }
+    *c0p = c0;
+    *c1p = c1;
+}
+
 /*
  * Creates the OSI Fletcher checksum. See 8473-1, Appendix C, section C.3.
  * The checksum field of the passed PDU does not need to be reset to zero.
@@ -107,24 +142,24 @@ create_osi_cksum (const uint8_t *pptr, int checksum_offset, int length)
     uint32_t c0;
     uint64_t c1;
     uint16_t checksum;
-    int idx;
+    int idx, field;
 
     c0 = 0;
     c1 = 0;
 
-    for (idx = 0; idx < length; idx++) {
-        /*
-         * Ignore the contents of the checksum field.
-         */
-        if (idx == checksum_offset ||
-            idx == checksum_offset+1) {
-            c1 += c0;
-            pptr++;
-        } else {
-            c0 = c0 + *(pptr++);
+    /*
+     * Sum the bytes around the checksum field, whose contents are
+     * ignored: each of its bytes counts as a zero.
+     */
+    idx = 0;
+    for (field = checksum_offset; field < checksum_offset + 2; field++) {
+        if (field >= idx && field < length) {
+            osi_cksum_add(pptr + idx, field - idx, &c0, &c1);
             c1 += c0;
+            idx = field + 1;
         }
     }
+    osi_cksum_add(pptr + idx, length - idx, &c0, &c1);
 
     c0 = c0 % 255;
     c1 = c1 % 255;
@@ -0,0 +1,637 @@
+/*
+ * Copyright (c) 2025 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Decode benchmark driver.
+ *
+ * Replays each savefile given on the command line through the same
+ * printing path as "tcpdump -r" (get_if_printer() and
+ * pretty_print_packet()), with the standard output sent to the null
+ * device, and reports for each file one line of tab-separated fields:
+ *
+ *	file packets bytes iterations elapsed_ns allocations maxrss_kb
+ *
+ * "allocations" is the number of malloc()/calloc()/realloc()/strdup()
+ * calls made by pretty_print_packet() during the timed iterations, not
+ * counting those of libpcap opening and reading the file, or -1 if the
+ * driver was built without allocation counting.  "maxrss_kb" is the
+ * peak resident set size of the process, so run one file per process
+ * to get per-file values.  tests/BENCHrun uses this to produce its
+ * results file.
+ *
+ * With -t, it instead times tok2str() and bittok2str() on some of the
+ * largest token tables, checks that they, and nd_tok2str() and
+ * nd_bittok2str(), give the same strings as a linear scan of the
+ * tables, and reports one line per table:
+ *
+ *	table function lookups elapsed_ns ns_per_lookup
+ *
+ * where function is "tok2str" for values in the table, "tok2str-miss"
+ * for values that aren't, or "bittok2str".
+ *
+ * With -k, it instead checks that create_osi_cksum() gives the same
+ * checksums as a byte-at-a-time reference on random data, lengths and
+ * checksum field offsets, times both on a few PDU lengths, and reports
+ * one line per function and length:
+ *
+ *	function length checksums elapsed_ns mb_per_s
+ *
+ * where function is "create_osi_cksum" or "reference".
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "netdissect-stdinc.h"
+#include "netdissect.h"
+#include "ascii_strcasecmp.h"
+#include "ethertype.h"
+#include "ipproto.h"
+#include "oui.h"
+#include "print.h"
+#include "tcp.h"
+
+#ifdef DECODE_BENCH_COUNT_ALLOCS
+/*
+ * Linked with "-Wl,--wrap=malloc,..." so that the calls made by
+ * libnetdissect end up here.
+ */
+extern void *__real_malloc(size_t);
+extern void *__real_calloc(size_t, size_t);
+extern void *__real_realloc(void *, size_t);
+extern char *__real_strdup(const char *);
+
+void *__wrap_malloc(size_t);
+void *__wrap_calloc(size_t, size_t);
+void *__wrap_realloc(void *, size_t);
+char *__wrap_strdup(const char *);
+
+static uint64_t alloc_count;
+static int alloc_counting;	/* in pretty_print_packet() */
+
+void *
+__wrap_malloc(size_t size)
+{
+	if (alloc_counting)
+		alloc_count++;
+	return __real_malloc(size);
+}
+
+void *
+__wrap_calloc(size_t nmemb, size_t size)
+{
+	if (alloc_counting)
+		alloc_count++;
+	return __real_calloc(nmemb, size);
+}
+
+void *
+__wrap_realloc(void *ptr, size_t size)
+{
+	if (alloc_counting)
+		alloc_count++;
+	return __real_realloc(ptr, size);
+}
+
+char *
+__wrap_strdup(const char *s)
+{
+	if (alloc_counting)
+		alloc_count++;
+	return __real_strdup(s);
+}
+#endif /* DECODE_BENCH_COUNT_ALLOCS */
+
+struct bench_state {
+	netdissect_options *ndo;
+	u_int packets;
+	uint64_t bytes;
+};
+
+static const char *program_name = "decode-bench";
+
+static void NORETURN
+usage(void)
+{
+	(void)fprintf(stderr,
+	    "Usage: %s [-eqSxXv] [-c iterations] [-T type] file ...\n",
+	    program_name);
+	(void)fprintf(stderr,
+	    "       %s -t [-c iterations]\n", program_name);
+	(void)fprintf(stderr,
+	    "       %s -k [-c iterations]\n", program_name);
+	exit(S_ERR_HOST_PROGRAM);
+}
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static void
+bench_packet(u_char *user, const struct pcap_pkthdr *h, const u_char *sp)
+{
+	struct bench_state *st = (struct bench_state *)user;
+
+	st->packets++;
+	st->bytes += h->caplen;
+#ifdef DECODE_BENCH_COUNT_ALLOCS
+	alloc_counting = 1;
+#endif
+	pretty_print_packet(st->ndo, h, sp, st->packets);
+#ifdef DECODE_BENCH_COUNT_ALLOCS
+	alloc_counting = 0;
+#endif
+}
+
+/*
+ * Decode the whole file once; returns -1 if it can't be read.
+ */
+static int
+bench_file(struct bench_state *st, const char *fname)
+{
+	char ebuf[PCAP_ERRBUF_SIZE];
+	pcap_t *pd;
+	int status;
+
+	pd = pcap_open_offline(fname, ebuf);
+	if (pd == NULL) {
+		(void)fprintf(stderr, "%s: %s\n", program_name, ebuf);
+		return -1;
+	}
+	st->ndo->ndo_snaplen = pcap_snapshot(pd);
+	st->ndo->ndo_if_printer = get_if_printer(pcap_datalink(pd));
+	st->packets = 0;
+	st->bytes = 0;
+	status = pcap_loop(pd, -1, bench_packet, (u_char *)st);
+	if (status == -1)
+		(void)fprintf(stderr, "%s: %s: %s\n", program_name, fname,
+		    pcap_geterr(pd));
+	(void)fflush(stdout);
+	pcap_close(pd);
+	return status == -1 ? -1 : 0;
+}
+
+/*
+ * The reference lookups: what tok2str() and bittok2str() did before
+ * the token tables were indexed.
+ */
+static const char *
+ref_tok2str(const struct tok *lp, const char *fmt, u_int v, char *buf,
+	    size_t bufsize)
+{
+	for (; lp->s != NULL; lp++) {
+		if (lp->v == v)
+			return lp->s;
+	}
+	(void)snprintf(buf, bufsize, fmt == NULL ? "#%d" : fmt, v);
+	return buf;
+}
+
+static const char *
+ref_bittok2str(const struct tok *lp, const char *fmt, u_int v, char *buf,
+	       size_t bufsize)
+{
+	const char *sep = "";
+	size_t len = 0;
+
+	for (; lp->s != NULL && len < bufsize; lp++) {
+		if (lp->v && (v & lp->v) == lp->v) {
+			len += strlcpy(buf + len, sep, bufsize - len);
+			if (len < bufsize)
+				len += strlcpy(buf + len, lp->s,
+				    bufsize - len);
+			sep = ", ";
+		}
+	}
+	if (len == 0)
+		(void)snprintf(buf, bufsize, fmt == NULL ? "#%08x" : fmt, v);
+	return buf;
+}
+
+/* A flags table longer than any in the tree. */
+static const struct tok bench_bit_values[] = {
+	{ 0x00000001, "b0" },	{ 0x00000002, "b1" },
+	{ 0x00000004, "b2" },	{ 0x00000008, "b3" },
+	{ 0x00000010, "b4" },	{ 0x00000020, "b5" },
+	{ 0x00000040, "b6" },	{ 0x00000080, "b7" },
+	{ 0x00000300, "b8-9" },	{ 0x00000400, "b10" },
+	{ 0x00000800, "b11" },	{ 0x00001000, "b12" },
+	{ 0x00002000, "b13" },	{ 0x0000c000, "b14-15" },
+	{ 0x00010000, "b16" },	{ 0x00020000, "b17" },
+	{ 0x00040000, "b18" },	{ 0x00080000, "b19" },
+	{ 0x00100000, "b20" },	{ 0x00200000, "b21" },
+	{ 0x00400000, "b22" },	{ 0x00800000, "b23" },
+	{ 0x01000000, "b24" },	{ 0x02000000, "b25" },
+	{ 0x04000000, "b26" },	{ 0x08000000, "b27" },
+	{ 0x10000000, "b28" },	{ 0x20000000, "b29" },
+	{ 0x40000000, "b30" },	{ 0x80000000, "b31" },
+	{ 0x00000001, "b0 again" },
+	{ 0, NULL }
+};
+
+static const struct {
+	const char *name;
+	const struct tok *table;
+	int bits;
+} bench_tables[] = {
+	{ "ipproto_values",	ipproto_values,		0 },
+	{ "ethertype_values",	ethertype_values,	0 },
+	{ "oui_values",		oui_values,		0 },
+	{ "smi_values",		smi_values,		0 },
+	{ "tcp_flag_values",	tcp_flag_values,	1 },
+	{ "bench_bit_values",	bench_bit_values,	1 },
+};
+
+static void
+bench_report(FILE *report, const char *table, const char *function,
+	     u_int nvalues, u_int iterations, uint64_t elapsed)
+{
+	uint64_t lookups = (uint64_t)nvalues * iterations;
+
+	(void)fprintf(report, "%s\t%s\t%" PRIu64 "\t%" PRIu64 "\t%.1f\n",
+	    table, function, lookups, elapsed, (double)elapsed /
+	    (double)lookups);
+}
+
+/*
+ * Look up every value of each table, and as many values that aren't in
+ * it; returns -1 if a lookup doesn't match the reference one.
+ */
+static int
+bench_tok_tables(netdissect_options *ndo, FILE *report, u_int iterations)
+{
+	char ref[1024 + 1];
+	const struct tok *lp;
+	const char *s, *r;
+	u_int *values, nvalues, ntoks, t, i, j, k, mask;
+	uint32_t x = 2463534242U;	/* xorshift32 state */
+	volatile size_t sink = 0;
+	uint64_t start;
+	int ret = 0;
+
+	for (t = 0; t < sizeof(bench_tables) / sizeof(bench_tables[0]); t++) {
+		lp = bench_tables[t].table;
+		for (ntoks = 0; lp[ntoks].s != NULL; ntoks++)
+			;
+		nvalues = bench_tables[t].bits ? 4096 : 2 * ntoks;
+		values = (u_int *)malloc(nvalues * sizeof(*values));
+		if (values == NULL) {
+			(void)fprintf(stderr, "%s: malloc failed\n",
+			    program_name);
+			return -1;
+		}
+		if (bench_tables[t].bits) {
+			/*
+			 * Random combinations of the flags, with about
+			 * one in eight set.
+			 */
+			for (i = 0, mask = 0; i < ntoks; i++)
+				mask |= lp[i].v;
+			for (i = 0; i < nvalues; i++) {
+				values[i] = mask;
+				for (k = 0; k < 3; k++) {
+					x ^= x << 13;
+					x ^= x >> 17;
+					x ^= x << 5;
+					values[i] &= x;
+				}
+			}
+		} else {
+			/* The values, and values next to them. */
+			for (i = 0; i < ntoks; i++) {
+				values[2 * i] = lp[i].v;
+				values[2 * i + 1] = lp[i].v + 0x10001;
+			}
+		}
+
+		for (i = 0; i < nvalues; i++) {
+			if (bench_tables[t].bits) {
+				s = bittok2str(lp, NULL, values[i]);
+				r = ref_bittok2str(lp, NULL, values[i], ref,
+				    sizeof(ref));
+			} else {
+				s = tok2str(lp, NULL, values[i]);
+				r = ref_tok2str(lp, NULL, values[i], ref,
+				    sizeof(ref));
+			}
+			if (strcmp(s, r) != 0 ||
+			    strcmp(bench_tables[t].bits ?
+			    nd_bittok2str(ndo, lp, NULL, values[i]) :
+			    nd_tok2str(ndo, lp, NULL, values[i]), r) != 0) {
+				(void)fprintf(stderr,
+				    "%s: %s: 0x%x gives \"%s\", not \"%s\"\n",
+				    program_name, bench_tables[t].name,
+				    values[i], s, r);
+				ret = -1;
+				break;
+			}
+		}
+
+		if (bench_tables[t].bits) {
+			start = now_ns();
+			for (j = 0; j < iterations / 16; j++) {
+				for (i = 0; i < nvalues; i++) {
+					s = bittok2str(lp, NULL, values[i]);
+					sink += (size_t)s[0];
+				}
+			}
+			bench_report(report, bench_tables[t].name,
+			    "bittok2str", nvalues, iterations / 16,
+			    now_ns() - start);
+		} else {
+			/*
+			 * Time the values found apart from the others,
+			 * whose cost is mostly formatting them.
+			 */
+			for (k = 0; k < 2; k++) {
+				start = now_ns();
+				for (j = 0; j < iterations; j++) {
+					for (i = k; i < nvalues; i += 2) {
+						s = tok2str(lp, NULL,
+						    values[i]);
+						sink += (size_t)s[0];
+					}
+				}
+				bench_report(report, bench_tables[t].name,
+				    k == 0 ? "tok2str" : "tok2str-miss",
+				    ntoks, iterations, now_ns() - start);
+			}
+		}
+		free(values);
+	}
+	(void)fflush(report);
+	return ret;
+}
+
+/*
+ * The reference OSI checksum: what create_osi_cksum() did before it
+ * summed the bytes a block at a time.
+ */
+static uint16_t
+ref_osi_cksum(const uint8_t *pptr, int checksum_offset, int length)
+{
+	int x, y, idx;
+	int32_t mul;
+	uint32_t c0 = 0;
+	uint64_t c1 = 0;
+
+	for (idx = 0; idx < length; idx++) {
+		if (idx == checksum_offset || idx == checksum_offset + 1) {
+			c1 += c0;
+			pptr++;
+		} else {
+			c0 = c0 + *(pptr++);
+			c1 += c0;
+		}
+	}
+	c0 = c0 % 255;
+	c1 = c1 % 255;
+	mul = (length - checksum_offset) * (c0);
+	x = mul - (int)c0 - (int)c1;
+	y = (int)c1 - mul;
+	x %= 255;
+	y %= 255;
+	if (x <= 0) x += 255;
+	if (y <= 0) y += 255;
+	y &= 0x00FF;
+	return (uint16_t)((x << 8) | y);
+}
+
+/* The largest PDU checked, more than an IS-IS LSP can be. */
+#define BENCH_CKSUM_MAXLEN	9000
+
+/*
+ * Compare create_osi_cksum() with the reference, then time them on
+ * the length of an ES-IS header, of a small and of a full-sized LSP,
+ * and of a jumbo frame; returns -1 if a checksum isn't the same.
+ */
+static int
+bench_osi_cksum(FILE *report, u_int iterations)
+{
+	static const int lengths[] = { 27, 128, 1492, BENCH_CKSUM_MAXLEN };
+	uint8_t *buf;
+	uint32_t x = 2463534242U;	/* xorshift32 state */
+	volatile u_int sink = 0;
+	uint64_t start, elapsed;
+	u_int i, j, k, n;
+	int len, off, ret = 0;
+
+	buf = (uint8_t *)malloc(BENCH_CKSUM_MAXLEN);
+	if (buf == NULL) {
+		(void)fprintf(stderr, "%s: malloc failed\n", program_name);
+		return -1;
+	}
+	for (i = 0; i < 100000 && ret == 0; i++) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		len = (int)(x % (i < 50000 ? 64 : BENCH_CKSUM_MAXLEN));
+		/* Include offsets at and past the end. */
+		off = len == 0 ? 0 : (int)((x >> 16) % (u_int)(len + 2));
+		for (j = 0; j < (u_int)len; j++) {
+			x ^= x << 13;
+			x ^= x >> 17;
+			x ^= x << 5;
+			/* Some runs of 0xff, to make the sums large. */
+			buf[j] = (i & 3) == 0 ? 0xff : (uint8_t)x;
+		}
+		if (create_osi_cksum(buf, off, len) !=
+		    ref_osi_cksum(buf, off, len)) {
+			(void)fprintf(stderr,
+			    "%s: length %d, offset %d: 0x%04x, not 0x%04x\n",
+			    program_name, len, off,
+			    create_osi_cksum(buf, off, len),
+			    ref_osi_cksum(buf, off, len));
+			ret = -1;
+		}
+	}
+
+	for (i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+		len = lengths[i];
+		/* About the same number of bytes for each length. */
+		n = (u_int)((uint64_t)iterations * 1500 / (u_int)len) + 1;
+		for (k = 0; k < 2; k++) {
+			start = now_ns();
+			for (j = 0; j < n; j++) {
+				sink += k == 0 ?
+				    create_osi_cksum(buf, 12, len) :
+				    ref_osi_cksum(buf, 12, len);
+			}
+			elapsed = now_ns() - start;
+			(void)fprintf(report, "%s\t%d\t%u\t%" PRIu64 "\t%.1f\n",
+			    k == 0 ? "create_osi_cksum" : "reference", len, n,
+			    elapsed, elapsed == 0 ? 0.0 :
+			    (double)n * (double)len * 1000.0 / (double)elapsed);
+		}
+	}
+	(void)fflush(report);
+	free(buf);
+	return ret;
+}
+
+int
+main(int argc, char **argv)
+{
+	netdissect_options Ndo;
+	netdissect_options *ndo = &Ndo;
+	struct bench_state st;
+	char ebuf[PCAP_ERRBUF_SIZE];
+	struct rusage ru;
+	FILE *report;
+	u_int iterations = 5;
+	u_int i;
+	uint64_t start, elapsed;
+	int64_t allocs;
+	int op, tflag = 0, kflag = 0, ret = S_SUCCESS;
+
+	if (nd_init(ebuf, sizeof(ebuf)) == -1) {
+		(void)fprintf(stderr, "%s: %s\n", program_name, ebuf);
+		exit(S_ERR_HOST_PROGRAM);
+	}
+	memset(ndo, 0, sizeof(*ndo));
+	ndo_set_function_pointers(ndo);
+	ndo->program_name = program_name;
+	/* Never let name resolution dominate the measurement. */
+	ndo->ndo_nflag = 1;
+
+	while ((op = getopt(argc, argv, "c:ekqStT:vxX")) != -1) {
+		switch (op) {
+		case 'c':
+			iterations = (u_int)strtoul(optarg, NULL, 10);
+			if (iterations == 0)
+				usage();
+			break;
+		case 'e':
+			++ndo->ndo_eflag;
+			break;
+		case 'k':
+			kflag = 1;
+			break;
+		case 'q':
+			++ndo->ndo_qflag;
+			break;
+		case 'S':
+			++ndo->ndo_Sflag;
+			break;
+		case 't':
+			tflag = 1;
+			break;
+		case 'T':
+			if (ascii_strcasecmp(optarg, "rpc") == 0)
+				ndo->ndo_packettype = PT_RPC;
+			else if (ascii_strcasecmp(optarg, "snmp") == 0)
+				ndo->ndo_packettype = PT_SNMP;
+			else if (ascii_strcasecmp(optarg, "domain") == 0)
+				ndo->ndo_packettype = PT_DOMAIN;
+			else if (ascii_strcasecmp(optarg, "quic") == 0)
+				ndo->ndo_packettype = PT_QUIC;
+			else
+				usage();
+			break;
+		case 'v':
+			++ndo->ndo_vflag;
+			break;
+		case 'x':
+			++ndo->ndo_xflag;
+			break;
+		case 'X':
+			++ndo->ndo_Xflag;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (tflag) {
+		if (optind != argc)
+			usage();
+		/* Many more lookups than packets in a file. */
+		if (bench_tok_tables(ndo, stdout, iterations * 1000) == -1)
+			ret = S_ERR_HOST_PROGRAM;
+		nd_free_context(ndo);
+		nd_cleanup();
+		return ret;
+	}
+	if (kflag) {
+		if (optind != argc)
+			usage();
+		if (bench_osi_cksum(stdout, iterations * 1000) == -1)
+			ret = S_ERR_HOST_PROGRAM;
+		nd_cleanup();
+		return ret;
+	}
+	if (optind >= argc)
+		usage();
+
+	/*
+	 * The report goes to the original standard output; the decoded
+	 * text goes to the null device.
+	 */
+	report = fdopen(dup(STDOUT_FILENO), "w");
+	if (report == NULL || freopen("/dev/null", "w", stdout) == NULL) {
+		(void)fprintf(stderr, "%s: can't redirect output: %s\n",
+		    program_name, strerror(errno));
+		exit(S_ERR_HOST_PROGRAM);
+	}
+
+	init_print(ndo, 0, 0);
+	st.ndo = ndo;
+
+	for (; optind < argc; optind++) {
+		const char *fname = argv[optind];
+
+		/* Warm up the name tables and per-protocol state. */
+		if (bench_file(&st, fname) == -1) {
+			ret = S_ERR_HOST_PROGRAM;
+			continue;
+		}
+#ifdef DECODE_BENCH_COUNT_ALLOCS
+		alloc_count = 0;
+#endif
+		elapsed = 0;
+		for (i = 0; i < iterations; i++) {
+			start = now_ns();
+			(void)bench_file(&st, fname);
+			elapsed += now_ns() - start;
+		}
+#ifdef DECODE_BENCH_COUNT_ALLOCS
+		allocs = (int64_t)alloc_count;
+#else
+		allocs = -1;
+#endif
+		if (getrusage(RUSAGE_SELF, &ru) == -1)
+			ru.ru_maxrss = 0;
+		(void)fprintf(report, "%s\t%u\t%" PRIu64 "\t%u\t%" PRIu64
+		    "\t%" PRId64 "\t%ld\n",
+		    fname, st.packets, st.bytes, iterations, elapsed, allocs,
+		    (long)ru.ru_maxrss);
+		(void)fflush(report);
+	}
+	nd_free_context(ndo);
+	nd_cleanup();
+	return ret;
+}
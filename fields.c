@@ -0,0 +1,449 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ *
+ * Fields of the packets, for --output-format json or csv.
+ *
+ * While a packet is dissected, the text output of the printers is
+ * discarded, and the printers that know about fields store their
+ * values here; once the packet is done, the values are written as one
+ * JSON object or CSV row, on one line.
+ */
+
+#include <config.h>
+
+#include "netdissect-stdinc.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "netdissect.h"
+#include "addrtostr.h"
+#include "fields.h"
+
+#define FIELDS_STRBUF_SIZE	1024	/* string values of a packet */
+#define FIELDS_LINE_SIZE	8192	/* output line */
+
+enum field_type {
+	FIELD_UINT,
+	FIELD_BOOL,
+	FIELD_STRING,
+	FIELD_TS
+};
+
+static const struct {
+	const char *name;
+	enum field_type type;
+} field_info[ND_FIELD_COUNT] = {
+	[ND_FIELD_TS] =			{ "ts", FIELD_TS },
+	[ND_FIELD_CAPLEN] =		{ "caplen", FIELD_UINT },
+	[ND_FIELD_LEN] =		{ "len", FIELD_UINT },
+	[ND_FIELD_PROTOCOL] =		{ "protocol", FIELD_STRING },
+	[ND_FIELD_TRUNCATED] =		{ "truncated", FIELD_BOOL },
+	[ND_FIELD_ETH_SRC] =		{ "eth_src", FIELD_STRING },
+	[ND_FIELD_ETH_DST] =		{ "eth_dst", FIELD_STRING },
+	[ND_FIELD_ETH_TYPE] =		{ "eth_type", FIELD_UINT },
+	[ND_FIELD_VLAN] =		{ "vlan", FIELD_UINT },
+	[ND_FIELD_IP_VERSION] =		{ "ip_version", FIELD_UINT },
+	[ND_FIELD_IP_SRC] =		{ "ip_src", FIELD_STRING },
+	[ND_FIELD_IP_DST] =		{ "ip_dst", FIELD_STRING },
+	[ND_FIELD_IP_PROTO] =		{ "ip_proto", FIELD_UINT },
+	[ND_FIELD_IP_TTL] =		{ "ip_ttl", FIELD_UINT },
+	[ND_FIELD_IP_TOS] =		{ "ip_tos", FIELD_UINT },
+	[ND_FIELD_IP_ID] =		{ "ip_id", FIELD_UINT },
+	[ND_FIELD_IP_LEN] =		{ "ip_len", FIELD_UINT },
+	[ND_FIELD_IP6_FLOW] =		{ "ip6_flow", FIELD_UINT },
+	[ND_FIELD_SPORT] =		{ "sport", FIELD_UINT },
+	[ND_FIELD_DPORT] =		{ "dport", FIELD_UINT },
+	[ND_FIELD_TCP_FLAGS] =		{ "tcp_flags", FIELD_UINT },
+	[ND_FIELD_TCP_SEQ] =		{ "tcp_seq", FIELD_UINT },
+	[ND_FIELD_TCP_ACK] =		{ "tcp_ack", FIELD_UINT },
+	[ND_FIELD_TCP_WIN] =		{ "tcp_win", FIELD_UINT },
+	[ND_FIELD_PAYLOAD_LEN] =	{ "payload_len", FIELD_UINT },
+	[ND_FIELD_ICMP_TYPE] =		{ "icmp_type", FIELD_UINT },
+	[ND_FIELD_ICMP_CODE] =		{ "icmp_code", FIELD_UINT },
+	[ND_FIELD_DNS_ID] =		{ "dns_id", FIELD_UINT },
+	[ND_FIELD_DNS_RESPONSE] =	{ "dns_response", FIELD_BOOL },
+	[ND_FIELD_DNS_OPCODE] =		{ "dns_opcode", FIELD_UINT },
+	[ND_FIELD_DNS_RCODE] =		{ "dns_rcode", FIELD_UINT },
+	[ND_FIELD_DNS_QNAME] =		{ "dns_qname", FIELD_STRING },
+	[ND_FIELD_DNS_QTYPE] =		{ "dns_qtype", FIELD_UINT },
+	[ND_FIELD_DNS_ANSWERS] =	{ "dns_answers", FIELD_UINT },
+	[ND_FIELD_NTP_VERSION] =	{ "ntp_version", FIELD_UINT },
+	[ND_FIELD_NTP_MODE] =		{ "ntp_mode", FIELD_UINT },
+	[ND_FIELD_NTP_STRATUM] =	{ "ntp_stratum", FIELD_UINT },
+};
+
+/*
+ * A value is set for the current packet if its generation is that of
+ * the packet, so that nothing has to be cleared between packets.
+ */
+struct field_value {
+	uint32_t gen;
+	uint16_t off;		/* string: offset in strbuf */
+	uint16_t len;		/* string: length */
+	uint64_t u;		/* number or boolean; seconds for ts */
+};
+
+struct nd_fields {
+	int (*saved_printf)(netdissect_options *, const char *, ...)
+	    PRINTFLIKE_FUNCPTR(2, 3);
+	uint32_t gen;
+	u_int layers;		/* layers whose fields are set */
+	u_int ts_frac;		/* micro or nanoseconds */
+	int csv_header_printed;
+	size_t strbuf_len;
+	struct field_value values[ND_FIELD_COUNT];
+	char strbuf[FIELDS_STRBUF_SIZE];
+	char line[FIELDS_LINE_SIZE];
+};
+
+/*
+ * How ASCII characters are written in JSON strings: as is (0), with a
+ * two characters escape sequence, or as \u00XX ('u'); the bytes above
+ * 0x7f are written as \u00XX too, i.e. taken as ISO 8859-1, as the
+ * printers don't know the encoding of what they decode.
+ */
+static const char json_escapes[128] = {
+	['\b'] = 'b', ['\t'] = 't', ['\n'] = 'n', ['\f'] = 'f', ['\r'] = 'r',
+	[0x00] = 'u', [0x01] = 'u', [0x02] = 'u', [0x03] = 'u', [0x04] = 'u',
+	[0x05] = 'u', [0x06] = 'u', [0x07] = 'u', [0x0b] = 'u', [0x0e] = 'u',
+	[0x0f] = 'u', [0x10] = 'u', [0x11] = 'u', [0x12] = 'u', [0x13] = 'u',
+	[0x14] = 'u', [0x15] = 'u', [0x16] = 'u', [0x17] = 'u', [0x18] = 'u',
+	[0x19] = 'u', [0x1a] = 'u', [0x1b] = 'u', [0x1c] = 'u', [0x1d] = 'u',
+	[0x1e] = 'u', [0x1f] = 'u',
+	['"'] = '"', ['\\'] = '\\', [0x7f] = 'u'
+};
+
+static const char hex[] = "0123456789abcdef";
+
+/* The text output of the printers. */
+static int PRINTFLIKE(2, 3)
+discard_printf(netdissect_options *ndo _U_,
+	       FORMAT_STRING(const char *fmt _U_), ...)
+{
+	return 0;
+}
+
+void
+nd_fields_init(netdissect_options *ndo)
+{
+	struct nd_fields *f;
+
+	f = calloc(1, sizeof(*f));
+	if (f == NULL)
+		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC, "%s: calloc",
+				  __func__);
+	ndo->ndo_fields = f;
+}
+
+void
+nd_fields_free(netdissect_options *ndo)
+{
+	free(ndo->ndo_fields);
+	ndo->ndo_fields = NULL;
+}
+
+/*
+ * Start a packet: from now on until nd_fields_end(), the text output
+ * is discarded.
+ */
+void
+nd_fields_begin(netdissect_options *ndo, const struct pcap_pkthdr *h)
+{
+	struct nd_fields *f = ndo->ndo_fields;
+
+	f->gen++;
+	if (f->gen == 0) {
+		/* Wrapped around: the values of 2^32 packets ago are set */
+		memset(f->values, 0, sizeof(f->values));
+		f->gen = 1;
+	}
+	f->layers = 0;
+	f->strbuf_len = 0;
+	f->saved_printf = ndo->ndo_printf;
+	ndo->ndo_printf = discard_printf;
+
+	f->values[ND_FIELD_TS].gen = f->gen;
+	f->values[ND_FIELD_TS].u = (uint64_t)h->ts.tv_sec;
+	f->ts_frac = (u_int)h->ts.tv_usec;
+	nd_field_uint(ndo, ND_FIELD_CAPLEN, h->caplen);
+	nd_field_uint(ndo, ND_FIELD_LEN, h->len);
+}
+
+/*
+ * Claim a layer for the header being dissected; returns 0 if its
+ * fields have been set by an outer header.
+ */
+int
+nd_fields_layer(netdissect_options *ndo, u_int layer)
+{
+	struct nd_fields *f = ndo->ndo_fields;
+
+	if (f->layers & layer)
+		return 0;
+	f->layers |= layer;
+	return 1;
+}
+
+void
+nd_field_uint(netdissect_options *ndo, enum nd_field field, uint64_t value)
+{
+	struct nd_fields *f = ndo->ndo_fields;
+
+	f->values[field].gen = f->gen;
+	f->values[field].u = value;
+}
+
+void
+nd_field_bool(netdissect_options *ndo, enum nd_field field, int value)
+{
+	nd_field_uint(ndo, field, value != 0);
+}
+
+/*
+ * Set a string value, which is copied; it is cut if the space for the
+ * strings of the packet is exhausted.
+ */
+void
+nd_field_string(netdissect_options *ndo, enum nd_field field,
+		const char *s, size_t len)
+{
+	struct nd_fields *f = ndo->ndo_fields;
+	size_t avail = sizeof(f->strbuf) - f->strbuf_len;
+
+	if (len > avail)
+		len = avail;
+	memcpy(f->strbuf + f->strbuf_len, s, len);
+	f->values[field].gen = f->gen;
+	f->values[field].off = (uint16_t)f->strbuf_len;
+	f->values[field].len = (uint16_t)len;
+	f->strbuf_len += len;
+}
+
+/*
+ * The address setters are given a pointer into the packet, which must
+ * have been checked to be in the captured data.
+ */
+void
+nd_field_ipv4(netdissect_options *ndo, enum nd_field field, const u_char *p)
+{
+	char buf[INET_ADDRSTRLEN];
+
+	addrtostr(p, buf, sizeof(buf));
+	nd_field_string(ndo, field, buf, strlen(buf));
+}
+
+void
+nd_field_ipv6(netdissect_options *ndo, enum nd_field field, const u_char *p)
+{
+	char buf[INET6_ADDRSTRLEN];
+
+	addrtostr6(p, buf, sizeof(buf));
+	nd_field_string(ndo, field, buf, strlen(buf));
+}
+
+void
+nd_field_mac48(netdissect_options *ndo, enum nd_field field, const u_char *p)
+{
+	char buf[MAC48_LEN * 3];
+	u_int i;
+
+	for (i = 0; i < MAC48_LEN; i++) {
+		buf[i * 3] = hex[p[i] >> 4];
+		buf[i * 3 + 1] = hex[p[i] & 0xf];
+		buf[i * 3 + 2] = ':';
+	}
+	nd_field_string(ndo, field, buf, sizeof(buf) - 1);
+}
+
+/*
+ * The line is written by appending to f->line; the appenders stop at
+ * ep, which leaves room for the delimiters written unchecked, and which
+ * the values of a packet can't reach anyway.
+ */
+static char *
+put_str(char *cp, const char *ep, const char *s)
+{
+	while (*s != '\0' && cp < ep)
+		*cp++ = *s++;
+	return cp;
+}
+
+static char *
+put_uint(char *cp, const char *ep, uint64_t u, u_int min_digits)
+{
+	char buf[20];
+	u_int n = 0;
+
+	do {
+		buf[n++] = (char)('0' + u % 10);
+		u /= 10;
+	} while (u != 0 || n < min_digits);
+	while (n != 0 && cp < ep)
+		*cp++ = buf[--n];
+	return cp;
+}
+
+static char *
+put_ts(netdissect_options *ndo, char *cp, const char *ep,
+       const struct nd_fields *f)
+{
+	cp = put_uint(cp, ep, f->values[ND_FIELD_TS].u, 1);
+	if (cp < ep)
+		*cp++ = '.';
+#ifdef HAVE_PCAP_SET_TSTAMP_PRECISION
+	if (ndo->ndo_tstamp_precision == PCAP_TSTAMP_PRECISION_NANO)
+		return put_uint(cp, ep, f->ts_frac, 9);
+#else
+	(void)ndo;
+#endif
+	return put_uint(cp, ep, f->ts_frac, 6);
+}
+
+static char *
+put_json_string(char *cp, const char *ep, const char *s, size_t len)
+{
+	const u_char *p = (const u_char *)s;
+	const u_char *end = p + len;
+	char esc;
+
+	if (cp < ep)
+		*cp++ = '"';
+	for (; p < end && ep - cp >= 6; p++) {
+		esc = *p < 0x80 ? json_escapes[*p] : 'u';
+		if (esc == 0)
+			*cp++ = (char)*p;
+		else if (esc != 'u') {
+			*cp++ = '\\';
+			*cp++ = esc;
+		} else {
+			memcpy(cp, "\\u00", 4);
+			cp[4] = hex[*p >> 4];
+			cp[5] = hex[*p & 0xf];
+			cp += 6;
+		}
+	}
+	if (cp < ep)
+		*cp++ = '"';
+	return cp;
+}
+
+/* RFC 4180: quoted if there is a comma, a quote or a line break. */
+static char *
+put_csv_string(char *cp, const char *ep, const char *s, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		if (s[i] == ',' || s[i] == '"' || s[i] == '\r' ||
+		    s[i] == '\n')
+			break;
+	if (i == len) {
+		for (i = 0; i < len && cp < ep; i++)
+			*cp++ = s[i];
+		return cp;
+	}
+	if (cp < ep)
+		*cp++ = '"';
+	for (i = 0; i < len && ep - cp >= 2; i++) {
+		if (s[i] == '"')
+			*cp++ = '"';
+		*cp++ = s[i];
+	}
+	if (cp < ep)
+		*cp++ = '"';
+	return cp;
+}
+
+static char *
+put_value(netdissect_options *ndo, char *cp, const char *ep,
+	  const struct nd_fields *f, enum nd_field field)
+{
+	const struct field_value *v = &f->values[field];
+
+	switch (field_info[field].type) {
+
+	case FIELD_UINT:
+		return put_uint(cp, ep, v->u, 1);
+
+	case FIELD_BOOL:
+		if (ndo->ndo_output_format == ND_OUTPUT_CSV)
+			return put_str(cp, ep, v->u ? "1" : "0");
+		return put_str(cp, ep, v->u ? "true" : "false");
+
+	case FIELD_STRING:
+		if (ndo->ndo_output_format == ND_OUTPUT_CSV)
+			return put_csv_string(cp, ep, f->strbuf + v->off,
+					      v->len);
+		return put_json_string(cp, ep, f->strbuf + v->off, v->len);
+
+	case FIELD_TS:
+		return put_ts(ndo, cp, ep, f);
+	}
+	return cp;
+}
+
+/*
+ * End a packet: restore the text output and write the fields set, as
+ * a JSON object, or as a CSV row with a column for each field, after
+ * a header line for the first packet.
+ */
+void
+nd_fields_end(netdissect_options *ndo)
+{
+	struct nd_fields *f = ndo->ndo_fields;
+	char *cp = f->line;
+	const char *ep = f->line + sizeof(f->line) - 3;
+	int field;
+	int first = 1;
+
+	if (ndo->ndo_protocol != NULL && *ndo->ndo_protocol != '\0')
+		nd_field_string(ndo, ND_FIELD_PROTOCOL, ndo->ndo_protocol,
+				strlen(ndo->ndo_protocol));
+	ndo->ndo_printf = f->saved_printf;
+
+	if (ndo->ndo_output_format == ND_OUTPUT_CSV) {
+		if (!f->csv_header_printed) {
+			for (field = 0; field < ND_FIELD_COUNT; field++) {
+				if (field != 0 && cp < ep)
+					*cp++ = ',';
+				cp = put_str(cp, ep, field_info[field].name);
+			}
+			*cp++ = '\n';
+			f->csv_header_printed = 1;
+		}
+		for (field = 0; field < ND_FIELD_COUNT; field++) {
+			if (field != 0 && cp < ep)
+				*cp++ = ',';
+			if (f->values[field].gen == f->gen)
+				cp = put_value(ndo, cp, ep, f, field);
+		}
+	} else {
+		*cp++ = '{';
+		for (field = 0; field < ND_FIELD_COUNT; field++) {
+			if (f->values[field].gen != f->gen)
+				continue;
+			if (!first && cp < ep)
+				*cp++ = ',';
+			first = 0;
+			cp = put_json_string(cp, ep, field_info[field].name,
+					     strlen(field_info[field].name));
+			if (cp < ep)
+				*cp++ = ':';
+			cp = put_value(ndo, cp, ep, f, field);
+		}
+		*cp++ = '}';
+	}
+	*cp++ = '\n';
+	*cp = '\0';
+	ND_PRINT("%s", f->line);
+}
@@ -0,0 +1,104 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ *
+ * Fields of the packets, for --output-format json or csv.
+ */
+
+#ifndef netdissect_fields_h
+#define netdissect_fields_h
+
+#include "netdissect.h"
+
+/*
+ * The fields, in the order of the JSON members and CSV columns; the
+ * names and types are in fields.c.
+ */
+enum nd_field {
+	ND_FIELD_TS,
+	ND_FIELD_CAPLEN,
+	ND_FIELD_LEN,
+	ND_FIELD_PROTOCOL,
+	ND_FIELD_TRUNCATED,
+	ND_FIELD_ETH_SRC,
+	ND_FIELD_ETH_DST,
+	ND_FIELD_ETH_TYPE,
+	ND_FIELD_VLAN,
+	ND_FIELD_IP_VERSION,
+	ND_FIELD_IP_SRC,
+	ND_FIELD_IP_DST,
+	ND_FIELD_IP_PROTO,
+	ND_FIELD_IP_TTL,
+	ND_FIELD_IP_TOS,
+	ND_FIELD_IP_ID,
+	ND_FIELD_IP_LEN,
+	ND_FIELD_IP6_FLOW,
+	ND_FIELD_SPORT,
+	ND_FIELD_DPORT,
+	ND_FIELD_TCP_FLAGS,
+	ND_FIELD_TCP_SEQ,
+	ND_FIELD_TCP_ACK,
+	ND_FIELD_TCP_WIN,
+	ND_FIELD_PAYLOAD_LEN,
+	ND_FIELD_ICMP_TYPE,
+	ND_FIELD_ICMP_CODE,
+	ND_FIELD_DNS_ID,
+	ND_FIELD_DNS_RESPONSE,
+	ND_FIELD_DNS_OPCODE,
+	ND_FIELD_DNS_RCODE,
+	ND_FIELD_DNS_QNAME,
+	ND_FIELD_DNS_QTYPE,
+	ND_FIELD_DNS_ANSWERS,
+	ND_FIELD_NTP_VERSION,
+	ND_FIELD_NTP_MODE,
+	ND_FIELD_NTP_STRATUM,
+	ND_FIELD_COUNT
+};
+
+/*
+ * Only the outermost header of each layer emits its fields, so that
+ * e.g. the IP header quoted in an ICMP error, or the inner headers of
+ * a tunnel, don't overwrite those of the packet.
+ */
+#define ND_LAYER_LINK		0x01
+#define ND_LAYER_NETWORK	0x02
+#define ND_LAYER_TRANSPORT	0x04
+#define ND_LAYER_APPLICATION	0x08
+
+/*
+ * A printer emits the fields of a layer, after having checked that the
+ * header is in the captured data, with
+ *
+ *	if (ND_FIELDS_LAYER(ndo, ND_LAYER_NETWORK)) {
+ *		nd_field_uint(ndo, ND_FIELD_IP_VERSION, 4);
+ *		...
+ *	}
+ */
+#define ND_FIELDS_LAYER(ndo, layer) \
+	((ndo)->ndo_fields != NULL && nd_fields_layer(ndo, layer))
+
+extern void nd_fields_init(netdissect_options *);
+extern void nd_fields_free(netdissect_options *);
+extern void nd_fields_begin(netdissect_options *, const struct pcap_pkthdr *);
+extern void nd_fields_end(netdissect_options *);
+extern int nd_fields_layer(netdissect_options *, u_int);
+extern void nd_field_uint(netdissect_options *, enum nd_field, uint64_t);
+extern void nd_field_bool(netdissect_options *, enum nd_field, int);
+extern void nd_field_string(netdissect_options *, enum nd_field,
+			    const char *, size_t);
+extern void nd_field_ipv4(netdissect_options *, enum nd_field,
+			  const u_char *);
+extern void nd_field_ipv6(netdissect_options *, enum nd_field,
+			  const u_char *);
+extern void nd_field_mac48(netdissect_options *, enum nd_field,
+			   const u_char *);
+
+#endif /* netdissect_fields_h */
@@ -0,0 +1,479 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ *
+ * Aggregation of the sFlow and NetFlow records, for --flow-collector.
+ *
+ * The sFlow and NetFlow printers decode the flow records into counts of
+ * packets and octets, scaled by the sampling rate, which are added up by
+ * exporter, agent, interfaces and 5-tuple; the last interface counters
+ * of each sFlow agent are kept as well.  The tables are printed, as CSV
+ * or JSON lines, and emptied, at the end of each report interval, on
+ * request and after the last packet.
+ */
+
+#include <config.h>
+
+#include "netdissect-stdinc.h"
+
+#include <string.h>
+
+#include "netdissect.h"
+#include "addrtostr.h"
+#include "extract.h"
+#include "ipproto.h"
+#include "udp.h"
+#include "lru_cache.h"
+#include "flow_collector.h"
+
+#define FLOW_TABLE_SIZE		16384	/* flows aggregated per report */
+#define FLOW_IF_TABLE_SIZE	1024	/* interfaces reported on */
+
+struct flow_counts {
+	uint64_t records;
+	uint64_t packets;
+	uint64_t octets;
+};
+
+struct flow_if_key {
+	uint8_t agent_ipver;
+	uint8_t pad[3];
+	uint32_t ifindex;
+	u_char agent[16];
+};
+
+struct flow_if_value {
+	uint64_t samples;
+	struct nd_flow_ifcounters counters;
+};
+
+static struct nd_lru_cache *flow_table;
+static struct nd_lru_cache *flow_if_table;
+
+/* Counts since the last report. */
+static struct {
+	uint64_t datagrams[ND_FLOW_NETFLOW + 1];
+	uint64_t records;
+	uint64_t malformed;
+	uint64_t evicted;
+} flow_stats;
+
+static time_t flow_next_report;		/* end of the report interval */
+static time_t flow_report_time;		/* time printed on the rows */
+static int flow_csv_header_printed;
+
+static const char *flow_exporters[] = { "", "sflow", "netflow" };
+
+/*
+ * A report row is a record type and a time, followed by named values;
+ * in CSV, the names are only in the header lines.
+ */
+static void
+report_begin(netdissect_options *ndo, const char *type)
+{
+	if (ndo->ndo_flow_collector == ND_FLOW_COLLECTOR_JSON)
+		ND_PRINT("{\"type\":\"%s\",\"time\":%" PRIu64, type,
+		    (uint64_t)flow_report_time);
+	else
+		ND_PRINT("%s,%" PRIu64, type, (uint64_t)flow_report_time);
+}
+
+static void
+report_uint(netdissect_options *ndo, const char *name, uint64_t value)
+{
+	if (ndo->ndo_flow_collector == ND_FLOW_COLLECTOR_JSON)
+		ND_PRINT(",\"%s\":%" PRIu64, name, value);
+	else
+		ND_PRINT(",%" PRIu64, value);
+}
+
+/* The strings are names and addresses, which need no escaping. */
+static void
+report_string(netdissect_options *ndo, const char *name, const char *value)
+{
+	if (ndo->ndo_flow_collector == ND_FLOW_COLLECTOR_JSON)
+		ND_PRINT(",\"%s\":\"%s\"", name, value);
+	else
+		ND_PRINT(",%s", value);
+}
+
+/* A value the row doesn't have: an empty CSV field, or no JSON member. */
+static void
+report_none(netdissect_options *ndo)
+{
+	if (ndo->ndo_flow_collector != ND_FLOW_COLLECTOR_JSON)
+		ND_PRINT(",");
+}
+
+static void
+report_end(netdissect_options *ndo)
+{
+	if (ndo->ndo_flow_collector == ND_FLOW_COLLECTOR_JSON)
+		ND_PRINT("}\n");
+	else
+		ND_PRINT("\n");
+}
+
+static void
+report_address(netdissect_options *ndo, const char *name, int ipver,
+	       const u_char *addr)
+{
+	char buf[INET6_ADDRSTRLEN];
+
+	if (ipver == 4)
+		addrtostr(addr, buf, sizeof(buf));
+	else
+		addrtostr6(addr, buf, sizeof(buf));
+	report_string(ndo, name, buf);
+}
+
+static void
+report_header(netdissect_options *ndo)
+{
+	if (ndo->ndo_flow_collector != ND_FLOW_COLLECTOR_CSV ||
+	    flow_csv_header_printed)
+		return;
+	ND_PRINT("#flow,time,exporter,agent,input,output,proto,src,sport,dst,"
+	    "dport,records,packets,octets\n");
+	ND_PRINT("#interface,time,agent,ifindex,samples,in_octets,in_packets,"
+	    "in_discards,in_errors,out_octets,out_packets,out_discards,"
+	    "out_errors\n");
+	ND_PRINT("#collector,time,sflow_datagrams,netflow_datagrams,records,"
+	    "malformed,evicted\n");
+	flow_csv_header_printed = 1;
+}
+
+static void
+report_flow(void *arg, const void *k, void *v)
+{
+	netdissect_options *ndo = (netdissect_options *)arg;
+	const struct nd_flow_key *key = (const struct nd_flow_key *)k;
+	const struct flow_counts *fc = (const struct flow_counts *)v;
+
+	report_begin(ndo, "flow");
+	report_string(ndo, "exporter", flow_exporters[key->exporter]);
+	report_address(ndo, "agent", key->agent_ipver, key->agent);
+	report_uint(ndo, "input", key->input);
+	report_uint(ndo, "output", key->output);
+	if (key->ipver != 0) {
+		report_uint(ndo, "proto", key->proto);
+		report_address(ndo, "src", key->ipver, key->src);
+		report_uint(ndo, "sport", key->sport);
+		report_address(ndo, "dst", key->ipver, key->dst);
+		report_uint(ndo, "dport", key->dport);
+	} else {
+		report_none(ndo);
+		report_none(ndo);
+		report_none(ndo);
+		report_none(ndo);
+		report_none(ndo);
+	}
+	report_uint(ndo, "records", fc->records);
+	report_uint(ndo, "packets", fc->packets);
+	report_uint(ndo, "octets", fc->octets);
+	report_end(ndo);
+}
+
+/* A flow pushed out of the full table is reported right away. */
+static void
+report_evicted_flow(void *arg, const void *k, void *v)
+{
+	netdissect_options *ndo = (netdissect_options *)arg;
+
+	flow_stats.evicted++;
+	flow_report_time = ndo->ndo_ts.tv_sec;
+	report_header(ndo);
+	report_flow(arg, k, v);
+}
+
+static void
+report_interface(void *arg, const void *k, void *v)
+{
+	netdissect_options *ndo = (netdissect_options *)arg;
+	const struct flow_if_key *key = (const struct flow_if_key *)k;
+	const struct flow_if_value *iv = (const struct flow_if_value *)v;
+
+	report_begin(ndo, "interface");
+	report_address(ndo, "agent", key->agent_ipver, key->agent);
+	report_uint(ndo, "ifindex", key->ifindex);
+	report_uint(ndo, "samples", iv->samples);
+	report_uint(ndo, "in_octets", iv->counters.in_octets);
+	report_uint(ndo, "in_packets", iv->counters.in_packets);
+	report_uint(ndo, "in_discards", iv->counters.in_discards);
+	report_uint(ndo, "in_errors", iv->counters.in_errors);
+	report_uint(ndo, "out_octets", iv->counters.out_octets);
+	report_uint(ndo, "out_packets", iv->counters.out_packets);
+	report_uint(ndo, "out_discards", iv->counters.out_discards);
+	report_uint(ndo, "out_errors", iv->counters.out_errors);
+	report_end(ndo);
+}
+
+/* Print the tables and the counts, stamped with when, and empty them. */
+static void
+flow_report(netdissect_options *ndo, time_t when)
+{
+	flow_report_time = when;
+	report_header(ndo);
+	if (flow_table != NULL) {
+		nd_lru_cache_walk(flow_table, report_flow, ndo);
+		nd_lru_cache_clear(flow_table);
+	}
+	if (flow_if_table != NULL) {
+		nd_lru_cache_walk(flow_if_table, report_interface, ndo);
+		nd_lru_cache_clear(flow_if_table);
+	}
+	report_begin(ndo, "collector");
+	report_uint(ndo, "sflow_datagrams",
+	    flow_stats.datagrams[ND_FLOW_SFLOW]);
+	report_uint(ndo, "netflow_datagrams",
+	    flow_stats.datagrams[ND_FLOW_NETFLOW]);
+	report_uint(ndo, "records", flow_stats.records);
+	report_uint(ndo, "malformed", flow_stats.malformed);
+	report_uint(ndo, "evicted", flow_stats.evicted);
+	report_end(ndo);
+	memset(&flow_stats, 0, sizeof(flow_stats));
+}
+
+/*
+ * Set the agent of key to the IPv4 (ipver 4) or IPv6 address at addr,
+ * which must be in the captured data.
+ */
+void
+nd_flow_key_set_agent(struct nd_flow_key *key, int ipver, const u_char *addr)
+{
+	key->agent_ipver = (uint8_t)ipver;
+	memcpy(key->agent, addr, ipver == 4 ? 4 : 16);
+}
+
+/*
+ * Set the IP version, addresses, protocol and, for TCP, UDP and SCTP,
+ * ports of key from the IPv4 or IPv6 header at p, of which len bytes are
+ * meant to be there.  As with --flow-sampling, IPv6 extension headers
+ * aren't walked and IPv4 fragments but the first have no ports.  Returns
+ * 0, leaving key unchanged, if there's no IP header.
+ */
+int
+nd_flow_key_set_ip(netdissect_options *ndo, struct nd_flow_key *key,
+		   const u_char *p, u_int len)
+{
+	const u_char *ports = NULL;
+	u_int hlen, proto;
+
+	len = ND_MIN(len, ND_BYTES_AVAILABLE_AFTER(p));
+	if (len < 1)
+		return 0;
+	switch (EXTRACT_U_1(p) >> 4) {
+
+	case 4:
+		if (len < 20)
+			return 0;
+		hlen = (EXTRACT_U_1(p) & 0x0f) * 4;
+		if (hlen < 20)
+			return 0;
+		proto = EXTRACT_U_1(p + 9);
+		key->ipver = 4;
+		memcpy(key->src, p + 12, 4);
+		memcpy(key->dst, p + 16, 4);
+		if ((EXTRACT_BE_U_2(p + 6) & 0x1fff) == 0 && len >= hlen + 4)
+			ports = p + hlen;
+		break;
+
+	case 6:
+		if (len < 40)
+			return 0;
+		proto = EXTRACT_U_1(p + 6);
+		key->ipver = 6;
+		memcpy(key->src, p + 8, 16);
+		memcpy(key->dst, p + 24, 16);
+		if (len >= 44)
+			ports = p + 40;
+		break;
+
+	default:
+		return 0;
+	}
+	key->proto = (uint8_t)proto;
+	if (ports != NULL && (proto == IPPROTO_TCP || proto == IPPROTO_UDP ||
+	    proto == IPPROTO_SCTP)) {
+		key->sport = EXTRACT_BE_U_2(ports);
+		key->dport = EXTRACT_BE_U_2(ports + 2);
+	}
+	return 1;
+}
+
+/*
+ * Add packets and octets, already scaled by the sampling rate, to the
+ * flow of key.
+ */
+void
+nd_flow_collect(netdissect_options *ndo, const struct nd_flow_key *key,
+		uint64_t packets, uint64_t octets)
+{
+	struct flow_counts *fc;
+
+	if (flow_table == NULL) {
+		flow_table = nd_lru_cache_create(ndo, FLOW_TABLE_SIZE,
+		    sizeof(struct nd_flow_key), sizeof(struct flow_counts));
+		nd_lru_cache_set_evict(flow_table, report_evicted_flow, ndo);
+	}
+	fc = (struct flow_counts *)nd_lru_cache_insert(flow_table, key);
+	fc->records++;
+	fc->packets += packets;
+	fc->octets += octets;
+	flow_stats.records++;
+}
+
+/*
+ * Keep the last counters of the interface ifindex of the agent at the
+ * IPv4 (ipver 4) or IPv6 address agent.
+ */
+void
+nd_flow_collect_ifcounters(netdissect_options *ndo, int ipver,
+			   const u_char *agent, uint32_t ifindex,
+			   const struct nd_flow_ifcounters *counters)
+{
+	struct flow_if_key key;
+	struct flow_if_value *iv;
+
+	if (flow_if_table == NULL)
+		flow_if_table = nd_lru_cache_create(ndo, FLOW_IF_TABLE_SIZE,
+		    sizeof(struct flow_if_key), sizeof(struct flow_if_value));
+	memset(&key, 0, sizeof(key));
+	key.agent_ipver = (uint8_t)ipver;
+	memcpy(key.agent, agent, ipver == 4 ? 4 : 16);
+	key.ifindex = ifindex;
+	iv = (struct flow_if_value *)nd_lru_cache_insert(flow_if_table, &key);
+	iv->samples++;
+	iv->counters = *counters;
+	flow_stats.records++;
+}
+
+/*
+ * Collect the records of the exporter datagram of len bytes at bp, sent
+ * from the IPv4 (ipver 4) or IPv6 address src.  The setjmp() is done
+ * here, where no local variable is changed after it.
+ */
+static void
+flow_collect_datagram(netdissect_options *ndo, int exporter,
+		      const u_char *bp, u_int len, int ipver,
+		      const u_char *src)
+{
+	if (setjmp(ndo->ndo_early_end) == 0) {
+		if (exporter == ND_FLOW_SFLOW) {
+			if (!sflow_collect(ndo, bp, len))
+				flow_stats.malformed++;
+		} else {
+			if (!cnfp_collect(ndo, bp, len, ipver, src))
+				flow_stats.malformed++;
+		}
+	} else {
+		/* Truncated; the records before the end were collected. */
+		flow_stats.malformed++;
+	}
+}
+
+/*
+ * Collect the records of the sFlow or NetFlow datagram, if any, in the
+ * IPv4 or IPv6 packet at ip, of which len bytes were captured.
+ *
+ * sFlow is recognized by its UDP port and NetFlow, which has no assigned
+ * port, by the customary one or, with "-T cnfp", on any port.  Fragmented
+ * datagrams aren't reassembled, and are skipped.
+ */
+void
+nd_flow_collector_packet(netdissect_options *ndo, const u_char *ip, u_int len)
+{
+	const u_char *udp, *src;
+	u_int ipver, hlen, iplen, ulen, sport, dport;
+	int exporter;
+
+	if (len < 1)
+		return;
+	ipver = EXTRACT_U_1(ip) >> 4;
+	switch (ipver) {
+
+	case 4:
+		if (len < 20)
+			return;
+		hlen = (EXTRACT_U_1(ip) & 0x0f) * 4;
+		iplen = EXTRACT_BE_U_2(ip + 2);
+		if (hlen < 20 || iplen < hlen ||
+		    EXTRACT_U_1(ip + 9) != IPPROTO_UDP ||
+		    (EXTRACT_BE_U_2(ip + 6) & 0x3fff) != 0)
+			return;
+		iplen -= hlen;
+		src = ip + 12;
+		break;
+
+	case 6:
+		if (len < 40)
+			return;
+		hlen = 40;
+		if (EXTRACT_U_1(ip + 6) != IPPROTO_UDP)
+			return;
+		iplen = EXTRACT_BE_U_2(ip + 4);
+		src = ip + 8;
+		break;
+
+	default:
+		return;
+	}
+	if (len < hlen + 8)
+		return;
+	udp = ip + hlen;
+	sport = EXTRACT_BE_U_2(udp);
+	dport = EXTRACT_BE_U_2(udp + 2);
+	ulen = EXTRACT_BE_U_2(udp + 4);
+	if (ulen < 8 || ulen > iplen)
+		return;
+
+	if (IS_SRC_OR_DST_PORT(SFLOW_PORT))
+		exporter = ND_FLOW_SFLOW;
+	else if (ndo->ndo_packettype == PT_CNFP ||
+	    IS_SRC_OR_DST_PORT(NETFLOW_PORT))
+		exporter = ND_FLOW_NETFLOW;
+	else
+		return;
+	flow_stats.datagrams[exporter]++;
+	flow_collect_datagram(ndo, exporter, udp + 8, ulen - 8, ipver, src);
+}
+
+/*
+ * Called for each packet, with ndo_ts set to its time: print a report
+ * if the packet is past the end of the report interval.  The intervals
+ * are aligned on multiples of their length; those without packets are
+ * skipped.
+ */
+void
+nd_flow_collector_tick(netdissect_options *ndo)
+{
+	time_t now = ndo->ndo_ts.tv_sec;
+	time_t interval = ndo->ndo_flow_report_interval;
+
+	if (interval == 0)
+		return;
+	if (flow_next_report != 0 && now >= flow_next_report)
+		flow_report(ndo, flow_next_report);
+	if (flow_next_report == 0 || now >= flow_next_report)
+		flow_next_report = now - now % interval + interval;
+}
+
+/*
+ * Print what was collected since the last report, stamped with the time
+ * of the last packet.
+ */
+void
+nd_flow_collector_print_stats(netdissect_options *ndo)
+{
+	if (ndo->ndo_flow_collector == ND_FLOW_COLLECTOR_OFF)
+		return;
+	flow_report(ndo, ndo->ndo_ts.tv_sec);
+}
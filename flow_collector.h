@@ -0,0 +1,68 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ *
+ * Aggregation of the sFlow and NetFlow records, for --flow-collector.
+ */
+
+#ifndef netdissect_flow_collector_h
+#define netdissect_flow_collector_h
+
+#include "netdissect.h"
+
+/* Protocols of the exporters. */
+#define ND_FLOW_SFLOW		1
+#define ND_FLOW_NETFLOW		2
+
+/*
+ * Flows are aggregated by exporter, agent, interfaces and 5-tuple.  The
+ * key is compared as bytes, so it must be zeroed before it's filled in.
+ */
+struct nd_flow_key {
+	uint8_t exporter;		/* ND_FLOW_SFLOW or ND_FLOW_NETFLOW */
+	uint8_t agent_ipver;		/* 4 or 6 */
+	uint8_t ipver;			/* 4 or 6, or 0 for other protocols */
+	uint8_t proto;
+	uint32_t input;			/* interfaces, as sent by the agent */
+	uint32_t output;
+	uint16_t sport;
+	uint16_t dport;
+	u_char agent[16];
+	u_char src[16];
+	u_char dst[16];
+};
+
+/* Interface counters, as sent in sFlow generic interface counters. */
+struct nd_flow_ifcounters {
+	uint64_t in_octets;
+	uint64_t in_packets;
+	uint64_t in_discards;
+	uint64_t in_errors;
+	uint64_t out_octets;
+	uint64_t out_packets;
+	uint64_t out_discards;
+	uint64_t out_errors;
+};
+
+extern void nd_flow_key_set_agent(struct nd_flow_key *, int, const u_char *);
+extern int nd_flow_key_set_ip(netdissect_options *, struct nd_flow_key *,
+			      const u_char *, u_int);
+extern void nd_flow_collect(netdissect_options *, const struct nd_flow_key *,
+			    uint64_t, uint64_t);
+extern void nd_flow_collect_ifcounters(netdissect_options *, int,
+				       const u_char *, uint32_t,
+				       const struct nd_flow_ifcounters *);
+extern void nd_flow_collector_packet(netdissect_options *, const u_char *,
+				     u_int);
+extern void nd_flow_collector_tick(netdissect_options *);
+extern void nd_flow_collector_print_stats(netdissect_options *);
+
+#endif /* netdissect_flow_collector_h */
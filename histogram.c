@@ -0,0 +1,228 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ *
+ * Latency histograms, used by the printers that match requests with
+ * their responses.
+ */
+
+#include <config.h>
+
+#include "netdissect-stdinc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "netdissect.h"
+#include "addrtoname.h"
+#include "histogram.h"
+#include "timeval-operations.h"
+
+/*
+ * Compute the time from "from" to "to", which are packet time stamps,
+ * in microseconds.  Returns 0 if "to" is before "from".
+ */
+int
+nd_latency_usec(netdissect_options *ndo _U_, const struct timeval *from,
+		const struct timeval *to, uint64_t *usecp)
+{
+	struct timeval diff;
+	int nano_prec = 0;
+
+#ifdef HAVE_PCAP_SET_TSTAMP_PRECISION
+	nano_prec = ndo->ndo_tstamp_precision == PCAP_TSTAMP_PRECISION_NANO;
+#endif
+	if (netdissect_timevalcmp(to, from, <))
+		return 0;
+	netdissect_timevalsub(to, from, &diff, nano_prec);
+	*usecp = (uint64_t)diff.tv_sec * ND_MICRO_PER_SEC +
+	    (nano_prec ? (uint64_t)diff.tv_usec / 1000 :
+	     (uint64_t)diff.tv_usec);
+	return 1;
+}
+
+static u_int
+nd_hist_index(uint64_t value)
+{
+	u_int magnitude;
+
+	if (value < 2 * ND_HIST_SUB_BUCKETS)
+		return (u_int)value;
+	for (magnitude = 5; (value >> (magnitude + 1)) != 0; magnitude++)
+		;
+	if (magnitude >= ND_HIST_MAX_MAGNITUDE)
+		return ND_HIST_BUCKETS - 1;
+	return (magnitude - 3) * ND_HIST_SUB_BUCKETS +
+	    (u_int)(value >> (magnitude - 4)) - ND_HIST_SUB_BUCKETS;
+}
+
+/* Highest value counted in a bucket. */
+static uint64_t
+nd_hist_bucket_max(u_int idx)
+{
+	u_int magnitude, sub;
+
+	if (idx < 2 * ND_HIST_SUB_BUCKETS)
+		return idx;
+	magnitude = idx / ND_HIST_SUB_BUCKETS + 3;
+	sub = idx % ND_HIST_SUB_BUCKETS;
+	return ((uint64_t)(ND_HIST_SUB_BUCKETS + sub + 1) <<
+	    (magnitude - 4)) - 1;
+}
+
+/*
+ * Return the histogram *hp, allocating it the first time.
+ */
+struct nd_histogram *
+nd_hist_get(netdissect_options *ndo, struct nd_histogram **hp)
+{
+	if (*hp == NULL) {
+		*hp = (struct nd_histogram *)calloc(1, sizeof(**hp));
+		if (*hp == NULL)
+			(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
+			    "%s: calloc", __func__);
+	}
+	return *hp;
+}
+
+void
+nd_hist_record(struct nd_histogram *h, uint64_t value)
+{
+	if (h->count == 0 || value < h->min)
+		h->min = value;
+	if (value > h->max)
+		h->max = value;
+	h->count++;
+	h->buckets[nd_hist_index(value)]++;
+}
+
+/*
+ * Value below which pct percent of the recorded values are, within the
+ * precision of the buckets.
+ */
+uint64_t
+nd_hist_percentile(const struct nd_histogram *h, double pct)
+{
+	uint64_t rank, seen = 0, value;
+	u_int i;
+
+	if (h->count == 0)
+		return 0;
+	rank = (uint64_t)(pct / 100.0 * (double)h->count + 0.5);
+	if (rank == 0)
+		rank = 1;
+	for (i = 0; i < ND_HIST_BUCKETS; i++) {
+		seen += h->buckets[i];
+		if (seen >= rank)
+			break;
+	}
+	value = nd_hist_bucket_max(i);
+	if (value > h->max)
+		value = h->max;
+	if (value < h->min)
+		value = h->min;
+	return value;
+}
+
+/* Print a latency in milliseconds. */
+void
+nd_hist_print_usec(netdissect_options *ndo, uint64_t usec)
+{
+	ND_PRINT("%" PRIu64 ".%03u", usec / 1000, (u_int)(usec % 1000));
+}
+
+void
+nd_hist_print_header(netdissect_options *ndo, const char *title)
+{
+	ND_PRINT("%-28s %8s %10s %10s %10s %10s %10s %10s\n", title, "count",
+	    "min", "p50", "p90", "p99", "p99.9", "max");
+}
+
+void
+nd_hist_print_row(netdissect_options *ndo, const char *label,
+		  const struct nd_histogram *h)
+{
+	static const double pcts[] = { 50.0, 90.0, 99.0, 99.9 };
+	char buf[32];
+	u_int i;
+
+	ND_PRINT("%-28s %8" PRIu64, label, h->count);
+	snprintf(buf, sizeof(buf), "%" PRIu64 ".%03u", h->min / 1000,
+	    (u_int)(h->min % 1000));
+	ND_PRINT(" %10s", buf);
+	for (i = 0; i < sizeof(pcts) / sizeof(pcts[0]); i++) {
+		uint64_t v = nd_hist_percentile(h, pcts[i]);
+
+		snprintf(buf, sizeof(buf), "%" PRIu64 ".%03u", v / 1000,
+		    (u_int)(v % 1000));
+		ND_PRINT(" %10s", buf);
+	}
+	snprintf(buf, sizeof(buf), "%" PRIu64 ".%03u", h->max / 1000,
+	    (u_int)(h->max % 1000));
+	ND_PRINT(" %10s\n", buf);
+}
+
+/*
+ * Return the histogram for the IPv4 or IPv6 address addr.
+ */
+struct nd_histogram *
+nd_addr_hist_get(netdissect_options *ndo, struct nd_addr_hists *hs,
+		 int ipver, const u_char *addr)
+{
+	struct nd_addr_hist *ah;
+	u_int addrlen = ipver == 4 ? sizeof(nd_ipv4) : sizeof(nd_ipv6);
+	u_int i;
+
+	for (i = 0; i < hs->count; i++) {
+		ah = &hs->addrs[i];
+		if (ah->ipver == ipver && memcmp(ah->addr, addr, addrlen) == 0)
+			return &ah->hist;
+	}
+	if (hs->count == ND_HIST_MAX_ADDRS)
+		return nd_hist_get(ndo, &hs->others);
+	if (hs->addrs == NULL) {
+		hs->addrs = (struct nd_addr_hist *)calloc(ND_HIST_MAX_ADDRS,
+		    sizeof(*hs->addrs));
+		if (hs->addrs == NULL)
+			(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
+			    "%s: calloc", __func__);
+	}
+	ah = &hs->addrs[hs->count++];
+	ah->ipver = ipver;
+	memcpy(ah->addr, addr, addrlen);
+	return &ah->hist;
+}
+
+/*
+ * Print a row per address, labelled "<what> <address>", and one for the
+ * other addresses, labelled "other <what>s".
+ */
+void
+nd_addr_hists_print(netdissect_options *ndo, const struct nd_addr_hists *hs,
+		    const char *what)
+{
+	const struct nd_addr_hist *ah;
+	char label[64];
+	u_int i;
+
+	for (i = 0; i < hs->count; i++) {
+		ah = &hs->addrs[i];
+		snprintf(label, sizeof(label), "%s %s", what, ah->ipver == 4 ?
+		    ipaddr_string(ndo, ah->addr) :
+		    ip6addr_string(ndo, ah->addr));
+		nd_hist_print_row(ndo, label, &ah->hist);
+	}
+	if (hs->others != NULL) {
+		snprintf(label, sizeof(label), "other %ss", what);
+		nd_hist_print_row(ndo, label, hs->others);
+	}
+}
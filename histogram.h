@@ -0,0 +1,73 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ *
+ * Latency histograms, used by the printers that match requests with
+ * their responses.
+ */
+
+#ifndef netdissect_histogram_h
+#define netdissect_histogram_h
+
+#include "netdissect.h"
+
+/*
+ * Values, in microseconds, are counted exactly up to 31 and then in 16
+ * buckets per power of two, so that any value is known within about 6%,
+ * up to 2^40 us (about 12 days).
+ */
+#define ND_HIST_SUB_BUCKETS	16
+#define ND_HIST_MAX_MAGNITUDE	40
+#define ND_HIST_BUCKETS \
+	((ND_HIST_MAX_MAGNITUDE - 3) * ND_HIST_SUB_BUCKETS)
+
+struct nd_histogram {
+	uint64_t count;
+	uint64_t min;
+	uint64_t max;
+	uint64_t buckets[ND_HIST_BUCKETS];
+};
+
+/*
+ * Histograms per IP address (e.g. per server), for the first
+ * ND_HIST_MAX_ADDRS addresses seen; the others share one histogram.
+ */
+#define ND_HIST_MAX_ADDRS	64
+
+struct nd_addr_hist {
+	int ipver;
+	nd_ipv6 addr;
+	struct nd_histogram hist;
+};
+
+struct nd_addr_hists {
+	struct nd_addr_hist *addrs;
+	u_int count;
+	struct nd_histogram *others;
+};
+
+extern int nd_latency_usec(netdissect_options *, const struct timeval *,
+			   const struct timeval *, uint64_t *);
+extern struct nd_histogram *nd_hist_get(netdissect_options *,
+					 struct nd_histogram **);
+extern void nd_hist_record(struct nd_histogram *, uint64_t);
+extern uint64_t nd_hist_percentile(const struct nd_histogram *, double);
+extern void nd_hist_print_usec(netdissect_options *, uint64_t);
+extern void nd_hist_print_header(netdissect_options *, const char *);
+extern void nd_hist_print_row(netdissect_options *, const char *,
+			      const struct nd_histogram *);
+extern struct nd_histogram *nd_addr_hist_get(netdissect_options *,
+					     struct nd_addr_hists *, int,
+					     const u_char *);
+extern void nd_addr_hists_print(netdissect_options *,
+				const struct nd_addr_hists *, const char *);
+
+#endif /* netdissect_histogram_h */
@@ -14,6 +14,9 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <time.h>
 #include <unistd.h>
 
 /*
@@ -43,6 +46,9 @@
  * unset or set to an empty string, print nothing, like with no instrumentation
  * set to "all" or "a", print all the functions names
  * set to "global" or "g", print only the global functions names
+ * set to "profile" or "p", print nothing while running, but add up the
+ * calls of each function and the time spent in it, and print the totals
+ * at exit (see profile_enter())
  */
 
 #define ND_NO_INSTRUMENT __attribute__((no_instrument_function))
@@ -51,119 +57,164 @@
 extern int profile_func_level;
 int profile_func_level = -1;
 
+/* Where pretty_print_packet() keeps the current protocol name, if set */
+extern const char **profile_ndo_protocol;
+const char **profile_ndo_protocol;
+
 typedef enum {
 	ENTER,
 	EXIT
 } action_type;
 
+enum {
+	INSTRUMENT_UNSET,
+	INSTRUMENT_OFF,
+	INSTRUMENT_ALL,
+	INSTRUMENT_GLOBAL,
+	INSTRUMENT_PROFILE
+};
+
+static int instrument_type = INSTRUMENT_UNSET;
+
+static bfd* abfd;
+static asymbol **symtab;
+static long symcount;
+static asection *text;
+static bfd_vma vma;
+
 void __cyg_profile_func_enter(void *this_fn, void *call_site) ND_NO_INSTRUMENT;
 
 void __cyg_profile_func_exit(void *this_fn, void *call_site) ND_NO_INSTRUMENT;
 
+static void get_instrument_type(void) ND_NO_INSTRUMENT;
+
+static int load_symbols(void) ND_NO_INSTRUMENT;
+
 static void print_debug(void *this_fn, void *call_site, action_type action)
 	ND_NO_INSTRUMENT;
 
+static void profile_enter(void *this_fn) ND_NO_INSTRUMENT;
+
+static void profile_exit(void *this_fn) ND_NO_INSTRUMENT;
+
 void
 __cyg_profile_func_enter(void *this_fn, void *call_site)
 {
-	print_debug(this_fn, call_site, ENTER);
+	if (instrument_type == INSTRUMENT_UNSET)
+		get_instrument_type();
+	if (instrument_type == INSTRUMENT_PROFILE)
+		profile_enter(this_fn);
+	else
+		print_debug(this_fn, call_site, ENTER);
 }
 
 void
 __cyg_profile_func_exit(void *this_fn, void *call_site)
 {
-	print_debug(this_fn, call_site, EXIT);
+	if (instrument_type == INSTRUMENT_PROFILE)
+		profile_exit(this_fn);
+	else
+		print_debug(this_fn, call_site, EXIT);
 }
 
-static void print_debug(void *this_fn, void *call_site, action_type action)
+static void
+get_instrument_type(void)
 {
-	static bfd* abfd;
-	static asymbol **symtab;
-	static long symcount;
-	static asection *text;
-	static bfd_vma vma;
-	static int instrument_set;
-	static int instrument_off;
-	static int instrument_global;
-
-	if (!instrument_set) {
-		static char *instrument_type;
-
-		/* Get the configuration environment variable INSTRUMENT value if any */
-		instrument_type = getenv("INSTRUMENT");
-		/* unset or set to an empty string ? */
-		if (instrument_type == NULL ||
-			!strncmp(instrument_type, "", sizeof(""))) {
-			instrument_off = 1;
-		} else {
-			/* set to "global" or "g" ? */
-			if (!strncmp(instrument_type, "global", sizeof("global")) ||
-				!strncmp(instrument_type, "g", sizeof("g")))
-				instrument_global = 1;
-			else if (strncmp(instrument_type, "all", sizeof("all")) &&
-					 strncmp(instrument_type, "a", sizeof("a"))) {
-				fprintf(stderr, "INSTRUMENT can be only \"\", \"all\", \"a\", "
-						"\"global\" or \"g\".\n");
-				exit(1);
-			}
-		}
-		instrument_set = 1;
+	char *type;
+
+	/* Get the configuration environment variable INSTRUMENT value if any */
+	type = getenv("INSTRUMENT");
+	/* unset or set to an empty string ? */
+	if (type == NULL || !strncmp(type, "", sizeof("")))
+		instrument_type = INSTRUMENT_OFF;
+	/* set to "global" or "g" ? */
+	else if (!strncmp(type, "global", sizeof("global")) ||
+			 !strncmp(type, "g", sizeof("g")))
+		instrument_type = INSTRUMENT_GLOBAL;
+	else if (!strncmp(type, "all", sizeof("all")) ||
+			 !strncmp(type, "a", sizeof("a")))
+		instrument_type = INSTRUMENT_ALL;
+	else if (!strncmp(type, "profile", sizeof("profile")) ||
+			 !strncmp(type, "p", sizeof("p")))
+		instrument_type = INSTRUMENT_PROFILE;
+	else {
+		fprintf(stderr, "INSTRUMENT can be only \"\", \"all\", \"a\", "
+				"\"global\", \"g\", \"profile\" or \"p\".\n");
+		exit(1);
 	}
+}
 
-	if (instrument_off)
-			return;
+/*
+ * Read the symbols of the executable; return 0 if they can be used, and
+ * -1 otherwise.  If no errors, this should be done one time.
+ */
+static int
+load_symbols(void)
+{
+	char pgm_name[1024];
+	long symsize;
+	ssize_t ret;
 
-	/* If no errors, this block should be executed one time */
-	if (!abfd) {
-		char pgm_name[1024];
-		long symsize;
+	if (abfd)
+		return text != NULL ? 0 : -1;
 
-		ssize_t ret = readlink("/proc/self/exe", pgm_name, sizeof(pgm_name));
-		if (ret == -1) {
-			perror("failed to find executable");
-			return;
-		}
-		if (ret == sizeof(pgm_name)) {
-			/* no space for the '\0' */
-			printf("truncation may have occurred\n");
-			return;
-		}
-		pgm_name[ret] = '\0';
+	ret = readlink("/proc/self/exe", pgm_name, sizeof(pgm_name));
+	if (ret == -1) {
+		perror("failed to find executable");
+		return -1;
+	}
+	if (ret == sizeof(pgm_name)) {
+		/* no space for the '\0' */
+		printf("truncation may have occurred\n");
+		return -1;
+	}
+	pgm_name[ret] = '\0';
 
-		bfd_init();
+	bfd_init();
 
-		abfd = bfd_openr(pgm_name, NULL);
-		if (!abfd) {
-			bfd_perror("bfd_openr");
-			return;
-		}
+	abfd = bfd_openr(pgm_name, NULL);
+	if (!abfd) {
+		bfd_perror("bfd_openr");
+		return -1;
+	}
 
-		if (!bfd_check_format(abfd, bfd_object)) {
-			bfd_perror("bfd_check_format");
-			return;
-		}
+	if (!bfd_check_format(abfd, bfd_object)) {
+		bfd_perror("bfd_check_format");
+		return -1;
+	}
 
-		if((symsize = bfd_get_symtab_upper_bound(abfd)) == -1) {
-			bfd_perror("bfd_get_symtab_upper_bound");
-			return;
-		}
+	if((symsize = bfd_get_symtab_upper_bound(abfd)) == -1) {
+		bfd_perror("bfd_get_symtab_upper_bound");
+		return -1;
+	}
 
-		symtab = (asymbol **)malloc((size_t)symsize);
-		symcount = bfd_canonicalize_symtab(abfd, symtab);
-		if (symcount < 0) {
-			free(symtab);
-			bfd_perror("bfd_canonicalize_symtab");
-			return;
-		}
+	symtab = (asymbol **)malloc((size_t)symsize);
+	symcount = bfd_canonicalize_symtab(abfd, symtab);
+	if (symcount < 0) {
+		free(symtab);
+		bfd_perror("bfd_canonicalize_symtab");
+		return -1;
+	}
 
-		if ((text = bfd_get_section_by_name(abfd, ".text")) == NULL) {
-			bfd_perror("bfd_get_section_by_name");
-			return;
-		}
-		vma = text->vma;
+	if ((text = bfd_get_section_by_name(abfd, ".text")) == NULL) {
+		bfd_perror("bfd_get_section_by_name");
+		return -1;
 	}
+	vma = text->vma;
+	return 0;
+}
+
+static void print_debug(void *this_fn, void *call_site, action_type action)
+{
+	if (instrument_type == INSTRUMENT_UNSET)
+		get_instrument_type();
+	if (instrument_type == INSTRUMENT_OFF)
+			return;
+
+	if (load_symbols() < 0)
+		return;
 
-	if (instrument_global) {
+	if (instrument_type == INSTRUMENT_GLOBAL) {
 		symbol_info syminfo;
 		int found;
 		long i;
@@ -255,4 +306,327 @@ static void print_debug(void *this_fn, void *call_site, action_type action)
 	fflush(stdout);
 }
 
+/*
+ * Profiling: the calls of each function are counted, in a hash table
+ * keyed by the function address, with the time spent in the function
+ * itself (exclusive) and with the functions it calls (inclusive).  The
+ * time between two entries or exits is charged to the function on the
+ * top of a stack of the calls in progress, and to the protocol that
+ * pretty_print_packet() is at (its ndo_protocol, which the printers set
+ * when they start), so that the time of each printer can be seen too.
+ * The symbols are only looked up at exit, when the totals are printed
+ * on the standard error.
+ *
+ * The time is the time stamp counter on x86 and the virtual counter on
+ * AArch64, in ticks, and otherwise CLOCK_MONOTONIC, in nanoseconds.
+ */
+#define PROFILE_FUNCS		16384	/* functions recorded, a power of 2 */
+#define PROFILE_PROTOCOLS	256		/* protocols recorded, a power of 2 */
+#define PROFILE_DEPTH		4096	/* calls in progress recorded */
+
+struct profile_func {
+	void *fn;
+	uint64_t calls;
+	uint64_t inclusive;
+	uint64_t exclusive;
+	unsigned int active;			/* calls in progress */
+};
+
+struct profile_protocol {
+	const char *name;				/* NULL outside a packet */
+	int used;
+	uint64_t calls;
+	uint64_t exclusive;
+};
+
+struct profile_frame {
+	struct profile_func *func;		/* NULL if not recorded */
+	void *fn;
+	uint64_t start;
+};
+
+static struct profile_func profile_funcs[PROFILE_FUNCS];
+static unsigned int profile_func_count;
+static struct profile_protocol profile_protocols[PROFILE_PROTOCOLS];
+static struct profile_protocol *profile_protocol;	/* the current one */
+static struct profile_frame profile_stack[PROFILE_DEPTH];
+static unsigned int profile_depth;
+static unsigned int profile_too_deep;	/* calls in progress not on the stack */
+static uint64_t profile_last;			/* time of the last entry or exit */
+static uint64_t profile_lost;			/* calls of functions not recorded */
+
+static uint64_t profile_now(void) ND_NO_INSTRUMENT;
+static struct profile_protocol *profile_find_protocol(const char *)
+	ND_NO_INSTRUMENT;
+static void profile_charge(uint64_t) ND_NO_INSTRUMENT;
+static void profile_pop(uint64_t) ND_NO_INSTRUMENT;
+static int profile_cmp(const void *, const void *) ND_NO_INSTRUMENT;
+static int profile_protocol_cmp(const void *, const void *) ND_NO_INSTRUMENT;
+static void profile_print_func(const struct profile_func *, uint64_t)
+	ND_NO_INSTRUMENT;
+static void profile_report(void) ND_NO_INSTRUMENT;
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PROFILE_UNIT	"TSC ticks"
+#elif defined(__aarch64__)
+#define PROFILE_UNIT	"CNTVCT ticks"
+#else
+#define PROFILE_UNIT	"ns"
+#endif
+
+static uint64_t
+profile_now(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	uint32_t lo, hi;
+
+	__asm__ __volatile__("rdtsc" : "=a" (lo), "=d" (hi));
+	return ((uint64_t)hi << 32) | lo;
+#elif defined(__aarch64__)
+	uint64_t ticks;
+
+	__asm__ __volatile__("mrs %0, cntvct_el0" : "=r" (ticks));
+	return ticks;
+#else
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/*
+ * The protocol names are string constants, so they are told apart by
+ * their addresses.
+ */
+static struct profile_protocol *
+profile_find_protocol(const char *name)
+{
+	unsigned int i, n;
+
+	i = (unsigned int)(((uintptr_t)name >> 3) * 2654435761U);
+	for (n = 0; n < PROFILE_PROTOCOLS; n++, i++) {
+		struct profile_protocol *p;
+
+		p = &profile_protocols[i & (PROFILE_PROTOCOLS - 1)];
+		if (!p->used) {
+			p->used = 1;
+			p->name = name;
+			return p;
+		}
+		if (p->name == name)
+			return p;
+	}
+	return NULL;
+}
+
+/* Charge the time since the last entry or exit. */
+static void
+profile_charge(uint64_t now)
+{
+	uint64_t elapsed = now - profile_last;
+	const char *name;
+
+	profile_last = now;
+	if (profile_depth != 0 && profile_stack[profile_depth - 1].func != NULL)
+		profile_stack[profile_depth - 1].func->exclusive += elapsed;
+	name = profile_ndo_protocol != NULL ? *profile_ndo_protocol : NULL;
+	if (profile_protocol == NULL || profile_protocol->name != name)
+		profile_protocol = profile_find_protocol(name);
+	if (profile_protocol != NULL)
+		profile_protocol->exclusive += elapsed;
+}
+
+static void
+profile_enter(void *this_fn)
+{
+	static int registered;
+	struct profile_func *func;
+	struct profile_frame *frame;
+	uint64_t now = profile_now();
+	unsigned int i, n;
+
+	if (!registered) {
+		atexit(profile_report);
+		profile_last = now;
+		registered = 1;
+	}
+	profile_charge(now);
+	if (profile_protocol != NULL)
+		profile_protocol->calls++;
+	if (profile_depth == PROFILE_DEPTH) {
+		profile_too_deep++;
+		profile_lost++;
+		return;
+	}
+
+	/* Keep the table at most 3/4 full, so that searches end quickly. */
+	func = NULL;
+	i = (unsigned int)(((uintptr_t)this_fn >> 2) * 2654435761U);
+	for (n = 0; n < PROFILE_FUNCS; n++, i++) {
+		func = &profile_funcs[i & (PROFILE_FUNCS - 1)];
+		if (func->fn == this_fn)
+			break;
+		if (func->fn == NULL) {
+			if (profile_func_count >= PROFILE_FUNCS / 4 * 3) {
+				func = NULL;
+				break;
+			}
+			func->fn = this_fn;
+			profile_func_count++;
+			break;
+		}
+	}
+	if (func != NULL) {
+		func->calls++;
+		func->active++;
+	} else
+		profile_lost++;
+	frame = &profile_stack[profile_depth++];
+	frame->func = func;
+	frame->fn = this_fn;
+	frame->start = now;
+}
+
+/* Take the call on the top of the stack off it. */
+static void
+profile_pop(uint64_t now)
+{
+	struct profile_frame *frame = &profile_stack[--profile_depth];
+
+	/* With recursion, the time is only counted for the outermost call. */
+	if (frame->func != NULL && --frame->func->active == 0)
+		frame->func->inclusive += now - frame->start;
+}
+
+static void
+profile_exit(void *this_fn)
+{
+	uint64_t now = profile_now();
+	unsigned int i;
+
+	profile_charge(now);
+	if (profile_too_deep != 0) {
+		profile_too_deep--;
+		return;
+	}
+
+	/*
+	 * The calls a longjmp() went out of never exit; they end with the
+	 * first call below them that does.
+	 */
+	for (i = profile_depth; i != 0; i--)
+		if (profile_stack[i - 1].fn == this_fn)
+			break;
+	if (i == 0)
+		return;
+	while (profile_depth >= i)
+		profile_pop(now);
+}
+
+static int
+profile_cmp(const void *a, const void *b)
+{
+	const struct profile_func *fa = *(const struct profile_func * const *)a;
+	const struct profile_func *fb = *(const struct profile_func * const *)b;
+
+	if (fa->exclusive != fb->exclusive)
+		return fa->exclusive < fb->exclusive ? 1 : -1;
+	return fa->calls < fb->calls ? 1 : fa->calls > fb->calls ? -1 : 0;
+}
+
+static int
+profile_protocol_cmp(const void *a, const void *b)
+{
+	const struct profile_protocol *pa = a;
+	const struct profile_protocol *pb = b;
+
+	if (pa->exclusive != pb->exclusive)
+		return pa->exclusive < pb->exclusive ? 1 : -1;
+	return 0;
+}
+
+static void
+profile_print_func(const struct profile_func *func, uint64_t total)
+{
+	const char *file = NULL;
+	const char *name = NULL;
+	unsigned int line = 0;
+
+	fprintf(stderr, "%12" PRIu64 " %16" PRIu64 " %16" PRIu64 " %5.1f%%  ",
+			func->calls, func->inclusive, func->exclusive,
+			total != 0 ? 100.0 * (double)func->exclusive / (double)total : 0.0);
+	if (text != NULL && (bfd_vma)func->fn >= vma)
+		(void)bfd_find_nearest_line(abfd, text, symtab,
+									(bfd_vma)func->fn - vma, &file, &name,
+									&line);
+	if (name == NULL || *name == '\0') {
+		fprintf(stderr, "%p\n", func->fn);
+		return;
+	}
+	fprintf(stderr, "%s", name);
+	if (file != NULL && *file != '\0') {
+		const char *slashp = strrchr(file, '/');
+
+		if (slashp != NULL)
+			file = slashp + 1;
+		fprintf(stderr, " (%s:%u)", file, line);
+	}
+	putc('\n', stderr);
+}
+
+static void
+profile_report(void)
+{
+	struct profile_func **funcs;
+	uint64_t now = profile_now();
+	uint64_t total = 0;
+	unsigned int i, n;
+
+	/* Stop counting, and end the calls in progress, e.g. main(). */
+	profile_charge(now);
+	instrument_type = INSTRUMENT_OFF;
+	while (profile_depth != 0)
+		profile_pop(now);
+
+	funcs = (struct profile_func **)malloc(profile_func_count *
+										   sizeof(*funcs));
+	if (funcs == NULL)
+		return;
+	for (i = 0, n = 0; i < PROFILE_FUNCS; i++)
+		if (profile_funcs[i].fn != NULL) {
+			funcs[n++] = &profile_funcs[i];
+			total += profile_funcs[i].exclusive;
+		}
+	qsort(funcs, n, sizeof(*funcs), profile_cmp);
+	(void)load_symbols();
+
+	fprintf(stderr, "Profile by function, in " PROFILE_UNIT ", %u functions",
+			n);
+	if (profile_lost != 0)
+		fprintf(stderr, ", %" PRIu64 " calls not recorded", profile_lost);
+	fprintf(stderr, ":\n%12s %16s %16s %6s  %s\n", "calls", "inclusive",
+			"exclusive", "excl", "function");
+	for (i = 0; i < n; i++)
+		profile_print_func(funcs[i], total);
+	free(funcs);
+
+	/* The table isn't used any more, so it can be sorted in place. */
+	qsort(profile_protocols, PROFILE_PROTOCOLS, sizeof(*profile_protocols),
+		  profile_protocol_cmp);
+	fprintf(stderr, "\nProfile by protocol, in " PROFILE_UNIT ":\n"
+			"%12s %16s %6s  %s\n", "calls", "exclusive", "excl", "protocol");
+	for (i = 0; i < PROFILE_PROTOCOLS; i++) {
+		const struct profile_protocol *p = &profile_protocols[i];
+
+		if (!p->used)
+			continue;
+		fprintf(stderr, "%12" PRIu64 " %16" PRIu64 " %5.1f%%  %s\n",
+				p->calls, p->exclusive,
+				total != 0 ? 100.0 * (double)p->exclusive / (double)total : 0.0,
+				p->name == NULL ? "(no packet)" :
+				*p->name == '\0' ? "(none)" : p->name);
+	}
+}
+
 /* vi: set tabstop=4 softtabstop=0 shiftwidth=4 smarttab autoindent : */
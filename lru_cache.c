@@ -0,0 +1,287 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ *
+ * Fixed-size caches with least recently used eviction, used by the
+ * printers that need to remember something about a request to make
+ * sense of its response.
+ */
+
+#include <config.h>
+
+#include "netdissect-stdinc.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "netdissect.h"
+#include "lru_cache.h"
+
+/*
+ * The entries are in one array; each one is a header followed by the
+ * key and the value.  They are found through a hash table of chains,
+ * and kept in a list from the most to the least recently used, whose
+ * tail is the one to go when a new key needs room.
+ */
+#define LRU_NONE	UINT32_MAX
+
+struct lru_entry {
+	uint32_t hnext;			/* next entry in the hash chain */
+	uint32_t hprev;			/* previous entry in the hash chain */
+	uint32_t newer;			/* more recently used entry */
+	uint32_t older;			/* less recently used entry */
+	uint32_t bucket;		/* hash bucket */
+};
+
+struct nd_lru_cache {
+	u_char *entries;
+	size_t stride;			/* size of an entry */
+	size_t keylen;
+	uint32_t *buckets;
+	u_int bucket_mask;
+	u_int size;			/* number of entries */
+	u_int count;			/* entries in use */
+	uint32_t newest;
+	uint32_t oldest;
+	uint64_t lookups;
+	uint64_t hits;
+	uint64_t inserts;
+	uint64_t evictions;
+	nd_lru_cache_fn evict;		/* called on an entry before reuse */
+	void *evict_arg;
+};
+
+#define LRU_ENTRY(c, idx) \
+	((struct lru_entry *)((c)->entries + (size_t)(idx) * (c)->stride))
+#define LRU_KEY(c, e)	((u_char *)(e) + sizeof(struct lru_entry))
+#define LRU_VALUE(c, e)	(LRU_KEY(c, e) + (c)->keylen)
+
+/*
+ * Create a cache of nentries values of valuelen bytes, found by keys of
+ * keylen bytes.
+ */
+struct nd_lru_cache *
+nd_lru_cache_create(netdissect_options *ndo, u_int nentries, size_t keylen,
+		    size_t valuelen)
+{
+	struct nd_lru_cache *c;
+	u_int nbuckets, i;
+
+	if (nentries == 0)
+		nentries = 1;
+	c = (struct nd_lru_cache *)calloc(1, sizeof(*c));
+	if (c == NULL)
+		goto fail;
+	/* Keep the entry headers aligned. */
+	c->stride = (sizeof(struct lru_entry) + keylen + valuelen + 7) &
+	    ~(size_t)7;
+	c->keylen = keylen;
+	c->size = nentries;
+	for (nbuckets = 16; nbuckets < nentries; nbuckets <<= 1)
+		;
+	c->bucket_mask = nbuckets - 1;
+	c->entries = (u_char *)calloc(nentries, c->stride);
+	c->buckets = (uint32_t *)malloc(nbuckets * sizeof(*c->buckets));
+	if (c->entries == NULL || c->buckets == NULL)
+		goto fail;
+	for (i = 0; i < nbuckets; i++)
+		c->buckets[i] = LRU_NONE;
+	c->newest = c->oldest = LRU_NONE;
+	return c;
+
+fail:
+	(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC, "%s: malloc", __func__);
+	/* NOTREACHED */
+}
+
+static u_int
+lru_hash(const struct nd_lru_cache *c, const u_char *key)
+{
+	uint32_t hash = 2166136261U;	/* FNV-1a */
+	size_t i;
+
+	for (i = 0; i < c->keylen; i++)
+		hash = (hash ^ key[i]) * 16777619U;
+	/* The buckets are picked with the low bits; mix in the high ones. */
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6bU;
+	hash ^= hash >> 13;
+	return hash & c->bucket_mask;
+}
+
+/* Take an entry off the recently used list. */
+static void
+lru_unlink_use(struct nd_lru_cache *c, struct lru_entry *e)
+{
+	if (e->newer != LRU_NONE)
+		LRU_ENTRY(c, e->newer)->older = e->older;
+	else
+		c->newest = e->older;
+	if (e->older != LRU_NONE)
+		LRU_ENTRY(c, e->older)->newer = e->newer;
+	else
+		c->oldest = e->newer;
+}
+
+/* Put an entry at the head of the recently used list. */
+static void
+lru_link_use(struct nd_lru_cache *c, struct lru_entry *e, uint32_t idx)
+{
+	e->newer = LRU_NONE;
+	e->older = c->newest;
+	if (c->newest != LRU_NONE)
+		LRU_ENTRY(c, c->newest)->newer = idx;
+	else
+		c->oldest = idx;
+	c->newest = idx;
+}
+
+static uint32_t
+lru_lookup(const struct nd_lru_cache *c, const u_char *key, u_int bucket)
+{
+	struct lru_entry *e;
+	uint32_t idx;
+
+	for (idx = c->buckets[bucket]; idx != LRU_NONE; idx = e->hnext) {
+		e = LRU_ENTRY(c, idx);
+		if (memcmp(LRU_KEY(c, e), key, c->keylen) == 0)
+			return idx;
+	}
+	return LRU_NONE;
+}
+
+/*
+ * Return the value for key, adding the key if it isn't there, in which
+ * case the value is zeroed.  Either way the entry becomes the most
+ * recently used one.
+ */
+void *
+nd_lru_cache_insert(struct nd_lru_cache *c, const void *key)
+{
+	struct lru_entry *e;
+	u_int bucket = lru_hash(c, (const u_char *)key);
+	uint32_t idx;
+
+	c->inserts++;
+	idx = lru_lookup(c, (const u_char *)key, bucket);
+	if (idx != LRU_NONE) {
+		e = LRU_ENTRY(c, idx);
+		lru_unlink_use(c, e);
+		lru_link_use(c, e, idx);
+		return LRU_VALUE(c, e);
+	}
+
+	if (c->count < c->size)
+		idx = c->count++;
+	else {
+		/* Evict the least recently used entry. */
+		idx = c->oldest;
+		e = LRU_ENTRY(c, idx);
+		lru_unlink_use(c, e);
+		if (e->hprev != LRU_NONE)
+			LRU_ENTRY(c, e->hprev)->hnext = e->hnext;
+		else
+			c->buckets[e->bucket] = e->hnext;
+		if (e->hnext != LRU_NONE)
+			LRU_ENTRY(c, e->hnext)->hprev = e->hprev;
+		c->evictions++;
+		if (c->evict != NULL)
+			(*c->evict)(c->evict_arg, LRU_KEY(c, e),
+			    LRU_VALUE(c, e));
+	}
+	e = LRU_ENTRY(c, idx);
+	memset(e, 0, c->stride);
+	memcpy(LRU_KEY(c, e), key, c->keylen);
+	e->bucket = bucket;
+	e->hprev = LRU_NONE;
+	e->hnext = c->buckets[bucket];
+	if (e->hnext != LRU_NONE)
+		LRU_ENTRY(c, e->hnext)->hprev = idx;
+	c->buckets[bucket] = idx;
+	lru_link_use(c, e, idx);
+	return LRU_VALUE(c, e);
+}
+
+/*
+ * Return the value for key, making it the most recently used one, or
+ * NULL if the key isn't in the cache.
+ */
+void *
+nd_lru_cache_find(struct nd_lru_cache *c, const void *key)
+{
+	struct lru_entry *e;
+	uint32_t idx;
+
+	c->lookups++;
+	idx = lru_lookup(c, (const u_char *)key,
+	    lru_hash(c, (const u_char *)key));
+	if (idx == LRU_NONE)
+		return NULL;
+	c->hits++;
+	e = LRU_ENTRY(c, idx);
+	lru_unlink_use(c, e);
+	lru_link_use(c, e, idx);
+	return LRU_VALUE(c, e);
+}
+
+/*
+ * Have fn called on the entries that are evicted, before they are reused.
+ */
+void
+nd_lru_cache_set_evict(struct nd_lru_cache *c, nd_lru_cache_fn fn, void *arg)
+{
+	c->evict = fn;
+	c->evict_arg = arg;
+}
+
+/*
+ * Call fn on each entry, from the least to the most recently used one;
+ * fn mustn't add or find entries.
+ */
+void
+nd_lru_cache_walk(struct nd_lru_cache *c, nd_lru_cache_fn fn, void *arg)
+{
+	struct lru_entry *e;
+	uint32_t idx;
+
+	for (idx = c->oldest; idx != LRU_NONE; idx = e->newer) {
+		e = LRU_ENTRY(c, idx);
+		(*fn)(arg, LRU_KEY(c, e), LRU_VALUE(c, e));
+	}
+}
+
+/*
+ * Remove all the entries, without calling the eviction function; the
+ * statistics are kept.
+ */
+void
+nd_lru_cache_clear(struct nd_lru_cache *c)
+{
+	u_int i;
+
+	for (i = 0; i <= c->bucket_mask; i++)
+		c->buckets[i] = LRU_NONE;
+	c->count = 0;
+	c->newest = c->oldest = LRU_NONE;
+}
+
+void
+nd_lru_cache_print_stats(netdissect_options *ndo,
+			 const struct nd_lru_cache *c, const char *name)
+{
+	ND_PRINT("%s: %" PRIu64 " inserted, %" PRIu64 " lookups, %" PRIu64
+	    " hits", name, c->inserts, c->lookups, c->hits);
+	if (c->lookups != 0)
+		ND_PRINT(" (%.1f%%)", 100.0 * (double)c->hits /
+		    (double)c->lookups);
+	ND_PRINT(", %" PRIu64 " evicted from a cache of %u\n", c->evictions,
+	    c->size);
+}
@@ -0,0 +1,43 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ *
+ * Fixed-size caches with least recently used eviction, used by the
+ * printers that need to remember something about a request to make
+ * sense of its response.
+ */
+
+#ifndef netdissect_lru_cache_h
+#define netdissect_lru_cache_h
+
+#include "netdissect.h"
+
+struct nd_lru_cache;
+
+/* Called with the key and the value of an entry. */
+typedef void (*nd_lru_cache_fn)(void *, const void *, void *);
+
+/*
+ * Keys are compared as bytes, so any padding in them must be zeroed.
+ */
+extern struct nd_lru_cache *nd_lru_cache_create(netdissect_options *,
+						u_int, size_t, size_t);
+extern void *nd_lru_cache_insert(struct nd_lru_cache *, const void *);
+extern void *nd_lru_cache_find(struct nd_lru_cache *, const void *);
+extern void nd_lru_cache_set_evict(struct nd_lru_cache *, nd_lru_cache_fn,
+				   void *);
+extern void nd_lru_cache_walk(struct nd_lru_cache *, nd_lru_cache_fn, void *);
+extern void nd_lru_cache_clear(struct nd_lru_cache *);
+extern void nd_lru_cache_print_stats(netdissect_options *,
+				     const struct nd_lru_cache *,
+				     const char *);
+
+#endif /* netdissect_lru_cache_h */
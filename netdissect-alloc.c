@@ -17,6 +17,7 @@
 #include <config.h>
 
 #include <stdlib.h>
+#include <string.h>
 #include "netdissect-alloc.h"
 
 static void nd_add_alloc_list(netdissect_options *, nd_mem_chunk_t *);
@@ -59,4 +60,98 @@ nd_free_all(netdissect_options *ndo)
 		current = previous;
 	}
 	ndo->ndo_last_mem_p = NULL;
+	/* The DNS name cache was allocated with nd_malloc(). */
+	ndo->ndo_dns_names = NULL;
+}
+
+/*
+ * An arena is a list of blocks, the newest first, the pieces being
+ * taken from the newest one.  Requests larger than ND_ARENA_BLOCK_SIZE
+ * get a block of their own.
+ */
+#define ND_ARENA_BLOCK_SIZE	4096
+#define ND_ARENA_ALIGN		8
+
+struct nd_arena {
+	struct nd_arena *next;
+	size_t size;			/* bytes after the header */
+	size_t used;
+};
+
+#define ND_ARENA_HDR_SIZE \
+	((sizeof(struct nd_arena) + ND_ARENA_ALIGN - 1) & \
+	 ~(size_t)(ND_ARENA_ALIGN - 1))
+
+/*
+ * Return size zeroed bytes from the arena *ap, creating it if it is NULL;
+ * they are good until the arena is reset or freed.
+ */
+void *
+nd_arena_alloc(netdissect_options *ndo, struct nd_arena **ap, size_t size)
+{
+	struct nd_arena *a = *ap, *b;
+	size_t bsize;
+	u_char *p;
+
+	size = (size + ND_ARENA_ALIGN - 1) & ~(size_t)(ND_ARENA_ALIGN - 1);
+	if (a == NULL || a->size - a->used < size) {
+		bsize = size > ND_ARENA_BLOCK_SIZE ? size : ND_ARENA_BLOCK_SIZE;
+		b = (struct nd_arena *)malloc(ND_ARENA_HDR_SIZE + bsize);
+		if (b == NULL)
+			(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
+			    "%s: malloc", __func__);
+		b->size = bsize;
+		b->used = 0;
+		if (a != NULL && bsize > ND_ARENA_BLOCK_SIZE) {
+			/* Keep filling the current block. */
+			b->next = a->next;
+			a->next = b;
+		} else {
+			b->next = a;
+			*ap = b;
+		}
+		a = b;
+	}
+	p = (u_char *)a + ND_ARENA_HDR_SIZE + a->used;
+	a->used += size;
+	memset(p, 0, size);
+	return p;
+}
+
+char *
+nd_arena_strdup(netdissect_options *ndo, struct nd_arena **ap, const char *s)
+{
+	size_t len = strlen(s) + 1;
+
+	return (char *)memcpy(nd_arena_alloc(ndo, ap, len), s, len);
+}
+
+/*
+ * Make all of the arena available again, keeping only its newest block.
+ */
+void
+nd_arena_reset(struct nd_arena *a)
+{
+	struct nd_arena *b, *next;
+
+	if (a == NULL)
+		return;
+	for (b = a->next; b != NULL; b = next) {
+		next = b->next;
+		free(b);
+	}
+	a->next = NULL;
+	a->used = 0;
+}
+
+void
+nd_arena_free(struct nd_arena **ap)
+{
+	struct nd_arena *b, *next;
+
+	for (b = *ap; b != NULL; b = next) {
+		next = b->next;
+		free(b);
+	}
+	*ap = NULL;
 }
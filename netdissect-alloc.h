@@ -29,4 +29,15 @@ typedef struct nd_mem_chunk {
 void * nd_malloc(netdissect_options *, size_t);
 void nd_free_all(netdissect_options *);
 
+/*
+ * Arenas: memory handed out in pieces from larger blocks, and freed all
+ * at once.
+ */
+struct nd_arena;
+
+void *nd_arena_alloc(netdissect_options *, struct nd_arena **, size_t);
+char *nd_arena_strdup(netdissect_options *, struct nd_arena **, const char *);
+void nd_arena_reset(struct nd_arena *);
+void nd_arena_free(struct nd_arena **);
+
 #endif /* netdissect_alloc_h */
@@ -338,4 +338,23 @@ typedef char *caddr_t;
 #  define ND_FALL_THROUGH
 #endif /*  __has_attribute(fallthrough) */
 
+/*
+ * Storage class of the buffers of the deprecated functions that return
+ * a string they formatted, such as tok2str() and intoa(), so that each
+ * thread has its own.  With a compiler that has no thread-local storage,
+ * the threads share them.
+ */
+#if defined(_MSC_VER)
+#  define ND_THREAD_LOCAL __declspec(thread)
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#  define ND_THREAD_LOCAL _Thread_local
+#elif ND_IS_AT_LEAST_GNUC_VERSION(3,3) || \
+    ND_IS_AT_LEAST_CLANG_VERSION(2,0) || \
+    ND_IS_AT_LEAST_SUNC_VERSION(5,9) || \
+    ND_IS_AT_LEAST_XL_C_VERSION(10,1)
+#  define ND_THREAD_LOCAL __thread
+#else
+#  define ND_THREAD_LOCAL
+#endif
+
 #endif /* netdissect_stdinc_h */
@@ -26,6 +26,10 @@
 
 #include "netdissect-stdinc.h"
 #include "netdissect.h"
+#include "netdissect-alloc.h"
+#include "addrtoname.h"
+#include "signature.h"
+#include "fields.h"
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -104,6 +108,22 @@ nd_cleanup(void)
 #endif
 }
 
+/*
+ * Free the state kept in a netdissect_options structure: the scratch
+ * space, the indexes of the token tables, the address to name
+ * translation tables, the HMAC states for the -M secret and the fields
+ * of --output-format.  The strings they returned are gone with it.
+ */
+void
+nd_free_context(netdissect_options *ndo)
+{
+	nd_arena_free(&ndo->ndo_scratch);
+	nd_free_tok_indexes(ndo);
+	free_addrtoname(ndo);
+	signature_free(ndo);
+	nd_fields_free(ndo);
+}
+
 /*
  * Indicates whether an SMI module has been loaded, so that we can use
  * libsmi to translate OIDs.
@@ -254,6 +274,11 @@ nd_pop_packet_info(netdissect_options *ndo)
 
 	free(ndspi->ndspi_buffer);
 	free(ndspi);
+	/*
+	 * The DNS names printed may be in the buffer that was freed;
+	 * another buffer could be allocated at the same address.
+	 */
+	ndo->ndo_dns_names = NULL;
 }
 
 void
@@ -207,6 +207,13 @@ struct netdissect_saved_packet_info {
 /* 'val' value(s) for longjmp */
 #define ND_TRUNCATED 1
 
+struct nd_arena;
+struct nd_tok_indexes;
+struct nd_name_tables;
+struct nd_fields;
+struct dns_name_cache;
+struct nd_sig_keys;
+
 struct netdissect_options {
   int ndo_bflag;		/* print 4 byte ASes in ASDOT notation */
   int ndo_eflag;		/* print ethernet header */
@@ -229,9 +236,21 @@ struct netdissect_options {
   const char *ndo_protocol;	/* protocol */
   jmp_buf ndo_early_end;	/* jmp_buf for setjmp()/longjmp() */
   void *ndo_last_mem_p;		/* pointer to the last allocated memory chunk */
+  struct dns_name_cache *ndo_dns_names; /* DNS names printed in the packet */
   int ndo_packet_number;	/* print a packet number in the beginning of line */
   int ndo_lengths;		/* print packet header caplen and len */
   int ndo_print_sampling;	/* print every Nth packet */
+  int ndo_print_sampling_flows; /* sample flows rather than packets */
+  int ndo_decode_depth;		/* last layer to dissect (--decode-depth) */
+  u_int ndo_rpc_xid_table_size;	/* outstanding RPC calls remembered */
+  int ndo_nfs_latency;		/* measure NFS call-to-reply latency */
+  int ndo_dns_stats;		/* match DNS responses with queries */
+  u_int ndo_rx_cache_size;	/* outstanding RX calls remembered */
+  int ndo_bgp_prefix_counts;	/* count rather than print BGP prefixes */
+  int ndo_flow_collector;	/* aggregate sFlow/NetFlow (--flow-collector) */
+  u_int ndo_flow_report_interval; /* seconds between collector reports */
+  int ndo_overlay_stats;	/* account tunnelled traffic (--overlay-stats) */
+  int ndo_output_format;	/* text, JSON or CSV (--output-format) */
   int ndo_suppress_default_print; /* don't use default_print() for unknown packet types */
   int ndo_tstamp_precision;	/* requested time stamp precision */
   const char *program_name;	/* Name of the program using the library */
@@ -241,12 +260,16 @@ struct netdissect_options {
   struct sa_list *ndo_sa_default;
 
   char *ndo_sigsecret;		/* Signature verification secret key */
+  struct nd_sig_keys *ndo_sig_keys; /* HMAC states for ndo_sigsecret */
 
   int   ndo_packettype;	/* as specified by -T */
 
   int   ndo_snaplen;
   int   ndo_ll_hdr_len;	/* link-layer header length */
 
+  /* time stamp of the packet being printed */
+  struct timeval ndo_ts;
+
   /*global pointers to beginning and end of current packet (during printing) */
   const u_char *ndo_packetp;
   const u_char *ndo_snapend;
@@ -254,6 +277,20 @@ struct netdissect_options {
   /* stack of saved packet boundary and buffer information */
   struct netdissect_saved_packet_info *ndo_packet_info_stack;
 
+  /*
+   * State kept here rather than in static variables, so that several
+   * of these structures can be used at the same time: the space the
+   * nd_*() string functions format into, emptied after each packet,
+   * the indexes of the token tables, the address to name translation
+   * tables, the reference time stamp for -ttt and -ttttt, and the
+   * fields of the packet for --output-format.
+   */
+  struct nd_arena *ndo_scratch;
+  struct nd_tok_indexes *ndo_tok_indexes;
+  struct nd_name_tables *ndo_name_tables;
+  struct timeval ndo_ts_ref;
+  struct nd_fields *ndo_fields;
+
   /* pointer to the if_printer function */
   if_printer ndo_if_printer;
 
@@ -309,6 +346,41 @@ NORETURN void nd_trunc_longjmp(netdissect_options *ndo);
 #define PT_DOMAIN	20	/* Domain Name System (DNS) */
 #define PT_QUIC		21	/* QUIC */
 
+/* Values of ndo_decode_depth; 0 dissects everything. */
+#define ND_DECODE_DEPTH_ALL	0
+#define ND_DECODE_DEPTH_L2	2	/* stop after the link layer */
+#define ND_DECODE_DEPTH_L3	3	/* stop after the network layer */
+#define ND_DECODE_DEPTH_L4	4	/* stop after the transport layer */
+#define ND_DECODE_DEPTH_TUNNEL	5	/* stop after the tunnel header */
+
+/* Is the dissection to stop after the given layer? */
+#define ND_DECODE_STOP(ndo, layer) \
+	((ndo)->ndo_decode_depth != ND_DECODE_DEPTH_ALL && \
+	 (ndo)->ndo_decode_depth <= (layer))
+
+/*
+ * Is the dissection to stop after a tunnel header?  Only with "tunnel":
+ * the tunnels carried directly in IP, as GRE is, are above the network
+ * layer but not below the transport one, and "l4" dissects them.
+ */
+#define ND_DECODE_STOP_TUNNEL(ndo) \
+	((ndo)->ndo_decode_depth == ND_DECODE_DEPTH_TUNNEL)
+
+/* Values of ndo_flow_collector, the format of the reports. */
+#define ND_FLOW_COLLECTOR_OFF	0
+#define ND_FLOW_COLLECTOR_CSV	1
+#define ND_FLOW_COLLECTOR_JSON	2
+
+/* Values of ndo_overlay_stats, the format of the reports. */
+#define ND_OVERLAY_STATS_OFF	0
+#define ND_OVERLAY_STATS_CSV	1
+#define ND_OVERLAY_STATS_JSON	2
+
+/* Values of ndo_output_format. */
+#define ND_OUTPUT_TEXT		0
+#define ND_OUTPUT_JSON		1
+#define ND_OUTPUT_CSV		2
+
 #define ND_MIN(a,b) ((a)>(b)?(b):(a))
 #define ND_MAX(a,b) ((b)>(a)?(b):(a))
 
@@ -463,11 +535,14 @@ extern const char *nd_format_time(char *buf, size_t bufsize,
     const char *format, const struct tm *timeptr);
 
 extern void fn_print_char(netdissect_options *, u_char);
+#define FN_CHAR_MAXLEN	4	/* "M-^X" */
+extern u_int fn_format_char(char *, u_char);
 extern void fn_print_str(netdissect_options *, const u_char *);
 extern u_int nd_printztn(netdissect_options *, const u_char *, u_int, const u_char *);
 extern int nd_printn(netdissect_options *, const u_char *, u_int, const u_char *);
 extern void nd_printjn(netdissect_options *, const u_char *, u_int);
 extern void nd_printjnp(netdissect_options *, const u_char *, u_int);
+extern u_int nd_ucs2le_to_ascii(const u_char *, u_int, char *, size_t);
 extern void nd_print_bytes_hex(netdissect_options *, const u_char *, u_int);
 
 /*
@@ -525,6 +600,34 @@ extern int unaligned_memcmp(const void *, const void *, size_t);
 extern const char *tok2strary_internal(const char **, int, const char *, const int);
 #define	tok2strary(a,f,i) tok2strary_internal(a, sizeof(a)/sizeof(a[0]),f,i)
 
+/*
+ * Versions of tok2str(), bittok2str() and tok2strary() that keep no
+ * static state: the strings they format are in ndo's scratch space,
+ * good until the end of the packet being printed.
+ */
+extern const char *nd_tok2str(netdissect_options *, const struct tok *, const char *, const u_int);
+extern const char *nd_bittok2str(netdissect_options *, const struct tok *, const char *, const u_int);
+extern const char *nd_bittok2str_nosep(netdissect_options *, const struct tok *, const char *, const u_int);
+extern const char *nd_tok2strary_internal(netdissect_options *, const char **, int, const char *, const int);
+#define	nd_tok2strary(ndo,a,f,i) nd_tok2strary_internal(ndo, a, sizeof(a)/sizeof(a[0]),f,i)
+extern char *nd_scratch_strdup(netdissect_options *, const char *);
+extern void nd_free_tok_indexes(netdissect_options *);
+
+/*
+ * The printers, like ND_PRINT() and the GET_ macros, use the ndo in
+ * scope: for them tok2str(), bittok2str(), bittok2str_nosep() and
+ * tok2strary() are the versions above.  Code without an ndo can still
+ * call the deprecated functions, by putting their names in parentheses.
+ */
+#define tok2str(lp, fmt, v)		nd_tok2str(ndo, lp, fmt, v)
+#define bittok2str(lp, fmt, v)		nd_bittok2str(ndo, lp, fmt, v)
+#define bittok2str_nosep(lp, fmt, v)	nd_bittok2str_nosep(ndo, lp, fmt, v)
+#undef tok2strary
+#define	tok2strary(a,f,i) nd_tok2strary(ndo, a, f, i)
+
+/* Free the state kept in ndo. */
+extern void nd_free_context(netdissect_options *);
+
 struct uint_tokary
 {
 	u_int uintval;
@@ -646,11 +749,13 @@ extern void cdp_print(netdissect_options *, const u_char *, u_int);
 extern void cfm_print(netdissect_options *, const u_char *, u_int);
 extern void chdlc_print(netdissect_options *, const u_char *, u_int);
 extern void cisco_autorp_print(netdissect_options *, const u_char *, u_int);
+extern int cnfp_collect(netdissect_options *, const u_char *, u_int, int, const u_char *);
 extern void cnfp_print(netdissect_options *, const u_char *);
 extern void dccp_print(netdissect_options *, const u_char *, const u_char *, u_int);
 extern void decnet_print(netdissect_options *, const u_char *, u_int, u_int);
 extern void dhcp6_print(netdissect_options *, const u_char *, u_int);
-extern void domain_print(netdissect_options *, const u_char *, u_int, int, int);
+extern void dns_print_stats(netdissect_options *);
+extern void domain_print(netdissect_options *, const u_char *, u_int, int, int, uint16_t, uint16_t, const u_char *);
 extern int dstopt_process(netdissect_options *, const u_char *);
 extern void dtp_print(netdissect_options *, const u_char *, u_int);
 extern void dvmrp_print(netdissect_options *, const u_char *, u_int);
@@ -683,6 +788,7 @@ extern void http_print(netdissect_options *, const u_char *, u_int);
 extern void icmp6_print(netdissect_options *, const u_char *, u_int, const u_char *, int);
 extern void icmp_print(netdissect_options *, const u_char *, u_int, int);
 extern u_int ieee802_11_radio_print(netdissect_options *, const u_char *, u_int, u_int);
+extern void ieee802_11_radio_print_stats(netdissect_options *);
 extern u_int ieee802_15_4_print(netdissect_options *, const u_char *, u_int);
 extern void igmp_print(netdissect_options *, const u_char *, u_int);
 extern void igrp_print(netdissect_options *, const u_char *, u_int);
@@ -724,6 +830,7 @@ extern void netbeui_print(netdissect_options *, u_short, const u_char *, u_int);
 extern void nfsreply_noaddr_print(netdissect_options *, const u_char *, u_int, const u_char *);
 extern void nfsreply_print(netdissect_options *, const u_char *, u_int, const u_char *);
 extern void nfsreq_noaddr_print(netdissect_options *, const u_char *, u_int, const u_char *);
+extern void nfs_latency_print_stats(netdissect_options *);
 extern void nhrp_print(netdissect_options *, const u_char *, u_int);
 extern void nsh_print(netdissect_options *, const u_char *, u_int);
 extern void ntp_print(netdissect_options *, const u_char *, u_int);
@@ -746,6 +853,7 @@ extern const char *q922_string(netdissect_options *, const u_char *, u_int);
 extern void q933_print(netdissect_options *, const u_char *, u_int);
 extern int quic_detect(netdissect_options *, const u_char *, const u_int);
 extern void quic_print(netdissect_options *, const u_char *);
+extern void quic_print_stats(netdissect_options *);
 extern void radius_print(netdissect_options *, const u_char *, const u_int);
 extern void resp_print(netdissect_options *, const u_char *, u_int);
 extern void rip_print(netdissect_options *, const u_char *, u_int);
@@ -756,7 +864,9 @@ extern int rt6_print(netdissect_options *, const u_char *, const u_char *);
 extern void rtl_print(netdissect_options *, const u_char *, u_int, const struct lladdr_info *, const struct lladdr_info *);
 extern void rtsp_print(netdissect_options *, const u_char *, u_int);
 extern void rx_print(netdissect_options *, const u_char *, u_int, uint16_t, uint16_t, const u_char *);
+extern void rx_print_stats(netdissect_options *);
 extern void sctp_print(netdissect_options *, const u_char *, const u_char *, u_int);
+extern int sflow_collect(netdissect_options *, const u_char *, u_int);
 extern void sflow_print(netdissect_options *, const u_char *, u_int);
 extern void sip_print(netdissect_options *, const u_char *, u_int);
 extern void slow_print(netdissect_options *, const u_char *, u_int);
@@ -764,6 +874,7 @@ extern void smb_tcp_print(netdissect_options *, const u_char *, u_int);
 extern void smtp_print(netdissect_options *, const u_char *, u_int);
 extern int snap_print(netdissect_options *, const u_char *, u_int, u_int, const struct lladdr_info *, const struct lladdr_info *, u_int);
 extern void snmp_print(netdissect_options *, const u_char *, u_int);
+extern void snmp_print_stats(netdissect_options *);
 extern void someip_print(netdissect_options *, const u_char *, const u_int);
 extern void ssh_print(netdissect_options *, const u_char *, u_int);
 extern void stp_print(netdissect_options *, const u_char *, u_int);
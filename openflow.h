@@ -63,7 +63,7 @@
 #define ONF_EXP_MPLSTPSPTN        0xff00000a
 extern const struct tok onf_exp_str[];
 
-extern const char * of_vendor_name(const uint32_t);
+extern const char * of_vendor_name(netdissect_options *, const uint32_t);
 extern void of_bitmap_print(netdissect_options *ndo,
 	const struct tok *, const uint32_t, const uint32_t);
 extern void of_data_print(netdissect_options *ndo,
@@ -0,0 +1,664 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ *
+ * Accounting of the tunnelled traffic, for --overlay-stats.
+ *
+ * The outer IP header and the VXLAN, VXLAN-GPE, Geneve, GRE or ERSPAN
+ * header of each packet are looked at, without dissecting the packet,
+ * and the packets and octets they carry are added up by tunnel
+ * identifier (VNI, GRE key or ERSPAN session ID) and, unless
+ * --decode-depth stops before the encapsulated frames, by tunnel and
+ * inner 5-tuple.  The tables are printed, as CSV or JSON lines, and
+ * emptied, at the end of each --flow-report-interval, on request and
+ * after the last packet.
+ */
+
+#include <config.h>
+
+#include "netdissect-stdinc.h"
+
+#include <string.h>
+
+#include "netdissect.h"
+#include "addrtostr.h"
+#include "extract.h"
+#include "ethertype.h"
+#include "gre.h"
+#include "ipproto.h"
+#include "udp.h"
+#include "lru_cache.h"
+#include "flow_collector.h"
+#include "overlay.h"
+
+#define OVERLAY_TUNNEL_TABLE_SIZE	4096	/* tunnels per report */
+#define OVERLAY_FLOW_TABLE_SIZE		16384	/* inner flows per report */
+
+/* Encapsulations, indexes of overlay_encaps[]. */
+#define OVERLAY_VXLAN		1
+#define OVERLAY_VXLAN_GPE	2
+#define OVERLAY_GENEVE		3
+#define OVERLAY_GRE		4
+#define OVERLAY_ERSPAN		5
+
+static const char *overlay_encaps[] = {
+	"", "vxlan", "vxlan-gpe", "geneve", "gre", "erspan"
+};
+
+/* What the tunnel header is followed by. */
+#define OVERLAY_PAYLOAD_OTHER	0
+#define OVERLAY_PAYLOAD_ETHER	1
+#define OVERLAY_PAYLOAD_IP	2	/* IPv4 or IPv6 */
+
+#define VXLAN_I			0x08	/* VNI present */
+#define VXLAN_GPE_VER_MASK	0x30
+#define VXLAN_GPE_P		0x04	/* next protocol present */
+#define VXLAN_GPE_O		0x01	/* OAM */
+#define VXLAN_GPE_PROTO_IPV4	0x01
+#define VXLAN_GPE_PROTO_IPV6	0x02
+#define VXLAN_GPE_PROTO_ETHER	0x03
+#define GRE_VERS_MASK		0x0007
+#define GRE_ERSPAN_III		0x22eb
+#define GRE_ERSPAN_I_II		0x88be
+#define ERSPAN2_VER		1
+#define ERSPAN3_VER		2
+#define ERSPAN_SID_MASK		0x3ff
+#define ERSPAN3_FT_ETHERNET	0
+#define ERSPAN3_FT_IP		2
+
+/*
+ * Tunnels are told apart by encapsulation and identifier.  The keys are
+ * compared as bytes, so they're zeroed before they're filled in.
+ */
+struct overlay_tunnel_key {
+	uint8_t encap;			/* OVERLAY_VXLAN, ... */
+	uint8_t has_id;			/* the header has an identifier */
+	uint8_t pad[2];
+	uint32_t id;
+};
+
+/* Only the IP version, protocol, addresses and ports of inner are set. */
+struct overlay_flow_key {
+	struct overlay_tunnel_key tunnel;
+	struct nd_flow_key inner;
+};
+
+struct overlay_counts {
+	uint64_t packets;
+	uint64_t octets;
+};
+
+/* A tunnel header, and the frame or packet it's followed by. */
+struct overlay_tunnel {
+	struct overlay_tunnel_key key;
+	int payload;			/* OVERLAY_PAYLOAD_* */
+	const u_char *p;
+	u_int len;			/* length sent, not captured */
+};
+
+static struct nd_lru_cache *overlay_tunnel_table;
+static struct nd_lru_cache *overlay_flow_table;
+
+/* Counts since the last report. */
+static struct {
+	uint64_t packets;		/* IPv4 and IPv6 packets */
+	uint64_t tunnelled;
+	uint64_t malformed;
+	uint64_t evicted;
+} overlay_stats;
+
+static time_t overlay_next_report;
+static time_t overlay_report_time;
+static int overlay_csv_header_printed;
+
+/*
+ * The rows are laid out as those of --flow-collector: a type and a time,
+ * then the values, named in JSON and in the CSV header lines.
+ */
+static void
+report_begin(netdissect_options *ndo, const char *type)
+{
+	if (ndo->ndo_overlay_stats == ND_OVERLAY_STATS_JSON)
+		ND_PRINT("{\"type\":\"%s\",\"time\":%" PRIu64, type,
+		    (uint64_t)overlay_report_time);
+	else
+		ND_PRINT("%s,%" PRIu64, type, (uint64_t)overlay_report_time);
+}
+
+static void
+report_uint(netdissect_options *ndo, const char *name, uint64_t value)
+{
+	if (ndo->ndo_overlay_stats == ND_OVERLAY_STATS_JSON)
+		ND_PRINT(",\"%s\":%" PRIu64, name, value);
+	else
+		ND_PRINT(",%" PRIu64, value);
+}
+
+static void
+report_string(netdissect_options *ndo, const char *name, const char *value)
+{
+	if (ndo->ndo_overlay_stats == ND_OVERLAY_STATS_JSON)
+		ND_PRINT(",\"%s\":\"%s\"", name, value);
+	else
+		ND_PRINT(",%s", value);
+}
+
+static void
+report_none(netdissect_options *ndo)
+{
+	if (ndo->ndo_overlay_stats != ND_OVERLAY_STATS_JSON)
+		ND_PRINT(",");
+}
+
+static void
+report_end(netdissect_options *ndo)
+{
+	if (ndo->ndo_overlay_stats == ND_OVERLAY_STATS_JSON)
+		ND_PRINT("}\n");
+	else
+		ND_PRINT("\n");
+}
+
+static void
+report_address(netdissect_options *ndo, const char *name, int ipver,
+	       const u_char *addr)
+{
+	char buf[INET6_ADDRSTRLEN];
+
+	if (ipver == 4)
+		addrtostr(addr, buf, sizeof(buf));
+	else
+		addrtostr6(addr, buf, sizeof(buf));
+	report_string(ndo, name, buf);
+}
+
+static void
+report_header(netdissect_options *ndo)
+{
+	if (ndo->ndo_overlay_stats != ND_OVERLAY_STATS_CSV ||
+	    overlay_csv_header_printed)
+		return;
+	ND_PRINT("#tunnel,time,encap,id,packets,octets\n");
+	ND_PRINT("#flow,time,encap,id,proto,src,sport,dst,dport,packets,"
+	    "octets\n");
+	ND_PRINT("#overlay,time,packets,tunnelled,malformed,evicted\n");
+	overlay_csv_header_printed = 1;
+}
+
+static void
+report_tunnel_key(netdissect_options *ndo, const struct overlay_tunnel_key *key)
+{
+	report_string(ndo, "encap", overlay_encaps[key->encap]);
+	if (key->has_id)
+		report_uint(ndo, "id", key->id);
+	else
+		report_none(ndo);
+}
+
+static void
+report_tunnel(void *arg, const void *k, void *v)
+{
+	netdissect_options *ndo = (netdissect_options *)arg;
+	const struct overlay_counts *oc = (const struct overlay_counts *)v;
+
+	report_begin(ndo, "tunnel");
+	report_tunnel_key(ndo, (const struct overlay_tunnel_key *)k);
+	report_uint(ndo, "packets", oc->packets);
+	report_uint(ndo, "octets", oc->octets);
+	report_end(ndo);
+}
+
+static void
+report_flow(void *arg, const void *k, void *v)
+{
+	netdissect_options *ndo = (netdissect_options *)arg;
+	const struct overlay_flow_key *key = (const struct overlay_flow_key *)k;
+	const struct overlay_counts *oc = (const struct overlay_counts *)v;
+
+	report_begin(ndo, "flow");
+	report_tunnel_key(ndo, &key->tunnel);
+	if (key->inner.ipver != 0) {
+		report_uint(ndo, "proto", key->inner.proto);
+		report_address(ndo, "src", key->inner.ipver, key->inner.src);
+		report_uint(ndo, "sport", key->inner.sport);
+		report_address(ndo, "dst", key->inner.ipver, key->inner.dst);
+		report_uint(ndo, "dport", key->inner.dport);
+	} else {
+		report_none(ndo);
+		report_none(ndo);
+		report_none(ndo);
+		report_none(ndo);
+		report_none(ndo);
+	}
+	report_uint(ndo, "packets", oc->packets);
+	report_uint(ndo, "octets", oc->octets);
+	report_end(ndo);
+}
+
+/* Entries pushed out of a full table are reported at once. */
+static void
+report_evicted_tunnel(void *arg, const void *k, void *v)
+{
+	netdissect_options *ndo = (netdissect_options *)arg;
+
+	overlay_stats.evicted++;
+	overlay_report_time = ndo->ndo_ts.tv_sec;
+	report_header(ndo);
+	report_tunnel(arg, k, v);
+}
+
+static void
+report_evicted_flow(void *arg, const void *k, void *v)
+{
+	netdissect_options *ndo = (netdissect_options *)arg;
+
+	overlay_stats.evicted++;
+	overlay_report_time = ndo->ndo_ts.tv_sec;
+	report_header(ndo);
+	report_flow(arg, k, v);
+}
+
+static void
+overlay_report(netdissect_options *ndo, time_t when)
+{
+	overlay_report_time = when;
+	report_header(ndo);
+	if (overlay_tunnel_table != NULL) {
+		nd_lru_cache_walk(overlay_tunnel_table, report_tunnel, ndo);
+		nd_lru_cache_clear(overlay_tunnel_table);
+	}
+	if (overlay_flow_table != NULL) {
+		nd_lru_cache_walk(overlay_flow_table, report_flow, ndo);
+		nd_lru_cache_clear(overlay_flow_table);
+	}
+	report_begin(ndo, "overlay");
+	report_uint(ndo, "packets", overlay_stats.packets);
+	report_uint(ndo, "tunnelled", overlay_stats.tunnelled);
+	report_uint(ndo, "malformed", overlay_stats.malformed);
+	report_uint(ndo, "evicted", overlay_stats.evicted);
+	report_end(ndo);
+	memset(&overlay_stats, 0, sizeof(overlay_stats));
+}
+
+/*
+ * The header parsers are given the UDP or GRE payload at p, of which
+ * len bytes were sent, and return 1 with t filled in, or 0 if the
+ * header is malformed or not entirely captured.
+ */
+static int
+overlay_vxlan(netdissect_options *ndo, const u_char *p, u_int len,
+	      struct overlay_tunnel *t)
+{
+	if (len < 8 || !ND_TTEST_8(p))
+		return 0;
+	t->key.encap = OVERLAY_VXLAN;
+	if (EXTRACT_U_1(p) & VXLAN_I) {
+		t->key.has_id = 1;
+		t->key.id = EXTRACT_BE_U_3(p + 4);
+	}
+	t->payload = OVERLAY_PAYLOAD_ETHER;
+	t->p = p + 8;
+	t->len = len - 8;
+	return 1;
+}
+
+static int
+overlay_vxlan_gpe(netdissect_options *ndo, const u_char *p, u_int len,
+		  struct overlay_tunnel *t)
+{
+	u_int flags, next_protocol;
+
+	if (len < 8 || !ND_TTEST_8(p))
+		return 0;
+	flags = EXTRACT_U_1(p);
+	if (flags & VXLAN_GPE_VER_MASK)
+		return 0;
+	t->key.encap = OVERLAY_VXLAN_GPE;
+	if (flags & VXLAN_I) {
+		t->key.has_id = 1;
+		t->key.id = EXTRACT_BE_U_3(p + 4);
+	}
+	/* Without the P flag, the payload is Ethernet, as with VXLAN. */
+	if (flags & VXLAN_GPE_P)
+		next_protocol = EXTRACT_U_1(p + 3);
+	else
+		next_protocol = VXLAN_GPE_PROTO_ETHER;
+	if (flags & VXLAN_GPE_O)
+		t->payload = OVERLAY_PAYLOAD_OTHER;
+	else if (next_protocol == VXLAN_GPE_PROTO_ETHER)
+		t->payload = OVERLAY_PAYLOAD_ETHER;
+	else if (next_protocol == VXLAN_GPE_PROTO_IPV4 ||
+	    next_protocol == VXLAN_GPE_PROTO_IPV6)
+		t->payload = OVERLAY_PAYLOAD_IP;
+	else
+		t->payload = OVERLAY_PAYLOAD_OTHER;
+	t->p = p + 8;
+	t->len = len - 8;
+	return 1;
+}
+
+static int
+overlay_geneve(netdissect_options *ndo, const u_char *p, u_int len,
+	       struct overlay_tunnel *t)
+{
+	u_int hlen, prot;
+
+	if (len < 8 || !ND_TTEST_8(p))
+		return 0;
+	if (EXTRACT_U_1(p) >> 6 != 0)
+		return 0;
+	hlen = 8 + (EXTRACT_U_1(p) & 0x3f) * 4;
+	if (len < hlen)
+		return 0;
+	prot = EXTRACT_BE_U_2(p + 2);
+	t->key.encap = OVERLAY_GENEVE;
+	t->key.has_id = 1;
+	t->key.id = EXTRACT_BE_U_3(p + 4);
+	if (prot == ETHERTYPE_TEB)
+		t->payload = OVERLAY_PAYLOAD_ETHER;
+	else if (prot == ETHERTYPE_IP || prot == ETHERTYPE_IPV6)
+		t->payload = OVERLAY_PAYLOAD_IP;
+	else
+		t->payload = OVERLAY_PAYLOAD_OTHER;
+	t->p = p + hlen;
+	t->len = len - hlen;
+	return 1;
+}
+
+/*
+ * ERSPAN, after the GRE header: type I has no header of its own, types
+ * II and III have a session ID.
+ */
+static int
+overlay_erspan(netdissect_options *ndo, u_int prot, u_int gre_flags,
+	       const u_char *p, u_int len, struct overlay_tunnel *t)
+{
+	uint32_t hdr;
+	u_int hlen, ft;
+
+	t->key.encap = OVERLAY_ERSPAN;
+	t->payload = OVERLAY_PAYLOAD_ETHER;
+	if (prot == GRE_ERSPAN_I_II) {
+		if (!(gre_flags & GRE_SP)) {
+			t->p = p;
+			t->len = len;
+			return 1;
+		}
+		if (len < 8 || !ND_TTEST_8(p))
+			return 0;
+		hdr = EXTRACT_BE_U_4(p);
+		if (hdr >> 28 != ERSPAN2_VER)
+			return 0;
+		hlen = 8;
+	} else {
+		if (len < 12 || !ND_TTEST_LEN(p, 12))
+			return 0;
+		hdr = EXTRACT_BE_U_4(p);
+		if (hdr >> 28 != ERSPAN3_VER)
+			return 0;
+		hlen = 12;
+		/* The frame type and the platform specific header flag. */
+		ft = (EXTRACT_BE_U_2(p + 10) >> 10) & 0x1f;
+		if (EXTRACT_BE_U_2(p + 10) & 0x1)
+			hlen += 8;
+		if (len < hlen)
+			return 0;
+		if (ft == ERSPAN3_FT_IP)
+			t->payload = OVERLAY_PAYLOAD_IP;
+		else if (ft != ERSPAN3_FT_ETHERNET)
+			t->payload = OVERLAY_PAYLOAD_OTHER;
+	}
+	t->key.has_id = 1;
+	t->key.id = hdr & ERSPAN_SID_MASK;
+	t->p = p + hlen;
+	t->len = len - hlen;
+	return 1;
+}
+
+/*
+ * GRE version 0, as from gre_print(); returns -1 for version 1, i.e.
+ * PPTP, which isn't an overlay.
+ */
+static int
+overlay_gre(netdissect_options *ndo, const u_char *p, u_int len,
+	    struct overlay_tunnel *t)
+{
+	u_int flags, prot, hlen;
+
+	if (len < 4 || !ND_TTEST_4(p))
+		return 0;
+	flags = EXTRACT_BE_U_2(p);
+	prot = EXTRACT_BE_U_2(p + 2);
+	if (flags & GRE_VERS_MASK)
+		return -1;
+	hlen = 4;
+	if (flags & (GRE_CP | GRE_RP))
+		hlen += 4;
+	if (flags & GRE_KP) {
+		if (len < hlen + 4 || !ND_TTEST_4(p + hlen))
+			return 0;
+		t->key.has_id = 1;
+		t->key.id = EXTRACT_BE_U_4(p + hlen);
+		hlen += 4;
+	}
+	if (flags & GRE_SP)
+		hlen += 4;
+	if (len < hlen)
+		return 0;
+	p += hlen;
+	len -= hlen;
+	if (prot == GRE_ERSPAN_I_II || prot == GRE_ERSPAN_III) {
+		/* Accounted by ERSPAN session rather than by GRE key. */
+		memset(&t->key, 0, sizeof(t->key));
+		return overlay_erspan(ndo, prot, flags, p, len, t);
+	}
+	t->key.encap = OVERLAY_GRE;
+	/* Source routing entries, obsolete, aren't walked. */
+	if (flags & GRE_RP)
+		t->payload = OVERLAY_PAYLOAD_OTHER;
+	else if (prot == ETHERTYPE_TEB)
+		t->payload = OVERLAY_PAYLOAD_ETHER;
+	else if (prot == ETHERTYPE_IP || prot == ETHERTYPE_IPV6)
+		t->payload = OVERLAY_PAYLOAD_IP;
+	else
+		t->payload = OVERLAY_PAYLOAD_OTHER;
+	t->p = p;
+	t->len = len;
+	return 1;
+}
+
+/*
+ * Set the inner 5-tuple of key from the payload of t, going through an
+ * Ethernet header with up to two VLAN tags; it is left unset if there's
+ * no IPv4 or IPv6 header.
+ */
+static void
+overlay_inner(netdissect_options *ndo, const struct overlay_tunnel *t,
+	      struct nd_flow_key *key)
+{
+	const u_char *p = t->p;
+	u_int len = t->len;
+	u_int ethertype, i;
+
+	if (t->payload == OVERLAY_PAYLOAD_ETHER) {
+		if (len < 14 || !ND_TTEST_LEN(p, 14))
+			return;
+		ethertype = EXTRACT_BE_U_2(p + 12);
+		p += 14;
+		len -= 14;
+		for (i = 0; i < 2 && (ethertype == ETHERTYPE_8021Q ||
+		    ethertype == ETHERTYPE_8021QinQ ||
+		    ethertype == ETHERTYPE_8021Q9100); i++) {
+			if (len < 4 || !ND_TTEST_4(p))
+				return;
+			ethertype = EXTRACT_BE_U_2(p + 2);
+			p += 4;
+			len -= 4;
+		}
+		if (ethertype != ETHERTYPE_IP && ethertype != ETHERTYPE_IPV6)
+			return;
+	} else if (t->payload != OVERLAY_PAYLOAD_IP)
+		return;
+	nd_flow_key_set_ip(ndo, key, p, len);
+}
+
+static void
+overlay_count(netdissect_options *ndo, const struct overlay_tunnel *t)
+{
+	struct overlay_flow_key fkey;
+	struct overlay_counts *oc;
+
+	if (overlay_tunnel_table == NULL) {
+		overlay_tunnel_table = nd_lru_cache_create(ndo,
+		    OVERLAY_TUNNEL_TABLE_SIZE, sizeof(struct overlay_tunnel_key),
+		    sizeof(struct overlay_counts));
+		nd_lru_cache_set_evict(overlay_tunnel_table,
+		    report_evicted_tunnel, ndo);
+	}
+	oc = (struct overlay_counts *)nd_lru_cache_insert(overlay_tunnel_table,
+	    &t->key);
+	oc->packets++;
+	oc->octets += t->len;
+
+	if (ND_DECODE_STOP(ndo, ND_DECODE_DEPTH_TUNNEL))
+		return;
+	if (overlay_flow_table == NULL) {
+		overlay_flow_table = nd_lru_cache_create(ndo,
+		    OVERLAY_FLOW_TABLE_SIZE, sizeof(struct overlay_flow_key),
+		    sizeof(struct overlay_counts));
+		nd_lru_cache_set_evict(overlay_flow_table,
+		    report_evicted_flow, ndo);
+	}
+	memset(&fkey, 0, sizeof(fkey));
+	fkey.tunnel = t->key;
+	overlay_inner(ndo, t, &fkey.inner);
+	oc = (struct overlay_counts *)nd_lru_cache_insert(overlay_flow_table,
+	    &fkey);
+	oc->packets++;
+	oc->octets += t->len;
+}
+
+/*
+ * Account for the IPv4 or IPv6 packet at ip, of which len bytes were
+ * captured, if it's tunnelled.
+ *
+ * The UDP encapsulations are recognized by their ports, as udp_print()
+ * does.  As with --flow-collector, fragments and IPv6 extension headers
+ * aren't handled, and the packet is skipped; zero IPv4, IPv6 or UDP
+ * lengths are taken as those of segmentation offload, as ip_print() does.
+ */
+void
+nd_overlay_packet(netdissect_options *ndo, const u_char *ip, u_int len)
+{
+	struct overlay_tunnel t;
+	const u_char *p;
+	u_int hlen, iplen, proto, ulen, sport, dport;
+	int ret;
+
+	if (len < 1)
+		return;
+	switch (EXTRACT_U_1(ip) >> 4) {
+
+	case 4:
+		if (len < 20)
+			return;
+		overlay_stats.packets++;
+		hlen = (EXTRACT_U_1(ip) & 0x0f) * 4;
+		iplen = EXTRACT_BE_U_2(ip + 2);
+		if (iplen == 0)
+			iplen = len;
+		if (hlen < 20 || iplen < hlen ||
+		    (EXTRACT_BE_U_2(ip + 6) & 0x3fff) != 0)
+			return;
+		proto = EXTRACT_U_1(ip + 9);
+		iplen -= hlen;
+		break;
+
+	case 6:
+		if (len < 40)
+			return;
+		overlay_stats.packets++;
+		hlen = 40;
+		proto = EXTRACT_U_1(ip + 6);
+		iplen = EXTRACT_BE_U_2(ip + 4);
+		if (iplen == 0)
+			iplen = len - hlen;
+		break;
+
+	default:
+		return;
+	}
+	p = ip + hlen;
+
+	memset(&t, 0, sizeof(t));
+	if (proto == IPPROTO_UDP) {
+		if (iplen < 8 || len < hlen + 8)
+			return;
+		sport = EXTRACT_BE_U_2(p);
+		dport = EXTRACT_BE_U_2(p + 2);
+		ulen = EXTRACT_BE_U_2(p + 4);
+		if (ulen == 0)
+			ulen = iplen;
+		if (ulen < 8 || ulen > iplen)
+			return;
+		if (IS_SRC_OR_DST_PORT(VXLAN_LINUX_PORT) ||
+		    IS_SRC_OR_DST_PORT(VXLAN_PORT))
+			ret = overlay_vxlan(ndo, p + 8, ulen - 8, &t);
+		else if (dport == GENEVE_PORT)
+			ret = overlay_geneve(ndo, p + 8, ulen - 8, &t);
+		else if (IS_SRC_OR_DST_PORT(VXLAN_GPE_PORT))
+			ret = overlay_vxlan_gpe(ndo, p + 8, ulen - 8, &t);
+		else
+			return;
+	} else if (proto == IPPROTO_GRE)
+		ret = overlay_gre(ndo, p, iplen, &t);
+	else
+		return;
+
+	if (ret < 0)
+		return;
+	if (ret == 0) {
+		overlay_stats.malformed++;
+		return;
+	}
+	overlay_stats.tunnelled++;
+	overlay_count(ndo, &t);
+}
+
+/*
+ * Called for each packet, with ndo_ts set to its time, to report at the
+ * end of each interval, as nd_flow_collector_tick() does.
+ */
+void
+nd_overlay_tick(netdissect_options *ndo)
+{
+	time_t now = ndo->ndo_ts.tv_sec;
+	time_t interval = ndo->ndo_flow_report_interval;
+
+	if (interval == 0)
+		return;
+	if (overlay_next_report != 0 && now >= overlay_next_report)
+		overlay_report(ndo, overlay_next_report);
+	if (overlay_next_report == 0 || now >= overlay_next_report)
+		overlay_next_report = now - now % interval + interval;
+}
+
+/*
+ * Print what was accounted since the last report, stamped with the time
+ * of the last packet.
+ */
+void
+nd_overlay_print_stats(netdissect_options *ndo)
+{
+	if (ndo->ndo_overlay_stats == ND_OVERLAY_STATS_OFF)
+		return;
+	overlay_report(ndo, ndo->ndo_ts.tv_sec);
+}
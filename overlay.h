@@ -0,0 +1,25 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ *
+ * Accounting of the tunnelled traffic, for --overlay-stats.
+ */
+
+#ifndef netdissect_overlay_h
+#define netdissect_overlay_h
+
+#include "netdissect.h"
+
+extern void nd_overlay_packet(netdissect_options *, const u_char *, u_int);
+extern void nd_overlay_tick(netdissect_options *);
+extern void nd_overlay_print_stats(netdissect_options *);
+
+#endif /* netdissect_overlay_h */
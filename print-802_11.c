@@ -34,6 +34,7 @@
 #include "extract.h"
 
 #include "cpack.h"
+#include "lru_cache.h"
 
 
 /* Lengths of 802.11 header components. */
@@ -190,54 +191,22 @@ struct mgmt_header_t {
 #define	CAPABILITY_CFP_REQ(cap)	((cap) & 0x0008)
 #define	CAPABILITY_PRIVACY(cap)	((cap) & 0x0010)
 
-struct ssid_t {
-	u_int		length;
-	u_char		ssid[33];  /* 32 + 1 for null */
-};
-
-struct rates_t {
-	u_int		length;
-	uint8_t		rate[16];
-};
-
-struct challenge_t {
-	u_int		length;
-	uint8_t		text[254]; /* 1-253 + 1 for null */
-};
-
-struct fh_t {
-	u_int		length;
-	uint16_t	dwell_time;
-	uint8_t		hop_set;
-	uint8_t	hop_pattern;
-	uint8_t		hop_index;
-};
-
-struct ds_t {
-	u_int		length;
-	uint8_t		channel;
-};
-
-struct cf_t {
-	u_int		length;
-	uint8_t		count;
-	uint8_t		period;
-	uint16_t	max_duration;
-	uint16_t	dur_remaining;
-};
-
-struct tim_t {
+/*
+ * An element of a management frame body, as a reference to its contents
+ * in the packet buffer, which parse_elements() has bounds-checked.
+ * data is NULL if the element isn't in the frame.
+ */
+struct element_ref {
+	const u_char	*data;
 	u_int		length;
-	uint8_t		count;
-	uint8_t		period;
-	uint8_t		bitmap_control;
-	uint8_t		bitmap[251];
 };
 
-struct meshid_t {
-	u_int		length;
-	u_char		meshid[33];  /* 32 + 1 for null */
-};
+/* The longest of these elements that are taken as valid. */
+#define	SSID_MAXLEN		32
+#define	RATES_MAXLEN		16
+#define	CHALLENGE_MAXLEN	253
+#define	TIM_MAXLEN		254	/* 3 + a bitmap of up to 251 */
+#define	MESHID_MAXLEN		32
 
 #define	E_SSID		0
 #define	E_RATES	1
@@ -265,6 +234,20 @@ struct meshid_t {
 /* reserved		16 */
 #define E_MESHID	114
 
+/*
+ * The elements parse_elements() finds, as indexes in the array of
+ * references in struct mgmt_body_t, and bits in a mask of the elements
+ * a frame type prints; the others are only checked.
+ */
+#define	ELEM_SSID	0
+#define	ELEM_RATES	1
+#define	ELEM_DS		2
+#define	ELEM_CF		3
+#define	ELEM_TIM	4
+#define	ELEM_CHALLENGE	5
+#define	ELEM_MESHID	6
+#define	NUM_ELEMS	7
+#define	ELEM_BIT(e)	(1U << (e))
 
 struct mgmt_body_t {
 	uint8_t		timestamp[IEEE802_11_TSTAMP_LEN];
@@ -276,23 +259,8 @@ struct mgmt_body_t {
 	uint16_t	reason_code;
 	uint16_t	auth_alg;
 	uint16_t	auth_trans_seq_num;
-	int		challenge_present;
-	struct challenge_t  challenge;
 	uint16_t	capability_info;
-	int		ssid_present;
-	struct ssid_t	ssid;
-	int		rates_present;
-	struct rates_t	rates;
-	int		ds_present;
-	struct ds_t	ds;
-	int		cf_present;
-	struct cf_t	cf;
-	int		fh_present;
-	struct fh_t	fh;
-	int		tim_present;
-	struct tim_t	tim;
-	int		meshid_present;
-	struct meshid_t	meshid;
+	struct element_ref elem[NUM_ELEMS];
 };
 
 struct ctrl_control_wrapper_hdr_t {
@@ -400,38 +368,42 @@ struct meshcntl_t {
 #define	IV_PAD(iv)	(((iv) >> 24) & 0x3F)
 #define	IV_KEYID(iv)	(((iv) >> 30) & 0x03)
 
+/*
+ * The elements are printed from the packet buffer, where parse_elements()
+ * has checked they are; they are still fetched with the checked macros.
+ */
 #define PRINT_SSID(p) \
-	if (p.ssid_present) { \
+	if (p.elem[ELEM_SSID].data != NULL) { \
 		ND_PRINT(" ("); \
-		fn_print_str(ndo, p.ssid.ssid); \
+		nd_printjnp(ndo, p.elem[ELEM_SSID].data, \
+		    p.elem[ELEM_SSID].length); \
 		ND_PRINT(")"); \
 	}
 
 #define PRINT_RATE(_sep, _r, _suf) \
 	ND_PRINT("%s%2.1f%s", _sep, (.5 * ((_r) & 0x7f)), _suf)
 #define PRINT_RATES(p) \
-	if (p.rates_present) { \
+	if (p.elem[ELEM_RATES].data != NULL) { \
 		const char *sep = " ["; \
-		if (p.rates.length != 0) { \
-			for (u_int z = 0; z < p.rates.length ; z++) { \
-				PRINT_RATE(sep, p.rates.rate[z], \
-					(p.rates.rate[z] & 0x80 ? "*" : "")); \
-				sep = " "; \
-			} \
-			ND_PRINT(" Mbit]"); \
+		for (u_int z = 0; z < p.elem[ELEM_RATES].length; z++) { \
+			uint8_t r = GET_U_1(p.elem[ELEM_RATES].data + z); \
+			PRINT_RATE(sep, r, (r & 0x80 ? "*" : "")); \
+			sep = " "; \
 		} \
+		ND_PRINT(" Mbit]"); \
 	}
 
 #define PRINT_DS_CHANNEL(p) \
-	if (p.ds_present) \
-		ND_PRINT(" CH: %u", p.ds.channel); \
+	if (p.elem[ELEM_DS].data != NULL) \
+		ND_PRINT(" CH: %u", GET_U_1(p.elem[ELEM_DS].data)); \
 	ND_PRINT("%s", \
 	    CAPABILITY_PRIVACY(p.capability_info) ? ", PRIVACY" : "");
 
 #define PRINT_MESHID(p) \
-	if (p.meshid_present) { \
+	if (p.elem[ELEM_MESHID].data != NULL) { \
 		ND_PRINT(" (MESHID: "); \
-		fn_print_str(ndo, p.meshid.meshid); \
+		nd_printjnp(ndo, p.elem[ELEM_MESHID].data, \
+		    p.elem[ELEM_MESHID].length); \
 		ND_PRINT(")"); \
 	}
 
@@ -1141,30 +1113,22 @@ trunc:
 	return 0;
 }
 
+/*
+ * Go through the elements of a management frame body, and refer to the
+ * first of each of those in the "wanted" mask of ELEM_BIT()s.
+ */
 static int
 parse_elements(netdissect_options *ndo,
 	       struct mgmt_body_t *pbody, const u_char *p, int offset,
-	       u_int length)
+	       u_int length, u_int wanted)
 {
 	u_int elementlen;
-	struct ssid_t ssid;
-	struct challenge_t challenge;
-	struct rates_t rates;
-	struct ds_t ds;
-	struct cf_t cf;
-	struct tim_t tim;
-	struct meshid_t meshid;
+	int elem;
 
 	/*
 	 * We haven't seen any elements yet.
 	 */
-	pbody->challenge_present = 0;
-	pbody->ssid_present = 0;
-	pbody->rates_present = 0;
-	pbody->ds_present = 0;
-	pbody->cf_present = 0;
-	pbody->tim_present = 0;
-	pbody->meshid_present = 0;
+	memset(pbody->elem, 0, sizeof(pbody->elem));
 
 	while (length != 0) {
 		/* Make sure we at least have the element ID and length. */
@@ -1178,76 +1142,26 @@ parse_elements(netdissect_options *ndo,
 		if (length < elementlen + 2)
 			goto trunc;
 
+		/*
+		 * Find which of the elements we know this one is, if
+		 * it's valid; one that's too long ends the parsing.
+		 */
+		elem = -1;
 		switch (GET_U_1(p + offset)) {
 		case E_SSID:
-			ssid.length = elementlen;
-			offset += 2;
-			length -= 2;
-			if (ssid.length != 0) {
-				if (ssid.length > sizeof(ssid.ssid) - 1)
-					return 0;
-				memcpy(&ssid.ssid, p + offset, ssid.length);
-				offset += ssid.length;
-				length -= ssid.length;
-			}
-			ssid.ssid[ssid.length] = '\0';
-			/*
-			 * Present and not truncated.
-			 *
-			 * If we haven't already seen an SSID IE,
-			 * copy this one, otherwise ignore this one,
-			 * so we later report the first one we saw.
-			 */
-			if (!pbody->ssid_present) {
-				pbody->ssid = ssid;
-				pbody->ssid_present = 1;
-			}
+			if (elementlen > SSID_MAXLEN)
+				return 0;
+			elem = ELEM_SSID;
 			break;
 		case E_CHALLENGE:
-			challenge.length = elementlen;
-			offset += 2;
-			length -= 2;
-			if (challenge.length != 0) {
-				if (challenge.length >
-				    sizeof(challenge.text) - 1)
-					return 0;
-				memcpy(&challenge.text, p + offset,
-				    challenge.length);
-				offset += challenge.length;
-				length -= challenge.length;
-			}
-			challenge.text[challenge.length] = '\0';
-			/*
-			 * Present and not truncated.
-			 *
-			 * If we haven't already seen a challenge IE,
-			 * copy this one, otherwise ignore this one,
-			 * so we later report the first one we saw.
-			 */
-			if (!pbody->challenge_present) {
-				pbody->challenge = challenge;
-				pbody->challenge_present = 1;
-			}
+			if (elementlen > CHALLENGE_MAXLEN)
+				return 0;
+			elem = ELEM_CHALLENGE;
 			break;
 		case E_RATES:
-			rates.length = elementlen;
-			offset += 2;
-			length -= 2;
-			if (rates.length != 0) {
-				if (rates.length > sizeof(rates.rate))
-					return 0;
-				memcpy(&rates.rate, p + offset, rates.length);
-				offset += rates.length;
-				length -= rates.length;
-			}
+			if (elementlen > RATES_MAXLEN)
+				return 0;
 			/*
-			 * Present and not truncated.
-			 *
-			 * If we haven't already seen a rates IE,
-			 * copy this one if it's not zero-length,
-			 * otherwise ignore this one, so we later
-			 * report the first one we saw.
-			 *
 			 * We ignore zero-length rates IEs as some
 			 * devices seem to put a zero-length rates
 			 * IE, followed by an SSID IE, followed by
@@ -1256,136 +1170,51 @@ parse_elements(netdissect_options *ndo,
 			 * seem to indicate that a zero-length rates
 			 * IE is valid.
 			 */
-			if (!pbody->rates_present && rates.length != 0) {
-				pbody->rates = rates;
-				pbody->rates_present = 1;
-			}
+			if (elementlen != 0)
+				elem = ELEM_RATES;
 			break;
 		case E_DS:
-			ds.length = elementlen;
-			offset += 2;
-			length -= 2;
-			if (ds.length != 1) {
-				offset += ds.length;
-				length -= ds.length;
-				break;
-			}
-			ds.channel = GET_U_1(p + offset);
-			offset += 1;
-			length -= 1;
-			/*
-			 * Present and not truncated.
-			 *
-			 * If we haven't already seen a DS IE,
-			 * copy this one, otherwise ignore this one,
-			 * so we later report the first one we saw.
-			 */
-			if (!pbody->ds_present) {
-				pbody->ds = ds;
-				pbody->ds_present = 1;
-			}
+			if (elementlen == 1)
+				elem = ELEM_DS;
 			break;
 		case E_CF:
-			cf.length = elementlen;
-			offset += 2;
-			length -= 2;
-			if (cf.length != 6) {
-				offset += cf.length;
-				length -= cf.length;
-				break;
-			}
-			cf.count = GET_U_1(p + offset);
-			offset += 1;
-			length -= 1;
-			cf.period = GET_U_1(p + offset);
-			offset += 1;
-			length -= 1;
-			cf.max_duration = GET_LE_U_2(p + offset);
-			offset += 2;
-			length -= 2;
-			cf.dur_remaining = GET_LE_U_2(p + offset);
-			offset += 2;
-			length -= 2;
-			/*
-			 * Present and not truncated.
-			 *
-			 * If we haven't already seen a CF IE,
-			 * copy this one, otherwise ignore this one,
-			 * so we later report the first one we saw.
-			 */
-			if (!pbody->cf_present) {
-				pbody->cf = cf;
-				pbody->cf_present = 1;
-			}
+			if (elementlen == 6)
+				elem = ELEM_CF;
 			break;
 		case E_TIM:
-			tim.length = elementlen;
-			offset += 2;
-			length -= 2;
-			if (tim.length <= 3U) {
-				offset += tim.length;
-				length -= tim.length;
+			if (elementlen <= 3)
 				break;
-			}
-			if (tim.length - 3U > sizeof(tim.bitmap))
+			if (elementlen > TIM_MAXLEN)
 				return 0;
-			tim.count = GET_U_1(p + offset);
-			offset += 1;
-			length -= 1;
-			tim.period = GET_U_1(p + offset);
-			offset += 1;
-			length -= 1;
-			tim.bitmap_control = GET_U_1(p + offset);
-			offset += 1;
-			length -= 1;
-			memcpy(tim.bitmap, p + offset, tim.length - 3);
-			offset += tim.length - 3;
-			length -= tim.length - 3;
-			/*
-			 * Present and not truncated.
-			 *
-			 * If we haven't already seen a TIM IE,
-			 * copy this one, otherwise ignore this one,
-			 * so we later report the first one we saw.
-			 */
-			if (!pbody->tim_present) {
-				pbody->tim = tim;
-				pbody->tim_present = 1;
-			}
+			elem = ELEM_TIM;
 			break;
 		case E_MESHID:
-			meshid.length = elementlen;
-			offset += 2;
-			length -= 2;
-			if (meshid.length != 0) {
-				if (meshid.length > sizeof(meshid.meshid) - 1)
-					return 0;
-				memcpy(&meshid.meshid, p + offset, meshid.length);
-				offset += meshid.length;
-				length -= meshid.length;
-			}
-			meshid.meshid[meshid.length] = '\0';
-			/*
-			 * Present and not truncated.
-			 *
-			 * If we haven't already seen a MESHID IE,
-			 * copy this one, otherwise ignore this one,
-			 * so we later report the first one we saw.
-			 */
-			if (!pbody->meshid_present) {
-				pbody->meshid = meshid;
-				pbody->meshid_present = 1;
-			}
+			if (elementlen > MESHID_MAXLEN)
+				return 0;
+			elem = ELEM_MESHID;
 			break;
 		default:
 #if 0
 			ND_PRINT("(1) unhandled element_id (%u)  ",
 			    GET_U_1(p + offset));
 #endif
-			offset += 2 + elementlen;
-			length -= 2 + elementlen;
 			break;
 		}
+
+		/*
+		 * Present and not truncated.
+		 *
+		 * If we haven't already seen such an element, refer to
+		 * this one, otherwise ignore this one, so we later
+		 * report the first one we saw.
+		 */
+		if (elem != -1 && (wanted & ELEM_BIT(elem)) != 0 &&
+		    pbody->elem[elem].data == NULL) {
+			pbody->elem[elem].data = p + offset + 2;
+			pbody->elem[elem].length = elementlen;
+		}
+		offset += 2 + elementlen;
+		length -= 2 + elementlen;
 	}
 
 	/* No problems found. */
@@ -1423,7 +1252,9 @@ handle_beacon(netdissect_options *ndo,
 	offset += IEEE802_11_CAPINFO_LEN;
 	length -= IEEE802_11_CAPINFO_LEN;
 
-	ret = parse_elements(ndo, &pbody, p, offset, length);
+	ret = parse_elements(ndo, &pbody, p, offset, length,
+	    ELEM_BIT(ELEM_SSID) | ELEM_BIT(ELEM_RATES) |
+	    ELEM_BIT(ELEM_DS) | ELEM_BIT(ELEM_MESHID));
 
 	PRINT_SSID(pbody);
 	PRINT_RATES(pbody);
@@ -1457,7 +1288,8 @@ handle_assoc_request(netdissect_options *ndo,
 	offset += IEEE802_11_LISTENINT_LEN;
 	length -= IEEE802_11_LISTENINT_LEN;
 
-	ret = parse_elements(ndo, &pbody, p, offset, length);
+	ret = parse_elements(ndo, &pbody, p, offset, length,
+	    ELEM_BIT(ELEM_SSID) | ELEM_BIT(ELEM_RATES));
 
 	PRINT_SSID(pbody);
 	PRINT_RATES(pbody);
@@ -1491,7 +1323,7 @@ handle_assoc_response(netdissect_options *ndo,
 	offset += IEEE802_11_AID_LEN;
 	length -= IEEE802_11_AID_LEN;
 
-	ret = parse_elements(ndo, &pbody, p, offset, length);
+	ret = parse_elements(ndo, &pbody, p, offset, length, 0);
 
 	ND_PRINT(" AID(%x) :%s: %s", ((uint16_t)(pbody.aid << 2 )) >> 2 ,
 	    CAPABILITY_PRIVACY(pbody.capability_info) ? " PRIVACY " : "",
@@ -1529,7 +1361,8 @@ handle_reassoc_request(netdissect_options *ndo,
 	offset += IEEE802_11_AP_LEN;
 	length -= IEEE802_11_AP_LEN;
 
-	ret = parse_elements(ndo, &pbody, p, offset, length);
+	ret = parse_elements(ndo, &pbody, p, offset, length,
+	    ELEM_BIT(ELEM_SSID));
 
 	PRINT_SSID(pbody);
 	ND_PRINT(" AP : %s", mac48_string(ndo,  pbody.ap ));
@@ -1557,7 +1390,8 @@ handle_probe_request(netdissect_options *ndo,
 
 	memset(&pbody, 0, sizeof(pbody));
 
-	ret = parse_elements(ndo, &pbody, p, offset, length);
+	ret = parse_elements(ndo, &pbody, p, offset, length,
+	    ELEM_BIT(ELEM_SSID) | ELEM_BIT(ELEM_RATES));
 
 	PRINT_SSID(pbody);
 	PRINT_RATES(pbody);
@@ -1590,7 +1424,9 @@ handle_probe_response(netdissect_options *ndo,
 	offset += IEEE802_11_CAPINFO_LEN;
 	length -= IEEE802_11_CAPINFO_LEN;
 
-	ret = parse_elements(ndo, &pbody, p, offset, length);
+	ret = parse_elements(ndo, &pbody, p, offset, length,
+	    ELEM_BIT(ELEM_SSID) | ELEM_BIT(ELEM_RATES) |
+	    ELEM_BIT(ELEM_DS) | ELEM_BIT(ELEM_MESHID));
 
 	PRINT_SSID(pbody);
 	PRINT_RATES(pbody);
@@ -1655,7 +1491,7 @@ handle_auth(netdissect_options *ndo,
 	offset += 2;
 	length -= 2;
 
-	ret = parse_elements(ndo, &pbody, p, offset, length);
+	ret = parse_elements(ndo, &pbody, p, offset, length, 0);
 
 	if ((pbody.auth_alg == 1) &&
 	    ((pbody.auth_trans_seq_num == 2) ||
@@ -2757,6 +2593,11 @@ print_chaninfo(netdissect_options *ndo,
 	ND_PRINT(" ");
 }
 
+/*
+ * The alignment and size of what each case fetches must match its
+ * entry in radiotap_field_layout[], from which the cached offsets of
+ * the fields are worked out; change both together.
+ */
 static int
 print_radiotap_field(netdissect_options *ndo,
 		     struct cpack_state *s, uint32_t bit, uint8_t *flagsp,
@@ -3275,6 +3116,184 @@ print_in_radiotap_namespace(netdissect_options *ndo,
 	return 0;
 }
 
+/*
+ * Alignment and size of the fields of the radiotap namespace, as
+ * print_radiotap_field() fetches them, indexed by bit number; a size
+ * of 0 is for a field it doesn't know.  An entry that doesn't match
+ * the fetches of its case there misplaces the fields after it in the
+ * frames printed from the offset cache.
+ */
+static const struct {
+	uint8_t align;
+	uint8_t size;
+} radiotap_field_layout[IEEE80211_RADIOTAP_NAMESPACE] = {
+	{ 8, 8 },	/* IEEE80211_RADIOTAP_TSFT */
+	{ 1, 1 },	/* IEEE80211_RADIOTAP_FLAGS */
+	{ 1, 1 },	/* IEEE80211_RADIOTAP_RATE */
+	{ 2, 4 },	/* IEEE80211_RADIOTAP_CHANNEL */
+	{ 1, 2 },	/* IEEE80211_RADIOTAP_FHSS */
+	{ 1, 1 },	/* IEEE80211_RADIOTAP_DBM_ANTSIGNAL */
+	{ 1, 1 },	/* IEEE80211_RADIOTAP_DBM_ANTNOISE */
+	{ 2, 2 },	/* IEEE80211_RADIOTAP_LOCK_QUALITY */
+	{ 2, 2 },	/* IEEE80211_RADIOTAP_TX_ATTENUATION */
+	{ 1, 1 },	/* IEEE80211_RADIOTAP_DB_TX_ATTENUATION */
+	{ 1, 1 },	/* IEEE80211_RADIOTAP_DBM_TX_POWER */
+	{ 1, 1 },	/* IEEE80211_RADIOTAP_ANTENNA */
+	{ 1, 1 },	/* IEEE80211_RADIOTAP_DB_ANTSIGNAL */
+	{ 1, 1 },	/* IEEE80211_RADIOTAP_DB_ANTNOISE */
+	{ 2, 2 },	/* IEEE80211_RADIOTAP_RX_FLAGS */
+	{ 0, 0 },	/* 15 */
+	{ 0, 0 },	/* 16 */
+	{ 0, 0 },	/* 17 */
+	{ 4, 8 },	/* IEEE80211_RADIOTAP_XCHANNEL */
+	{ 1, 3 },	/* IEEE80211_RADIOTAP_MCS */
+	{ 4, 8 },	/* IEEE80211_RADIOTAP_AMPDU_STATUS */
+	{ 2, 12 },	/* IEEE80211_RADIOTAP_VHT */
+	{ 0, 0 },	/* 22 */
+	{ 0, 0 },	/* 23 */
+	{ 0, 0 },	/* 24 */
+	{ 0, 0 },	/* 25 */
+	{ 0, 0 },	/* 26 */
+	{ 0, 0 },	/* 27 */
+	{ 0, 0 },	/* 28 */
+};
+
+/*
+ * A capture from one interface has the same few combinations of
+ * presence bitmaps in all its frames, so the offsets of the fields
+ * they select are kept in a cache keyed on the bitmaps, rather than
+ * worked out for every frame.  Frames with more bitmaps, or that
+ * switch to a vendor namespace, whose length is in the frame, are
+ * printed by walking the bitmaps.
+ */
+#define RADIOTAP_LAYOUT_CACHE_SIZE	64
+#define RADIOTAP_LAYOUT_MAX_WORDS	4
+#define RADIOTAP_LAYOUT_MAX_FIELDS \
+	(RADIOTAP_LAYOUT_MAX_WORDS * IEEE80211_RADIOTAP_NAMESPACE)
+
+struct radiotap_layout_key {
+	uint32_t npresent;
+	uint32_t present[RADIOTAP_LAYOUT_MAX_WORDS];
+};
+
+struct radiotap_layout {
+	int cacheable;		/* 0 if the bitmaps must be walked */
+	u_int end;		/* offset of the end of the last field */
+	u_int nfields;
+	struct {
+		uint8_t bit;	/* radiotap bit number */
+		uint8_t word;	/* presence bitmap it's in */
+		uint16_t offset; /* from the start of the header */
+	} fields[RADIOTAP_LAYOUT_MAX_FIELDS];
+};
+
+static struct nd_lru_cache *radiotap_layouts;
+
+/*
+ * Work out the offsets of the fields selected by the presence bitmaps
+ * in key, the same way print_in_radiotap_namespace() and
+ * ieee802_11_radio_print() go through them.  A field
+ * print_radiotap_field() doesn't know ends the list, as it ends the
+ * printing.
+ */
+static void
+radiotap_layout_compute(const struct radiotap_layout_key *key,
+			struct radiotap_layout *l)
+{
+	uint32_t present, next_present;
+	u_int w, bit, bit0, offset;
+	int bitno;
+
+	l->cacheable = 1;
+	l->nfields = 0;
+	/* The fields follow the bitmaps, aligned against the header start. */
+	offset = sizeof(struct ieee80211_radiotap_header) +
+	    (key->npresent - 1) * sizeof(nd_uint32_t);
+	bit0 = 0;
+	for (w = 0; w < key->npresent; w++) {
+		for (present = key->present[w]; present; present = next_present) {
+			next_present = present & (present - 1);
+			bitno = BITNO_32(present ^ next_present);
+			if (bitno >= IEEE80211_RADIOTAP_NAMESPACE)
+				break;
+			bit = bit0 + bitno;
+			l->fields[l->nfields].bit = (uint8_t)bit;
+			l->fields[l->nfields].word = (uint8_t)w;
+			if (bit >= IEEE80211_RADIOTAP_NAMESPACE ||
+			    radiotap_field_layout[bit].size == 0) {
+				/* Printed as "[bit N]", then nothing more. */
+				l->fields[l->nfields++].offset = 0;
+				goto done;
+			}
+			offset = roundup2(offset, radiotap_field_layout[bit].align);
+			l->fields[l->nfields++].offset = (uint16_t)offset;
+			offset += radiotap_field_layout[bit].size;
+		}
+
+		switch (key->present[w] &
+		    ((1U << IEEE80211_RADIOTAP_NAMESPACE)|(1U << IEEE80211_RADIOTAP_VENDOR_NAMESPACE))) {
+
+		case 0:
+			bit0 += 32;
+			break;
+
+		case 1U << IEEE80211_RADIOTAP_NAMESPACE:
+			bit0 = 0;
+			break;
+
+		case 1U << IEEE80211_RADIOTAP_VENDOR_NAMESPACE:
+			l->cacheable = 0;
+			return;
+
+		default:
+			/* Both bits are ignored. */
+			break;
+		}
+	}
+done:
+	l->end = offset;
+}
+
+/*
+ * Return the layout of the fields for the presence bitmaps from presentp
+ * to last_presentp, or NULL if there are too many of them to cache.
+ */
+static const struct radiotap_layout *
+radiotap_layout_get(netdissect_options *ndo, const nd_uint32_t *presentp,
+		    const nd_uint32_t *last_presentp)
+{
+	struct radiotap_layout_key key;
+	struct radiotap_layout *l;
+	u_int w;
+
+	if (last_presentp - presentp >= RADIOTAP_LAYOUT_MAX_WORDS)
+		return NULL;
+	memset(&key, 0, sizeof(key));
+	key.npresent = (uint32_t)(last_presentp - presentp) + 1;
+	for (w = 0; w < key.npresent; w++)
+		key.present[w] = GET_LE_U_4(presentp + w);
+
+	if (radiotap_layouts == NULL)
+		radiotap_layouts = nd_lru_cache_create(ndo,
+		    RADIOTAP_LAYOUT_CACHE_SIZE, sizeof(key), sizeof(*l));
+	l = (struct radiotap_layout *)nd_lru_cache_find(radiotap_layouts,
+	    &key);
+	if (l == NULL) {
+		l = (struct radiotap_layout *)nd_lru_cache_insert(
+		    radiotap_layouts, &key);
+		radiotap_layout_compute(&key, l);
+	}
+	return l;
+}
+
+void
+ieee802_11_radio_print_stats(netdissect_options *ndo)
+{
+	if (radiotap_layouts != NULL)
+		nd_lru_cache_print_stats(ndo, radiotap_layouts,
+		    "802.11 radiotap layout cache");
+}
+
 u_int
 ieee802_11_radio_print(netdissect_options *ndo,
 		       const u_char *p, u_int length, u_int caplen)
@@ -3296,6 +3315,8 @@ ieee802_11_radio_print(netdissect_options *ndo,
 	uint8_t flags;
 	int pad;
 	u_int fcslen;
+	const struct radiotap_layout *layout;
+	u_int i;
 
 	ndo->ndo_protocol = "802.11_radio";
 	if (caplen < sizeof(*hdr)) {
@@ -3337,6 +3358,24 @@ ieee802_11_radio_print(netdissect_options *ndo,
 		return caplen;
 	}
 
+	/* Assume no flags */
+	flags = 0;
+
+	/*
+	 * If the fields are at known offsets, print them from there.
+	 */
+	layout = radiotap_layout_get(ndo, &hdr->it_present, last_presentp);
+	if (layout != NULL && layout->cacheable && layout->end <= len) {
+		for (i = 0; i < layout->nfields; i++) {
+			cpacker.c_next = cpacker.c_buf + layout->fields[i].offset;
+			if (print_radiotap_field(ndo, &cpacker,
+			    layout->fields[i].bit, &flags,
+			    GET_LE_U_4(&hdr->it_present + layout->fields[i].word)) != 0)
+				break;
+		}
+		goto fields_done;
+	}
+
 	/*
 	 * Start out at the beginning of the default radiotap namespace.
 	 */
@@ -3345,12 +3384,6 @@ ieee802_11_radio_print(netdissect_options *ndo,
 	memset(vendor_oui, 0, 3);
 	vendor_subnamespace = 0;
 	skip_length = 0;
-	/* Assume no flags */
-	flags = 0;
-	/* Assume no Atheros padding between 802.11 header and body */
-	pad = 0;
-	/* Assume no FCS at end of frame */
-	fcslen = 0;
 	for (presentp = &hdr->it_present; presentp <= last_presentp;
 	    presentp++) {
 		presentflags = GET_LE_U_4(presentp);
@@ -3464,6 +3497,11 @@ ieee802_11_radio_print(netdissect_options *ndo,
 		}
 	}
 
+fields_done:
+	/* Assume no Atheros padding between 802.11 header and body */
+	pad = 0;
+	/* Assume no FCS at end of frame */
+	fcslen = 0;
 	if (flags & IEEE80211_RADIOTAP_F_DATAPAD)
 		pad = 1;	/* Atheros padding */
 	if (flags & IEEE80211_RADIOTAP_F_FCS)
@@ -43,6 +43,7 @@
 
 #include "netdissect.h"
 #include "addrtoname.h"
+#include "addrtostr.h"
 #include "extract.h"
 #include "af.h"
 #include "l2vpn.h"
@@ -1709,6 +1710,152 @@ check_add_path(netdissect_options *ndo, const u_char *pptr, u_int length,
     return 0;
 }
 
+/*
+ * Return the longest prefix for the address family and subsequent
+ * address family whose NLRI is a list of IPv4 or IPv6 prefixes, as in
+ * the withdrawn routes and NLRI of UPDATE messages, or 0 for the others.
+ */
+static u_int
+bgp_prefix_maxlen(uint16_t af, uint8_t safi)
+{
+    switch (af<<8 | safi) {
+    case (AFNUM_IP<<8 | SAFNUM_UNICAST):
+    case (AFNUM_IP<<8 | SAFNUM_MULTICAST):
+    case (AFNUM_IP<<8 | SAFNUM_UNIMULTICAST):
+        return 32;
+    case (AFNUM_IP6<<8 | SAFNUM_UNICAST):
+    case (AFNUM_IP6<<8 | SAFNUM_MULTICAST):
+    case (AFNUM_IP6<<8 | SAFNUM_UNIMULTICAST):
+        return 128;
+    default:
+        return 0;
+    }
+}
+
+/* Put the decimal digits of v in buf and return their number. */
+static u_int
+bgp_format_uint(char *buf, u_int v)
+{
+    char digits[10];
+    u_int n = 0, i;
+
+    do {
+        digits[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v != 0);
+    for (i = 0; i < n; i++)
+        buf[i] = digits[n - 1 - i];
+    return n;
+}
+
+/*
+ * Room needed in the buffer of bgp_prefix_block_print() for a prefix,
+ * not counting its address when names are printed: the separator, an
+ * IPv6 address, "/128" and "   Path Id: 4294967295".
+ */
+#define BGP_PREFIX_ENTRY_SIZE	(16 + INET6_ADDRSTRLEN + 4 + 22)
+
+/*
+ * Print the block of len bytes at p of IPv4 (if max_plen is 32) or IPv6
+ * (if it's 128) prefixes, each one preceded by a path ID if add_path is
+ * set, with sep before each one; with --bgp-prefix-counts, print only
+ * how many there are.
+ *
+ * A full routing table goes through here, so the block is checked as a
+ * whole first, and the prefixes are then formatted, without any more
+ * checks or copies, into a buffer printed when it's full.  Return 0 if
+ * the block isn't all in the captured data or isn't made of valid
+ * prefixes ending exactly at its end; nothing was printed, and the
+ * caller has to print the prefixes one at a time, reporting the error
+ * where it is.
+ */
+static int
+bgp_prefix_block_print(netdissect_options *ndo, const u_char *p, u_int len,
+                       u_int max_plen, int add_path, const char *sep)
+{
+    char buf[4096];
+    u_char addr[16];
+    const char *name;
+    size_t n, seplen, namelen;
+    u_int off, plen, plenbytes, count, path_id = 0;
+
+    if (!ND_TTEST_LEN(p, len))
+        return 0;
+    count = 0;
+    for (off = 0; off < len; count++) {
+        if (add_path) {
+            if (len - off < 5)
+                return 0;
+            off += 4;
+        }
+        plen = EXTRACT_U_1(p + off);
+        if (plen > max_plen || len - off - 1 < (plen + 7) / 8)
+            return 0;
+        off += 1 + (plen + 7) / 8;
+    }
+
+    if (ndo->ndo_bgp_prefix_counts) {
+        if (count != 0)
+            ND_PRINT("%s%u prefix%s", sep, count, count == 1 ? "" : "es");
+        return 1;
+    }
+
+    seplen = strlen(sep);
+    n = 0;
+    for (off = 0; off < len;) {
+        if (add_path) {
+            path_id = EXTRACT_BE_U_4(p + off);
+            off += 4;
+        }
+        plen = EXTRACT_U_1(p + off);
+        plenbytes = (plen + 7) / 8;
+        memset(addr, 0, sizeof(addr));
+        memcpy(addr, p + off + 1, plenbytes);
+        if (plen % 8)
+            addr[plenbytes - 1] &= ((0xff00 >> (plen % 8)) & 0xff);
+        off += 1 + plenbytes;
+
+        if (ndo->ndo_nflag) {
+            name = NULL;
+            namelen = 0;
+        } else {
+            name = max_plen == 32 ? ipaddr_string(ndo, addr) :
+                ip6addr_string(ndo, addr);
+            namelen = strlen(name);
+        }
+        if (sizeof(buf) - n < BGP_PREFIX_ENTRY_SIZE + namelen) {
+            ND_PRINT("%.*s", (int)n, buf);
+            n = 0;
+        }
+        memcpy(buf + n, sep, seplen);
+        n += seplen;
+        if (name != NULL) {
+            memcpy(buf + n, name, namelen);
+            n += namelen;
+        } else if (max_plen == 32) {
+            n += bgp_format_uint(buf + n, addr[0]);
+            buf[n++] = '.';
+            n += bgp_format_uint(buf + n, addr[1]);
+            buf[n++] = '.';
+            n += bgp_format_uint(buf + n, addr[2]);
+            buf[n++] = '.';
+            n += bgp_format_uint(buf + n, addr[3]);
+        } else {
+            addrtostr6(addr, buf + n, INET6_ADDRSTRLEN);
+            n += strlen(buf + n);
+        }
+        buf[n++] = '/';
+        n += bgp_format_uint(buf + n, plen);
+        if (add_path) {
+            memcpy(buf + n, "   Path Id: ", 12);
+            n += 12;
+            n += bgp_format_uint(buf + n, path_id);
+        }
+    }
+    ND_PRINT("%.*s", (int)n, buf);
+    return 1;
+}
+
 static int
 bgp_mp_af_print(netdissect_options *ndo,
 	        const u_char *tptr, u_int tlen,
@@ -1908,6 +2055,7 @@ bgp_attr_print(netdissect_options *ndo,
     const u_char *tptr;
     u_int as_size;
     int add_path4, add_path6;
+    u_int maxlen;
     int ret;
 
     tptr = pptr;
@@ -2263,6 +2411,13 @@ bgp_attr_print(netdissect_options *ndo,
         add_path6 = check_add_path(ndo, tptr,
                                    (len-ND_BYTES_BETWEEN(pptr, tptr)), 128);
 
+        maxlen = bgp_prefix_maxlen(af, safi);
+        if (maxlen != 0 &&
+            bgp_prefix_block_print(ndo, tptr,
+                                   ND_BYTES_BETWEEN(tptr, pptr + len),
+                                   maxlen, maxlen == 32 ?
+                                   add_path4 : add_path6, "\n\t      "))
+            break;
         while (tptr < pptr + len) {
             advance = bgp_nlri_print(ndo, af, safi, tptr, len,
                     add_path4, add_path6);
@@ -2292,6 +2447,13 @@ bgp_attr_print(netdissect_options *ndo,
         add_path6 = check_add_path(ndo, tptr,
                                    (len-ND_BYTES_BETWEEN(pptr, tptr)), 128);
 
+        maxlen = bgp_prefix_maxlen(af, safi);
+        if (maxlen != 0 &&
+            bgp_prefix_block_print(ndo, tptr,
+                                   ND_BYTES_BETWEEN(tptr, pptr + len),
+                                   maxlen, maxlen == 32 ?
+                                   add_path4 : add_path6, "\n\t      "))
+            break;
         while (tptr < pptr + len) {
             advance = bgp_nlri_print(ndo, af, safi, tptr, len,
                     add_path4, add_path6);
@@ -2904,6 +3066,12 @@ bgp_update_print(netdissect_options *ndo,
             goto trunc;
         ND_PRINT("\n\t  Withdrawn routes:");
         add_path = check_add_path(ndo, p, withdrawn_routes_len, 32);
+        if (bgp_prefix_block_print(ndo, p, withdrawn_routes_len, 32,
+                                   add_path, "\n\t    ")) {
+            p += withdrawn_routes_len;
+            length -= withdrawn_routes_len;
+            withdrawn_routes_len = 0;
+        }
         while (withdrawn_routes_len != 0) {
             if (add_path) {
                 if (withdrawn_routes_len < 4) {
@@ -3022,6 +3190,9 @@ bgp_update_print(netdissect_options *ndo,
     if (length) {
         add_path = check_add_path(ndo, p, length, 32);
         ND_PRINT("\n\t  Updated routes:");
+        if (bgp_prefix_block_print(ndo, p, length, 32, add_path,
+                                   "\n\t    "))
+            return;
         while (length != 0) {
             if (add_path) {
                 ND_TCHECK_4(p);
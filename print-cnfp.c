@@ -44,10 +44,13 @@
 
 #include "netdissect-stdinc.h"
 
+#include <string.h>
+
 #define ND_LONGJMP_FROM_TCHECK
 #include "netdissect.h"
 #include "addrtoname.h"
 #include "extract.h"
+#include "flow_collector.h"
 
 #include "tcp.h"
 #include "ipproto.h"
@@ -192,15 +195,15 @@ cnfp_v1_print(netdissect_options *ndo, const u_char *cp)
 		       GET_BE_U_4(nr->last_time)%1000);
 
 		ND_PRINT("\n    %s:%u ",
-			intoa(GET_IPV4_TO_NETWORK_ORDER(nr->src_ina)),
+			nd_intoa(ndo, GET_IPV4_TO_NETWORK_ORDER(nr->src_ina)),
 			GET_BE_U_2(nr->srcport));
 
 		ND_PRINT("> %s:%u ",
-			intoa(GET_IPV4_TO_NETWORK_ORDER(nr->dst_ina)),
+			nd_intoa(ndo, GET_IPV4_TO_NETWORK_ORDER(nr->dst_ina)),
 			GET_BE_U_2(nr->dstport));
 
 		ND_PRINT(">> %s\n    ",
-			intoa(GET_IPV4_TO_NETWORK_ORDER(nr->nhop_ina)));
+			nd_intoa(ndo, GET_IPV4_TO_NETWORK_ORDER(nr->nhop_ina)));
 
 		proto = GET_U_1(nr->proto);
 		if (!ndo->ndo_nflag && (p_name = netdb_protoname(proto)) != NULL)
@@ -270,17 +273,17 @@ cnfp_v5_print(netdissect_options *ndo, const u_char *cp)
 		       GET_BE_U_4(nr->last_time)%1000);
 
 		ND_PRINT("\n    %s/%u:%u:%u ",
-			intoa(GET_IPV4_TO_NETWORK_ORDER(nr->src_ina)),
+			nd_intoa(ndo, GET_IPV4_TO_NETWORK_ORDER(nr->src_ina)),
 			GET_U_1(nr->src_mask), GET_BE_U_2(nr->src_as),
 			GET_BE_U_2(nr->srcport));
 
 		ND_PRINT("> %s/%u:%u:%u ",
-			intoa(GET_IPV4_TO_NETWORK_ORDER(nr->dst_ina)),
+			nd_intoa(ndo, GET_IPV4_TO_NETWORK_ORDER(nr->dst_ina)),
 			GET_U_1(nr->dst_mask), GET_BE_U_2(nr->dst_as),
 			GET_BE_U_2(nr->dstport));
 
 		ND_PRINT(">> %s\n    ",
-			intoa(GET_IPV4_TO_NETWORK_ORDER(nr->nhop_ina)));
+			nd_intoa(ndo, GET_IPV4_TO_NETWORK_ORDER(nr->nhop_ina)));
 
 		proto = GET_U_1(nr->proto);
 		if (!ndo->ndo_nflag && (p_name = netdb_protoname(proto)) != NULL)
@@ -350,17 +353,17 @@ cnfp_v6_print(netdissect_options *ndo, const u_char *cp)
 		       GET_BE_U_4(nr->last_time)%1000);
 
 		ND_PRINT("\n    %s/%u:%u:%u ",
-			intoa(GET_IPV4_TO_NETWORK_ORDER(nr->src_ina)),
+			nd_intoa(ndo, GET_IPV4_TO_NETWORK_ORDER(nr->src_ina)),
 			GET_U_1(nr->src_mask), GET_BE_U_2(nr->src_as),
 			GET_BE_U_2(nr->srcport));
 
 		ND_PRINT("> %s/%u:%u:%u ",
-			intoa(GET_IPV4_TO_NETWORK_ORDER(nr->dst_ina)),
+			nd_intoa(ndo, GET_IPV4_TO_NETWORK_ORDER(nr->dst_ina)),
 			GET_U_1(nr->dst_mask), GET_BE_U_2(nr->dst_as),
 			GET_BE_U_2(nr->dstport));
 
 		ND_PRINT(">> %s\n    ",
-			intoa(GET_IPV4_TO_NETWORK_ORDER(nr->nhop_ina)));
+			nd_intoa(ndo, GET_IPV4_TO_NETWORK_ORDER(nr->nhop_ina)));
 
 		proto = GET_U_1(nr->proto);
 		if (!ndo->ndo_nflag && (p_name = netdb_protoname(proto)) != NULL)
@@ -387,6 +390,97 @@ cnfp_v6_print(netdissect_options *ndo, const u_char *cp)
 	}
 }
 
+/*
+ * Lengths of the headers and records of each version, for collecting.
+ * (struct nfrec_v5 ends with the peer next hop of the v6 records, which
+ * the v5 records don't have.)  v7 is v5 with more fields at the ends of
+ * the headers and records.
+ */
+#define NF_V1_HDR_LEN	16
+#define NF_V1_REC_LEN	48
+#define NF_V5_HDR_LEN	24
+#define NF_V5_REC_LEN	48
+#define NF_V6_HDR_LEN	24
+#define NF_V6_REC_LEN	52
+#define NF_V7_HDR_LEN	24
+#define NF_V7_REC_LEN	52
+
+/*
+ * Add the records of a NetFlow datagram of len bytes, sent by the
+ * exporter at the IPv4 (ipver 4) or IPv6 address agent, to the
+ * --flow-collector tables.  Returns 0 if the datagram isn't valid or of
+ * a version that isn't supported.
+ */
+int
+cnfp_collect(netdissect_options *ndo, const u_char *cp, u_int len,
+	     int ipver, const u_char *agent)
+{
+	const struct nfhdr_v5 *nh5;
+	const struct nfrec_v1 *nr;
+	struct nd_flow_key key;
+	u_int ver, nrecs, hdrlen, reclen, interval;
+	uint64_t scale = 1;
+
+	ndo->ndo_protocol = "cnfp";
+	ver = GET_BE_U_2(cp);
+	switch (ver) {
+
+	case 1:
+		hdrlen = NF_V1_HDR_LEN;
+		reclen = NF_V1_REC_LEN;
+		break;
+
+	case 5:
+		hdrlen = NF_V5_HDR_LEN;
+		reclen = NF_V5_REC_LEN;
+		/* The top two bits are the sampling mode. */
+		nh5 = (const struct nfhdr_v5 *)cp;
+		interval = GET_BE_U_2(nh5->sampling_interval) & 0x3fff;
+		if (interval > 1)
+			scale = interval;
+		break;
+
+	case 6:
+		hdrlen = NF_V6_HDR_LEN;
+		reclen = NF_V6_REC_LEN;
+		break;
+
+	case 7:
+		hdrlen = NF_V7_HDR_LEN;
+		reclen = NF_V7_REC_LEN;
+		break;
+
+	default:
+		return 0;
+	}
+	nrecs = GET_BE_U_2(((const struct nfhdr_v1 *)cp)->count);
+	if (len < hdrlen || (len - hdrlen) / reclen < nrecs)
+		return 0;
+
+	memset(&key, 0, sizeof(key));
+	key.exporter = ND_FLOW_NETFLOW;
+	nd_flow_key_set_agent(&key, ipver, agent);
+	key.ipver = 4;
+	/*
+	 * The fields collected are at the same offsets in the records of
+	 * all the versions.
+	 */
+	for (cp += hdrlen; nrecs != 0; cp += reclen, nrecs--) {
+		nr = (const struct nfrec_v1 *)cp;
+		ND_TCHECK_LEN(cp, reclen);
+		GET_CPY_BYTES(key.src, nr->src_ina, sizeof(nd_ipv4));
+		GET_CPY_BYTES(key.dst, nr->dst_ina, sizeof(nd_ipv4));
+		key.input = GET_BE_U_2(nr->input);
+		key.output = GET_BE_U_2(nr->output);
+		key.proto = GET_U_1(nr->proto);
+		key.sport = GET_BE_U_2(nr->srcport);
+		key.dport = GET_BE_U_2(nr->dstport);
+		nd_flow_collect(ndo, &key, scale * GET_BE_U_4(nr->packets),
+		    scale * GET_BE_U_4(nr->octets));
+	}
+	return 1;
+}
+
 void
 cnfp_print(netdissect_options *ndo, const u_char *cp)
 {
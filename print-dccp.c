@@ -397,7 +397,7 @@ dccp_print(netdissect_options *ndo, const u_char *bp, const u_char *data2,
 		dccp_print_ack_no(ndo, bp);
 
 	if (ndo->ndo_vflag < 2)
-		return;
+		goto payload;
 
 	ND_PRINT("seq %" PRIu64, dccp_seqno(ndo, bp));
 
@@ -420,6 +420,19 @@ dccp_print(netdissect_options *ndo, const u_char *bp, const u_char *data2,
 		}
 		ND_PRINT(">");
 	}
+payload:
+	/*
+	 * The payload isn't dissected; with --decode-depth l4, print its
+	 * length, as tcp_print() and udp_print() do.  Without -vv, the
+	 * line already ends with a space.
+	 */
+	if (ND_DECODE_STOP(ndo, ND_DECODE_DEPTH_L4)) {
+		/* The option loop consumed hlen. */
+		hlen = GET_U_1(dh->dccph_doff) * 4;
+		if (length >= hlen)
+			ND_PRINT(ndo->ndo_vflag < 2 ? "length %u" :
+				 ", length %u", length - hlen);
+	}
 	return;
 invalid:
 	nd_print_invalid(ndo);
@@ -1179,15 +1179,10 @@ print_reason(netdissect_options *ndo,
 const char *
 dnnum_string(netdissect_options *ndo, u_short dnaddr)
 {
-	char *str;
-	size_t siz;
+	char str[sizeof("00.0000")];
 	u_int area = (u_short)(dnaddr & AREAMASK) >> AREASHIFT;
 	u_int node = dnaddr & NODEMASK;
 
-	/* malloc() return used by the 'dnaddrtable' hash table: do not free() */
-	str = (char *)malloc(siz = sizeof("00.0000"));
-	if (str == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC, "%s: malloc", __func__);
-	snprintf(str, siz, "%u.%u", area, node);
-	return(str);
+	snprintf(str, sizeof(str), "%u.%u", area, node);
+	return(nd_scratch_strdup(ndo, str));
 }
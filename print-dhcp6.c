@@ -272,7 +272,7 @@ struct dhcp6opt {
 };
 
 static const char *
-dhcp6stcode(const uint16_t code)
+dhcp6stcode(netdissect_options *ndo, const uint16_t code)
 {
 	return code > 255 ? "INVALID code" : tok2str(dh6opt_stcode_str, "code%u", code);
 }
@@ -618,7 +618,7 @@ dhcp6opt_print(netdissect_options *ndo,
 				break;
 			}
 			tp = (const u_char *)(dh6o + 1);
-			ND_PRINT(" %s)", dhcp6stcode(GET_BE_U_2(tp)));
+			ND_PRINT(" %s)", dhcp6stcode(ndo, GET_BE_U_2(tp)));
 			break;
 		case DH6OPT_IA_NA:
 		case DH6OPT_IA_PD:
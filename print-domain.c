@@ -25,13 +25,21 @@
 
 #include "netdissect-stdinc.h"
 
+#include <stdlib.h>
 #include <string.h>
 
+#include "netdissect-ctype.h"
+
 #include "netdissect.h"
+#include "netdissect-alloc.h"
 #include "addrtoname.h"
 #include "addrtostr.h"
 #include "extract.h"
+#include "histogram.h"
+#include "fields.h"
 
+#include "ip.h"
+#include "ip6.h"
 #include "nameser.h"
 
 static const char *ns_ops[] = {
@@ -178,6 +186,108 @@ labellen(netdissect_options *ndo,
 	}
 }
 
+/*
+ * The names printed in a packet, so that the suffix a compression
+ * pointer points to, if it was printed before, can be printed at once
+ * rather than by following the pointer and printing it again.
+ *
+ * Each label of a name that was printed completely gets an entry,
+ * found by its offset in the message, with the text of the name from
+ * that label on.  The entries and the text are allocated with
+ * nd_malloc() and so freed, with the cache, after each packet.
+ */
+#define DNS_NAME_BUCKETS	64
+#define DNS_NAME_MAX_LABELS	((MAXCDNAME + 1) / 2)
+#define DNS_NAME_TEXT_SIZE	(MAXCDNAME * FN_CHAR_MAXLEN + 1)
+
+struct dns_name_suffix {
+	struct dns_name_suffix *next;
+	u_int offset;			/* of the first label in the message */
+	const char *text;		/* as printed */
+	u_int textlen;
+	u_int name_chars;		/* as counted by fqdn_print() */
+};
+
+struct dns_name_cache {
+	const u_char *bp;		/* start of the message */
+	struct dns_name_suffix *buckets[DNS_NAME_BUCKETS];
+};
+
+/* A label of the name being printed. */
+struct dns_name_label {
+	u_int offset;
+	u_int textpos;			/* where its text starts */
+	u_int name_chars;		/* name characters before it */
+};
+
+static u_int
+dns_name_hash(u_int offset)
+{
+	return (offset * 2654435761U) >> 26;	/* 64 buckets */
+}
+
+static const struct dns_name_suffix *
+dns_name_lookup(netdissect_options *ndo, const u_char *bp, u_int offset)
+{
+	const struct dns_name_cache *nc = ndo->ndo_dns_names;
+	const struct dns_name_suffix *sp;
+
+	if (nc == NULL || nc->bp != bp)
+		return NULL;
+	for (sp = nc->buckets[dns_name_hash(offset)]; sp != NULL;
+	    sp = sp->next) {
+		if (sp->offset == offset)
+			return sp;
+	}
+	return NULL;
+}
+
+/*
+ * Remember a name that was printed completely, in name_chars characters
+ * and as text, for each of its labels that isn't in the cache yet.
+ */
+static void
+dns_name_enter(netdissect_options *ndo, const u_char *bp,
+	       const struct dns_name_label *labels, u_int nlabels,
+	       const char *text, u_int textlen, u_int name_chars)
+{
+	struct dns_name_cache *nc = ndo->ndo_dns_names;
+	struct dns_name_suffix *sp;
+	char *textcopy;
+	u_int i, h;
+
+	if (nc == NULL || nc->bp != bp) {
+		/*
+		 * First name in the packet, or in another message in
+		 * it; only the names of the current message are kept.
+		 */
+		nc = (struct dns_name_cache *)nd_malloc(ndo, sizeof(*nc));
+		if (nc == NULL)
+			return;
+		memset(nc, 0, sizeof(*nc));
+		nc->bp = bp;
+		ndo->ndo_dns_names = nc;
+	}
+	sp = (struct dns_name_suffix *)nd_malloc(ndo,
+	    nlabels * sizeof(*sp) + textlen);
+	if (sp == NULL)
+		return;
+	textcopy = (char *)(sp + nlabels);
+	memcpy(textcopy, text, textlen);
+	for (i = 0; i < nlabels; i++) {
+		if (dns_name_lookup(ndo, bp, labels[i].offset) != NULL)
+			continue;
+		sp->offset = labels[i].offset;
+		sp->text = textcopy + labels[i].textpos;
+		sp->textlen = textlen - labels[i].textpos;
+		sp->name_chars = name_chars - labels[i].name_chars;
+		h = dns_name_hash(sp->offset);
+		sp->next = nc->buckets[h];
+		nc->buckets[h] = sp;
+		sp++;
+	}
+}
+
 /* print a <domain-name> */
 const u_char *
 fqdn_print(netdissect_options *ndo,
@@ -189,6 +299,16 @@ fqdn_print(netdissect_options *ndo,
 	u_int elt;
 	u_int offset, max_offset;
 	u_int name_chars = 0;
+	const struct dns_name_suffix *sp;
+	/*
+	 * The text of the name, and where its labels are, to be cached
+	 * if it's printed completely; cacheable is cleared if it can't
+	 * be, e.g. if it has a bit label.
+	 */
+	struct dns_name_label labels[DNS_NAME_MAX_LABELS];
+	char text[DNS_NAME_TEXT_SIZE];
+	u_int nlabels = 0, textlen = 0, j;
+	int cacheable = 1;
 
 	if ((l = labellen(ndo, cp)) == (u_int)-1)
 		return(NULL);
@@ -230,6 +350,27 @@ fqdn_print(netdissect_options *ndo,
 				}
 				max_offset = offset;
 				cp = bp + offset;
+				/*
+				 * If the rest of the name was printed before,
+				 * print it again at once.  It was printed with
+				 * a limit on the pointers in it no higher than
+				 * the one it would get now, so it would be
+				 * printed the same way.
+				 */
+				sp = dns_name_lookup(ndo, bp, offset);
+				if (sp != NULL &&
+				    name_chars + sp->name_chars <= MAXCDNAME) {
+					ND_PRINT("%.*s", (int)sp->textlen,
+					    sp->text);
+					if (cacheable) {
+						memcpy(text + textlen, sp->text,
+						    sp->textlen);
+						textlen += sp->textlen;
+					}
+					name_chars += sp->name_chars;
+					i = 0;
+					continue;
+				}
 				if (!ND_TTEST_1(cp))
 					return(NULL);
 				i = GET_U_1(cp);
@@ -242,6 +383,7 @@ fqdn_print(netdissect_options *ndo,
 				elt = (i & ~TYPE_MASK);
 				switch(elt) {
 				case EDNS0_ELT_BITLABEL:
+					cacheable = 0;
 					if (blabel_print(ndo, cp) == NULL)
 						return (NULL);
 					break;
@@ -257,6 +399,31 @@ fqdn_print(netdissect_options *ndo,
 				return(NULL);
 
 			case TYPE_LABEL:
+				if (cacheable && name_chars + l < MAXCDNAME &&
+				    cp - 1 >= bp && ND_TTEST_LEN(cp, l)) {
+					/*
+					 * Print the label, and its ".", from
+					 * the text of the name.
+					 */
+					labels[nlabels].offset =
+					    (u_int)(cp - 1 - bp);
+					labels[nlabels].textpos = textlen;
+					labels[nlabels].name_chars = name_chars;
+					nlabels++;
+					for (j = 0; j < l; j++)
+						textlen += fn_format_char(
+						    text + textlen,
+						    GET_U_1(cp + j));
+					text[textlen] = '.';
+					ND_PRINT("%.*s", (int)(textlen + 1 -
+					    labels[nlabels - 1].textpos),
+					    text + labels[nlabels - 1].textpos);
+					textlen++;
+					name_chars += l + 1;
+					cp += l;
+					goto next_label;
+				}
+				cacheable = 0;
 				if (name_chars + l <= MAXCDNAME) {
 					if (nd_printn(ndo, cp, l, ndo->ndo_snapend))
 						return(NULL);
@@ -273,6 +440,7 @@ fqdn_print(netdissect_options *ndo,
 			if (name_chars <= MAXCDNAME)
 				ND_PRINT(".");
 			name_chars++;
+		next_label:
 			if (!ND_TTEST_1(cp))
 				return(NULL);
 			i = GET_U_1(cp);
@@ -284,6 +452,9 @@ fqdn_print(netdissect_options *ndo,
 		}
 		if (name_chars > MAXCDNAME)
 			ND_PRINT("<DOMAIN NAME TOO LONG>");
+		else if (i == 0 && cacheable && nlabels != 0)
+			dns_name_enter(ndo, bp, labels, nlabels, text, textlen,
+			    name_chars);
 	} else
 		ND_PRINT(".");
 	return (rp);
@@ -731,7 +902,7 @@ ns_rprint(netdissect_options *ndo,
 	case T_A:
 		if (!ND_TTEST_LEN(cp, sizeof(nd_ipv4)))
 			return(NULL);
-		ND_PRINT(" %s", intoa(GET_IPV4_TO_NETWORK_ORDER(cp)));
+		ND_PRINT(" %s", nd_intoa(ndo, GET_IPV4_TO_NETWORK_ORDER(cp)));
 		break;
 
 	case T_NS:
@@ -900,9 +1071,438 @@ trunc:
 	return(NULL);
 }
 
+/*
+ * Query/response tracking for --dns-stats.
+ *
+ * The queries are kept in an array managed as a ring, in the order they
+ * were seen, so that the oldest one is the first to go when the table is
+ * full or when it gets too old; they are found by a hash of the ID and
+ * of the client and server addresses and ports.
+ */
+#define DNS_XACT_TABLE_SIZE	4096
+#define DNS_XACT_MAX_AGE	30	/* seconds */
+#define DNS_XACT_NONE		UINT32_MAX
+
+struct dns_xact {
+	uint16_t id;			/* DNS ID */
+	uint16_t cport;			/* client port */
+	uint16_t sport;			/* server port */
+	uint8_t ipver;			/* IP version (4 or 6) */
+	uint8_t answered;		/* a response was seen */
+	nd_ipv6 client;			/* client IP address (net order) */
+	nd_ipv6 server;			/* server IP address (net order) */
+	struct timeval ts;		/* time stamp of the query */
+	uint32_t hnext;			/* next entry in the hash chain */
+	uint32_t hprev;			/* previous entry in the hash chain */
+};
+
+static struct dns_xact *dns_xacts;
+static uint32_t *dns_xact_buckets;
+static u_int dns_xact_head;		/* oldest entry */
+static u_int dns_xact_count;
+
+#define DNS_NRCODES	(sizeof(ns_resp) / sizeof(ns_resp[0]))
+
+static struct {
+	uint64_t queries;
+	uint64_t responses;
+	uint64_t matched;
+	uint64_t duplicates;		/* responses to answered queries */
+	uint64_t rcodes[DNS_NRCODES + 1];	/* the last one for the others */
+} dns_stats;
+
+static struct nd_histogram *dns_latency;
+static struct nd_addr_hists dns_server_latency;
+
+/*
+ * The most queried names are found with the Space-Saving algorithm: a
+ * fixed number of names are counted, and a name that isn't replaces the
+ * least counted one, taking over its count, which bounds the error.
+ */
+#define DNS_TOPNAMES_SIZE	128
+#define DNS_TOPNAMES_PRINT	10
+
+struct dns_topname {
+	char name[256];
+	uint32_t hash;
+	uint64_t count;
+	uint64_t error;			/* count is at most this too high */
+};
+
+static struct dns_topname *dns_topnames;
+static u_int dns_topname_count;
+
+/*
+ * Fill in the addresses and ports of *xp for a message going from the
+ * client to the server, or the other way if is_response is set.
+ * Returns 0 if the network layer isn't IPv4 or IPv6.
+ */
+static int
+dns_xact_key(netdissect_options *ndo, const u_char *bp2, uint16_t sport,
+	     uint16_t dport, int is_response, struct dns_xact *xp)
+{
+	const struct ip *ip = (const struct ip *)bp2;
+	const struct ip6_hdr *ip6 = (const struct ip6_hdr *)bp2;
+	const u_char *src, *dst;
+	u_int addrlen;
+
+	memset(xp->client, 0, sizeof(xp->client));
+	memset(xp->server, 0, sizeof(xp->server));
+	switch (IP_V(ip)) {
+	case 4:
+		src = ip->ip_src;
+		dst = ip->ip_dst;
+		addrlen = sizeof(nd_ipv4);
+		break;
+	case 6:
+		src = ip6->ip6_src;
+		dst = ip6->ip6_dst;
+		addrlen = sizeof(nd_ipv6);
+		break;
+	default:
+		return 0;
+	}
+	xp->ipver = IP_V(ip);
+	if (is_response) {
+		UNALIGNED_MEMCPY(&xp->client, dst, addrlen);
+		UNALIGNED_MEMCPY(&xp->server, src, addrlen);
+		xp->cport = dport;
+		xp->sport = sport;
+	} else {
+		UNALIGNED_MEMCPY(&xp->client, src, addrlen);
+		UNALIGNED_MEMCPY(&xp->server, dst, addrlen);
+		xp->cport = sport;
+		xp->sport = dport;
+	}
+	return 1;
+}
+
+static u_int
+dns_xact_hash(const struct dns_xact *xp)
+{
+	uint32_t hash;
+	u_int i;
+
+	hash = ((uint32_t)xp->id << 16 | xp->cport) ^ xp->sport;
+	for (i = 0; i < sizeof(nd_ipv6); i++)
+		hash = hash * 31 + xp->client[i] + xp->server[i];
+	hash *= 2654435761U;
+	return (hash >> 16) & (DNS_XACT_TABLE_SIZE - 1);
+}
+
+static int
+dns_xact_same(const struct dns_xact *a, const struct dns_xact *b)
+{
+	return a->id == b->id && a->cport == b->cport &&
+	    a->sport == b->sport && a->ipver == b->ipver &&
+	    memcmp(a->client, b->client, sizeof(a->client)) == 0 &&
+	    memcmp(a->server, b->server, sizeof(a->server)) == 0;
+}
+
+static void
+dns_xact_drop_oldest(void)
+{
+	struct dns_xact *xp = &dns_xacts[dns_xact_head];
+
+	if (xp->hprev != DNS_XACT_NONE)
+		dns_xacts[xp->hprev].hnext = xp->hnext;
+	else
+		dns_xact_buckets[dns_xact_hash(xp)] = xp->hnext;
+	if (xp->hnext != DNS_XACT_NONE)
+		dns_xacts[xp->hnext].hprev = xp->hprev;
+	if (++dns_xact_head == DNS_XACT_TABLE_SIZE)
+		dns_xact_head = 0;
+	dns_xact_count--;
+}
+
+static void
+dns_xact_enter(netdissect_options *ndo, const struct dns_xact *key)
+{
+	struct dns_xact *xp;
+	u_int idx, bucket, i;
+
+	if (dns_xacts == NULL) {
+		dns_xacts = (struct dns_xact *)calloc(DNS_XACT_TABLE_SIZE,
+		    sizeof(*dns_xacts));
+		dns_xact_buckets = (uint32_t *)malloc(DNS_XACT_TABLE_SIZE *
+		    sizeof(*dns_xact_buckets));
+		if (dns_xacts == NULL || dns_xact_buckets == NULL)
+			(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
+			    "%s: malloc", __func__);
+		for (i = 0; i < DNS_XACT_TABLE_SIZE; i++)
+			dns_xact_buckets[i] = DNS_XACT_NONE;
+	}
+
+	/* Make room, and forget the queries that got too old. */
+	while (dns_xact_count != 0 &&
+	    (dns_xact_count == DNS_XACT_TABLE_SIZE ||
+	     ndo->ndo_ts.tv_sec - dns_xacts[dns_xact_head].ts.tv_sec >
+	     DNS_XACT_MAX_AGE))
+		dns_xact_drop_oldest();
+
+	idx = (dns_xact_head + dns_xact_count) % DNS_XACT_TABLE_SIZE;
+	dns_xact_count++;
+	xp = &dns_xacts[idx];
+	*xp = *key;
+	xp->ts = ndo->ndo_ts;
+	xp->answered = 0;
+	bucket = dns_xact_hash(xp);
+	xp->hprev = DNS_XACT_NONE;
+	xp->hnext = dns_xact_buckets[bucket];
+	if (xp->hnext != DNS_XACT_NONE)
+		dns_xacts[xp->hnext].hprev = idx;
+	dns_xact_buckets[bucket] = idx;
+}
+
+static struct dns_xact *
+dns_xact_find(netdissect_options *ndo, const struct dns_xact *key)
+{
+	struct dns_xact *xp;
+	uint32_t idx;
+
+	if (dns_xacts == NULL)
+		return NULL;
+	for (idx = dns_xact_buckets[dns_xact_hash(key)];
+	     idx != DNS_XACT_NONE; idx = xp->hnext) {
+		xp = &dns_xacts[idx];
+		if (!dns_xact_same(xp, key))
+			continue;
+		if (ndo->ndo_ts.tv_sec - xp->ts.tv_sec > DNS_XACT_MAX_AGE)
+			break;	/* a reused ID */
+		return xp;
+	}
+	return NULL;
+}
+
+/*
+ * Copy the name at cp, in lower case, to buf.  Returns 0 if it doesn't
+ * fit, is truncated or uses anything other than labels and pointers.
+ */
+static int
+dns_name_copy(netdissect_options *ndo, const u_char *cp, const u_char *bp,
+	      char *buf, size_t size)
+{
+	u_int i, offset, max_offset = (u_int)(cp - bp);
+	size_t n = 0;
+	u_char c;
+
+	for (;;) {
+		if (!ND_TTEST_1(cp))
+			return 0;
+		i = GET_U_1(cp);
+		if ((i & TYPE_MASK) == TYPE_INDIR) {
+			if (!ND_TTEST_1(cp + 1))
+				return 0;
+			offset = ((i << 8) | GET_U_1(cp + 1)) & 0x3fff;
+			/* Only backwards, as in fqdn_print(). */
+			if (offset >= max_offset)
+				return 0;
+			max_offset = offset;
+			cp = bp + offset;
+			continue;
+		}
+		if ((i & TYPE_MASK) != TYPE_LABEL)
+			return 0;
+		cp++;
+		if (i == 0)
+			break;
+		if (!ND_TTEST_LEN(cp, i) || n + i + 2 > size)
+			return 0;
+		for (; i != 0; i--) {
+			c = GET_U_1(cp);
+			cp++;
+			buf[n++] = ND_ASCII_ISGRAPH(c) ? ND_ASCII_TOLOWER(c) : '?';
+		}
+		buf[n++] = '.';
+	}
+	if (n == 0)
+		buf[n++] = '.';
+	buf[n] = '\0';
+	return 1;
+}
+
+static void
+dns_topname_record(netdissect_options *ndo, const char *name)
+{
+	struct dns_topname *tn, *least = NULL;
+	uint32_t hash = 2166136261U;	/* FNV-1a */
+	const char *p;
+	u_int i;
+
+	for (p = name; *p != '\0'; p++)
+		hash = (hash ^ (u_char)*p) * 16777619U;
+	for (i = 0; i < dns_topname_count; i++) {
+		tn = &dns_topnames[i];
+		if (tn->hash == hash && strcmp(tn->name, name) == 0) {
+			tn->count++;
+			return;
+		}
+		if (least == NULL || tn->count < least->count)
+			least = tn;
+	}
+	if (dns_topname_count < DNS_TOPNAMES_SIZE) {
+		if (dns_topnames == NULL) {
+			dns_topnames = (struct dns_topname *)calloc(
+			    DNS_TOPNAMES_SIZE, sizeof(*dns_topnames));
+			if (dns_topnames == NULL)
+				(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
+				    "%s: calloc", __func__);
+		}
+		tn = &dns_topnames[dns_topname_count++];
+		tn->count = 1;
+		tn->error = 0;
+	} else {
+		tn = least;
+		tn->error = tn->count;
+		tn->count++;
+	}
+	tn->hash = hash;
+	memcpy(tn->name, name, strlen(name) + 1);
+}
+
+/*
+ * Account for a query or a response.  Returns 1 and sets *usecp to the
+ * response time if this is the first response to a known query.
+ */
+static int
+dns_stats_record(netdissect_options *ndo, const dns_header_t *np,
+		 uint16_t flags, u_int rcode, u_int qdcount,
+		 const u_char *bp2, uint16_t sport, uint16_t dport,
+		 uint64_t *usecp)
+{
+	struct dns_xact key, *xp;
+	char name[sizeof(dns_topnames->name)];
+
+	if (!dns_xact_key(ndo, bp2, sport, dport, DNS_QR(flags), &key))
+		return 0;
+	key.id = GET_BE_U_2(np->id);
+
+	if (!DNS_QR(flags)) {
+		dns_stats.queries++;
+		if (qdcount != 0 && dns_name_copy(ndo,
+		    (const u_char *)(np + 1), (const u_char *)np,
+		    name, sizeof(name)))
+			dns_topname_record(ndo, name);
+		dns_xact_enter(ndo, &key);
+		return 0;
+	}
+
+	dns_stats.responses++;
+	dns_stats.rcodes[rcode < DNS_NRCODES ? rcode : DNS_NRCODES]++;
+	if ((xp = dns_xact_find(ndo, &key)) == NULL)
+		return 0;
+	if (xp->answered) {
+		dns_stats.duplicates++;
+		return 0;
+	}
+	xp->answered = 1;
+	dns_stats.matched++;
+	if (!nd_latency_usec(ndo, &xp->ts, &ndo->ndo_ts, usecp))
+		return 0;
+	nd_hist_record(nd_hist_get(ndo, &dns_latency), *usecp);
+	/* The server is the source of the response. */
+	nd_hist_record(nd_addr_hist_get(ndo, &dns_server_latency, key.ipver,
+	    key.server), *usecp);
+	return 1;
+}
+
+static int
+dns_topname_cmp(const void *a, const void *b)
+{
+	const struct dns_topname *ta = (const struct dns_topname *)a;
+	const struct dns_topname *tb = (const struct dns_topname *)b;
+
+	if (ta->count != tb->count)
+		return ta->count < tb->count ? 1 : -1;
+	return strcmp(ta->name, tb->name);
+}
+
+/*
+ * Print the query and response counts, the response time percentiles,
+ * overall and per server, the response codes and the most queried names.
+ */
+void
+dns_print_stats(netdissect_options *ndo)
+{
+	const char *s;
+	u_int i;
+
+	if (!ndo->ndo_dns_stats)
+		return;
+	ND_PRINT("DNS: %" PRIu64 " queries, %" PRIu64 " responses (%" PRIu64
+	    " matched, %" PRIu64 " duplicate, %" PRIu64 " unmatched), %"
+	    PRIu64 " queries unanswered\n", dns_stats.queries,
+	    dns_stats.responses, dns_stats.matched, dns_stats.duplicates,
+	    dns_stats.responses - dns_stats.matched - dns_stats.duplicates,
+	    dns_stats.queries - dns_stats.matched);
+	if (dns_latency != NULL) {
+		nd_hist_print_header(ndo, "DNS latency (ms)");
+		nd_hist_print_row(ndo, "all", dns_latency);
+		nd_addr_hists_print(ndo, &dns_server_latency, "server");
+	}
+	if (dns_stats.responses != 0) {
+		ND_PRINT("DNS response codes:");
+		for (i = 0; i <= DNS_NRCODES; i++) {
+			if (dns_stats.rcodes[i] == 0)
+				continue;
+			if (i == 0)
+				s = "NoError";
+			else if (i < DNS_NRCODES)
+				s = ns_rcode(i);
+			else
+				s = "other";
+			if (*s == ' ')
+				s++;
+			ND_PRINT(" %s %" PRIu64, s, dns_stats.rcodes[i]);
+		}
+		ND_PRINT("\n");
+	}
+	if (dns_topname_count != 0) {
+		qsort(dns_topnames, dns_topname_count, sizeof(*dns_topnames),
+		    dns_topname_cmp);
+		ND_PRINT("DNS most queried names:\n");
+		for (i = 0; i < dns_topname_count && i < DNS_TOPNAMES_PRINT;
+		     i++) {
+			ND_PRINT("  %-48s %8" PRIu64, dns_topnames[i].name,
+			    dns_topnames[i].count);
+			if (dns_topnames[i].error != 0)
+				ND_PRINT(" (at most %" PRIu64 " too many)",
+				    dns_topnames[i].error);
+			ND_PRINT("\n");
+		}
+	}
+}
+
+/*
+ * Set the fields of a message, for --output-format, with the name and
+ * type of the first question.
+ */
+static void
+dns_fields(netdissect_options *ndo, const dns_header_t *np, uint16_t flags,
+	   u_int rcode, u_int qdcount, u_int ancount)
+{
+	char name[MAXDNAME + 1];
+	const u_char *cp;
+
+	nd_field_uint(ndo, ND_FIELD_DNS_ID, GET_BE_U_2(np->id));
+	nd_field_bool(ndo, ND_FIELD_DNS_RESPONSE, DNS_QR(flags));
+	nd_field_uint(ndo, ND_FIELD_DNS_OPCODE, DNS_OPCODE(flags));
+	nd_field_uint(ndo, ND_FIELD_DNS_RCODE, rcode);
+	nd_field_uint(ndo, ND_FIELD_DNS_ANSWERS, ancount);
+	if (qdcount == 0)
+		return;
+	cp = (const u_char *)(np + 1);
+	if (dns_name_copy(ndo, cp, (const u_char *)np, name, sizeof(name)))
+		nd_field_string(ndo, ND_FIELD_DNS_QNAME, name, strlen(name));
+	cp = ns_nskip(ndo, cp);
+	if (cp != NULL && ND_TTEST_2(cp))
+		nd_field_uint(ndo, ND_FIELD_DNS_QTYPE, GET_BE_U_2(cp));
+}
+
 void
 domain_print(netdissect_options *ndo,
-             const u_char *bp, u_int length, int over_tcp, int is_mdns)
+             const u_char *bp, u_int length, int over_tcp, int is_mdns,
+             uint16_t sport, uint16_t dport, const u_char *bp2)
 {
 	const dns_header_t *np;
 	uint16_t flags, rcode, rdlen, type;
@@ -910,6 +1510,8 @@ domain_print(netdissect_options *ndo,
 	u_int i;
 	const u_char *cp;
 	uint16_t b2;
+	uint64_t usec;
+	int have_latency = 0;
 
 	ndo->ndo_protocol = "domain";
 
@@ -1001,6 +1603,11 @@ domain_print(netdissect_options *ndo,
 	}
 
  print:
+	if (ndo->ndo_dns_stats && !is_mdns)
+		have_latency = dns_stats_record(ndo, np, flags, rcode, qdcount,
+		    bp2, sport, dport, &usec);
+	if (ND_FIELDS_LAYER(ndo, ND_LAYER_APPLICATION))
+		dns_fields(ndo, np, flags, rcode, qdcount, ancount);
 	if (DNS_QR(flags)) {
 		/* this is a response */
 		ND_PRINT("%u%s%s%s%s%s%s",
@@ -1011,6 +1618,11 @@ domain_print(netdissect_options *ndo,
 			DNS_RA(flags)? "" : "-",
 			DNS_TC(flags)? "|" : "",
 			DNS_AD(flags)? "$" : "");
+		if (have_latency && ndo->ndo_vflag) {
+			ND_PRINT(" [latency ");
+			nd_hist_print_usec(ndo, usec);
+			ND_PRINT(" ms]");
+		}
 
 		if (qdcount != 1)
 			ND_PRINT(" [%uq]", qdcount);
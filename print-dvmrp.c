@@ -165,7 +165,7 @@ print_report(netdissect_options *ndo,
 		if (GET_U_1(bp + 2))
 			width = 4;
 
-		ND_PRINT("\n\tMask %s", intoa(htonl(mask)));
+		ND_PRINT("\n\tMask %s", nd_intoa(ndo, htonl(mask)));
 		bp += 3;
 		len -= 3;
 		do {
@@ -185,7 +185,7 @@ print_report(netdissect_options *ndo,
 			bp++;
 			done = metric & 0x80;
 			metric &= 0x7f;
-			ND_PRINT("\n\t  %s metric %u", intoa(htonl(origin)),
+			ND_PRINT("\n\t  %s metric %u", nd_intoa(ndo, htonl(origin)),
 				metric);
 			len -= width + 1;
 		} while (!done);
@@ -77,7 +77,10 @@ erspan_i_ii_print(netdissect_options *ndo, uint16_t flags, const u_char *bp, u_i
 		/*
 		 * ERSPAN Type I; no header, just a raw Ethernet frame.
 		 */
-		ND_PRINT(" type1: ");
+		ND_PRINT(" type1");
+		if (ND_DECODE_STOP_TUNNEL(ndo))
+			return;
+		ND_PRINT(": ");
 		ether_print(ndo, bp, len, ND_BYTES_AVAILABLE_AFTER(bp), NULL, NULL);
 		return;
 	}
@@ -140,6 +143,8 @@ erspan_i_ii_print(netdissect_options *ndo, uint16_t flags, const u_char *bp, u_i
 		         (hdr & ERSPAN2_INDEX_MASK) >> ERSPAN2_INDEX_SHIFT);
 	}
 
+	if (ND_DECODE_STOP_TUNNEL(ndo))
+		return;
 	ND_PRINT(": ");
 	ether_print(ndo, bp, len, ND_BYTES_AVAILABLE_AFTER(bp), NULL, NULL);
 	return;
@@ -274,6 +279,8 @@ erspan_iii_print(netdissect_options *ndo, const u_char *bp, u_int len)
 		len -= 8;
 	}
 
+	if (ND_DECODE_STOP_TUNNEL(ndo))
+		return;
 	ND_PRINT(": ");
 
 	switch (ft) {
@@ -30,6 +30,7 @@
 #include "extract.h"
 #include "addrtoname.h"
 #include "ethertype.h"
+#include "fields.h"
 
 /*
  * Structure of an Ethernet header.
@@ -147,6 +148,7 @@ ether_common_print(netdissect_options *ndo, const u_char *p, u_int length,
 	int printed_length;
 	int llc_hdrlen;
 	struct lladdr_info src, dst;
+	int fields;
 
 	if (length < caplen) {
 		ND_PRINT("[length %u < caplen %u]", length, caplen);
@@ -181,6 +183,12 @@ ether_common_print(netdissect_options *ndo, const u_char *p, u_int length,
 	if (ndo->ndo_eflag)
 		ether_addresses_print(ndo, src.addr, dst.addr);
 
+	fields = ND_FIELDS_LAYER(ndo, ND_LAYER_LINK);
+	if (fields) {
+		nd_field_mac48(ndo, ND_FIELD_ETH_SRC, src.addr);
+		nd_field_mac48(ndo, ND_FIELD_ETH_DST, dst.addr);
+	}
+
 	/*
 	 * Print the switch tag, if we have one, and skip past it.
 	 */
@@ -275,8 +283,11 @@ recurse:
 				printed_length = 1;
 			} else
 				ND_PRINT(", ");
-			ND_PRINT("%s, ", ieee8021q_tci_string(tag));
+			ND_PRINT("%s, ", ieee8021q_tci_string(ndo, tag));
 		}
+		/* The innermost VLAN ID is kept */
+		if (fields)
+			nd_field_uint(ndo, ND_FIELD_VLAN, GET_BE_U_2(p) & 0xfff);
 
 		length_type = GET_BE_U_2(p + 2);
 		p += 4;
@@ -288,6 +299,8 @@ recurse:
 	/*
 	 * We now have the final length/type field.
 	 */
+	if (fields && length_type > MAX_ETHERNET_LENGTH_VAL)
+		nd_field_uint(ndo, ND_FIELD_ETH_TYPE, length_type);
 	if (length_type <= MAX_ETHERNET_LENGTH_VAL) {
 		/*
 		 * It's a length field, containing the length of the
@@ -528,6 +541,22 @@ ethertype_print(netdissect_options *ndo,
 		u_int length, u_int caplen,
 		const struct lladdr_info *src, const struct lladdr_info *dst)
 {
+	if (ND_DECODE_STOP(ndo, ND_DECODE_DEPTH_L2)) {
+		/*
+		 * Print only what the link layer tells; the addresses
+		 * and type have already been printed with -e.
+		 */
+		if (!ndo->ndo_eflag) {
+			if (src != NULL && dst != NULL)
+				ND_PRINT("%s > %s, ",
+					 (src->addr_string)(ndo, src->addr),
+					 (dst->addr_string)(ndo, dst->addr));
+			ether_type_print(ndo, ether_type);
+			ND_PRINT(", length %u", length);
+		}
+		return (1);
+	}
+
 	switch (ether_type) {
 
 	case ETHERTYPE_IP:
@@ -283,6 +283,11 @@ geneve_print(netdissect_options *ndo, const u_char *bp, u_int len)
     bp += opts_len;
     len -= opts_len;
 
+    if (ND_DECODE_STOP_TUNNEL(ndo)) {
+        ND_PRINT(", length %u", len);
+        return;
+    }
+
     if (ndo->ndo_vflag < 1)
         ND_PRINT(": ");
     else
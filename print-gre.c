@@ -131,6 +131,7 @@ gre_print_0(netdissect_options *ndo, const u_char *bp, u_int length)
 {
 	u_int len = length;
 	uint16_t flags, prot;
+	int stop;
 
 	ND_ICHECK_U(len, <, 2);
 	flags = GET_BE_U_2(bp);
@@ -212,11 +213,19 @@ gre_print_0(netdissect_options *ndo, const u_char *bp, u_int length)
 		}
 	}
 
-	if (ndo->ndo_eflag)
+	/*
+	 * When stopping at the tunnel, the payload type is printed as -e
+	 * does; ERSPAN still prints its own header.
+	 */
+	stop = ND_DECODE_STOP_TUNNEL(ndo) &&
+	    prot != GRE_ERSPAN_I_II && prot != GRE_ERSPAN_III;
+	if (ndo->ndo_eflag || stop)
 		ND_PRINT(", proto %s (0x%04x)",
 			 tok2str(ethertype_values,"unknown",prot), prot);
 
 	ND_PRINT(", length %u",length);
+	if (stop)
+		return;
 
 	if (ndo->ndo_vflag < 1)
 		ND_PRINT(": "); /* put in a colon as protocol demarc */
@@ -38,6 +38,7 @@
 #include "udp.h"
 #include "ipproto.h"
 #include "mpls.h"
+#include "fields.h"
 
 /*
  * Interface Control Message Protocol Definitions.
@@ -685,6 +686,10 @@ icmp_print(netdissect_options *ndo, const u_char *bp, u_int plen,
 
 	icmp_type = GET_U_1(dp->icmp_type);
 	icmp_code = GET_U_1(dp->icmp_code);
+	if (ND_FIELDS_LAYER(ndo, ND_LAYER_TRANSPORT)) {
+		nd_field_uint(ndo, ND_FIELD_ICMP_TYPE, icmp_type);
+		nd_field_uint(ndo, ND_FIELD_ICMP_CODE, icmp_code);
+	}
 	switch (icmp_type) {
 
 	case ICMP_ECHO:
@@ -39,6 +39,7 @@
 
 #include "udp.h"
 #include "ah.h"
+#include "fields.h"
 
 /*	NetBSD: icmp6.h,v 1.13 2000/08/03 16:30:37 itojun Exp	*/
 /*	$KAME: icmp6.h,v 1.22 2000/08/03 15:25:16 jinmei Exp $	*/
@@ -1073,6 +1074,12 @@ icmp6_print(netdissect_options *ndo,
 	}
 
 	icmp6_type = GET_U_1(dp->icmp6_type);
+	if (ND_FIELDS_LAYER(ndo, ND_LAYER_TRANSPORT)) {
+		nd_field_uint(ndo, ND_FIELD_ICMP_TYPE, icmp6_type);
+		if (ND_TTEST_1(dp->icmp6_code))
+			nd_field_uint(ndo, ND_FIELD_ICMP_CODE,
+				      GET_U_1(dp->icmp6_code));
+	}
 	ND_PRINT("ICMP6, %s", tok2str(icmp6_type_values,"unknown icmp6 type (%u)",icmp6_type));
 
         /* display cosmetics: print the packet length for printer that use the vflag now */
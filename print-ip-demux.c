@@ -43,6 +43,12 @@ ip_demux_print(netdissect_options *ndo,
 
 	advance = 0;
 
+	if (ND_DECODE_STOP(ndo, ND_DECODE_DEPTH_L3)) {
+		ND_PRINT("%s, length %u",
+			 tok2str(ipproto_values, "ip-proto-%u", nh), length);
+		return;
+	}
+
 again:
 	switch (nh) {
 
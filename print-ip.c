@@ -31,6 +31,7 @@
 
 #include "ip.h"
 #include "ipproto.h"
+#include "fields.h"
 
 
 static const struct tok ip_option_values[] = {
@@ -381,6 +382,17 @@ ip_print(netdissect_options *ndo,
 
 	ip_proto = GET_U_1(ip->ip_p);
 
+	if (ND_FIELDS_LAYER(ndo, ND_LAYER_NETWORK)) {
+		nd_field_uint(ndo, ND_FIELD_IP_VERSION, 4);
+		nd_field_ipv4(ndo, ND_FIELD_IP_SRC, ip->ip_src);
+		nd_field_ipv4(ndo, ND_FIELD_IP_DST, ip->ip_dst);
+		nd_field_uint(ndo, ND_FIELD_IP_PROTO, ip_proto);
+		nd_field_uint(ndo, ND_FIELD_IP_TTL, GET_U_1(ip->ip_ttl));
+		nd_field_uint(ndo, ND_FIELD_IP_TOS, GET_U_1(ip->ip_tos));
+		nd_field_uint(ndo, ND_FIELD_IP_ID, GET_BE_U_2(ip->ip_id));
+		nd_field_uint(ndo, ND_FIELD_IP_LEN, GET_BE_U_2(ip->ip_len));
+	}
+
 	if (ndo->ndo_vflag) {
 		ip_tos = GET_U_1(ip->ip_tos);
 		ND_PRINT("(tos 0x%x", ip_tos);
@@ -470,8 +482,9 @@ ip_print(netdissect_options *ndo,
 	if ((off & IP_OFFMASK) == 0) {
 		uint8_t nh = GET_U_1(ip->ip_p);
 
-		if (nh != IPPROTO_TCP && nh != IPPROTO_UDP &&
-		    nh != IPPROTO_SCTP && nh != IPPROTO_DCCP) {
+		if ((nh != IPPROTO_TCP && nh != IPPROTO_UDP &&
+		     nh != IPPROTO_SCTP && nh != IPPROTO_DCCP) ||
+		    ND_DECODE_STOP(ndo, ND_DECODE_DEPTH_L3)) {
 			ND_PRINT("%s > %s: ",
 			    GET_IPADDR_STRING(ip->ip_src),
 			    GET_IPADDR_STRING(ip->ip_dst));
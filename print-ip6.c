@@ -33,6 +33,7 @@
 
 #include "ip6.h"
 #include "ipproto.h"
+#include "fields.h"
 
 /*
  * If routing headers are presend and valid, set dst to the final destination.
@@ -235,6 +236,7 @@ ip6_print(netdissect_options *ndo, const u_char *bp, u_int length)
 	int found_extension_header;
 	int found_jumbo;
 	int found_hbh;
+	int fields;
 
 	ndo->ndo_protocol = "ip6";
 	ip6 = (const struct ip6_hdr *)bp;
@@ -300,6 +302,20 @@ ip6_print(netdissect_options *ndo, const u_char *bp, u_int length)
 	}
 	ND_TCHECK_SIZE(ip6);
 
+	fields = ND_FIELDS_LAYER(ndo, ND_LAYER_NETWORK);
+	if (fields) {
+		flow = GET_BE_U_4(ip6->ip6_flow);
+		nd_field_uint(ndo, ND_FIELD_IP_VERSION, 6);
+		nd_field_ipv6(ndo, ND_FIELD_IP_SRC, ip6->ip6_src);
+		nd_field_ipv6(ndo, ND_FIELD_IP_DST, ip6->ip6_dst);
+		nd_field_uint(ndo, ND_FIELD_IP_PROTO, nh);
+		nd_field_uint(ndo, ND_FIELD_IP_TTL, GET_U_1(ip6->ip6_hlim));
+		nd_field_uint(ndo, ND_FIELD_IP_TOS, (flow & 0x0ff00000) >> 20);
+		nd_field_uint(ndo, ND_FIELD_IP6_FLOW, flow & 0x000fffff);
+		nd_field_uint(ndo, ND_FIELD_IP_LEN,
+			      payload_len + sizeof(struct ip6_hdr));
+	}
+
 	/*
 	 * Cut off the snapshot length to the end of the IP payload
 	 * or the end of the data in which it's contained, whichever
@@ -325,8 +341,9 @@ ip6_print(netdissect_options *ndo, const u_char *bp, u_int length)
 		total_advance += advance;
 
 		if (cp == (const u_char *)(ip6 + 1) &&
-		    nh != IPPROTO_TCP && nh != IPPROTO_UDP &&
-		    nh != IPPROTO_DCCP && nh != IPPROTO_SCTP) {
+		    ((nh != IPPROTO_TCP && nh != IPPROTO_UDP &&
+		      nh != IPPROTO_DCCP && nh != IPPROTO_SCTP) ||
+		     ND_DECODE_STOP(ndo, ND_DECODE_DEPTH_L3))) {
 			ND_PRINT("%s > %s: ", GET_IP6ADDR_STRING(ip6->ip6_src),
 				 GET_IP6ADDR_STRING(ip6->ip6_dst));
 		}
@@ -420,6 +437,8 @@ ip6_print(netdissect_options *ndo, const u_char *bp, u_int length)
 			 * Not an extension header; hand off to the
 			 * IP protocol demuxer.
 			 */
+			if (fields)
+				nd_field_uint(ndo, ND_FIELD_IP_PROTO, nh);
 			if (found_jumbo) {
 				/*
 				 * We saw a Jumbo Payload option.
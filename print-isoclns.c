@@ -2430,17 +2430,20 @@ isis_print_router_cap_subtlv(netdissect_options *ndo, const uint8_t *tptr, uint8
 }
 
 /*
- * Clear checksum and lifetime prior to signature verification.
+ * The checksum and remaining lifetime of an LSP are taken to be zero
+ * when computing its signature (RFC 5304, RFC 5310).
  */
-static void
-isis_clear_checksum_lifetime(void *header)
+static u_int
+isis_auth_zero(uint8_t pdu_type, const struct isis_lsp_header *header_lsp,
+               struct signature_zero *zero)
 {
-    struct isis_lsp_header *header_lsp = (struct isis_lsp_header *) header;
-
-    header_lsp->checksum[0] = 0;
-    header_lsp->checksum[1] = 0;
-    header_lsp->remaining_lifetime[0] = 0;
-    header_lsp->remaining_lifetime[1] = 0;
+    if (pdu_type != ISIS_PDU_L1_LSP && pdu_type != ISIS_PDU_L2_LSP)
+        return 0;
+    zero[0].ptr = header_lsp->checksum;
+    zero[0].len = sizeof(header_lsp->checksum);
+    zero[1].ptr = header_lsp->remaining_lifetime;
+    zero[1].len = sizeof(header_lsp->remaining_lifetime);
+    return 2;
 }
 
 /*
@@ -2485,6 +2488,8 @@ isis_print(netdissect_options *ndo,
     uint8_t auth_type;
     uint8_t num_system_ids;
     int sigcheck;
+    struct signature_zero zero[2];
+    u_int nzero;
 
     ndo->ndo_protocol = "isis";
     packet_len=length;
@@ -3110,9 +3115,9 @@ isis_print(netdissect_options *ndo,
 		if (tlen != ISIS_SUBTLV_AUTH_MD5_LEN)
                     ND_PRINT(", (invalid subTLV) ");
 
-                sigcheck = signature_verify(ndo, optr, length, tptr,
-                                            isis_clear_checksum_lifetime,
-                                            header_lsp);
+                nzero = isis_auth_zero(pdu_type, header_lsp, zero);
+                sigcheck = signature_verify(ndo, optr, length, tptr, zero,
+                                            nzero);
                 ND_PRINT(" (%s)", tok2str(signature_check_values, "Unknown", sigcheck));
 
 		break;
@@ -3126,6 +3131,11 @@ isis_print(netdissect_options *ndo,
                 for(i=0;i<tlen;i++) {
                     ND_PRINT("%02x", GET_U_1(tptr + i));
                 }
+
+                nzero = isis_auth_zero(pdu_type, header_lsp, zero);
+                sigcheck = signature_verify_sha(ndo, optr, length, tptr, tlen,
+                                                zero, nzero);
+                ND_PRINT(" (%s)", tok2str(signature_check_values, "Unknown", sigcheck));
                 break;
 	    case ISIS_SUBTLV_AUTH_PRIVATE:
 	    default:
@@ -32,6 +32,7 @@
 #include "netdissect.h"
 #include "addrtoname.h"
 #include "extract.h"
+#include "histogram.h"
 
 #include "nfs.h"
 #include "nfsfh.h"
@@ -40,12 +41,12 @@
 #include "ip6.h"
 #include "rpc_auth.h"
 #include "rpc_msg.h"
+#include "rpc_xid.h"
 
 
 static void nfs_printfh(netdissect_options *, const uint32_t *, const u_int);
-static int xid_map_enter(netdissect_options *, const struct sunrpc_msg *, const u_char *);
-static int xid_map_find(netdissect_options *, const struct sunrpc_msg *, const u_char *, uint32_t *, uint32_t *);
 static void interp_reply(netdissect_options *, const struct sunrpc_msg *, uint32_t, uint32_t, int);
+static void nfs_latency_record(netdissect_options *, const struct rpc_xid_call *, const u_char *);
 static const uint32_t *parse_post_op_attr(netdissect_options *, const uint32_t *, int);
 
 /*
@@ -358,7 +359,8 @@ nfsreply_noaddr_print(netdissect_options *ndo,
                       const u_char *bp2)
 {
 	const struct sunrpc_msg *rp;
-	uint32_t proc, vers, reply_stat;
+	struct rpc_xid_call call;
+	uint32_t reply_stat;
 	enum sunrpc_reject_stat rstat;
 	uint32_t rlow;
 	uint32_t rhigh;
@@ -373,8 +375,12 @@ nfsreply_noaddr_print(netdissect_options *ndo,
 
 	case SUNRPC_MSG_ACCEPTED:
 		ND_PRINT("reply ok %u", length);
-		if (xid_map_find(ndo, rp, bp2, &proc, &vers) >= 0)
-			interp_reply(ndo, rp, proc, vers, length);
+		if (rpc_xid_find(ndo, rp, bp2, &call) >= 0 &&
+		    call.prog == NFS_PROG) {
+			if (ndo->ndo_nfs_latency)
+				nfs_latency_record(ndo, &call, bp2);
+			interp_reply(ndo, rp, call.proc, call.vers, length);
+		}
 		break;
 
 	case SUNRPC_MSG_DENIED:
@@ -573,7 +579,7 @@ nfsreq_noaddr_print(netdissect_options *ndo,
 	ND_PRINT("%u", length);
 	rp = (const struct sunrpc_msg *)bp;
 
-	if (!xid_map_enter(ndo, rp, bp2))	/* record proc number for later on */
+	if (!rpc_xid_enter(ndo, rp, bp2, NFS_PROG))	/* record proc number for later on */
 		goto trunc;
 
 	v3 = (GET_BE_U_4(&rp->rm_call.cb_vers) == NFS_VER3);
@@ -920,136 +926,66 @@ nfs_printfh(netdissect_options *ndo,
 }
 
 /*
- * Maintain a small cache of recent client.XID.server/proc pairs, to allow
- * us to match up replies with requests and thus to know how to parse
- * the reply.
+ * Call-to-reply latency of the NFS procedures, overall and per server,
+ * for --nfs-latency.
  */
-
-struct xid_map_entry {
-	uint32_t	xid;		/* transaction ID (net order) */
-	int ipver;			/* IP version (4 or 6) */
-	nd_ipv6	client;			/* client IP address (net order) */
-	nd_ipv6	server;			/* server IP address (net order) */
-	uint32_t	proc;		/* call proc number (host order) */
-	uint32_t	vers;		/* program version (host order) */
-};
+/* Indexed by NFSv3 procedure number; the last one is for the others. */
+static struct nd_histogram *nfs_proc_latency[NFS_NPROCS + 1];
+static struct nd_addr_hists nfs_server_latency;
 
 /*
- * Map entries are kept in an array that we manage as a ring;
- * new entries are always added at the tail of the ring.  Initially,
- * all the entries are zero and hence don't match anything.
+ * Record the latency of a matched reply and, with -v, print it.
  */
-
-#define	XIDMAPSIZE	64
-
-static struct xid_map_entry xid_map[XIDMAPSIZE];
-
-static int xid_map_next = 0;
-static int xid_map_hint = 0;
-
-static int
-xid_map_enter(netdissect_options *ndo,
-              const struct sunrpc_msg *rp, const u_char *bp)
+static void
+nfs_latency_record(netdissect_options *ndo, const struct rpc_xid_call *call,
+		   const u_char *bp2)
 {
-	const struct ip *ip = NULL;
-	const struct ip6_hdr *ip6 = NULL;
-	struct xid_map_entry *xmep;
-
-	if (!ND_TTEST_4(rp->rm_call.cb_proc))
-		return (0);
-	switch (IP_V((const struct ip *)bp)) {
-	case 4:
-		ip = (const struct ip *)bp;
-		break;
-	case 6:
-		ip6 = (const struct ip6_hdr *)bp;
-		break;
-	default:
-		return (1);
-	}
+	const struct ip *ip;
+	const u_char *server;
+	uint32_t proc = call->proc;
+	uint64_t usec;
 
-	xmep = &xid_map[xid_map_next];
-
-	if (++xid_map_next >= XIDMAPSIZE)
-		xid_map_next = 0;
-
-	UNALIGNED_MEMCPY(&xmep->xid, &rp->rm_xid, sizeof(xmep->xid));
-	if (ip) {
-		xmep->ipver = 4;
-		UNALIGNED_MEMCPY(&xmep->client, ip->ip_src,
-				 sizeof(ip->ip_src));
-		UNALIGNED_MEMCPY(&xmep->server, ip->ip_dst,
-				 sizeof(ip->ip_dst));
-	} else if (ip6) {
-		xmep->ipver = 6;
-		UNALIGNED_MEMCPY(&xmep->client, ip6->ip6_src,
-				 sizeof(ip6->ip6_src));
-		UNALIGNED_MEMCPY(&xmep->server, ip6->ip6_dst,
-				 sizeof(ip6->ip6_dst));
+	if (!nd_latency_usec(ndo, &call->ts, &ndo->ndo_ts, &usec))
+		return;
+	if (call->vers != NFS_VER3 && proc < NFS_NPROCS)
+		proc = nfsv3_procid[proc];
+	if (proc >= NFS_NPROCS)
+		proc = NFS_NPROCS;
+	nd_hist_record(nd_hist_get(ndo, &nfs_proc_latency[proc]), usec);
+	/* The server is the source of the reply. */
+	ip = (const struct ip *)bp2;
+	if (IP_V(ip) == 4)
+		server = ip->ip_src;
+	else
+		server = ((const struct ip6_hdr *)bp2)->ip6_src;
+	nd_hist_record(nd_addr_hist_get(ndo, &nfs_server_latency, IP_V(ip),
+	    server), usec);
+	if (ndo->ndo_vflag) {
+		ND_PRINT(" [latency ");
+		nd_hist_print_usec(ndo, usec);
+		ND_PRINT(" ms]");
 	}
-	xmep->proc = GET_BE_U_4(&rp->rm_call.cb_proc);
-	xmep->vers = GET_BE_U_4(&rp->rm_call.cb_vers);
-	return (1);
 }
 
 /*
- * Returns 0 and puts NFSPROC_xxx in proc return and
- * version in vers return, or returns -1 on failure
+ * Print the latency percentiles, per procedure and per server.
  */
-static int
-xid_map_find(netdissect_options *ndo, const struct sunrpc_msg *rp,
-	     const u_char *bp, uint32_t *proc, uint32_t *vers)
+void
+nfs_latency_print_stats(netdissect_options *ndo)
 {
-	int i;
-	struct xid_map_entry *xmep;
-	uint32_t xid;
-	const struct ip *ip = (const struct ip *)bp;
-	const struct ip6_hdr *ip6 = (const struct ip6_hdr *)bp;
-	int cmp;
-
-	UNALIGNED_MEMCPY(&xid, &rp->rm_xid, sizeof(xmep->xid));
-	/* Start searching from where we last left off */
-	i = xid_map_hint;
-	do {
-		xmep = &xid_map[i];
-		cmp = 1;
-		if (xmep->ipver != IP_V(ip) || xmep->xid != xid)
-			goto nextitem;
-		switch (xmep->ipver) {
-		case 4:
-			if (UNALIGNED_MEMCMP(ip->ip_src, &xmep->server,
-					     sizeof(ip->ip_src)) != 0 ||
-			    UNALIGNED_MEMCMP(ip->ip_dst, &xmep->client,
-					     sizeof(ip->ip_dst)) != 0) {
-				cmp = 0;
-			}
-			break;
-		case 6:
-			if (UNALIGNED_MEMCMP(ip6->ip6_src, &xmep->server,
-					     sizeof(ip6->ip6_src)) != 0 ||
-			    UNALIGNED_MEMCMP(ip6->ip6_dst, &xmep->client,
-					     sizeof(ip6->ip6_dst)) != 0) {
-				cmp = 0;
-			}
-			break;
-		default:
-			cmp = 0;
-			break;
-		}
-		if (cmp) {
-			/* match */
-			xid_map_hint = i;
-			*proc = xmep->proc;
-			*vers = xmep->vers;
-			return 0;
-		}
-	nextitem:
-		if (++i >= XIDMAPSIZE)
-			i = 0;
-	} while (i != xid_map_hint);
+	u_int i;
 
-	/* search failed */
-	return (-1);
+	if (!ndo->ndo_nfs_latency)
+		return;
+	nd_hist_print_header(ndo, "NFS latency (ms)");
+	for (i = 0; i <= NFS_NPROCS; i++) {
+		if (nfs_proc_latency[i] == NULL)
+			continue;
+		nd_hist_print_row(ndo, i < NFS_NPROCS ?
+		    tok2str(nfsproc_str, "proc-%u", i) : "other",
+		    nfs_proc_latency[i]);
+	}
+	nd_addr_hists_print(ndo, &nfs_server_latency, "server");
 }
 
 /*
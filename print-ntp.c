@@ -43,6 +43,7 @@
 #include "extract.h"
 
 #include "ntp.h"
+#include "fields.h"
 
 /*
  * Based on ntp.h from the U of MD implementation
@@ -431,6 +432,13 @@ ntp_print(netdissect_options *ndo,
 	ND_PRINT("v%u", version);
 
 	mode = (status & MODEMASK) >> MODESHIFT;
+	if (ND_FIELDS_LAYER(ndo, ND_LAYER_APPLICATION)) {
+		nd_field_uint(ndo, ND_FIELD_NTP_VERSION, version);
+		nd_field_uint(ndo, ND_FIELD_NTP_MODE, mode);
+		if (mode <= MODE_BROADCAST && ND_TTEST_1(bp->td.stratum))
+			nd_field_uint(ndo, ND_FIELD_NTP_STRATUM,
+				      GET_U_1(bp->td.stratum));
+	}
 	if (!ndo->ndo_vflag) {
 		ND_PRINT(", %s, length %u",
 			 tok2str(ntp_mode_values, "Unknown mode", mode),
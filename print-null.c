@@ -62,7 +62,7 @@ null_hdr_print(netdissect_options *ndo, uint32_t family, u_int length)
 			tok2str(bsd_af_values,"Unknown AF %u",family));
 	}
 
-	ND_PRINT(", length %u: ", length);
+	ND_PRINT(", length %u", length);
 }
 
 /*
@@ -95,8 +95,20 @@ null_if_print(netdissect_options *ndo, const struct pcap_pkthdr *h, const u_char
 	if ((family & 0xFFFF0000) != 0)
 		family = SWAPLONG(family);
 
-	if (ndo->ndo_eflag)
+	if (ndo->ndo_eflag) {
 		null_hdr_print(ndo, family, length);
+		ND_PRINT(": ");
+	}
+
+	if (ND_DECODE_STOP(ndo, ND_DECODE_DEPTH_L2)) {
+		/*
+		 * Print only what the link layer tells; the family has
+		 * already been printed with -e.
+		 */
+		if (!ndo->ndo_eflag)
+			null_hdr_print(ndo, family, length - NULL_HDRLEN);
+		return;
+	}
 
 	length -= NULL_HDRLEN;
 	caplen -= NULL_HDRLEN;
@@ -128,8 +140,10 @@ null_if_print(netdissect_options *ndo, const struct pcap_pkthdr *h, const u_char
 
 	default:
 		/* unknown AF_ value */
-		if (!ndo->ndo_eflag)
+		if (!ndo->ndo_eflag) {
 			null_hdr_print(ndo, family, length + NULL_HDRLEN);
+			ND_PRINT(": ");
+		}
 		if (!ndo->ndo_suppress_default_print)
 			ND_DEFAULTPRINT(p, caplen);
 	}
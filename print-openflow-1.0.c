@@ -904,7 +904,7 @@ of10_bsn_actions_print(netdissect_options *ndo,
 			ND_PRINT(", vlan_tag none");
 			break;
 		case ETHERTYPE_8021Q:
-			ND_PRINT(", vlan_tag 802.1Q (%s)", ieee8021q_tci_string(vlan_tag & 0xffff));
+			ND_PRINT(", vlan_tag 802.1Q (%s)", ieee8021q_tci_string(ndo, vlan_tag & 0xffff));
 			break;
 		default:
 			ND_PRINT(", vlan_tag unknown (0x%04x)", vlan_tag >> 16);
@@ -938,7 +938,7 @@ of10_vendor_action_print(netdissect_options *ndo,
 	/* vendor */
 	vendor = GET_BE_U_4(cp);
 	OF_FWD(4);
-	ND_PRINT(", vendor 0x%08x (%s)", vendor, of_vendor_name(vendor));
+	ND_PRINT(", vendor 0x%08x (%s)", vendor, of_vendor_name(ndo, vendor));
 	/* data */
 	decoder =
 		vendor == OUI_BSN         ? of10_bsn_actions_print         :
@@ -962,7 +962,7 @@ of10_vendor_message_print(netdissect_options *ndo,
 	/* vendor */
 	vendor = GET_BE_U_4(cp);
 	OF_FWD(4);
-	ND_PRINT(", vendor 0x%08x (%s)", vendor, of_vendor_name(vendor));
+	ND_PRINT(", vendor 0x%08x (%s)", vendor, of_vendor_name(ndo, vendor));
 	/* data */
 	decoder =
 		vendor == OUI_BSN         ? of10_bsn_message_print         :
@@ -981,7 +981,7 @@ of10_vendor_data_print(netdissect_options *ndo,
 	/* vendor */
 	vendor = GET_BE_U_4(cp);
 	OF_FWD(4);
-	ND_PRINT(", vendor 0x%08x (%s)", vendor, of_vendor_name(vendor));
+	ND_PRINT(", vendor 0x%08x (%s)", vendor, of_vendor_name(ndo, vendor));
 	/* data */
 	of_data_print(ndo, cp, len);
 	return;
@@ -910,7 +910,7 @@ of13_experimenter_message_print(netdissect_options *ndo,
 	experimenter = GET_BE_U_4(cp);
 	OF_FWD(4);
 	ND_PRINT("\n\t experimenter 0x%08x (%s)", experimenter,
-	         of_vendor_name(experimenter));
+	         of_vendor_name(ndo, experimenter));
 	/* exp_type */
 	ND_PRINT(", exp_type 0x%08x", GET_BE_U_4(cp));
 	OF_FWD(4);
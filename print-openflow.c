@@ -69,7 +69,7 @@ const struct tok onf_exp_str[] = {
 };
 
 const char *
-of_vendor_name(const uint32_t vendor)
+of_vendor_name(netdissect_options *ndo, const uint32_t vendor)
 {
 	const struct tok *table = (vendor & 0xff000000) == 0 ? oui_values : onf_exp_str;
 	return tok2str(table, "unknown", vendor);
@@ -29,16 +29,12 @@
 #include "netdissect-alloc.h"
 #include "netdissect.h"
 #include "extract.h"
+#include "lru_cache.h"
 
 #define QUIC_MAX_CID_LENGTH	20
 
 typedef uint8_t quic_cid[QUIC_MAX_CID_LENGTH];
 
-struct quic_cid_array {
-	uint8_t cid[QUIC_MAX_CID_LENGTH];
-	uint8_t length;
-};
-
 enum quic_lh_packet_type {
 	QUIC_LH_TYPE_INITIAL = 0,
 	QUIC_LH_TYPE_0RTT = 1,
@@ -55,51 +51,71 @@ hexprint(netdissect_options *ndo, const uint8_t *cp, size_t len)
 		ND_PRINT("%02x", cp[i]);
 }
 
-#define QUIC_CID_LIST_MAX	512
+/*
+ * The connection IDs seen in long headers are remembered so that short
+ * header packets, which don't give the length of their destination
+ * connection ID, can be matched with them.  There is a cache per length,
+ * each holding up to QUIC_CID_TABLE_SIZE IDs and forgetting the least
+ * recently used one, so a short header is looked up by hash once per
+ * length in use.
+ */
+#define QUIC_CID_TABLE_SIZE	4096
+
+static struct nd_lru_cache *quic_cids[QUIC_MAX_CID_LENGTH + 1];
 
-static struct quic_cid_array quic_cid_array[QUIC_CID_LIST_MAX];
+static struct {
+	uint64_t short_headers;
+	uint64_t identified;
+} quic_stats;
 
-static struct quic_cid_array *
+/*
+ * Return the length of the longest known connection ID that starts the
+ * length bytes at cid, or 0 if there is none.
+ */
+static u_int
 lookup_quic_cid(const u_char *cid, size_t length)
 {
-	for (unsigned int i = 0; i < QUIC_CID_LIST_MAX; i++) {
-		if (quic_cid_array[i].length > length) {
-			continue;
-		}
-		if (quic_cid_array[i].length == 0) {
-			break;
-		}
-		if (memcmp(quic_cid_array[i].cid, cid,
-			   quic_cid_array[i].length) == 0) {
-			/*
-			 * Swap the entries so that it behaves like an
-			 * LRU cache.
-			 */
-			if (i != 0) {
-				struct quic_cid_array tmp = quic_cid_array[i];
-				quic_cid_array[i] = quic_cid_array[0];
-				quic_cid_array[0] = tmp;
-			}
+	u_int cidlen;
 
-			return &quic_cid_array[0];
-		}
+	if (length > QUIC_MAX_CID_LENGTH)
+		length = QUIC_MAX_CID_LENGTH;
+	for (cidlen = (u_int)length; cidlen != 0; cidlen--) {
+		if (quic_cids[cidlen] != NULL &&
+		    nd_lru_cache_find(quic_cids[cidlen], cid) != NULL)
+			return cidlen;
 	}
-
-	return NULL;
+	return 0;
 }
 
 static void
-register_quic_cid(const quic_cid cid, uint8_t length)
+register_quic_cid(netdissect_options *ndo, const quic_cid cid,
+		  uint8_t length)
+{
+	if (length == 0 || length > QUIC_MAX_CID_LENGTH)
+		return;
+	if (quic_cids[length] == NULL)
+		quic_cids[length] = nd_lru_cache_create(ndo,
+		    QUIC_CID_TABLE_SIZE, length, 0);
+	nd_lru_cache_insert(quic_cids[length], cid);
+}
+
+void
+quic_print_stats(netdissect_options *ndo)
 {
-	static uint16_t next_cid = 0;
+	char name[sizeof("QUIC CIDs of length 20")];
+	u_int cidlen;
 
-	if (length == 0 ||
-	    lookup_quic_cid(cid, length) != NULL) {
+	if (quic_stats.short_headers == 0)
 		return;
+	ND_PRINT("QUIC: %" PRIu64 " short header packets, %" PRIu64
+	    " with a known destination connection ID\n",
+	    quic_stats.short_headers, quic_stats.identified);
+	for (cidlen = 1; cidlen <= QUIC_MAX_CID_LENGTH; cidlen++) {
+		if (quic_cids[cidlen] == NULL)
+			continue;
+		snprintf(name, sizeof(name), "QUIC CIDs of length %u", cidlen);
+		nd_lru_cache_print_stats(ndo, quic_cids[cidlen], name);
 	}
-	memcpy(&quic_cid_array[next_cid].cid, cid, QUIC_MAX_CID_LENGTH);
-	quic_cid_array[next_cid].length = length;
-	next_cid = (next_cid + 1) % QUIC_CID_LIST_MAX;
 }
 
 /* Returns 1 if the first octet looks like a QUIC packet. */
@@ -186,7 +202,7 @@ quic_print_packet(netdissect_options *ndo, const u_char *bp, const u_char *end)
 			bp += dcil;
 			ND_PRINT(", dcid ");
 			hexprint(ndo, dcid, dcil);
-			register_quic_cid(dcid, dcil);
+			register_quic_cid(ndo, dcid, dcil);
 		}
 		scil = GET_U_1(bp);
 		bp += 1;
@@ -196,7 +212,7 @@ quic_print_packet(netdissect_options *ndo, const u_char *bp, const u_char *end)
 			bp += scil;
 			ND_PRINT(", scid ");
 			hexprint(ndo, scid, scil);
-			register_quic_cid(scid, scil);
+			register_quic_cid(ndo, scid, scil);
 		}
 		if (version == 0) {
 			/* Version Negotiation packet */
@@ -251,14 +267,15 @@ quic_print_packet(netdissect_options *ndo, const u_char *bp, const u_char *end)
 	} else {
 		/* Short Header */
 		ND_PRINT(", protected");
+		quic_stats.short_headers++;
 		if (end > bp && end - bp > 16 &&
 		    ND_TTEST_LEN(bp, end - bp)) {
-			struct quic_cid_array *cid_array =
-				lookup_quic_cid(bp, end - bp);
-			if (cid_array != NULL) {
+			u_int cidlen = lookup_quic_cid(bp, end - bp);
+
+			if (cidlen != 0) {
+				quic_stats.identified++;
 				ND_PRINT(", dcid ");
-				hexprint(ndo, cid_array->cid,
-					 cid_array->length);
+				hexprint(ndo, bp, cidlen);
 			}
 		} else {
 			nd_print_trunc(ndo);
@@ -30,6 +30,19 @@
 
 #include "ip.h"
 
+/*
+ * There is no link-layer header to print; with --decode-depth l2, say
+ * which network layer follows instead of dissecting it.
+ */
+static int
+raw_decode_stop(netdissect_options *ndo, const char *name, u_int length)
+{
+	if (!ND_DECODE_STOP(ndo, ND_DECODE_DEPTH_L2))
+		return 0;
+	ND_PRINT("%s, length %u", name, length);
+	return 1;
+}
+
 /*
  * The DLT_RAW packet has no header. It contains a raw IPv4 or IPv6 packet.
  */
@@ -48,11 +61,15 @@ raw_if_print(netdissect_options *ndo, const struct pcap_pkthdr *h, const u_char
 	u_char ipver = IP_V((const struct ip *)p);
 	switch (ipver) {
 	case 4:
+		if (raw_decode_stop(ndo, "IP", h->len))
+			break;
 		if (ndo->ndo_eflag)
 			ND_PRINT("IP ");
 		ip_print(ndo, p, h->len);
 		break;
 	case 6:
+		if (raw_decode_stop(ndo, "IP6", h->len))
+			break;
 		if (ndo->ndo_eflag)
 			ND_PRINT("IP6 ");
 		ip6_print(ndo, p, h->len);
@@ -74,6 +91,8 @@ ipv4_if_print(netdissect_options *ndo, const struct pcap_pkthdr *h, const u_char
 	ndo->ndo_protocol = "ip";
 	ndo->ndo_ll_hdr_len += 0;
 
+	if (raw_decode_stop(ndo, "IP", h->len))
+		return;
 	if (ndo->ndo_eflag)
 		ND_PRINT("IP ");
 	ip_print(ndo, p, h->len);
@@ -89,6 +108,8 @@ ipv6_if_print(netdissect_options *ndo, const struct pcap_pkthdr *h, const u_char
 	ndo->ndo_protocol = "ip6";
 	ndo->ndo_ll_hdr_len += 0;
 
+	if (raw_decode_stop(ndo, "IP6", h->len))
+		return;
 	if (ndo->ndo_eflag)
 		ND_PRINT("IP6 ");
 	ip6_print(ndo, p, h->len);
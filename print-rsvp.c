@@ -651,18 +651,6 @@ invalid:
     return 0;
 }
 
-/*
- * Clear checksum prior to signature verification.
- */
-static void
-rsvp_clear_checksum(void *header)
-{
-    struct rsvp_common_header *rsvp_com_header = (struct rsvp_common_header *) header;
-
-    rsvp_com_header->checksum[0] = 0;
-    rsvp_com_header->checksum[1] = 0;
-}
-
 static int
 rsvp_obj_print(netdissect_options *ndo,
                const u_char *pptr, u_int plen, const u_char *tptr,
@@ -680,6 +668,7 @@ rsvp_obj_print(netdissect_options *ndo,
     u_int obj_tlen,intserv_serv_tlen;
     int hexdump;
     u_int processed,padbytes,error_code,error_value,sigcheck;
+    struct signature_zero zero;
     u_int namelen;
 
     u_int action, subchannel;
@@ -1758,10 +1747,12 @@ rsvp_obj_print(netdissect_options *ndo,
                        GET_BE_U_4(obj_ptr.rsvp_obj_integrity->digest + 8),
                        GET_BE_U_4(obj_ptr.rsvp_obj_integrity->digest + 12));
 
+                /* The checksum is taken to be zero. */
+                zero.ptr = rsvp_com_header->checksum;
+                zero.len = sizeof(rsvp_com_header->checksum);
                 sigcheck = signature_verify(ndo, pptr, plen,
                                             obj_ptr.rsvp_obj_integrity->digest,
-                                            rsvp_clear_checksum,
-                                            rsvp_com_header);
+                                            &zero, 1);
                 ND_PRINT(" (%s)", tok2str(signature_check_values, "Unknown", sigcheck));
 
                 obj_tlen+=sizeof(struct rsvp_obj_integrity_t);
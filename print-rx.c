@@ -44,6 +44,7 @@
 #include "netdissect.h"
 #include "addrtoname.h"
 #include "extract.h"
+#include "lru_cache.h"
 
 #include "ip.h"
 
@@ -476,21 +477,21 @@ static const struct tok rx_ack_reasons[] = {
  * numbers for replies.  This allows us to make sense of RX reply packets.
  */
 
-struct rx_cache_entry {
+struct rx_cache_key {
+	uint32_t	epoch;		/* Connection epoch */
+	uint32_t	cid;		/* Connection ID */
 	uint32_t	callnum;	/* Call number (net order) */
 	uint32_t	client;		/* client IP address (net order) */
 	uint32_t	server;		/* server IP address (net order) */
 	uint16_t	dport;		/* server UDP port (host order) */
 	uint16_t	serviceId;	/* Service identifier (net order) */
-	uint32_t	opcode;		/* RX opcode (host order) */
 };
 
-#define RX_CACHE_SIZE	64
+/* Default number of calls remembered. */
+#define RX_CACHE_SIZE	1024
 
-static struct rx_cache_entry	rx_cache[RX_CACHE_SIZE];
+static struct nd_lru_cache	*rx_cache;
 
-static uint32_t	rx_cache_next = 0;
-static uint32_t	rx_cache_hint = 0;
 static void	rx_cache_insert(netdissect_options *, const u_char *, const struct ip *, uint16_t);
 static int	rx_cache_find(netdissect_options *, const struct rx_header *,
 			      const struct ip *, uint16_t, uint32_t *);
@@ -677,34 +678,41 @@ rx_print(netdissect_options *ndo,
 }
 
 /*
- * Insert an entry into the cache.  Taken from print-nfs.c
+ * Insert an entry into the cache.  The cache is keyed on the connection
+ * (call numbers are per connection), the call number, the addresses and
+ * the server port and service, and remembers the opcode.
  */
 
 static void
 rx_cache_insert(netdissect_options *ndo,
                 const u_char *bp, const struct ip *ip, uint16_t dport)
 {
-	struct rx_cache_entry *rxent;
+	struct rx_cache_key key;
 	const struct rx_header *rxh = (const struct rx_header *) bp;
+	uint32_t *opcode;
 
 	if (!ND_TTEST_4(bp + sizeof(struct rx_header)))
 		return;
 
-	rxent = &rx_cache[rx_cache_next];
-
-	if (++rx_cache_next >= RX_CACHE_SIZE)
-		rx_cache_next = 0;
-
-	rxent->callnum = GET_BE_U_4(rxh->callNumber);
-	rxent->client = GET_IPV4_TO_NETWORK_ORDER(ip->ip_src);
-	rxent->server = GET_IPV4_TO_NETWORK_ORDER(ip->ip_dst);
-	rxent->dport = dport;
-	rxent->serviceId = GET_BE_U_2(rxh->serviceId);
-	rxent->opcode = GET_BE_U_4(bp + sizeof(struct rx_header));
+	if (rx_cache == NULL)
+		rx_cache = nd_lru_cache_create(ndo,
+		    ndo->ndo_rx_cache_size != 0 ? ndo->ndo_rx_cache_size :
+		    RX_CACHE_SIZE, sizeof(key), sizeof(*opcode));
+
+	memset(&key, 0, sizeof(key));
+	key.epoch = GET_BE_U_4(rxh->epoch);
+	key.cid = GET_BE_U_4(rxh->cid);
+	key.callnum = GET_BE_U_4(rxh->callNumber);
+	key.client = GET_IPV4_TO_NETWORK_ORDER(ip->ip_src);
+	key.server = GET_IPV4_TO_NETWORK_ORDER(ip->ip_dst);
+	key.dport = dport;
+	key.serviceId = GET_BE_U_2(rxh->serviceId);
+	opcode = (uint32_t *)nd_lru_cache_insert(rx_cache, &key);
+	*opcode = GET_BE_U_4(bp + sizeof(struct rx_header));
 }
 
 /*
- * Lookup an entry in the cache.  Also taken from print-nfs.c
+ * Lookup an entry in the cache.
  *
  * Note that because this is a reply, we're looking at the _source_
  * port.
@@ -714,37 +722,32 @@ static int
 rx_cache_find(netdissect_options *ndo, const struct rx_header *rxh,
 	      const struct ip *ip, uint16_t sport, uint32_t *opcode)
 {
-	uint32_t i;
-	struct rx_cache_entry *rxent;
-	uint32_t clip;
-	uint32_t sip;
-
-	clip = GET_IPV4_TO_NETWORK_ORDER(ip->ip_dst);
-	sip = GET_IPV4_TO_NETWORK_ORDER(ip->ip_src);
-
-	/* Start the search where we last left off */
-
-	i = rx_cache_hint;
-	do {
-		rxent = &rx_cache[i];
-		if (rxent->callnum == GET_BE_U_4(rxh->callNumber) &&
-		    rxent->client == clip &&
-		    rxent->server == sip &&
-		    rxent->serviceId == GET_BE_U_2(rxh->serviceId) &&
-		    rxent->dport == sport) {
+	struct rx_cache_key key;
+	const uint32_t *value;
 
-			/* We got a match! */
+	if (rx_cache == NULL)
+		return(0);
 
-			rx_cache_hint = i;
-			*opcode = rxent->opcode;
-			return(1);
-		}
-		if (++i >= RX_CACHE_SIZE)
-			i = 0;
-	} while (i != rx_cache_hint);
+	memset(&key, 0, sizeof(key));
+	key.epoch = GET_BE_U_4(rxh->epoch);
+	key.cid = GET_BE_U_4(rxh->cid);
+	key.callnum = GET_BE_U_4(rxh->callNumber);
+	key.client = GET_IPV4_TO_NETWORK_ORDER(ip->ip_dst);
+	key.server = GET_IPV4_TO_NETWORK_ORDER(ip->ip_src);
+	key.dport = sport;
+	key.serviceId = GET_BE_U_2(rxh->serviceId);
+	value = (const uint32_t *)nd_lru_cache_find(rx_cache, &key);
+	if (value == NULL)
+		return(0);
+	*opcode = *value;
+	return(1);
+}
 
-	/* Our search failed */
-	return(0);
+void
+rx_print_stats(netdissect_options *ndo)
+{
+	if (rx_cache != NULL)
+		nd_lru_cache_print_stats(ndo, rx_cache, "RX call cache");
 }
 
 /*
@@ -1730,7 +1733,7 @@ vldb_reply_print(netdissect_options *ndo,
 				ND_TCHECK_4(bp);
 				if (i < nservers)
 					ND_PRINT(" %s",
-					   intoa(GET_IPV4_TO_NETWORK_ORDER(bp)));
+					   nd_intoa(ndo, GET_IPV4_TO_NETWORK_ORDER(bp)));
 				bp += sizeof(nd_ipv4);
 			}
 			ND_PRINT(" partitions");
@@ -1776,7 +1779,7 @@ vldb_reply_print(netdissect_options *ndo,
 				ND_TCHECK_4(bp);
 				if (i < nservers)
 					ND_PRINT(" %s",
-					   intoa(GET_IPV4_TO_NETWORK_ORDER(bp)));
+					   nd_intoa(ndo, GET_IPV4_TO_NETWORK_ORDER(bp)));
 				bp += sizeof(nd_ipv4);
 			}
 			ND_PRINT(" partitions");
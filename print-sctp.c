@@ -594,7 +594,10 @@ sctp_print(netdissect_options *ndo,
 	    ND_ICHECKMSG_U("chunk length", chunkLengthRemaining, ==, 0);
 	    payload_size = chunkLengthRemaining;
 
-	    if (isforces) {
+	    if (ND_DECODE_STOP(ndo, ND_DECODE_DEPTH_L4)) {
+		/* Stop at the chunk; don't dissect the user data. */
+		ND_PRINT("[len %u] ", payload_size);
+	    } else if (isforces) {
 		forces_print(ndo, bp, payload_size);
 		/* ndo_protocol reassignment after forces_print() call */
 		ndo->ndo_protocol = "sctp";
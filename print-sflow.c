@@ -25,10 +25,14 @@
 
 #include "netdissect-stdinc.h"
 
+#include <string.h>
+
 #define ND_LONGJMP_FROM_TCHECK
 #include "netdissect.h"
 #include "extract.h"
 #include "addrtoname.h"
+#include "ethertype.h"
+#include "flow_collector.h"
 
 /*
  * sFlow datagram
@@ -104,6 +108,13 @@ struct sflow_flow_sample_t {
 
 };
 
+/*
+ * The input and output interfaces of a flow sample have the format in
+ * their 2 upper bits, and the ifIndex, or what the format says, in the
+ * others.  Those of an expanded flow sample have it in a separate word.
+ */
+#define SFLOW_INTERFACE_VALUE_MASK	0x3fffffff
+
 struct sflow_expanded_flow_sample_t {
     nd_uint32_t seqnum;
     nd_uint32_t type;
@@ -180,6 +191,28 @@ struct sflow_ethernet_frame_t {
     nd_uint32_t type;
 };
 
+struct sflow_ipv4_data_t {
+    nd_uint32_t length;
+    nd_uint32_t protocol;
+    nd_ipv4     src_ip;
+    nd_ipv4     dst_ip;
+    nd_uint32_t src_port;
+    nd_uint32_t dst_port;
+    nd_uint32_t tcp_flags;
+    nd_uint32_t tos;
+};
+
+struct sflow_ipv6_data_t {
+    nd_uint32_t length;
+    nd_uint32_t protocol;
+    nd_ipv6     src_ip;
+    nd_ipv6     dst_ip;
+    nd_uint32_t src_port;
+    nd_uint32_t dst_port;
+    nd_uint32_t tcp_flags;
+    nd_uint32_t priority;
+};
+
 struct sflow_extended_switch_data_t {
     nd_uint32_t src_vlan;
     nd_uint32_t src_pri;
@@ -813,6 +846,301 @@ sflow_print_expanded_flow_sample(netdissect_options *ndo,
 				    nrecords);
 }
 
+/*
+ * Set the 5-tuple of key, unless it's already set, and *lenp to the
+ * length of the sampled packet from the flow record of type flow_type
+ * and len bytes at tptr.  Returns 0 if the record has neither.
+ */
+static int
+sflow_collect_flow_record(netdissect_options *ndo, u_int flow_type,
+                          const u_char *tptr, u_int len,
+                          struct nd_flow_key *key, u_int *lenp)
+{
+    const struct sflow_expanded_flow_raw_t *sflow_flow_raw;
+    const struct sflow_ipv4_data_t *sflow_ipv4_data;
+    const struct sflow_ipv6_data_t *sflow_ipv6_data;
+    const u_char *hdr;
+    u_int hdrlen, ethertype;
+
+    switch (flow_type) {
+    case SFLOW_FLOW_RAW_PACKET:
+	if (len < sizeof(struct sflow_expanded_flow_raw_t))
+	    return 0;
+	sflow_flow_raw = (const struct sflow_expanded_flow_raw_t *)tptr;
+	*lenp = GET_BE_U_4(sflow_flow_raw->length);
+	if (key->ipver != 0)
+	    return 1;
+	hdr = tptr + sizeof(struct sflow_expanded_flow_raw_t);
+	hdrlen = ND_MIN(GET_BE_U_4(sflow_flow_raw->header_size),
+			len - sizeof(struct sflow_expanded_flow_raw_t));
+	switch (GET_BE_U_4(sflow_flow_raw->protocol)) {
+	case SFLOW_HEADER_PROTOCOL_ETHERNET:
+	    if (hdrlen < 14)
+		return 1;
+	    ethertype = GET_BE_U_2(hdr + 12);
+	    hdr += 14;
+	    hdrlen -= 14;
+	    while ((ethertype == ETHERTYPE_8021Q ||
+		    ethertype == ETHERTYPE_8021QinQ ||
+		    ethertype == ETHERTYPE_8021Q9100) && hdrlen >= 4) {
+		ethertype = GET_BE_U_2(hdr + 2);
+		hdr += 4;
+		hdrlen -= 4;
+	    }
+	    if (ethertype == ETHERTYPE_IP || ethertype == ETHERTYPE_IPV6)
+		nd_flow_key_set_ip(ndo, key, hdr, hdrlen);
+	    break;
+	case SFLOW_HEADER_PROTOCOL_IPV4:
+	case SFLOW_HEADER_PROTOCOL_IPV6:
+	    nd_flow_key_set_ip(ndo, key, hdr, hdrlen);
+	    break;
+	}
+	return 1;
+
+    case SFLOW_FLOW_IPV4_DATA:
+	if (len < sizeof(struct sflow_ipv4_data_t))
+	    return 0;
+	sflow_ipv4_data = (const struct sflow_ipv4_data_t *)tptr;
+	*lenp = GET_BE_U_4(sflow_ipv4_data->length);
+	if (key->ipver != 0)
+	    return 1;
+	key->ipver = 4;
+	key->proto = (uint8_t)GET_BE_U_4(sflow_ipv4_data->protocol);
+	GET_CPY_BYTES(key->src, sflow_ipv4_data->src_ip, sizeof(nd_ipv4));
+	GET_CPY_BYTES(key->dst, sflow_ipv4_data->dst_ip, sizeof(nd_ipv4));
+	key->sport = (uint16_t)GET_BE_U_4(sflow_ipv4_data->src_port);
+	key->dport = (uint16_t)GET_BE_U_4(sflow_ipv4_data->dst_port);
+	return 1;
+
+    case SFLOW_FLOW_IPV6_DATA:
+	if (len < sizeof(struct sflow_ipv6_data_t))
+	    return 0;
+	sflow_ipv6_data = (const struct sflow_ipv6_data_t *)tptr;
+	*lenp = GET_BE_U_4(sflow_ipv6_data->length);
+	if (key->ipver != 0)
+	    return 1;
+	key->ipver = 6;
+	key->proto = (uint8_t)GET_BE_U_4(sflow_ipv6_data->protocol);
+	GET_CPY_BYTES(key->src, sflow_ipv6_data->src_ip, sizeof(nd_ipv6));
+	GET_CPY_BYTES(key->dst, sflow_ipv6_data->dst_ip, sizeof(nd_ipv6));
+	key->sport = (uint16_t)GET_BE_U_4(sflow_ipv6_data->src_port);
+	key->dport = (uint16_t)GET_BE_U_4(sflow_ipv6_data->dst_port);
+	return 1;
+    }
+    return 0;
+}
+
+/*
+ * Collect a (compact or expanded) flow sample: it stands for rate
+ * packets of the flow of the sampled one, from the agent of agent_key.
+ */
+static int
+sflow_collect_flow_sample(netdissect_options *ndo,
+                          const u_char *pointer, u_int len, int expanded,
+                          const struct nd_flow_key *agent_key)
+{
+    const struct sflow_flow_sample_t *sflow_flow_sample;
+    const struct sflow_expanded_flow_sample_t *sflow_expanded_flow_sample;
+    const struct sflow_flow_record_t *sflow_flow_record;
+    struct nd_flow_key key = *agent_key;
+    const u_char *tptr;
+    u_int tlen, nrecords, rate, format, flow_len, frame_len;
+    uint64_t octets = 0;
+
+    if (expanded) {
+	if (len < sizeof(struct sflow_expanded_flow_sample_t))
+	    return 0;
+	sflow_expanded_flow_sample = (const struct sflow_expanded_flow_sample_t *)pointer;
+	rate = GET_BE_U_4(sflow_expanded_flow_sample->rate);
+	key.input = GET_BE_U_4(sflow_expanded_flow_sample->in_interface_value);
+	key.output = GET_BE_U_4(sflow_expanded_flow_sample->out_interface_value);
+	nrecords = GET_BE_U_4(sflow_expanded_flow_sample->records);
+	tptr = pointer + sizeof(struct sflow_expanded_flow_sample_t);
+	tlen = len - sizeof(struct sflow_expanded_flow_sample_t);
+    } else {
+	if (len < sizeof(struct sflow_flow_sample_t))
+	    return 0;
+	sflow_flow_sample = (const struct sflow_flow_sample_t *)pointer;
+	rate = GET_BE_U_4(sflow_flow_sample->rate);
+	key.input = GET_BE_U_4(sflow_flow_sample->in_interface) &
+	    SFLOW_INTERFACE_VALUE_MASK;
+	key.output = GET_BE_U_4(sflow_flow_sample->out_interface) &
+	    SFLOW_INTERFACE_VALUE_MASK;
+	nrecords = GET_BE_U_4(sflow_flow_sample->records);
+	tptr = pointer + sizeof(struct sflow_flow_sample_t);
+	tlen = len - sizeof(struct sflow_flow_sample_t);
+    }
+
+    while (nrecords != 0) {
+	if (tlen < sizeof(struct sflow_flow_record_t))
+	    return 0;
+	sflow_flow_record = (const struct sflow_flow_record_t *)tptr;
+	format = GET_BE_U_4(sflow_flow_record->format);
+	flow_len = GET_BE_U_4(sflow_flow_record->length);
+	tptr += sizeof(struct sflow_flow_record_t);
+	tlen -= sizeof(struct sflow_flow_record_t);
+	if (tlen < flow_len)
+	    return 0;
+	/* Only the standard records, of enterprise 0, are known. */
+	if ((format >> 12) == 0 &&
+	    sflow_collect_flow_record(ndo, format & 0x0FFF, tptr, flow_len,
+				      &key, &frame_len) &&
+	    octets == 0)
+	    octets = frame_len;
+	tptr += flow_len;
+	tlen -= flow_len;
+	nrecords--;
+    }
+
+    if (rate == 0)
+	rate = 1;
+    nd_flow_collect(ndo, &key, rate, rate * octets);
+    return 1;
+}
+
+/*
+ * Collect the generic interface counters of a (compact or expanded)
+ * counter sample.
+ */
+static int
+sflow_collect_counter_sample(netdissect_options *ndo,
+                             const u_char *pointer, u_int len, int expanded,
+                             int agent_ipver, const u_char *agent)
+{
+    const struct sflow_counter_record_t *sflow_counter_record;
+    const struct sflow_generic_counter_t *sflow_gen_counter;
+    struct nd_flow_ifcounters counters;
+    const u_char *tptr;
+    u_int tlen, nrecords, format, counter_len, hdrlen;
+
+    hdrlen = expanded ? sizeof(struct sflow_expanded_counter_sample_t) :
+			sizeof(struct sflow_counter_sample_t);
+    if (len < hdrlen)
+	return 0;
+    nrecords = expanded ?
+	GET_BE_U_4(((const struct sflow_expanded_counter_sample_t *)pointer)->records) :
+	GET_BE_U_4(((const struct sflow_counter_sample_t *)pointer)->records);
+    tptr = pointer + hdrlen;
+    tlen = len - hdrlen;
+
+    while (nrecords != 0) {
+	if (tlen < sizeof(struct sflow_counter_record_t))
+	    return 0;
+	sflow_counter_record = (const struct sflow_counter_record_t *)tptr;
+	format = GET_BE_U_4(sflow_counter_record->format);
+	counter_len = GET_BE_U_4(sflow_counter_record->length);
+	tptr += sizeof(struct sflow_counter_record_t);
+	tlen -= sizeof(struct sflow_counter_record_t);
+	if (tlen < counter_len)
+	    return 0;
+	if (format == SFLOW_COUNTER_GENERIC &&
+	    counter_len >= sizeof(struct sflow_generic_counter_t)) {
+	    sflow_gen_counter = (const struct sflow_generic_counter_t *)tptr;
+	    counters.in_octets = GET_BE_U_8(sflow_gen_counter->ifinoctets);
+	    counters.in_packets =
+		(uint64_t)GET_BE_U_4(sflow_gen_counter->ifinunicastpkts) +
+		GET_BE_U_4(sflow_gen_counter->ifinmulticastpkts) +
+		GET_BE_U_4(sflow_gen_counter->ifinbroadcastpkts);
+	    counters.in_discards = GET_BE_U_4(sflow_gen_counter->ifindiscards);
+	    counters.in_errors = GET_BE_U_4(sflow_gen_counter->ifinerrors);
+	    counters.out_octets = GET_BE_U_8(sflow_gen_counter->ifoutoctets);
+	    counters.out_packets =
+		(uint64_t)GET_BE_U_4(sflow_gen_counter->ifoutunicastpkts) +
+		GET_BE_U_4(sflow_gen_counter->ifoutmulticastpkts) +
+		GET_BE_U_4(sflow_gen_counter->ifoutbroadcastpkts);
+	    counters.out_discards = GET_BE_U_4(sflow_gen_counter->ifoutdiscards);
+	    counters.out_errors = GET_BE_U_4(sflow_gen_counter->ifouterrors);
+	    nd_flow_collect_ifcounters(ndo, agent_ipver, agent,
+				       GET_BE_U_4(sflow_gen_counter->ifindex),
+				       &counters);
+	}
+	tptr += counter_len;
+	tlen -= counter_len;
+	nrecords--;
+    }
+    return 1;
+}
+
+/*
+ * Add the flow and counter samples of an sFlow datagram of len bytes to
+ * the --flow-collector tables.  Returns 0 if the datagram isn't valid.
+ */
+int
+sflow_collect(netdissect_options *ndo,
+              const u_char *pptr, u_int len)
+{
+    const struct sflow_datagram_t *sflow_datagram;
+    const struct sflow_v6_datagram_t *sflow_v6_datagram;
+    const struct sflow_sample_header *sflow_sample;
+    struct nd_flow_key key;
+    const u_char *tptr;
+    u_int tlen, nsamples, sample_type, sample_len;
+    int ok;
+
+    ndo->ndo_protocol = "sflow";
+    sflow_datagram = (const struct sflow_datagram_t *)pptr;
+    sflow_v6_datagram = (const struct sflow_v6_datagram_t *)pptr;
+    if (GET_BE_U_4(sflow_datagram->version) != 5)
+	return 0;
+
+    memset(&key, 0, sizeof(key));
+    key.exporter = ND_FLOW_SFLOW;
+    switch (GET_BE_U_4(sflow_datagram->ip_version)) {
+    case 1:
+	if (len < sizeof(struct sflow_datagram_t))
+	    return 0;
+	nsamples = GET_BE_U_4(sflow_datagram->samples);
+	nd_flow_key_set_agent(&key, 4, sflow_datagram->agent);
+	tptr = pptr + sizeof(struct sflow_datagram_t);
+	tlen = len - sizeof(struct sflow_datagram_t);
+	break;
+    case 2:
+	if (len < sizeof(struct sflow_v6_datagram_t))
+	    return 0;
+	nsamples = GET_BE_U_4(sflow_v6_datagram->samples);
+	nd_flow_key_set_agent(&key, 6, sflow_v6_datagram->agent);
+	tptr = pptr + sizeof(struct sflow_v6_datagram_t);
+	tlen = len - sizeof(struct sflow_v6_datagram_t);
+	break;
+    default:
+	return 0;
+    }
+
+    while (nsamples != 0) {
+	if (tlen < sizeof(struct sflow_sample_header))
+	    return 0;
+	sflow_sample = (const struct sflow_sample_header *)tptr;
+	sample_type = GET_BE_U_4(sflow_sample->format);
+	sample_len = GET_BE_U_4(sflow_sample->len);
+	tptr += sizeof(struct sflow_sample_header);
+	tlen -= sizeof(struct sflow_sample_header);
+	if (tlen < sample_len)
+	    return 0;
+	ND_TCHECK_LEN(tptr, sample_len);
+
+	ok = 1;
+	switch (sample_type) {
+	case SFLOW_FLOW_SAMPLE:
+	case SFLOW_EXPANDED_FLOW_SAMPLE:
+	    ok = sflow_collect_flow_sample(ndo, tptr, sample_len,
+		sample_type == SFLOW_EXPANDED_FLOW_SAMPLE, &key);
+	    break;
+	case SFLOW_COUNTER_SAMPLE:
+	case SFLOW_EXPANDED_COUNTER_SAMPLE:
+	    ok = sflow_collect_counter_sample(ndo, tptr, sample_len,
+		sample_type == SFLOW_EXPANDED_COUNTER_SAMPLE,
+		key.agent_ipver, key.agent);
+	    break;
+	}
+	if (!ok)
+	    return 0;
+	tptr += sample_len;
+	tlen -= sample_len;
+	nsamples--;
+    }
+    return 1;
+}
+
 void
 sflow_print(netdissect_options *ndo,
             const u_char *pptr, u_int len)
@@ -303,7 +303,7 @@ recurse:
 	        if (ndo->ndo_eflag) {
 			uint16_t tag = GET_BE_U_2(p);
 
-			ND_PRINT("%s, ", ieee8021q_tci_string(tag));
+			ND_PRINT("%s, ", ieee8021q_tci_string(ndo, tag));
 		}
 
 		ether_type = GET_BE_U_2(p + 2);
@@ -512,7 +512,7 @@ recurse:
 	        if (ndo->ndo_eflag) {
 			uint16_t tag = GET_BE_U_2(p);
 
-			ND_PRINT("%s, ", ieee8021q_tci_string(tag));
+			ND_PRINT("%s, ", ieee8021q_tci_string(ndo, tag));
 		}
 
 		ether_type = GET_BE_U_2(p + 2);
@@ -75,6 +75,7 @@
 #define ND_LONGJMP_FROM_TCHECK
 #include "netdissect.h"
 #include "extract.h"
+#include "lru_cache.h"
 
 #undef OPAQUE  /* defined in <wingdi.h> */
 
@@ -923,6 +924,90 @@ smi_decode_oid(netdissect_options *ndo,
 	return 0;
 }
 
+/*
+ * libsmi walks its MIB tree for every OID looked up, and polling traffic
+ * asks for the same OIDs over and over, so what is found for an OID is
+ * cached, keyed on its BER encoding, with the least recently used OID
+ * forgotten when the cache is full.
+ */
+#define SMI_OID_CACHE_SIZE	4096
+#define SMI_OID_CACHE_MAXLEN	64	/* longer encodings aren't cached */
+
+struct smi_oid_key {
+	u_char len;
+	u_char bytes[SMI_OID_CACHE_MAXLEN];
+};
+
+struct smi_oid_node {
+	SmiNode *node;		/* NULL if the OID isn't in the loaded MIBs */
+	SmiType *type;		/* type of node, or NULL */
+	const char *module;	/* name of the module defining node */
+};
+
+static struct nd_lru_cache *smi_oid_cache;
+
+/*
+ * Find the node for the OID encoded in elem, decoded in oid.
+ */
+static void
+smi_lookup_oid(netdissect_options *ndo, struct be *elem,
+	       unsigned int *oid, unsigned int oidlen,
+	       struct smi_oid_node *on)
+{
+	struct smi_oid_key key;
+	struct smi_oid_node *cached = NULL;
+	SmiModule *smiModule;
+
+	memset(&key, 0, sizeof(key));
+	if (elem->asnlen <= SMI_OID_CACHE_MAXLEN) {
+		if (smi_oid_cache == NULL)
+			smi_oid_cache = nd_lru_cache_create(ndo,
+			    SMI_OID_CACHE_SIZE, sizeof(key), sizeof(*on));
+		key.len = (u_char)elem->asnlen;
+		GET_CPY_BYTES(key.bytes, elem->data.raw, elem->asnlen);
+		cached = (struct smi_oid_node *)nd_lru_cache_find(
+		    smi_oid_cache, &key);
+		if (cached != NULL) {
+			*on = *cached;
+			return;
+		}
+	}
+
+	on->node = smiGetNodeByOID(oidlen, oid);
+	on->type = NULL;
+	on->module = NULL;
+	if (on->node != NULL) {
+		on->type = smiGetNodeType(on->node);
+		smiModule = smiGetNodeModule(on->node);
+		if (smiModule != NULL)
+			on->module = smiModule->name;
+	}
+	if (elem->asnlen <= SMI_OID_CACHE_MAXLEN) {
+		cached = (struct smi_oid_node *)nd_lru_cache_insert(
+		    smi_oid_cache, &key);
+		*cached = *on;
+	}
+}
+
+/*
+ * Print the name of the node found for oid, followed by the
+ * subidentifiers below it.
+ */
+static void
+smi_print_oid_name(netdissect_options *ndo, const struct smi_oid_node *on,
+		   const unsigned int *oid, unsigned int oidlen)
+{
+	unsigned int i;
+
+	if (ndo->ndo_vflag && on->module != NULL) {
+		ND_PRINT("%s::", on->module);
+	}
+	ND_PRINT("%s", on->node->name);
+	for (i = on->node->oidlen; i < oidlen; i++) {
+		ND_PRINT(".%u", oid[i]);
+	}
+}
+
 static int smi_check_type(SmiBasetype basetype, int be)
 {
     int i;
@@ -1013,46 +1098,37 @@ static int smi_check_range(SmiType *smiType, struct be *elem)
 	return ok;
 }
 
-static SmiNode *
+static int
 smi_print_variable(netdissect_options *ndo,
-                   struct be *elem, int *status)
+                   struct be *elem, struct smi_oid_node *on)
 {
 	unsigned int oid[128], oidlen;
-	SmiNode *smiNode = NULL;
-	unsigned int i;
+	int status;
 
+	on->node = NULL;
 	if (!nd_smi_module_loaded) {
-		*status = asn1_print(ndo, elem);
-		return NULL;
+		return asn1_print(ndo, elem);
 	}
-	*status = smi_decode_oid(ndo, elem, oid, sizeof(oid) / sizeof(unsigned int),
+	status = smi_decode_oid(ndo, elem, oid, sizeof(oid) / sizeof(unsigned int),
 	    &oidlen);
-	if (*status < 0)
-		return NULL;
-	smiNode = smiGetNodeByOID(oidlen, oid);
-	if (! smiNode) {
-		*status = asn1_print(ndo, elem);
-		return NULL;
-	}
-	if (ndo->ndo_vflag) {
-		ND_PRINT("%s::", smiGetNodeModule(smiNode)->name);
-	}
-	ND_PRINT("%s", smiNode->name);
-	if (smiNode->oidlen < oidlen) {
-		for (i = smiNode->oidlen; i < oidlen; i++) {
-			ND_PRINT(".%u", oid[i]);
-		}
+	if (status < 0)
+		return status;
+	smi_lookup_oid(ndo, elem, oid, oidlen, on);
+	if (! on->node) {
+		return asn1_print(ndo, elem);
 	}
-	*status = 0;
-	return smiNode;
+	smi_print_oid_name(ndo, on, oid, oidlen);
+	return 0;
 }
 
 static int
 smi_print_value(netdissect_options *ndo,
-                SmiNode *smiNode, u_short pduid, struct be *elem)
+                const struct smi_oid_node *var, u_short pduid, struct be *elem)
 {
-	unsigned int i, oid[128], oidlen;
+	unsigned int oid[128], oidlen;
+	SmiNode *smiNode = var->node;
 	SmiType *smiType;
+	struct smi_oid_node on;
 	SmiNamedNumber *nn;
 	int done = 0;
 
@@ -1084,7 +1160,7 @@ smi_print_value(netdissect_options *ndo,
 	    ND_PRINT("[noAccess]");
 	}
 
-	smiType = smiGetNodeType(smiNode);
+	smiType = var->type;
 	if (! smiType) {
 	    return asn1_print(ndo, elem);
 	}
@@ -1114,18 +1190,10 @@ smi_print_value(netdissect_options *ndo,
 			    smi_decode_oid(ndo, elem, oid,
 					   sizeof(oid)/sizeof(unsigned int),
 					   &oidlen) == 0) {
-				smiNode = smiGetNodeByOID(oidlen, oid);
-				if (smiNode) {
-				        if (ndo->ndo_vflag) {
-						ND_PRINT("%s::", smiGetNodeModule(smiNode)->name);
-					}
-					ND_PRINT("%s", smiNode->name);
-					if (smiNode->oidlen < oidlen) {
-					        for (i = smiNode->oidlen;
-						     i < oidlen; i++) {
-						        ND_PRINT(".%u", oid[i]);
-						}
-					}
+				smi_lookup_oid(ndo, elem, oid, oidlen, &on);
+				if (on.node) {
+					smi_print_oid_name(ndo, &on, oid,
+							   oidlen);
 					done++;
 				}
 			}
@@ -1199,7 +1267,7 @@ varbind_print(netdissect_options *ndo,
 	struct be elem;
 	int count = 0;
 #ifdef USE_LIBSMI
-	SmiNode *smiNode = NULL;
+	struct smi_oid_node smiOid;
 #endif
 	int status;
 
@@ -1246,7 +1314,7 @@ varbind_print(netdissect_options *ndo,
 			return;
 		}
 #ifdef USE_LIBSMI
-		smiNode = smi_print_variable(ndo, &elem, &status);
+		status = smi_print_variable(ndo, &elem, &smiOid);
 #else
 		status = asn1_print(ndo, &elem);
 #endif
@@ -1272,7 +1340,7 @@ varbind_print(netdissect_options *ndo,
 		} else {
 		        if (elem.type != BE_NULL) {
 #ifdef USE_LIBSMI
-				status = smi_print_value(ndo, smiNode, pduid, &elem);
+				status = smi_print_value(ndo, &smiOid, pduid, &elem);
 #else
 				status = asn1_print(ndo, &elem);
 #endif
@@ -1905,3 +1973,12 @@ snmp_print(netdissect_options *ndo,
 		ND_PRINT("} ");
 	}
 }
+
+void
+snmp_print_stats(netdissect_options *ndo _U_)
+{
+#ifdef USE_LIBSMI
+	if (smi_oid_cache != NULL)
+		nd_lru_cache_print_stats(ndo, smi_oid_cache, "SNMP OID cache");
+#endif
+}
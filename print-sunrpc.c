@@ -59,6 +59,7 @@
 
 #include "rpc_auth.h"
 #include "rpc_msg.h"
+#include "rpc_xid.h"
 
 /*
  * Copyright (c) 2009, Sun Microsystems, Inc.
@@ -198,6 +199,9 @@ sunrpc_print(netdissect_options *ndo, const u_char *bp,
 	if (x != SUNRPC_MSG_VERSION)
 		ND_PRINT(" [rpcver %u]", x);
 
+	/* Remember the call, so its reply can be matched. */
+	(void)rpc_xid_enter(ndo, rp, bp2, GET_BE_U_4(rp->rm_call.cb_prog));
+
 	switch (GET_BE_U_4(rp->rm_call.cb_proc)) {
 
 	case SUNRPC_PMAPPROC_SET:
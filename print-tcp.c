@@ -51,6 +51,7 @@ __RCSID("$NetBSD: print-tcp.c,v 1.8 2007/07/24 11:53:48 drochner Exp $");
 #include "ipproto.h"
 #include "rpc_auth.h"
 #include "rpc_msg.h"
+#include "fields.h"
 
 #ifdef HAVE_LIBCRYPTO
 #include <openssl/md5.h>
@@ -259,6 +260,18 @@ tcp_print(netdissect_options *ndo,
         win = GET_BE_U_2(tp->th_win);
         urp = GET_BE_U_2(tp->th_urp);
 
+        if (ND_FIELDS_LAYER(ndo, ND_LAYER_TRANSPORT)) {
+                nd_field_uint(ndo, ND_FIELD_SPORT, sport);
+                nd_field_uint(ndo, ND_FIELD_DPORT, dport);
+                nd_field_uint(ndo, ND_FIELD_TCP_FLAGS, tcp_get_flags(tp));
+                nd_field_uint(ndo, ND_FIELD_TCP_SEQ, seq);
+                nd_field_uint(ndo, ND_FIELD_TCP_ACK, ack);
+                nd_field_uint(ndo, ND_FIELD_TCP_WIN, win);
+                if (hlen <= length)
+                        nd_field_uint(ndo, ND_FIELD_PAYLOAD_LEN,
+                                      length - hlen);
+        }
+
         if (ndo->ndo_qflag) {
                 ND_PRINT("tcp %u", length - hlen);
                 if (hlen > length) {
@@ -746,7 +759,7 @@ tcp_print(netdissect_options *ndo,
          */
         ND_PRINT(", length %u", length);
 
-        if (length == 0)
+        if (length == 0 || ND_DECODE_STOP(ndo, ND_DECODE_DEPTH_L4))
                 return;
 
         /*
@@ -781,7 +794,7 @@ tcp_print(netdissect_options *ndo,
                         break;
                 case PT_DOMAIN:
                         /* over_tcp: TRUE, is_mdns: FALSE */
-                        domain_print(ndo, bp, length, TRUE, FALSE);
+                        domain_print(ndo, bp, length, TRUE, FALSE, sport, dport, bp2);
                         break;
                 }
                 return;
@@ -802,7 +815,7 @@ tcp_print(netdissect_options *ndo,
                 whois_print(ndo, bp, length);
         } else if (IS_SRC_OR_DST_PORT(NAMESERVER_PORT)) {
                 /* over_tcp: TRUE, is_mdns: FALSE */
-                domain_print(ndo, bp, length, TRUE, FALSE);
+                domain_print(ndo, bp, length, TRUE, FALSE, sport, dport, bp2);
         } else if (IS_SRC_OR_DST_PORT(HTTP_PORT)) {
                 ND_PRINT(": ");
                 http_print(ndo, bp, length);
@@ -964,64 +977,69 @@ tcp_verify_signature(netdissect_options *ndo,
                      const struct ip *ip, const struct tcphdr *tp,
                      const u_char *data, u_int length, const u_char *rcvsig)
 {
-        struct tcphdr tp1;
+        /*
+         * The IPv6 pseudo-header is the longest one; the TCP header,
+         * without options, follows it.
+         */
+        u_char hdrs[2 * sizeof(nd_ipv6) + 8 + sizeof(struct tcphdr)];
+        u_char *hp = hdrs;
         u_char sig[TCP_SIGLEN];
-        char zero_proto = 0;
         MD5_CTX ctx;
-        uint16_t savecsum, tlen;
+        u_int tlen;
         const struct ip6_hdr *ip6;
-        uint32_t len32;
-        uint8_t nxt;
 
         if (!ND_TTEST_LEN(data, length)) {
                 ND_PRINT("snaplen too short, ");
                 return (CANT_CHECK_SIGNATURE);
         }
 
-        tp1 = *tp;
-
         if (ndo->ndo_sigsecret == NULL) {
                 ND_PRINT("shared secret not supplied with -M, ");
                 return (CANT_CHECK_SIGNATURE);
         }
 
-        MD5_Init(&ctx);
         /*
-         * Step 1: Update MD5 hash with IP pseudo-header.
+         * Step 1: Build the IP pseudo-header.
          */
         if (IP_V(ip) == 4) {
-                MD5_Update(&ctx, (const char *)&ip->ip_src, sizeof(ip->ip_src));
-                MD5_Update(&ctx, (const char *)&ip->ip_dst, sizeof(ip->ip_dst));
-                MD5_Update(&ctx, (const char *)&zero_proto, sizeof(zero_proto));
-                MD5_Update(&ctx, (const char *)&ip->ip_p, sizeof(ip->ip_p));
+                memcpy(hp, &ip->ip_src, sizeof(ip->ip_src));
+                hp += sizeof(ip->ip_src);
+                memcpy(hp, &ip->ip_dst, sizeof(ip->ip_dst));
+                hp += sizeof(ip->ip_dst);
+                *hp++ = 0;
+                *hp++ = GET_U_1(ip->ip_p);
                 tlen = GET_BE_U_2(ip->ip_len) - IP_HL(ip) * 4;
-                tlen = htons(tlen);
-                MD5_Update(&ctx, (const char *)&tlen, sizeof(tlen));
+                *hp++ = (u_char)(tlen >> 8);
+                *hp++ = (u_char)tlen;
         } else if (IP_V(ip) == 6) {
                 ip6 = (const struct ip6_hdr *)ip;
-                MD5_Update(&ctx, (const char *)&ip6->ip6_src, sizeof(ip6->ip6_src));
-                MD5_Update(&ctx, (const char *)&ip6->ip6_dst, sizeof(ip6->ip6_dst));
-                len32 = htonl(GET_BE_U_2(ip6->ip6_plen));
-                MD5_Update(&ctx, (const char *)&len32, sizeof(len32));
-                nxt = 0;
-                MD5_Update(&ctx, (const char *)&nxt, sizeof(nxt));
-                MD5_Update(&ctx, (const char *)&nxt, sizeof(nxt));
-                MD5_Update(&ctx, (const char *)&nxt, sizeof(nxt));
-                nxt = IPPROTO_TCP;
-                MD5_Update(&ctx, (const char *)&nxt, sizeof(nxt));
+                memcpy(hp, &ip6->ip6_src, sizeof(ip6->ip6_src));
+                hp += sizeof(ip6->ip6_src);
+                memcpy(hp, &ip6->ip6_dst, sizeof(ip6->ip6_dst));
+                hp += sizeof(ip6->ip6_dst);
+                tlen = GET_BE_U_2(ip6->ip6_plen);
+                *hp++ = 0;
+                *hp++ = 0;
+                *hp++ = (u_char)(tlen >> 8);
+                *hp++ = (u_char)tlen;
+                *hp++ = 0;
+                *hp++ = 0;
+                *hp++ = 0;
+                *hp++ = IPPROTO_TCP;
         } else {
                 ND_PRINT("IP version not 4 or 6, ");
                 return (CANT_CHECK_SIGNATURE);
         }
 
         /*
-         * Step 2: Update MD5 hash with TCP header, excluding options.
-         * The TCP checksum must be set to zero.
+         * Step 2: Append the TCP header, excluding options, with the
+         * TCP checksum set to zero, and hash both at once.
          */
-        memcpy(&savecsum, tp1.th_sum, sizeof(savecsum));
-        memset(tp1.th_sum, 0, sizeof(tp1.th_sum));
-        MD5_Update(&ctx, (const char *)&tp1, sizeof(struct tcphdr));
-        memcpy(tp1.th_sum, &savecsum, sizeof(tp1.th_sum));
+        memcpy(hp, tp, sizeof(struct tcphdr));
+        memset(((struct tcphdr *)hp)->th_sum, 0, sizeof(tp->th_sum));
+        hp += sizeof(struct tcphdr);
+        MD5_Init(&ctx);
+        MD5_Update(&ctx, hdrs, hp - hdrs);
         /*
          * Step 3: Update MD5 hash with TCP segment data, if present.
          */
@@ -39,6 +39,7 @@
 #include "rpc_msg.h"
 
 #include "nfs.h"
+#include "fields.h"
 
 
 struct rtcphdr {
@@ -364,7 +365,8 @@ udp_print(netdissect_options *ndo, const u_char *bp, u_int length,
 
 	sport = GET_BE_U_2(up->uh_sport);
 	dport = GET_BE_U_2(up->uh_dport);
-	if (ndo->ndo_packettype != PT_RPC)
+	if (ndo->ndo_packettype != PT_RPC ||
+	    ND_DECODE_STOP(ndo, ND_DECODE_DEPTH_L4))
 		udpipaddr_print(ndo, ip, sport, dport);
 
 	ND_ICHECKMSG_ZU("undersized-udp", length, <, sizeof(struct udphdr));
@@ -384,9 +386,15 @@ udp_print(netdissect_options *ndo, const u_char *bp, u_int length,
 	if (ulen < length)
 		length = ulen;
 
+	if (ND_FIELDS_LAYER(ndo, ND_LAYER_TRANSPORT)) {
+		nd_field_uint(ndo, ND_FIELD_SPORT, sport);
+		nd_field_uint(ndo, ND_FIELD_DPORT, dport);
+		nd_field_uint(ndo, ND_FIELD_PAYLOAD_LEN, length);
+	}
+
 	cp = (const u_char *)(up + 1);
 
-	if (ndo->ndo_packettype) {
+	if (ndo->ndo_packettype && !ND_DECODE_STOP(ndo, ND_DECODE_DEPTH_L4)) {
 		const struct sunrpc_msg *rp;
 		enum sunrpc_msg_type direction;
 
@@ -459,7 +467,7 @@ udp_print(netdissect_options *ndo, const u_char *bp, u_int length,
 			break;
 		case PT_DOMAIN:
 			/* over_tcp: FALSE, is_mdns: FALSE */
-			domain_print(ndo, cp, length, FALSE, FALSE);
+			domain_print(ndo, cp, length, FALSE, FALSE, sport, dport, bp2);
 			break;
 		case PT_QUIC:
 			quic_print(ndo, cp);
@@ -468,7 +476,7 @@ udp_print(netdissect_options *ndo, const u_char *bp, u_int length,
 		return;
 	}
 
-	if (!ndo->ndo_qflag) {
+	if (!ndo->ndo_qflag && !ND_DECODE_STOP(ndo, ND_DECODE_DEPTH_L4)) {
 		const struct sunrpc_msg *rp;
 		enum sunrpc_msg_type direction;
 
@@ -534,10 +542,10 @@ udp_print(netdissect_options *ndo, const u_char *bp, u_int length,
 		}
 	}
 
-	if (!ndo->ndo_qflag) {
+	if (!ndo->ndo_qflag && !ND_DECODE_STOP(ndo, ND_DECODE_DEPTH_L4)) {
 		if (IS_SRC_OR_DST_PORT(NAMESERVER_PORT))
 			/* over_tcp: FALSE, is_mdns: FALSE */
-			domain_print(ndo, cp, length, FALSE, FALSE);
+			domain_print(ndo, cp, length, FALSE, FALSE, sport, dport, bp2);
 		else if (IS_SRC_OR_DST_PORT(BOOTPC_PORT) ||
 			 IS_SRC_OR_DST_PORT(BOOTPS_PORT))
 			bootp_print(ndo, cp, length);
@@ -588,7 +596,7 @@ udp_print(netdissect_options *ndo, const u_char *bp, u_int length,
 			lwres_print(ndo, cp, length);
 		else if (IS_SRC_OR_DST_PORT(MULTICASTDNS_PORT))
 			/* over_tcp: FALSE, is_mdns: TRUE */
-			domain_print(ndo, cp, length, FALSE, TRUE);
+			domain_print(ndo, cp, length, FALSE, TRUE, sport, dport, bp2);
 		else if (IS_SRC_OR_DST_PORT(ISAKMP_PORT_NATT))
 			 isakmp_rfc3948_print(ndo, cp, length, bp2, IP_V(ip), fragmented, ttl_hl);
 		else if (IS_SRC_OR_DST_PORT(ISAKMP_PORT_USER1) || IS_SRC_OR_DST_PORT(ISAKMP_PORT_USER2))
@@ -146,6 +146,11 @@ vxlan_gpe_print(netdissect_options *ndo, const u_char *bp, u_int len)
     bp += 1;
     len -= 1;
 
+    if (ND_DECODE_STOP_TUNNEL(ndo)) {
+        ND_PRINT(", length %u", len);
+        return;
+    }
+
     ND_PRINT(ndo->ndo_vflag ? "\n    " : ": ");
 
     switch (next_protocol) {
@@ -68,11 +68,17 @@ vxlan_print(netdissect_options *ndo, const u_char *bp, u_int length)
      * RFC 7348 says that the I flag MUST be set.
      */
     if (flags & VXLAN_I)
-        ND_PRINT("vni %u\n", GET_BE_U_3(bp));
+        ND_PRINT("vni %u", GET_BE_U_3(bp));
     else
-        ND_PRINT("ERROR: I flag not set\n");
+        ND_PRINT("ERROR: I flag not set");
     bp += 3;
 
+    if (ND_DECODE_STOP_TUNNEL(ndo)) {
+        ND_PRINT(", length %u", length - VXLAN_HDR_LEN);
+        return;
+    }
+    ND_PRINT("\n");
+
     /* 2nd Reserved */
     ND_TCHECK_1(bp);
     bp += 1;
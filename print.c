@@ -35,8 +35,16 @@
 
 #include "netdissect.h"
 #include "addrtoname.h"
+#include "af.h"
+#include "ethertype.h"
+#include "extract.h"
+#include "ipproto.h"
 #include "print.h"
 #include "netdissect-alloc.h"
+#include "rpc_xid.h"
+#include "flow_collector.h"
+#include "overlay.h"
+#include "fields.h"
 
 struct printer {
 	if_printer f;
@@ -244,6 +252,8 @@ void
 init_print(netdissect_options *ndo, uint32_t localnet, uint32_t mask)
 {
 	init_addrtoname(ndo, localnet, mask);
+	if (ndo->ndo_output_format != ND_OUTPUT_TEXT)
+		nd_fields_init(ndo);
 }
 
 if_printer
@@ -302,9 +312,225 @@ get_if_printer(int type)
 
 #ifdef ENABLE_INSTRUMENT_FUNCTIONS
 extern int profile_func_level;
+extern const char **profile_ndo_protocol;
 static int pretty_print_packet_level = -1;
 #endif
 
+/*
+ * Find the IPv4 or IPv6 header of a packet, for --flow-sampling and
+ * --flow-collector, without dissecting the packet; only a few link-layer
+ * header types and VLAN tags are known.  Returns NULL if the packet isn't
+ * IP or can't be parsed, and otherwise sets *lenp to the number of
+ * captured bytes from the IP header on.
+ */
+static const u_char *
+flow_ip_header(netdissect_options *ndo, const struct pcap_pkthdr *h,
+	       const u_char *sp, u_int *lenp)
+{
+	const u_char *p = sp;
+	u_int len = h->caplen;
+	u_int ethertype, i;
+	uint32_t family;
+
+	if (ndo->ndo_if_printer == ether_if_print) {
+		if (len < 14)
+			return NULL;
+		ethertype = EXTRACT_BE_U_2(p + 12);
+		p += 14;
+		len -= 14;
+		/* Up to two 802.1Q/802.1ad tags. */
+		for (i = 0; i < 2 && (ethertype == ETHERTYPE_8021Q ||
+		    ethertype == ETHERTYPE_8021QinQ ||
+		    ethertype == ETHERTYPE_8021Q9100); i++) {
+			if (len < 4)
+				return NULL;
+			ethertype = EXTRACT_BE_U_2(p + 2);
+			p += 4;
+			len -= 4;
+		}
+		if (ethertype != ETHERTYPE_IP && ethertype != ETHERTYPE_IPV6)
+			return NULL;
+	} else if (ndo->ndo_if_printer == sll_if_print) {
+		if (len < 16)
+			return NULL;
+		ethertype = EXTRACT_BE_U_2(p + 14);
+		if (ethertype != ETHERTYPE_IP && ethertype != ETHERTYPE_IPV6)
+			return NULL;
+		p += 16;
+		len -= 16;
+	} else if (ndo->ndo_if_printer == sll2_if_print) {
+		if (len < 20)
+			return NULL;
+		ethertype = EXTRACT_BE_U_2(p);
+		if (ethertype != ETHERTYPE_IP && ethertype != ETHERTYPE_IPV6)
+			return NULL;
+		p += 20;
+		len -= 20;
+	} else if (ndo->ndo_if_printer == null_if_print) {
+		if (len < 4)
+			return NULL;
+		/*
+		 * The family is in the byte order of the capturing host;
+		 * as in null_if_print(), values with bits in the upper
+		 * half are taken as byte-swapped.
+		 */
+		family = EXTRACT_LE_U_4(p);
+		if ((family & 0xffff0000) != 0)
+			family = EXTRACT_BE_U_4(p);
+		if (family != BSD_AF_INET && family != BSD_AF_INET6_BSD &&
+		    family != BSD_AF_INET6_FREEBSD &&
+		    family != BSD_AF_INET6_DARWIN)
+			return NULL;
+		p += 4;
+		len -= 4;
+	} else if (ndo->ndo_if_printer != raw_if_print)
+		return NULL;
+	*lenp = len;
+	return p;
+}
+
+/*
+ * Hash the IPv4 or IPv6 addresses, protocol and TCP/UDP/SCTP ports of
+ * a packet, the same way in both directions, for --flow-sampling.
+ *
+ * This is done before, and far more cheaply than, dissecting the packet,
+ * so it doesn't walk IPv6 extension headers and doesn't use the ports of
+ * fragmented IPv4 datagrams.  It returns 0 if the packet isn't IP or
+ * can't be parsed.
+ */
+#define FLOW_HASH_STEP(hash, b)	(((hash) ^ (b)) * 16777619U)	/* FNV-1a */
+
+static int
+flow_hash(netdissect_options *ndo, const struct pcap_pkthdr *h,
+	  const u_char *sp, uint32_t *hashp)
+{
+	const u_char *p;
+	u_int len, hlen, proto, alen, i;
+	const u_char *src, *dst, *ports = NULL;
+	uint32_t hash = 2166136261U;
+	int swap;
+
+	p = flow_ip_header(ndo, h, sp, &len);
+	if (p == NULL)
+		return 0;
+	if (len < 1)
+		return 0;
+	switch (p[0] >> 4) {
+
+	case 4:
+		if (len < 20)
+			return 0;
+		hlen = (p[0] & 0x0f) * 4;
+		if (hlen < 20)
+			return 0;
+		proto = p[9];
+		src = p + 12;
+		dst = p + 16;
+		alen = 4;
+		/* Only unfragmented datagrams have ports we can use. */
+		if ((EXTRACT_BE_U_2(p + 6) & 0x3fff) == 0 && len >= hlen + 4)
+			ports = p + hlen;
+		break;
+
+	case 6:
+		if (len < 40)
+			return 0;
+		proto = p[6];
+		src = p + 8;
+		dst = p + 24;
+		alen = 16;
+		if (len >= 44)
+			ports = p + 40;
+		break;
+
+	default:
+		return 0;
+	}
+	if (proto != IPPROTO_TCP && proto != IPPROTO_UDP &&
+	    proto != IPPROTO_SCTP)
+		ports = NULL;
+
+	/* Put the lower address (and its port) first. */
+	swap = memcmp(src, dst, alen);
+	if (swap == 0 && ports != NULL)
+		swap = memcmp(ports, ports + 2, 2);
+	if (swap > 0) {
+		const u_char *tmp = src;
+		src = dst;
+		dst = tmp;
+	}
+	for (i = 0; i < alen; i++)
+		hash = FLOW_HASH_STEP(hash, src[i]);
+	for (i = 0; i < alen; i++)
+		hash = FLOW_HASH_STEP(hash, dst[i]);
+	hash = FLOW_HASH_STEP(hash, proto);
+	if (ports != NULL) {
+		for (i = 0; i < 2; i++)
+			hash = FLOW_HASH_STEP(hash, ports[swap > 0 ? 2 + i : i]);
+		for (i = 0; i < 2; i++)
+			hash = FLOW_HASH_STEP(hash, ports[swap > 0 ? i : 2 + i]);
+	}
+	/*
+	 * FNV-1a leaves the low bits, used for the modulo, poorly mixed
+	 * when only a port differs; finish with the MurmurHash3 mixer.
+	 */
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6bU;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35U;
+	hash ^= hash >> 16;
+	*hashp = hash;
+	return 1;
+}
+
+/*
+ * Should this packet be printed, given --print-sampling or
+ * --flow-sampling?
+ */
+static int
+sampled(netdissect_options *ndo, const struct pcap_pkthdr *h,
+	const u_char *sp, u_int packets_captured)
+{
+	uint32_t hash;
+
+	if (ndo->ndo_print_sampling_flows &&
+	    flow_hash(ndo, h, sp, &hash))
+		return hash % (u_int)ndo->ndo_print_sampling == 0;
+	/* Not a flow we know about: sample it as a packet. */
+	return packets_captured % ndo->ndo_print_sampling == 0;
+}
+
+/*
+ * With --flow-collector, add the sFlow and NetFlow records in a packet to
+ * the collector's tables, and with --overlay-stats, account for it if
+ * it's tunnelled, rather than printing it.
+ */
+static void
+collect_packet(netdissect_options *ndo, const struct pcap_pkthdr *h,
+	       const u_char *sp)
+{
+	const u_char *ip;
+	u_int len;
+
+	ndo->ndo_ts.tv_sec = h->ts.tv_sec;
+	ndo->ndo_ts.tv_usec = h->ts.tv_usec;
+	if (ndo->ndo_overlay_stats)
+		nd_overlay_tick(ndo);
+	else
+		nd_flow_collector_tick(ndo);
+	ip = flow_ip_header(ndo, h, sp, &len);
+	if (ip == NULL)
+		return;
+	ndo->ndo_snapend = sp + h->caplen;
+	ndo->ndo_packetp = sp;
+	if (ndo->ndo_overlay_stats)
+		nd_overlay_packet(ndo, ip, len);
+	else
+		nd_flow_collector_packet(ndo, ip, len);
+	nd_pop_all_packet_info(ndo);
+	nd_free_all(ndo);
+}
+
 void
 pretty_print_packet(netdissect_options *ndo, const struct pcap_pkthdr *h,
 		    const u_char *sp, u_int packets_captured)
@@ -312,14 +538,25 @@ pretty_print_packet(netdissect_options *ndo, const struct pcap_pkthdr *h,
 	u_int hdrlen = 0;
 	int invalid_header = 0;
 
-	if (ndo->ndo_print_sampling && packets_captured % ndo->ndo_print_sampling != 0)
+	if (ndo->ndo_flow_collector || ndo->ndo_overlay_stats) {
+		collect_packet(ndo, h, sp);
+		return;
+	}
+
+	if (ndo->ndo_print_sampling &&
+	    !sampled(ndo, h, sp, packets_captured))
 		return;
 
 #ifdef ENABLE_INSTRUMENT_FUNCTIONS
 	if (pretty_print_packet_level == -1)
 		pretty_print_packet_level = profile_func_level;
+	/* Charge the time to the protocols, with INSTRUMENT=profile */
+	profile_ndo_protocol = &ndo->ndo_protocol;
 #endif
 
+	if (ndo->ndo_fields != NULL)
+		nd_fields_begin(ndo, h);
+
 	if (ndo->ndo_packet_number)
 		ND_PRINT("%5u  ", packets_captured);
 
@@ -364,6 +601,11 @@ pretty_print_packet(netdissect_options *ndo, const struct pcap_pkthdr *h,
 	}
 	if (invalid_header) {
 		ND_PRINT("]\n");
+		if (ndo->ndo_fields != NULL)
+			nd_fields_end(ndo);
+#ifdef ENABLE_INSTRUMENT_FUNCTIONS
+		profile_ndo_protocol = NULL;
+#endif
 		return;
 	}
 
@@ -389,6 +631,7 @@ pretty_print_packet(netdissect_options *ndo, const struct pcap_pkthdr *h,
 	tvbuf.tv_sec = h->ts.tv_sec;
 	tvbuf.tv_usec = h->ts.tv_usec;
 	ts_print(ndo, &tvbuf);
+	ndo->ndo_ts = tvbuf;
 
 	/*
 	 * Printers must check that they're not walking off the end of
@@ -409,6 +652,8 @@ pretty_print_packet(netdissect_options *ndo, const struct pcap_pkthdr *h,
 	case ND_TRUNCATED:
 		/* A printer quit because the packet was truncated; report it */
 		nd_print_trunc(ndo);
+		if (ndo->ndo_fields != NULL)
+			nd_field_bool(ndo, ND_FIELD_TRUNCATED, 1);
 		/* Print the full packet */
 		ndo->ndo_ll_hdr_len = 0;
 #ifdef ENABLE_INSTRUMENT_FUNCTIONS
@@ -495,7 +740,13 @@ pretty_print_packet(netdissect_options *ndo, const struct pcap_pkthdr *h,
 	}
 
 	ND_PRINT("\n");
+	if (ndo->ndo_fields != NULL)
+		nd_fields_end(ndo);
 	nd_free_all(ndo);
+	nd_arena_reset(ndo->ndo_scratch);
+#ifdef ENABLE_INSTRUMENT_FUNCTIONS
+	profile_ndo_protocol = NULL;
+#endif
 }
 
 /*
@@ -573,3 +824,20 @@ ndo_set_function_pointers(netdissect_options *ndo)
 	ndo->ndo_error=ndo_error;
 	ndo->ndo_warning=ndo_warning;
 }
+
+/*
+ * Print the statistics gathered by the printers, for --protocol-stats.
+ */
+void
+print_protocol_stats(netdissect_options *ndo)
+{
+	rpc_xid_print_stats(ndo);
+	nfs_latency_print_stats(ndo);
+	dns_print_stats(ndo);
+	quic_print_stats(ndo);
+	rx_print_stats(ndo);
+	snmp_print_stats(ndo);
+	ieee802_11_radio_print_stats(ndo);
+	nd_flow_collector_print_stats(ndo);
+	nd_overlay_print_stats(ndo);
+}
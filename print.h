@@ -40,4 +40,6 @@ void	pretty_print_packet(netdissect_options *ndo,
 
 void	ndo_set_function_pointers(netdissect_options *ndo);
 
+void	print_protocol_stats(netdissect_options *ndo);
+
 #endif /* print_h */
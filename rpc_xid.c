@@ -0,0 +1,276 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ *
+ * ONC RPC transaction table, used to match replies with their calls.
+ */
+
+#include <config.h>
+
+#include "netdissect-stdinc.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "netdissect.h"
+#include "extract.h"
+
+#include "ip.h"
+#include "ip6.h"
+#include "rpc_auth.h"
+#include "rpc_msg.h"
+#include "rpc_xid.h"
+
+/*
+ * The calls are kept in an array managed as a ring, in the order they
+ * were seen, so that the oldest one is the first to go when the table
+ * is full or when it gets too old; they are found by a hash of the XID
+ * and addresses, with the newest first, so a retransmitted call wins
+ * over the earlier ones.
+ */
+struct rpc_xid_entry {
+	uint32_t xid;			/* transaction ID (net order) */
+	int ipver;			/* IP version (4 or 6) */
+	nd_ipv6 client;			/* client IP address (net order) */
+	nd_ipv6 server;			/* server IP address (net order) */
+	struct rpc_xid_call call;
+	int matched;			/* a reply was seen */
+	uint32_t hnext;			/* next entry in the hash chain */
+	uint32_t hprev;			/* previous entry in the hash chain */
+};
+
+#define RPC_XID_NONE	UINT32_MAX
+
+static struct rpc_xid_entry *xid_table;
+static uint32_t *xid_buckets;
+static u_int xid_table_size;
+static u_int xid_bucket_mask;
+static u_int xid_head;			/* oldest entry */
+static u_int xid_count;
+
+static struct {
+	uint64_t calls;
+	uint64_t matched;
+	uint64_t unmatched;
+	uint64_t expired;		/* dropped unanswered for age */
+	uint64_t overwritten;		/* dropped unanswered for room */
+} xid_stats;
+
+static void
+rpc_xid_init(netdissect_options *ndo)
+{
+	u_int nbuckets, i;
+
+	xid_table_size = ndo->ndo_rpc_xid_table_size != 0 ?
+	    ndo->ndo_rpc_xid_table_size : RPC_XID_TABLE_SIZE;
+	for (nbuckets = 16; nbuckets < xid_table_size; nbuckets <<= 1)
+		;
+	xid_table = (struct rpc_xid_entry *)calloc(xid_table_size,
+	    sizeof(*xid_table));
+	xid_buckets = (uint32_t *)malloc(nbuckets * sizeof(*xid_buckets));
+	if (xid_table == NULL || xid_buckets == NULL)
+		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
+		    "%s: malloc", __func__);
+	for (i = 0; i < nbuckets; i++)
+		xid_buckets[i] = RPC_XID_NONE;
+	xid_bucket_mask = nbuckets - 1;
+}
+
+static u_int
+rpc_xid_hash(uint32_t xid, const u_char *client, const u_char *server,
+	     u_int addrlen)
+{
+	uint32_t hash = xid;
+	u_int i;
+
+	/* The XID does most of the work; the addresses split collisions. */
+	for (i = 0; i < addrlen; i++)
+		hash = hash * 31 + client[i] + server[i];
+	hash *= 2654435761U;
+	return (hash >> 16) & xid_bucket_mask;
+}
+
+static void
+rpc_xid_unlink(u_int idx)
+{
+	struct rpc_xid_entry *xe = &xid_table[idx];
+	u_int addrlen = xe->ipver == 6 ? sizeof(nd_ipv6) : sizeof(nd_ipv4);
+
+	if (xe->hprev != RPC_XID_NONE)
+		xid_table[xe->hprev].hnext = xe->hnext;
+	else
+		xid_buckets[rpc_xid_hash(xe->xid, xe->client, xe->server,
+		    addrlen)] = xe->hnext;
+	if (xe->hnext != RPC_XID_NONE)
+		xid_table[xe->hnext].hprev = xe->hprev;
+}
+
+static void
+rpc_xid_drop_oldest(void)
+{
+	rpc_xid_unlink(xid_head);
+	if (++xid_head == xid_table_size)
+		xid_head = 0;
+	xid_count--;
+}
+
+/*
+ * Remember a call to the program prog, which is the one the printer
+ * decodes the call as (e.g. NFS for the NFS port), not necessarily the
+ * one in the call.  Returns 0 if the packet was truncated.
+ */
+int
+rpc_xid_enter(netdissect_options *ndo, const struct sunrpc_msg *rp,
+	      const u_char *bp, uint32_t prog)
+{
+	const struct ip *ip = (const struct ip *)bp;
+	const struct ip6_hdr *ip6 = (const struct ip6_hdr *)bp;
+	struct rpc_xid_entry *xe;
+	const u_char *client, *server;
+	u_int addrlen, idx, bucket;
+	int ipver;
+
+	if (!ND_TTEST_4(rp->rm_call.cb_proc))
+		return (0);
+	ipver = IP_V(ip);
+	switch (ipver) {
+	case 4:
+		client = ip->ip_src;
+		server = ip->ip_dst;
+		addrlen = sizeof(nd_ipv4);
+		break;
+	case 6:
+		client = ip6->ip6_src;
+		server = ip6->ip6_dst;
+		addrlen = sizeof(nd_ipv6);
+		break;
+	default:
+		return (1);
+	}
+
+	if (xid_table == NULL)
+		rpc_xid_init(ndo);
+
+	/* Make room, and forget the calls that got too old. */
+	while (xid_count != 0) {
+		xe = &xid_table[xid_head];
+		if (xid_count == xid_table_size) {
+			if (!xe->matched)
+				xid_stats.overwritten++;
+		} else if (ndo->ndo_ts.tv_sec - xe->call.ts.tv_sec >
+			   RPC_XID_MAX_AGE) {
+			if (!xe->matched)
+				xid_stats.expired++;
+		} else
+			break;
+		rpc_xid_drop_oldest();
+	}
+
+	idx = xid_head + xid_count;
+	if (idx >= xid_table_size)
+		idx -= xid_table_size;
+	xid_count++;
+	xe = &xid_table[idx];
+	UNALIGNED_MEMCPY(&xe->xid, &rp->rm_xid, sizeof(xe->xid));
+	xe->ipver = ipver;
+	memset(xe->client, 0, sizeof(xe->client));
+	memset(xe->server, 0, sizeof(xe->server));
+	UNALIGNED_MEMCPY(&xe->client, client, addrlen);
+	UNALIGNED_MEMCPY(&xe->server, server, addrlen);
+	xe->call.prog = prog;
+	xe->call.vers = GET_BE_U_4(rp->rm_call.cb_vers);
+	xe->call.proc = GET_BE_U_4(rp->rm_call.cb_proc);
+	xe->call.ts = ndo->ndo_ts;
+	xe->matched = 0;
+
+	bucket = rpc_xid_hash(xe->xid, xe->client, xe->server, addrlen);
+	xe->hprev = RPC_XID_NONE;
+	xe->hnext = xid_buckets[bucket];
+	if (xe->hnext != RPC_XID_NONE)
+		xid_table[xe->hnext].hprev = idx;
+	xid_buckets[bucket] = idx;
+	xid_stats.calls++;
+	return (1);
+}
+
+/*
+ * Find the call a reply answers.  Returns 0 and fills in *call, or
+ * returns -1 if the call isn't known.
+ */
+int
+rpc_xid_find(netdissect_options *ndo, const struct sunrpc_msg *rp,
+	     const u_char *bp, struct rpc_xid_call *call)
+{
+	const struct ip *ip = (const struct ip *)bp;
+	const struct ip6_hdr *ip6 = (const struct ip6_hdr *)bp;
+	struct rpc_xid_entry *xe;
+	nd_ipv6 client, server;
+	uint32_t xid;
+	u_int addrlen, idx;
+	int ipver;
+
+	ipver = IP_V(ip);
+	memset(client, 0, sizeof(client));
+	memset(server, 0, sizeof(server));
+	switch (ipver) {
+	case 4:
+		addrlen = sizeof(nd_ipv4);
+		UNALIGNED_MEMCPY(&client, ip->ip_dst, addrlen);
+		UNALIGNED_MEMCPY(&server, ip->ip_src, addrlen);
+		break;
+	case 6:
+		addrlen = sizeof(nd_ipv6);
+		UNALIGNED_MEMCPY(&client, ip6->ip6_dst, addrlen);
+		UNALIGNED_MEMCPY(&server, ip6->ip6_src, addrlen);
+		break;
+	default:
+		xid_stats.unmatched++;
+		return (-1);
+	}
+	if (xid_table == NULL) {
+		xid_stats.unmatched++;
+		return (-1);
+	}
+
+	UNALIGNED_MEMCPY(&xid, &rp->rm_xid, sizeof(xid));
+	for (idx = xid_buckets[rpc_xid_hash(xid, client, server, addrlen)];
+	     idx != RPC_XID_NONE; idx = xe->hnext) {
+		xe = &xid_table[idx];
+		if (xe->xid != xid || xe->ipver != ipver ||
+		    memcmp(xe->client, client, addrlen) != 0 ||
+		    memcmp(xe->server, server, addrlen) != 0)
+			continue;
+		if (ndo->ndo_ts.tv_sec - xe->call.ts.tv_sec > RPC_XID_MAX_AGE)
+			break;	/* a reused XID */
+		xe->matched = 1;
+		*call = xe->call;
+		xid_stats.matched++;
+		return (0);
+	}
+	xid_stats.unmatched++;
+	return (-1);
+}
+
+void
+rpc_xid_print_stats(netdissect_options *ndo)
+{
+	if (xid_stats.calls == 0 && xid_stats.unmatched == 0)
+		return;
+	ND_PRINT("RPC: %" PRIu64 " calls, %" PRIu64 " replies matched, %"
+	    PRIu64 " unmatched, %" PRIu64 " calls dropped unanswered (%"
+	    PRIu64 " too old, %" PRIu64 " for room in a table of %u)\n",
+	    xid_stats.calls, xid_stats.matched, xid_stats.unmatched,
+	    xid_stats.expired + xid_stats.overwritten, xid_stats.expired,
+	    xid_stats.overwritten,
+	    xid_table_size != 0 ? xid_table_size :
+	    (ndo->ndo_rpc_xid_table_size != 0 ?
+	     ndo->ndo_rpc_xid_table_size : RPC_XID_TABLE_SIZE));
+}
@@ -0,0 +1,43 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ *
+ * ONC RPC transaction table, used to match replies with their calls.
+ */
+
+#ifndef netdissect_rpc_xid_h
+#define netdissect_rpc_xid_h
+
+#include "netdissect.h"
+
+/* Default number of outstanding calls remembered. */
+#define RPC_XID_TABLE_SIZE	4096
+
+/* Calls older than this, in seconds, no longer match a reply. */
+#define RPC_XID_MAX_AGE		120
+
+struct sunrpc_msg;
+
+/* What is remembered of a call. */
+struct rpc_xid_call {
+	uint32_t prog;		/* program number (host order) */
+	uint32_t vers;		/* program version (host order) */
+	uint32_t proc;		/* procedure number (host order) */
+	struct timeval ts;	/* time stamp of the call */
+};
+
+extern int rpc_xid_enter(netdissect_options *, const struct sunrpc_msg *,
+			 const u_char *, uint32_t);
+extern int rpc_xid_find(netdissect_options *, const struct sunrpc_msg *,
+			const u_char *, struct rpc_xid_call *);
+extern void rpc_xid_print_stats(netdissect_options *);
+
+#endif /* netdissect_rpc_xid_h */
@@ -28,6 +28,7 @@
 
 #ifdef HAVE_LIBCRYPTO
 #include <openssl/md5.h>
+#include <openssl/sha.h>
 #endif
 
 const struct tok signature_check_values[] = {
@@ -41,86 +42,258 @@ const struct tok signature_check_values[] = {
 
 #ifdef HAVE_LIBCRYPTO
 /*
- * Compute a HMAC MD5 sum.
- * Taken from rfc2104, Appendix.
+ * The hash functions the signatures are computed with.
  */
+#define SIGNATURE_HMAC_MD5	0
+#define SIGNATURE_HMAC_SHA1	1
+#define SIGNATURE_HMAC_SHA224	2
+#define SIGNATURE_HMAC_SHA256	3
+#define SIGNATURE_HMAC_SHA384	4
+#define SIGNATURE_HMAC_SHA512	5
+#define SIGNATURE_NHASHES	6
+
+union signature_hash_ctx {
+    MD5_CTX md5;
+    SHA_CTX sha1;
+    SHA256_CTX sha256;
+    SHA512_CTX sha512;
+};
+
+static const struct {
+    u_int digest_len;
+    u_int block_len;
+} signature_hashes[SIGNATURE_NHASHES] = {
+    { MD5_DIGEST_LENGTH,    MD5_CBLOCK },       /* SIGNATURE_HMAC_MD5 */
+    { SHA_DIGEST_LENGTH,    SHA_CBLOCK },       /* SIGNATURE_HMAC_SHA1 */
+    { SHA224_DIGEST_LENGTH, SHA256_CBLOCK },    /* SIGNATURE_HMAC_SHA224 */
+    { SHA256_DIGEST_LENGTH, SHA256_CBLOCK },    /* SIGNATURE_HMAC_SHA256 */
+    { SHA384_DIGEST_LENGTH, SHA512_CBLOCK },    /* SIGNATURE_HMAC_SHA384 */
+    { SHA512_DIGEST_LENGTH, SHA512_CBLOCK },    /* SIGNATURE_HMAC_SHA512 */
+};
+
+#define SIGNATURE_MAX_DIGEST_LEN    SHA512_DIGEST_LENGTH
+#define SIGNATURE_MAX_BLOCK_LEN     SHA512_CBLOCK
+
 DIAG_OFF_DEPRECATION
 static void
-signature_compute_hmac_md5(const uint8_t *text, int text_len, unsigned char *key,
-                           unsigned int key_len, uint8_t *digest)
+signature_hash_init(u_int hash, union signature_hash_ctx *ctx)
 {
-    MD5_CTX context;
-    unsigned char k_ipad[65];    /* inner padding - key XORd with ipad */
-    unsigned char k_opad[65];    /* outer padding - key XORd with opad */
-    unsigned char tk[16];
-    int i;
+    switch (hash) {
+    case SIGNATURE_HMAC_MD5:
+        MD5_Init(&ctx->md5);
+        break;
+    case SIGNATURE_HMAC_SHA1:
+        SHA1_Init(&ctx->sha1);
+        break;
+    case SIGNATURE_HMAC_SHA224:
+        SHA224_Init(&ctx->sha256);
+        break;
+    case SIGNATURE_HMAC_SHA256:
+        SHA256_Init(&ctx->sha256);
+        break;
+    case SIGNATURE_HMAC_SHA384:
+        SHA384_Init(&ctx->sha512);
+        break;
+    case SIGNATURE_HMAC_SHA512:
+        SHA512_Init(&ctx->sha512);
+        break;
+    }
+}
 
-    /* if key is longer than 64 bytes reset it to key=MD5(key) */
-    if (key_len > 64) {
+static void
+signature_hash_update(u_int hash, union signature_hash_ctx *ctx,
+                      const void *data, size_t len)
+{
+    switch (hash) {
+    case SIGNATURE_HMAC_MD5:
+        MD5_Update(&ctx->md5, data, len);
+        break;
+    case SIGNATURE_HMAC_SHA1:
+        SHA1_Update(&ctx->sha1, data, len);
+        break;
+    case SIGNATURE_HMAC_SHA224:
+        SHA224_Update(&ctx->sha256, data, len);
+        break;
+    case SIGNATURE_HMAC_SHA256:
+        SHA256_Update(&ctx->sha256, data, len);
+        break;
+    case SIGNATURE_HMAC_SHA384:
+        SHA384_Update(&ctx->sha512, data, len);
+        break;
+    case SIGNATURE_HMAC_SHA512:
+        SHA512_Update(&ctx->sha512, data, len);
+        break;
+    }
+}
 
-        MD5_CTX tctx;
+static void
+signature_hash_final(u_int hash, union signature_hash_ctx *ctx,
+                     uint8_t *digest)
+{
+    switch (hash) {
+    case SIGNATURE_HMAC_MD5:
+        MD5_Final(digest, &ctx->md5);
+        break;
+    case SIGNATURE_HMAC_SHA1:
+        SHA1_Final(digest, &ctx->sha1);
+        break;
+    case SIGNATURE_HMAC_SHA224:
+        SHA224_Final(digest, &ctx->sha256);
+        break;
+    case SIGNATURE_HMAC_SHA256:
+        SHA256_Final(digest, &ctx->sha256);
+        break;
+    case SIGNATURE_HMAC_SHA384:
+        SHA384_Final(digest, &ctx->sha512);
+        break;
+    case SIGNATURE_HMAC_SHA512:
+        SHA512_Final(digest, &ctx->sha512);
+        break;
+    }
+}
+DIAG_ON_DEPRECATION
 
-        MD5_Init(&tctx);
-        MD5_Update(&tctx, key, key_len);
-        MD5_Final(tk, &tctx);
+/*
+ * The HMAC states after hashing the key XORed with ipad and opad, for
+ * the -M secret, computed the first time a hash function is used.
+ */
+struct nd_sig_keys {
+    const char *secret;         /* the ndo_sigsecret they're for */
+    int ready[SIGNATURE_NHASHES];
+    union signature_hash_ctx inner[SIGNATURE_NHASHES];
+    union signature_hash_ctx outer[SIGNATURE_NHASHES];
+};
 
-        key = tk;
-        key_len = 16;
+/*
+ * Compute the inner and outer states of HMAC with the hash function
+ * "hash" for the -M secret, as in RFC 2104:
+ *
+ * H(K XOR opad, H(K XOR ipad, text))
+ *
+ * where ipad is the byte 0x36 and opad the byte 0x5c repeated to the
+ * block length of H, and K the key padded with zeroes to that length.
+ * A key longer than the block length is first hashed; for HMAC-SHA, as
+ * used by RFC 5310 and RFC 5709, so is a key longer than the digest.
+ */
+static void
+signature_hmac_key(netdissect_options *ndo, u_int hash)
+{
+    struct nd_sig_keys *keys;
+    union signature_hash_ctx ctx;
+    const u_char *key;
+    size_t key_len;
+    uint8_t tk[SIGNATURE_MAX_DIGEST_LEN];
+    uint8_t k_ipad[SIGNATURE_MAX_BLOCK_LEN];    /* key XORd with ipad */
+    uint8_t k_opad[SIGNATURE_MAX_BLOCK_LEN];    /* key XORd with opad */
+    u_int block_len = signature_hashes[hash].block_len;
+    u_int max_key_len;
+    u_int i;
+
+    if (ndo->ndo_sig_keys == NULL) {
+        ndo->ndo_sig_keys = (struct nd_sig_keys *)calloc(1,
+                                                         sizeof(*ndo->ndo_sig_keys));
+        if (ndo->ndo_sig_keys == NULL)
+            (*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC, "%s: calloc",
+                              __func__);
+    }
+    keys = ndo->ndo_sig_keys;
+    if (keys->secret != ndo->ndo_sigsecret) {
+        memset(keys->ready, 0, sizeof(keys->ready));
+        keys->secret = ndo->ndo_sigsecret;
     }
+    if (keys->ready[hash])
+        return;
 
-    /*
-     * the HMAC_MD5 transform looks like:
-     *
-     * MD5(K XOR opad, MD5(K XOR ipad, text))
-     *
-     * where K is an n byte key
-     * ipad is the byte 0x36 repeated 64 times
-     * opad is the byte 0x5c repeated 64 times
-     * and text is the data being protected
-     */
+    key = (const u_char *)ndo->ndo_sigsecret;
+    key_len = strlen(ndo->ndo_sigsecret);
+    max_key_len = hash == SIGNATURE_HMAC_MD5 ? block_len :
+                  signature_hashes[hash].digest_len;
+    if (key_len > max_key_len) {
+        signature_hash_init(hash, &ctx);
+        signature_hash_update(hash, &ctx, key, key_len);
+        signature_hash_final(hash, &ctx, tk);
+        key = tk;
+        key_len = signature_hashes[hash].digest_len;
+    }
 
-    /* start out by storing key in pads */
-    memset(k_ipad, 0, sizeof(k_ipad));
-    memset(k_opad, 0, sizeof(k_opad));
+    memset(k_ipad, 0, block_len);
     memcpy(k_ipad, key, key_len);
-    memcpy(k_opad, key, key_len);
-
-    /* XOR key with ipad and opad values */
-    for (i=0; i<64; i++) {
+    memcpy(k_opad, k_ipad, block_len);
+    for (i = 0; i < block_len; i++) {
         k_ipad[i] ^= 0x36;
         k_opad[i] ^= 0x5c;
     }
 
-    /*
-     * perform inner MD5
-     */
-    MD5_Init(&context);                   /* init context for 1st pass */
-    MD5_Update(&context, k_ipad, 64);     /* start with inner pad */
-    MD5_Update(&context, text, text_len); /* then text of datagram */
-    MD5_Final(digest, &context);          /* finish up 1st pass */
+    signature_hash_init(hash, &keys->inner[hash]);
+    signature_hash_update(hash, &keys->inner[hash], k_ipad, block_len);
+    signature_hash_init(hash, &keys->outer[hash]);
+    signature_hash_update(hash, &keys->outer[hash], k_opad, block_len);
+    keys->ready[hash] = 1;
+}
 
-    /*
-     * perform outer MD5
-     */
-    MD5_Init(&context);                   /* init context for 2nd pass */
-    MD5_Update(&context, k_opad, 64);     /* start with outer pad */
-    MD5_Update(&context, digest, 16);     /* then results of 1st hash */
-    MD5_Final(digest, &context);          /* finish up 2nd pass */
+/* A range of the packet that is hashed as if it held other bytes. */
+struct signature_range {
+    const u_char *ptr;
+    u_int len;
+    const uint8_t *fill;        /* what it's taken to hold, or NULL for zeroes */
+};
+
+/*
+ * Hash the packet, taking the ranges, which are sorted and within the
+ * packet, to hold their fill bytes.
+ */
+static void
+signature_hash_packet(u_int hash, union signature_hash_ctx *ctx,
+                      const u_char *pptr, u_int plen,
+                      const struct signature_range *ranges, u_int nranges)
+{
+    static const uint8_t zeroes[64];
+    const u_char *p = pptr, *start, *end;
+    u_int i, n;
+
+    for (i = 0; i < nranges; i++) {
+        start = ranges[i].ptr;
+        end = start + ranges[i].len;
+        if (end <= p)
+            continue;       /* overlaps an earlier range */
+        if (start > p)
+            signature_hash_update(hash, ctx, p, start - p);
+        else
+            start = p;
+        if (ranges[i].fill != NULL)
+            signature_hash_update(hash, ctx,
+                                  ranges[i].fill + (start - ranges[i].ptr),
+                                  end - start);
+        else {
+            while (start < end) {
+                n = ND_MIN((u_int)(end - start), sizeof(zeroes));
+                signature_hash_update(hash, ctx, zeroes, n);
+                start += n;
+            }
+        }
+        p = end;
+    }
+    if (p < pptr + plen)
+        signature_hash_update(hash, ctx, p, pptr + plen - p);
 }
-DIAG_ON_DEPRECATION
 
 /*
- * Verify a cryptographic signature of the packet.
- * Currently only MD5 is supported.
+ * Verify a signature of the packet computed with HMAC and the hash
+ * function "hash", taking the signature to hold sig_fill, and the
+ * ranges in zero, if any, to hold zeroes.  The packet isn't copied.
  */
-int
-signature_verify(netdissect_options *ndo, const u_char *pptr, u_int plen,
-                 const u_char *sig_ptr, void (*clear_rtn)(void *),
-                 const void *clear_arg)
+static int
+signature_verify_hmac(netdissect_options *ndo, u_int hash,
+                      const u_char *pptr, u_int plen,
+                      const u_char *sig_ptr, const uint8_t *sig_fill,
+                      const struct signature_zero *zero, u_int nzero)
 {
-    uint8_t *packet_copy, *sig_copy;
-    uint8_t sig[16];
-    unsigned int i;
+    struct signature_range ranges[SIGNATURE_MAX_ZERO + 1];
+    struct signature_range r;
+    union signature_hash_ctx ctx;
+    uint8_t sig[SIGNATURE_MAX_DIGEST_LEN];
+    u_int sig_len = signature_hashes[hash].digest_len;
+    u_int i, j, nranges;
 
     if (!ndo->ndo_sigsecret) {
         return (CANT_CHECK_SIGNATURE);
@@ -137,70 +310,131 @@ signature_verify(netdissect_options *ndo, const u_char *pptr, u_int plen,
     /*
      * Do we have the entire signature to check?
      */
-    if (!ND_TTEST_LEN(sig_ptr, sizeof(sig))) {
-        /* No. */
-        return (CANT_CHECK_SIGNATURE);
-    }
-    if (sig_ptr + sizeof(sig) > pptr + plen) {
+    if (sig_ptr < pptr || sig_ptr + sig_len > pptr + plen) {
         /* No. */
         return (CANT_CHECK_SIGNATURE);
     }
 
     /*
-     * Make a copy of the packet, so we don't overwrite the original.
+     * Sort the signature and the ranges to be cleared, leaving out
+     * what isn't in the packet.  Our caller is assumed to have vetted
+     * the pointers.
      */
-    packet_copy = malloc(plen);
-    if (packet_copy == NULL) {
-        return (CANT_ALLOCATE_COPY);
+    ranges[0].ptr = sig_ptr;
+    ranges[0].len = sig_len;
+    ranges[0].fill = sig_fill;
+    nranges = 1;
+    for (i = 0; i < nzero && i < SIGNATURE_MAX_ZERO; i++) {
+        if (zero[i].ptr < pptr || zero[i].ptr + zero[i].len > pptr + plen)
+            continue;
+        r.ptr = zero[i].ptr;
+        r.len = zero[i].len;
+        r.fill = NULL;
+        for (j = nranges; j > 0 && ranges[j - 1].ptr > r.ptr; j--)
+            ranges[j] = ranges[j - 1];
+        ranges[j] = r;
+        nranges++;
     }
 
-    memcpy(packet_copy, pptr, plen);
-
-    /*
-     * Clear the signature in the copy.
-     */
-    sig_copy = packet_copy + (sig_ptr - pptr);
-    memset(sig_copy, 0, sizeof(sig));
-
     /*
-     * Clear anything else that needs to be cleared in the copy.
-     * Our caller is assumed to have vetted the clear_arg pointer.
+     * Compute the signature, starting from the precomputed states.
      */
-    (*clear_rtn)((void *)(packet_copy + ((const uint8_t *)clear_arg - pptr)));
-
-    /*
-     * Compute the signature.
-     */
-    signature_compute_hmac_md5(packet_copy, plen,
-                               (unsigned char *)ndo->ndo_sigsecret,
-                               strlen(ndo->ndo_sigsecret), sig);
-
-    /*
-     * Free the copy.
-     */
-    free(packet_copy);
+    signature_hmac_key(ndo, hash);
+    ctx = ndo->ndo_sig_keys->inner[hash];
+    signature_hash_packet(hash, &ctx, pptr, plen, ranges, nranges);
+    signature_hash_final(hash, &ctx, sig);
+    ctx = ndo->ndo_sig_keys->outer[hash];
+    signature_hash_update(hash, &ctx, sig, sig_len);
+    signature_hash_final(hash, &ctx, sig);
 
     /*
      * Does the computed signature match the signature in the packet?
      */
-    if (memcmp(sig_ptr, sig, sizeof(sig)) == 0) {
+    if (memcmp(sig_ptr, sig, sig_len) == 0) {
         /* Yes. */
         return (SIGNATURE_VALID);
     } else {
         /* No - print the computed signature. */
-        for (i = 0; i < sizeof(sig); ++i) {
+        for (i = 0; i < sig_len; ++i) {
             ND_PRINT("%02x", sig[i]);
         }
 
         return (SIGNATURE_INVALID);
     }
 }
+
+/*
+ * Verify an HMAC-MD5 signature of the packet, as used by IS-IS (RFC 5304)
+ * and RSVP (RFC 2747), taking the signature and the ranges in zero to
+ * hold zeroes.
+ */
+int
+signature_verify(netdissect_options *ndo, const u_char *pptr, u_int plen,
+                 const u_char *sig_ptr, const struct signature_zero *zero,
+                 u_int nzero)
+{
+    return (signature_verify_hmac(ndo, SIGNATURE_HMAC_MD5, pptr, plen,
+                                  sig_ptr, NULL, zero, nzero));
+}
+
+/*
+ * Verify an HMAC-SHA signature of the packet, as used by IS-IS (RFC 5310)
+ * and OSPF (RFC 5709), taking the signature to hold Apad and the ranges
+ * in zero to hold zeroes.  The hash function is the one whose digest is
+ * sig_len bytes long.
+ */
+int
+signature_verify_sha(netdissect_options *ndo, const u_char *pptr, u_int plen,
+                     const u_char *sig_ptr, u_int sig_len,
+                     const struct signature_zero *zero, u_int nzero)
+{
+    uint8_t apad[SIGNATURE_MAX_DIGEST_LEN];
+    u_int hash, i;
+
+    for (hash = SIGNATURE_HMAC_SHA1; hash < SIGNATURE_NHASHES; hash++) {
+        if (signature_hashes[hash].digest_len == sig_len)
+            break;
+    }
+    if (hash == SIGNATURE_NHASHES)
+        return (CANT_CHECK_SIGNATURE);
+
+    /* Apad is 0x878FE1F3 repeated. */
+    for (i = 0; i < sig_len; i += 4) {
+        apad[i] = 0x87;
+        apad[i + 1] = 0x8f;
+        apad[i + 2] = 0xe1;
+        apad[i + 3] = 0xf3;
+    }
+    return (signature_verify_hmac(ndo, hash, pptr, plen, sig_ptr, apad,
+                                  zero, nzero));
+}
+
+void
+signature_free(netdissect_options *ndo)
+{
+    free(ndo->ndo_sig_keys);
+    ndo->ndo_sig_keys = NULL;
+}
 #else
 int
 signature_verify(netdissect_options *ndo _U_, const u_char *pptr _U_,
                  u_int plen _U_, const u_char *sig_ptr _U_,
-                 void (*clear_rtn)(void *) _U_, const void *clear_arg _U_)
+                 const struct signature_zero *zero _U_, u_int nzero _U_)
 {
     return (CANT_CHECK_SIGNATURE);
 }
+
+int
+signature_verify_sha(netdissect_options *ndo _U_, const u_char *pptr _U_,
+                     u_int plen _U_, const u_char *sig_ptr _U_,
+                     u_int sig_len _U_,
+                     const struct signature_zero *zero _U_, u_int nzero _U_)
+{
+    return (CANT_CHECK_SIGNATURE);
+}
+
+void
+signature_free(netdissect_options *ndo _U_)
+{
+}
 #endif
@@ -24,6 +24,22 @@
 #define CANT_ALLOCATE_COPY	2
 #define CANT_CHECK_SIGNATURE	3
 
+/*
+ * A field of the packet that is taken to be zero when computing the
+ * signature, such as a checksum.
+ */
+struct signature_zero {
+    const u_char *ptr;
+    u_int len;
+};
+
+#define SIGNATURE_MAX_ZERO	4
+
 extern const struct tok signature_check_values[];
 extern int signature_verify(netdissect_options *, const u_char *, u_int,
-                            const u_char *, void (*)(void *), const void *);
+                            const u_char *, const struct signature_zero *,
+                            u_int);
+extern int signature_verify_sha(netdissect_options *, const u_char *, u_int,
+                                const u_char *, u_int,
+                                const struct signature_zero *, u_int);
+extern void signature_free(netdissect_options *);
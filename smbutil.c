@@ -340,10 +340,11 @@ unistr(netdissect_options *ndo, char (*buf)[MAX_UNISTR_SIZE+1],
        const u_char *s, uint32_t strsize, int is_null_terminated,
        int use_unicode)
 {
-    u_int c;
-    size_t l = 0;
+    u_int avail, n, l;
+    u_char c;
     const u_char *sp;
 
+    (*buf)[0] = 0;
     if (use_unicode) {
 	/*
 	 * Skip padding that puts the string on an even boundary.
@@ -353,104 +354,79 @@ unistr(netdissect_options *ndo, char (*buf)[MAX_UNISTR_SIZE+1],
 	    s++;
 	}
     }
+    /*
+     * Look at all of the string that was captured at once, rather
+     * than a character at a time; if the string, or its terminating
+     * null, isn't all there, we longjmp out, as GET_U_1() or
+     * GET_LE_U_2() would.
+     */
+    avail = ND_BYTES_AVAILABLE_AFTER(s);
     if (is_null_terminated) {
 	/*
 	 * Null-terminated string.
-	 * Find the length, counting the terminating NUL.
+	 * Find the length, counting the terminating NUL, while
+	 * converting the string.
 	 */
-	strsize = 0;
-	sp = s;
 	if (!use_unicode) {
-	    for (;;) {
-		c = GET_U_1(sp);
-		sp++;
-		strsize++;
-		if (c == '\0')
-		    break;
-	    }
+	    sp = (const u_char *)memchr(s, '\0', avail);
+	    if (sp == NULL)
+		nd_trunc_longjmp(ndo);
+	    strsize = ND_BYTES_BETWEEN(s, sp) + 1;
 	} else {
-	    for (;;) {
-		c = GET_LE_U_2(sp);
-		sp += 2;
-		strsize += 2;
-		if (c == '\0')
-		    break;
-	    }
+	    n = nd_ucs2le_to_ascii(s, avail / 2, *buf, sizeof(*buf));
+	    if (n == avail / 2)
+		nd_trunc_longjmp(ndo);
+	    return s + 2 * (n + 1);
 	}
     }
     if (!use_unicode) {
-	while (strsize != 0) {
-	    c = GET_U_1(s);
-	    s++;
-	    strsize--;
-	    if (c == 0) {
-		/*
-		 * Even counted strings may have embedded null
-		 * terminators, so quit here, and skip past
-		 * the rest of the data.
-		 *
-		 * Make sure, however, that the rest of the data
-		 * is there, so we don't overflow the buffer when
-		 * skipping past it.
-		 */
-		ND_TCHECK_LEN(s, strsize);
-		s += strsize;
-		strsize = 0;
-		break;
-	    }
-	    if (l < MAX_UNISTR_SIZE) {
-		if (ND_ASCII_ISPRINT(c)) {
-		    /* It's a printable ASCII character */
-		    (*buf)[l] = (char)c;
-		} else {
-		    /* It's a non-ASCII character or a non-printable ASCII character */
-		    (*buf)[l] = '.';
-		}
-		l++;
-	    }
+	n = ND_MIN(strsize, avail);
+	sp = (const u_char *)memchr(s, '\0', n);
+	if (sp != NULL)
+	    n = ND_BYTES_BETWEEN(s, sp);
+	for (l = 0; l < n && l < MAX_UNISTR_SIZE; l++) {
+	    c = s[l];
+	    /* Non-ASCII and non-printable characters become '.' */
+	    (*buf)[l] = ND_ASCII_ISPRINT(c) ? (char)c : '.';
 	}
+	(*buf)[l] = 0;
+	if (sp == NULL) {
+	    if (n < strsize)
+		nd_trunc_longjmp(ndo);
+	    return s + strsize;
+	}
+	/* Skip past the null terminator. */
+	n++;
     } else {
-	while (strsize > 1) {
-	    c = GET_LE_U_2(s);
-	    s += 2;
-	    strsize -= 2;
-	    if (c == 0) {
-		/*
-		 * Even counted strings may have embedded null
-		 * terminators, so quit here, and skip past
-		 * the rest of the data.
-		 *
-		 * Make sure, however, that the rest of the data
-		 * is there, so we don't overflow the buffer when
-		 * skipping past it.
-		 */
-		ND_TCHECK_LEN(s, strsize);
-		s += strsize;
-		strsize = 0;
-		break;
-	    }
-	    if (l < MAX_UNISTR_SIZE) {
-		if (ND_ASCII_ISPRINT(c)) {
-		    /* It's a printable ASCII character */
-		    (*buf)[l] = (char)c;
-		} else {
-		    /* It's a non-ASCII character or a non-printable ASCII character */
-		    (*buf)[l] = '.';
-		}
-		l++;
+	n = nd_ucs2le_to_ascii(s, ND_MIN(strsize / 2, avail / 2), *buf,
+			       sizeof(*buf));
+	if (n == ND_MIN(strsize / 2, avail / 2)) {
+	    if (n < strsize / 2)
+		nd_trunc_longjmp(ndo);
+	    s += 2 * n;
+	    if (strsize % 2 == 1) {
+		/* We have half of a code point; skip past it */
+		ND_TCHECK_1(s);
+		s++;
 	    }
+	    return s;
 	}
-	if (strsize == 1) {
-	    /* We have half of a code point; skip past it */
-	    ND_TCHECK_1(s);
-	    s++;
-	}
+	/* Skip past the null terminator. */
+	n = 2 * (n + 1);
     }
-    (*buf)[l] = 0;
-    return s;
+    /*
+     * Even counted strings may have embedded null terminators, so
+     * quit here, and skip past the rest of the data.
+     *
+     * Make sure, however, that the rest of the data is there, so we
+     * don't overflow the buffer when skipping past it.
+     */
+    s += n;
+    strsize -= n;
+    ND_TCHECK_LEN(s, strsize);
+    return s + strsize;
 
 trunc:
-    (*buf)[l] = 0;
     return NULL;
 }
 
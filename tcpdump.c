@@ -148,6 +148,7 @@ The Regents of the University of California.  All rights reserved.\n";
 #include "interface.h"
 #include "addrtoname.h"
 #include "ascii_strcasecmp.h"
+#include "bpf_fast.h"
 
 #include "print.h"
 
@@ -214,8 +215,22 @@ static int timeout = 1000;		/* default timeout = 1000 ms = 1 s */
 static int immediate_mode;
 #endif
 static int count_mode;
+static netdissect_options *protocol_stats_ndo;	/* with --protocol-stats */
 static u_int packets_to_skip;
 
+/*
+ * Pre-trigger ring: with -w, keep the most recent packets in memory and
+ * write them out only when a trigger fires.
+ */
+static int64_t ring_size;		/* bytes of packets kept in memory */
+static int ring_seconds;		/* seconds of packets kept in memory */
+static int post_trigger_seconds;	/* seconds written after a trigger */
+static char *trigger_expr;		/* filter whose matches fire a trigger */
+static u_int trigger_count = 1;		/* matches within a second needed */
+static struct bpf_program trigger_fcode;
+static struct bpf_fast *fast_trigger_fcode;	/* for bpf_fast_filter(), or NULL */
+static volatile sig_atomic_t trigger_requested;	/* set by the signal */
+
 static int infodelay;
 static int infoprint;
 
@@ -237,6 +252,8 @@ static u_int parse_u_int(const char *argname, const char *string, char **endp,
     u_int minval, u_int maxval, int base);
 static int64_t parse_int64(const char *argname, const char *string,
     char **endp, int64_t minval, int64_t maxval, int base);
+static int64_t parse_size(const char *argname, const char *string,
+    int64_t maxval);
 static void (*setsignal (int sig, void (*func)(int)))(int);
 static void cleanup(int);
 #if defined(HAVE_FORK) || defined(HAVE_VFORK)
@@ -248,6 +265,11 @@ static void print_usage(FILE *);
 static void print_packet(u_char *, const struct pcap_pkthdr *, const u_char *);
 static void dump_packet_and_trunc(u_char *, const struct pcap_pkthdr *, const u_char *);
 static void dump_packet(u_char *, const struct pcap_pkthdr *, const u_char *);
+static void dump_packet_ring(u_char *, const struct pcap_pkthdr *, const u_char *);
+static void fast_filter_packet(u_char *, const struct pcap_pkthdr *, const u_char *);
+static void run_filter_bench(const struct bpf_program *, int);
+static int run_filter_check(const struct bpf_program *, int);
+static void ring_init(void);
 
 #ifdef SIGNAL_REQ_INFO
 static void requestinfo(int);
@@ -284,6 +306,19 @@ static const struct tok status_flags[] = {
 static pcap_t *pd;
 static pcap_dumper_t *pdd = NULL;
 
+/*
+ * When reading a savefile, the filter is run by bpf_fast_filter() rather
+ * than by libpcap if it can be; filtered_callback is then called on the
+ * packets that pass it.
+ */
+static struct bpf_fast *fast_fcode;
+static pcap_handler filtered_callback;
+static int filtered_left;		/* packets to pass the filter, or -1 */
+static int filtered_all;		/* all the packets for -c passed */
+static int filter_bench;		/* time the filter, for --filter-bench */
+static int filter_check;		/* compare the results, for --filter-check */
+static int no_fast_filter;		/* leave the filter to libpcap */
+
 static int supports_monitor_mode;
 
 extern int optind;
@@ -496,7 +531,7 @@ show_devices_and_exit(void)
 			printf(" (%s)", dev->description);
 		if (dev->flags != 0) {
 			printf(" [");
-			printf("%s", bittok2str(status_flags, "none", dev->flags));
+			printf("%s", (bittok2str)(status_flags, "none", dev->flags));
 #ifdef PCAP_IF_WIRELESS
 			if (dev->flags & PCAP_IF_WIRELESS) {
 				switch (dev->flags & PCAP_IF_CONNECTION_STATUS) {
@@ -573,7 +608,7 @@ show_remote_devices_and_exit(void)
 		if (dev->description != NULL)
 			printf(" (%s)", dev->description);
 		if (dev->flags != 0)
-			printf(" [%s]", bittok2str(status_flags, "none", dev->flags));
+			printf(" [%s]", (bittok2str)(status_flags, "none", dev->flags));
 		printf("\n");
 	}
 	pcap_freealldevs(devlist);
@@ -684,6 +719,26 @@ show_remote_devices_and_exit(void)
 #define OPTION_LENGTHS			138
 #define OPTION_TIME_T_SIZE		139
 #define OPTION_SKIP			140
+#define OPTION_RING_BUFFER		141
+#define OPTION_RING_SECONDS		142
+#define OPTION_TRIGGER			143
+#define OPTION_TRIGGER_COUNT		144
+#define OPTION_POST_TRIGGER		145
+#define OPTION_FLOW_SAMPLING		146
+#define OPTION_DECODE_DEPTH		147
+#define OPTION_PROTOCOL_STATS		148
+#define OPTION_RPC_XID_TABLE_SIZE	149
+#define OPTION_NFS_LATENCY		150
+#define OPTION_DNS_STATS		151
+#define OPTION_RX_CACHE_SIZE		152
+#define OPTION_BGP_PREFIX_COUNTS	153
+#define OPTION_FLOW_COLLECTOR		154
+#define OPTION_FLOW_REPORT_INTERVAL	155
+#define OPTION_FILTER_BENCH		156
+#define OPTION_OUTPUT_FORMAT		157
+#define OPTION_OVERLAY_STATS		158
+#define OPTION_FILTER_CHECK		159
+#define OPTION_NO_FAST_FILTER		160
 
 static const struct option longopts[] = {
 	{ "buffer-size", required_argument, NULL, 'B' },
@@ -724,10 +779,30 @@ static const struct option longopts[] = {
 	{ "number", no_argument, NULL, '#' },
 	{ "print", no_argument, NULL, OPTION_PRINT },
 	{ "print-sampling", required_argument, NULL, OPTION_PRINT_SAMPLING },
+	{ "flow-sampling", required_argument, NULL, OPTION_FLOW_SAMPLING },
+	{ "decode-depth", required_argument, NULL, OPTION_DECODE_DEPTH },
+	{ "protocol-stats", no_argument, NULL, OPTION_PROTOCOL_STATS },
+	{ "rpc-xid-table-size", required_argument, NULL, OPTION_RPC_XID_TABLE_SIZE },
+	{ "nfs-latency", no_argument, NULL, OPTION_NFS_LATENCY },
+	{ "dns-stats", no_argument, NULL, OPTION_DNS_STATS },
+	{ "rx-cache-size", required_argument, NULL, OPTION_RX_CACHE_SIZE },
+	{ "bgp-prefix-counts", no_argument, NULL, OPTION_BGP_PREFIX_COUNTS },
+	{ "flow-collector", required_argument, NULL, OPTION_FLOW_COLLECTOR },
+	{ "flow-report-interval", required_argument, NULL, OPTION_FLOW_REPORT_INTERVAL },
+	{ "filter-bench", no_argument, NULL, OPTION_FILTER_BENCH },
+	{ "filter-check", no_argument, NULL, OPTION_FILTER_CHECK },
+	{ "no-fast-filter", no_argument, NULL, OPTION_NO_FAST_FILTER },
+	{ "output-format", required_argument, NULL, OPTION_OUTPUT_FORMAT },
+	{ "overlay-stats", required_argument, NULL, OPTION_OVERLAY_STATS },
 	{ "lengths", no_argument, NULL, OPTION_LENGTHS },
 	{ "time-t-size", no_argument, NULL, OPTION_TIME_T_SIZE },
 	{ "ip-oneline", no_argument, NULL, 'g' },
 	{ "skip", required_argument, NULL, OPTION_SKIP },
+	{ "ring-buffer", required_argument, NULL, OPTION_RING_BUFFER },
+	{ "ring-seconds", required_argument, NULL, OPTION_RING_SECONDS },
+	{ "trigger", required_argument, NULL, OPTION_TRIGGER },
+	{ "trigger-count", required_argument, NULL, OPTION_TRIGGER_COUNT },
+	{ "post-trigger", required_argument, NULL, OPTION_POST_TRIGGER },
 	{ "version", no_argument, NULL, OPTION_VERSION },
 	{ NULL, 0, NULL, 0 }
 };
@@ -1454,7 +1529,6 @@ main(int argc, char **argv)
 	int cnt, op, i;
 	bpf_u_int32 localnet = 0, netmask = 0;
 	char *cp, *infile, *cmdbuf, *device, *RFileName, *VFileName, *WFileName;
-	char *endp;
 	pcap_handler callback;
 	int dlt;
 	const char *dlt_name;
@@ -1483,7 +1557,6 @@ main(int argc, char **argv)
 	int yflag_dlt = -1;
 	const char *yflag_dlt_name = NULL;
 	int print = 0;
-	long Cflagmult;
 
 	netdissect_options Ndo;
 	netdissect_options *ndo = &Ndo;
@@ -1718,77 +1791,11 @@ main(int argc, char **argv)
 			break;
 
 		case 'C':
-			Cflag = parse_int64("file size", optarg, &endp, 1,
-			    INT64_MAX, 10);
-
-			if (*endp == '\0') {
-				/*
-				 * There's nothing after the file size,
-				 * so the size is in units of 1 MB
-				 * (1,000,000 bytes).
-				 */
-				Cflagmult = 1000000;
-			} else {
-				/*
-				 * There's something after the file
-				 * size.
-				 *
-				 * If it's a single letter, then:
-				 *
-				 *   if the letter is k or K, the size
-				 *   is in units of 1 KiB (1024 bytes);
-				 *
-				 *   if the letter is m or M, the size
-				 *   is in units of 1 MiB (1,048,576 bytes);
-				 *
-				 *   if the letter is g or G, the size
-				 *   is in units of 1 GiB (1,073,741,824 bytes).
-				 *
-				 * Otherwise, it's an error.
-				 */
-				switch (*endp) {
-
-				case 'k':
-				case 'K':
-					Cflagmult = 1024;
-					break;
-
-				case 'm':
-				case 'M':
-					Cflagmult = 1024*1024;
-					break;
-
-				case 'g':
-				case 'G':
-					Cflagmult = 1024*1024*1024;
-					break;
-
-				default:
-					error("invalid file size %s (invalid units)", optarg);
-				}
-
-				/*
-				 * OK, there was a letter that we treat
-				 * as a units indication; was there
-				 * anything after it?
-				 */
-				endp++;
-				if (*endp != '\0') {
-					/* Yes - error */
-					error("invalid file size %s (invalid units)", optarg);
-				}
-			}
-
-			/*
-			 * Will multiplying it by multiplier overflow?
-			 */
 #ifdef HAVE_PCAP_DUMP_FTELL64
-			if (Cflag > INT64_MAX / Cflagmult)
+			Cflag = parse_size("file size", optarg, INT64_MAX);
 #else
-			if (Cflag > LONG_MAX / Cflagmult)
+			Cflag = parse_size("file size", optarg, LONG_MAX);
 #endif
-				error("file size %s is too large", optarg);
-			Cflag *= Cflagmult;
 			break;
 
 		case 'd':
@@ -2110,6 +2117,111 @@ main(int argc, char **argv)
 			++ndo->ndo_Sflag;
 			ndo->ndo_print_sampling = parse_int("print sampling",
 			    optarg, NULL, 1, INT_MAX, 10);
+			ndo->ndo_print_sampling_flows = 0;
+			break;
+
+		case OPTION_DECODE_DEPTH:
+			if (ascii_strcasecmp(optarg, "l2") == 0)
+				ndo->ndo_decode_depth = ND_DECODE_DEPTH_L2;
+			else if (ascii_strcasecmp(optarg, "l3") == 0)
+				ndo->ndo_decode_depth = ND_DECODE_DEPTH_L3;
+			else if (ascii_strcasecmp(optarg, "l4") == 0)
+				ndo->ndo_decode_depth = ND_DECODE_DEPTH_L4;
+			else if (ascii_strcasecmp(optarg, "tunnel") == 0)
+				ndo->ndo_decode_depth = ND_DECODE_DEPTH_TUNNEL;
+			else if (ascii_strcasecmp(optarg, "all") == 0)
+				ndo->ndo_decode_depth = ND_DECODE_DEPTH_ALL;
+			else
+				error("unknown decode depth '%s'", optarg);
+			break;
+
+		case OPTION_PROTOCOL_STATS:
+			protocol_stats_ndo = ndo;
+			break;
+
+		case OPTION_NFS_LATENCY:
+			ndo->ndo_nfs_latency = 1;
+			protocol_stats_ndo = ndo;
+			break;
+
+		case OPTION_DNS_STATS:
+			ndo->ndo_dns_stats = 1;
+			protocol_stats_ndo = ndo;
+			break;
+
+		case OPTION_RPC_XID_TABLE_SIZE:
+			ndo->ndo_rpc_xid_table_size = parse_u_int(
+			    "RPC XID table size", optarg, NULL, 1, 1 << 24, 0);
+			break;
+
+		case OPTION_RX_CACHE_SIZE:
+			ndo->ndo_rx_cache_size = parse_u_int(
+			    "RX call cache size", optarg, NULL, 1, 1 << 24, 0);
+			break;
+
+		case OPTION_BGP_PREFIX_COUNTS:
+			ndo->ndo_bgp_prefix_counts = 1;
+			break;
+
+		case OPTION_FLOW_COLLECTOR:
+			if (ascii_strcasecmp(optarg, "csv") == 0)
+				ndo->ndo_flow_collector = ND_FLOW_COLLECTOR_CSV;
+			else if (ascii_strcasecmp(optarg, "json") == 0)
+				ndo->ndo_flow_collector = ND_FLOW_COLLECTOR_JSON;
+			else
+				error("unknown flow collector format '%s'",
+				    optarg);
+			protocol_stats_ndo = ndo;
+			break;
+
+		case OPTION_FLOW_REPORT_INTERVAL:
+			ndo->ndo_flow_report_interval = parse_u_int(
+			    "flow report interval", optarg, NULL, 1, 86400, 0);
+			break;
+
+		case OPTION_FILTER_BENCH:
+			filter_bench = 1;
+			break;
+
+		case OPTION_FILTER_CHECK:
+			filter_check = 1;
+			break;
+
+		case OPTION_NO_FAST_FILTER:
+			no_fast_filter = 1;
+			break;
+
+		case OPTION_OUTPUT_FORMAT:
+			if (ascii_strcasecmp(optarg, "text") == 0)
+				ndo->ndo_output_format = ND_OUTPUT_TEXT;
+			else if (ascii_strcasecmp(optarg, "json") == 0)
+				ndo->ndo_output_format = ND_OUTPUT_JSON;
+			else if (ascii_strcasecmp(optarg, "csv") == 0)
+				ndo->ndo_output_format = ND_OUTPUT_CSV;
+			else
+				error("unknown output format '%s'", optarg);
+			break;
+
+		case OPTION_OVERLAY_STATS:
+			if (ascii_strcasecmp(optarg, "csv") == 0)
+				ndo->ndo_overlay_stats = ND_OVERLAY_STATS_CSV;
+			else if (ascii_strcasecmp(optarg, "json") == 0)
+				ndo->ndo_overlay_stats = ND_OVERLAY_STATS_JSON;
+			else
+				error("unknown overlay stats format '%s'",
+				    optarg);
+			protocol_stats_ndo = ndo;
+			break;
+
+		case OPTION_FLOW_SAMPLING:
+			/*
+			 * All the packets of a sampled flow are printed,
+			 * so relative TCP sequence numbers can be used.
+			 */
+			print = 1;
+			ndo->ndo_print_sampling = parse_int("flow sampling",
+			    optarg, NULL, 1, INT_MAX, 10);
+			ndo->ndo_print_sampling_flows = 1;
 			break;
 
 		case OPTION_SKIP:
@@ -2117,6 +2229,30 @@ main(int argc, char **argv)
 			    optarg, NULL, 0, INT_MAX, 0);
 			break;
 
+		case OPTION_RING_BUFFER:
+			ring_size = parse_size("ring buffer size", optarg,
+			    SIZE_MAX > INT64_MAX ? INT64_MAX : (int64_t)SIZE_MAX);
+			break;
+
+		case OPTION_RING_SECONDS:
+			ring_seconds = parse_int("ring buffer seconds", optarg,
+			    NULL, 1, INT_MAX, 10);
+			break;
+
+		case OPTION_TRIGGER:
+			trigger_expr = optarg;
+			break;
+
+		case OPTION_TRIGGER_COUNT:
+			trigger_count = parse_u_int("trigger count", optarg,
+			    NULL, 1, INT_MAX, 10);
+			break;
+
+		case OPTION_POST_TRIGGER:
+			post_trigger_seconds = parse_int("post-trigger seconds",
+			    optarg, NULL, 0, INT_MAX, 10);
+			break;
+
 #ifdef HAVE_PCAP_SET_TSTAMP_PRECISION
 		case OPTION_TSTAMP_MICRO:
 			ndo->ndo_tstamp_precision = PCAP_TSTAMP_PRECISION_MICRO;
@@ -2158,11 +2294,27 @@ main(int argc, char **argv)
 		error("-C cannot be used without -w.");
 	if (Gflag != 0 && WFileName == NULL)
 		error("-G cannot be used without -w.");
+	if (ring_seconds != 0 && ring_size == 0)
+		error("--ring-seconds cannot be used without --ring-buffer.");
+	if ((trigger_expr != NULL || post_trigger_seconds != 0) &&
+	    ring_size == 0)
+		error("--trigger and --post-trigger cannot be used without --ring-buffer.");
+	if (ring_size != 0) {
+		if (WFileName == NULL)
+			error("--ring-buffer cannot be used without -w.");
+		if (Cflag != 0 || Gflag != 0)
+			error("--ring-buffer cannot be used with -C or -G.");
+	}
 	if (count_mode && RFileName == NULL && VFileName == NULL)
 		error("--count cannot be used without -r or -V.");
+	if (filter_bench && RFileName == NULL)
+		error("--filter-bench cannot be used without -r.");
+	if (filter_check && RFileName == NULL)
+		error("--filter-check cannot be used without -r.");
 #if defined(HAVE_FORK) || defined(HAVE_VFORK)
-	if (zflag != NULL && (WFileName == NULL || (Cflag == 0 && Gflag == 0)))
-		error("-z cannot be used without -w and (-C or -G).");
+	if (zflag != NULL &&
+	    (WFileName == NULL || (Cflag == 0 && Gflag == 0 && ring_size == 0)))
+		error("-z cannot be used without -w and (-C, -G or --ring-buffer).");
 #endif
 
 	if (cnt != -1)
@@ -2199,6 +2351,21 @@ main(int argc, char **argv)
 	if (VFileName != NULL && RFileName != NULL)
 		error("-V and -r are mutually exclusive.");
 
+	if (ndo->ndo_overlay_stats && ndo->ndo_flow_collector)
+		error("--overlay-stats and --flow-collector are mutually exclusive.");
+
+	if (ndo->ndo_output_format != ND_OUTPUT_TEXT) {
+		if (ndo->ndo_flow_collector)
+			error("--output-format and --flow-collector are mutually exclusive.");
+		if (ndo->ndo_overlay_stats)
+			error("--output-format and --overlay-stats are mutually exclusive.");
+		/*
+		 * The fields have the addresses and ports as numbers;
+		 * looking up their names would be wasted.
+		 */
+		ndo->ndo_nflag = 1;
+	}
+
 	/*
 	 * If we're printing dissected packets to the standard output,
 	 * and either the standard output is a terminal or we're doing
@@ -2447,6 +2614,10 @@ DIAG_ON_WARN_UNUSED_RESULT
 	 */
 	if (pcap_compile(pd, &fcode, cmdbuf, Oflag, ntohl(netmask)) < 0)
 		error("%s", pcap_geterr(pd));
+	if (trigger_expr != NULL &&
+	    pcap_compile(pd, &trigger_fcode, trigger_expr, Oflag,
+	    ntohl(netmask)) < 0)
+		error("trigger: %s", pcap_geterr(pd));
 	if (dflag) {
 		bpf_dump(&fcode, dflag);
 		pcap_close(pd);
@@ -2454,6 +2625,25 @@ DIAG_ON_WARN_UNUSED_RESULT
 		pcap_freecode(&fcode);
 		exit_tcpdump(S_SUCCESS);
 	}
+	if (filter_bench) {
+		run_filter_bench(&fcode, cnt);
+		pcap_close(pd);
+		free(cmdbuf);
+		pcap_freecode(&fcode);
+		exit_tcpdump(S_SUCCESS);
+	}
+	if (filter_check) {
+		status = run_filter_check(&fcode, cnt);
+		pcap_close(pd);
+		free(cmdbuf);
+		pcap_freecode(&fcode);
+		exit_tcpdump(status);
+	}
+	if (RFileName != NULL && !no_fast_filter) {
+		fast_fcode = bpf_fast_compile(&fcode);
+		if (trigger_expr != NULL)
+			fast_trigger_fcode = bpf_fast_compile(&trigger_fcode);
+	}
 
 #ifdef HAVE_CASPER
 	if (!ndo->ndo_nflag)
@@ -2545,13 +2735,19 @@ DIAG_ON_ASSIGN_ENUM
 		}
 		capng_apply(CAPNG_SELECT_BOTH);
 #endif /* HAVE_LIBCAP_NG */
+		/*
+		 * The name databases are normally loaded on first use;
+		 * after chrooting, the files might not be reachable.
+		 */
+		if (chroot_dir)
+			load_addrtoname_tables(ndo);
 		if (username || chroot_dir)
 			droproot(username, chroot_dir);
 
 	}
 #endif /* _WIN32 */
 
-	if (pcap_setfilter(pd, &fcode) < 0)
+	if (fast_fcode == NULL && pcap_setfilter(pd, &fcode) < 0)
 		error("%s", pcap_geterr(pd));
 #ifdef HAVE_CAPSICUM
 	if (RFileName == NULL && VFileName == NULL && pcap_fileno(pd) != -1) {
@@ -2586,26 +2782,34 @@ DIAG_ON_ASSIGN_ENUM
 		else
 		  MakeFilename(dumpinfo.CurrentFileName, WFileName, 0, 0);
 
-		pdd = pcap_dump_open(pd, dumpinfo.CurrentFileName);
+		/*
+		 * With --ring-buffer, the file is only created when
+		 * a trigger fires.
+		 */
+		if (ring_size == 0)
+			pdd = pcap_dump_open(pd, dumpinfo.CurrentFileName);
 #ifdef HAVE_LIBCAP_NG
 		/* Give up CAP_DAC_OVERRIDE capability.
-		 * Only allow it to be restored if the -C or -G flag have been
-		 * set since we may need to create more files later on.
+		 * Only allow it to be restored if the -C, -G or --ring-buffer
+		 * flag have been set since we may need to create more files
+		 * later on.
 		 */
 		capng_update(
 			CAPNG_DROP,
-			(Cflag || Gflag ? 0 : CAPNG_PERMITTED)
+			(Cflag || Gflag || ring_size ? 0 : CAPNG_PERMITTED)
 				| CAPNG_EFFECTIVE,
 			CAP_DAC_OVERRIDE
 			);
 		capng_apply(CAPNG_SELECT_BOTH);
 #endif /* HAVE_LIBCAP_NG */
-		if (pdd == NULL)
-			error("%s", pcap_geterr(pd));
+		if (ring_size == 0) {
+			if (pdd == NULL)
+				error("%s", pcap_geterr(pd));
 #ifdef HAVE_CAPSICUM
-		set_dumper_capsicum_rights(pdd);
+			set_dumper_capsicum_rights(pdd);
 #endif
-		if (Cflag != 0 || Gflag != 0) {
+		}
+		if (Cflag != 0 || Gflag != 0 || ring_size != 0) {
 #ifdef HAVE_CAPSICUM
 			/*
 			 * basename() and dirname() may modify their input buffer
@@ -2658,7 +2862,11 @@ DIAG_ON_ASSIGN_ENUM
 #else	/* !HAVE_CAPSICUM */
 			dumpinfo.WFileName = WFileName;
 #endif
-			callback = dump_packet_and_trunc;
+			if (ring_size != 0) {
+				ring_init();
+				callback = dump_packet_ring;
+			} else
+				callback = dump_packet_and_trunc;
 			dumpinfo.pd = pd;
 			dumpinfo.pdd = pdd;
 			pcap_userdata = (u_char *)&dumpinfo;
@@ -2676,7 +2884,7 @@ DIAG_ON_ASSIGN_ENUM
 		} else
 			dumpinfo.ndo = NULL;
 
-		if (Uflag)
+		if (Uflag && pdd != NULL)
 			pcap_dump_flush(pdd);
 	} else {
 		dlt = pcap_datalink(pd);
@@ -2684,6 +2892,10 @@ DIAG_ON_ASSIGN_ENUM
 		callback = print_packet;
 		pcap_userdata = (u_char *)ndo;
 	}
+	if (fast_fcode != NULL) {
+		filtered_callback = callback;
+		callback = fast_filter_packet;
+	}
 
 #ifdef SIGNAL_REQ_INFO
 	/*
@@ -2769,14 +2981,29 @@ DIAG_ON_ASSIGN_ENUM
 	cansandbox = (cansandbox && (pcap_fileno(pd) != -1 ||
 	    RFileName != NULL));
 
+	if (cansandbox)
+		load_addrtoname_tables(ndo);
 	if (cansandbox && cap_enter() < 0 && errno != ENOSYS)
 		error("unable to enter the capability mode");
 #endif	/* HAVE_CAPSICUM */
 
 	do {
-		status = pcap_loop(pd,
-				   (cnt == -1 ? -1 : cnt + (int)packets_to_skip),
-				   callback, pcap_userdata);
+		if (fast_fcode != NULL) {
+			/*
+			 * pcap_loop() would count the packets passed to
+			 * the callback, i.e. those that pass the filter;
+			 * fast_filter_packet() counts them instead.
+			 */
+			filtered_left = (cnt == -1 ? -1 :
+			    cnt + (int)packets_to_skip);
+			filtered_all = 0;
+			status = pcap_loop(pd, -1, callback, pcap_userdata);
+			if (status == -2 && filtered_all)
+				status = 0;
+		} else
+			status = pcap_loop(pd,
+					   (cnt == -1 ? -1 : cnt + (int)packets_to_skip),
+					   callback, pcap_userdata);
 		if (WFileName == NULL) {
 			/*
 			 * We're printing packets.  Flush the printed output,
@@ -2871,12 +3098,24 @@ DIAG_ON_ASSIGN_ENUM
 					 */
 					if (pcap_compile(pd, &fcode, cmdbuf, Oflag, ntohl(netmask)) < 0)
 						error("%s", pcap_geterr(pd));
+					/*
+					 * If we were running the filter
+					 * ourselves and can't run this
+					 * one, leave it to libpcap.
+					 */
+					if (fast_fcode != NULL) {
+						bpf_fast_free(fast_fcode);
+						fast_fcode = bpf_fast_compile(&fcode);
+						if (fast_fcode == NULL)
+							callback = filtered_callback;
+					}
 				}
 
 				/*
 				 * Set the filter on the new file.
 				 */
-				if (pcap_setfilter(pd, &fcode) < 0)
+				if (fast_fcode == NULL &&
+				    pcap_setfilter(pd, &fcode) < 0)
 					error("%s", pcap_geterr(pd));
 
 				/*
@@ -2901,8 +3140,12 @@ DIAG_ON_ASSIGN_ENUM
 		fprintf(stdout, "%u packet%s\n", packets_captured,
 			PLURAL_SUFFIX(packets_captured));
 
+	if (protocol_stats_ndo != NULL)
+		print_protocol_stats(ndo);
+
 	free(cmdbuf);
 	pcap_freecode(&fcode);
+	bpf_fast_free(fast_fcode);
 	exit_tcpdump(status == -1 ? S_ERR_HOST_PROGRAM : S_SUCCESS);
 }
 
@@ -3034,6 +3277,82 @@ parse_int64(const char *argname, const char *string, char **endpp,
 	return ((int64_t)val);
 }
 
+/*
+ * Parse a size argument such as the -C file size: a plain number is in
+ * units of 1 MB (1,000,000 bytes), a number followed by k, m or g (or
+ * K, M or G) is in units of 1 KiB, 1 MiB or 1 GiB.
+ */
+static int64_t
+parse_size(const char *argname, const char *string, int64_t maxval)
+{
+	int64_t val, mult;
+	char *endp;
+
+	val = parse_int64(argname, string, &endp, 1, INT64_MAX, 10);
+
+	if (*endp == '\0') {
+		/*
+		 * There's nothing after the size, so the size is in
+		 * units of 1 MB (1,000,000 bytes).
+		 */
+		mult = 1000000;
+	} else {
+		/*
+		 * There's something after the size.
+		 *
+		 * If it's a single letter, then:
+		 *
+		 *   if the letter is k or K, the size
+		 *   is in units of 1 KiB (1024 bytes);
+		 *
+		 *   if the letter is m or M, the size
+		 *   is in units of 1 MiB (1,048,576 bytes);
+		 *
+		 *   if the letter is g or G, the size
+		 *   is in units of 1 GiB (1,073,741,824 bytes).
+		 *
+		 * Otherwise, it's an error.
+		 */
+		switch (*endp) {
+
+		case 'k':
+		case 'K':
+			mult = 1024;
+			break;
+
+		case 'm':
+		case 'M':
+			mult = 1024*1024;
+			break;
+
+		case 'g':
+		case 'G':
+			mult = 1024*1024*1024;
+			break;
+
+		default:
+			error("invalid %s %s (invalid units)", argname, string);
+		}
+
+		/*
+		 * OK, there was a letter that we treat as a units
+		 * indication; was there anything after it?
+		 */
+		endp++;
+		if (*endp != '\0') {
+			/* Yes - error */
+			error("invalid %s %s (invalid units)", argname, string);
+		}
+	}
+
+	/*
+	 * Will multiplying it by multiplier overflow?
+	 */
+	if (val > maxval / mult)
+		error("%s %s is too large", argname, string);
+	return val * mult;
+}
+
 /*
  * Catch a signal.
  */
@@ -3118,6 +3437,12 @@ info(int verbose)
 {
 	struct pcap_stat stats;
 
+	/* On request, report what the printers have gathered so far. */
+	if (!verbose && protocol_stats_ndo != NULL) {
+		print_protocol_stats(protocol_stats_ndo);
+		(void)fflush(stdout);
+	}
+
 	/*
 	 * Older versions of libpcap didn't set ps_ifdrop on some
 	 * platforms; initialize it to 0 to handle that.
@@ -3414,6 +3739,422 @@ dump_packet(u_char *user, const struct pcap_pkthdr *h, const u_char *sp)
 		info(0);
 }
 
+/*
+ * The pre-trigger ring is a single buffer of ring_size bytes holding
+ * records made of a struct ring_hdr followed by the packet data, from
+ * the oldest at ring_head to the newest ending at ring_tail.  When a
+ * record doesn't fit before the end of the buffer, a record with a zero
+ * length (or the lack of room for a header) marks the wrap to the
+ * beginning.  The oldest records are dropped to make room for new ones,
+ * and, with --ring-seconds, when they get too old.
+ */
+struct ring_hdr {
+	size_t len;			/* record length, including this */
+	struct pcap_pkthdr h;
+};
+
+#define RING_ALIGN(x)	(((x) + sizeof(void *) - 1) & ~(sizeof(void *) - 1))
+
+static u_char *ring_buf;
+static size_t ring_head, ring_tail;
+static u_int ring_count;
+static int trigger_file_count;
+static time_t trigger_window_start;
+static u_int trigger_window_hits;
+static time_t post_trigger_end;
+
+static void
+ring_init(void)
+{
+	ring_buf = (u_char *)malloc((size_t)ring_size);
+	if (ring_buf == NULL)
+		error("%s: can't allocate %" PRId64 " bytes for the ring buffer",
+		    __func__, ring_size);
+}
+
+/* Header of the record at *offp, following a wrap marker if needed. */
+static struct ring_hdr *
+ring_record(size_t *offp)
+{
+	struct ring_hdr *rh;
+
+	if ((size_t)ring_size - *offp < sizeof(struct ring_hdr))
+		*offp = 0;
+	rh = (struct ring_hdr *)(ring_buf + *offp);
+	if (rh->len == 0) {
+		*offp = 0;
+		rh = (struct ring_hdr *)ring_buf;
+	}
+	return rh;
+}
+
+static void
+ring_drop_oldest(void)
+{
+	struct ring_hdr *rh;
+
+	rh = ring_record(&ring_head);
+	ring_head += rh->len;
+	if (--ring_count == 0)
+		ring_head = ring_tail = 0;
+}
+
+static void
+ring_add(const struct pcap_pkthdr *h, const u_char *sp)
+{
+	size_t len = RING_ALIGN(sizeof(struct ring_hdr) + h->caplen);
+	struct ring_hdr *rh;
+	size_t off;
+
+	if (len > (size_t)ring_size)
+		return;		/* can never fit */
+	for (;;) {
+		if (ring_count == 0 || ring_tail > ring_head) {
+			/* Free space at the end and before the head. */
+			if ((size_t)ring_size - ring_tail >= len) {
+				off = ring_tail;
+				break;
+			}
+			if (ring_count == 0 || ring_head >= len) {
+				if ((size_t)ring_size - ring_tail >=
+				    sizeof(struct ring_hdr))
+					((struct ring_hdr *)(ring_buf + ring_tail))->len = 0;
+				off = 0;
+				break;
+			}
+		} else {
+			/* Free space between the tail and the head. */
+			if (ring_head - ring_tail >= len) {
+				off = ring_tail;
+				break;
+			}
+		}
+		ring_drop_oldest();
+	}
+	rh = (struct ring_hdr *)(ring_buf + off);
+	rh->len = len;
+	rh->h = *h;
+	memcpy(rh + 1, sp, h->caplen);
+	ring_tail = off + len;
+	ring_count++;
+
+	if (ring_seconds != 0) {
+		while (ring_count > 1) {
+			off = ring_head;
+			rh = ring_record(&off);
+			if (h->ts.tv_sec - rh->h.ts.tv_sec < ring_seconds)
+				break;
+			ring_drop_oldest();
+		}
+	}
+}
+
+/* Write the ring contents, oldest first, and empty it. */
+static void
+ring_flush(struct dump_info *dump_info)
+{
+	struct ring_hdr *rh;
+
+	while (ring_count != 0) {
+		rh = ring_record(&ring_head);
+		pcap_dump((u_char *)dump_info->pdd, &rh->h, (u_char *)(rh + 1));
+		ring_drop_oldest();
+	}
+}
+
+/*
+ * Has a trigger fired?  The trigger filter fires when it has matched
+ * trigger_count packets within the same second, so that it can detect
+ * e.g. a burst of TCP resets.
+ */
+static int
+trigger_fired(const struct pcap_pkthdr *h, const u_char *sp)
+{
+	if (trigger_requested) {
+		trigger_requested = 0;
+		return 1;
+	}
+	if (trigger_expr == NULL)
+		return 0;
+	if (fast_trigger_fcode != NULL) {
+		if (bpf_fast_filter(fast_trigger_fcode, sp, h->len,
+		    h->caplen) == 0)
+			return 0;
+	} else if (pcap_offline_filter(&trigger_fcode, h, sp) == 0)
+		return 0;
+	if (h->ts.tv_sec != trigger_window_start) {
+		trigger_window_start = h->ts.tv_sec;
+		trigger_window_hits = 0;
+	}
+	if (++trigger_window_hits < trigger_count)
+		return 0;
+	trigger_window_hits = 0;
+	return 1;
+}
+
+static void
+dump_packet_ring(u_char *user, const struct pcap_pkthdr *h, const u_char *sp)
+{
+	struct dump_info *dump_info;
+
+	++packets_captured;
+
+	++infodelay;
+
+	dump_info = (struct dump_info *)user;
+
+	if (packets_captured <= packets_to_skip)
+		return;
+
+	if (trigger_fired(h, sp)) {
+		post_trigger_end = h->ts.tv_sec + post_trigger_seconds;
+		if (dump_info->pdd == NULL) {
+			/*
+			 * Each trigger gets its own file, numbered as
+			 * with -C and recycled as with -C and -W.
+			 */
+			MakeFilename(dump_info->CurrentFileName,
+			    dump_info->WFileName, trigger_file_count,
+			    WflagChars);
+			if (++trigger_file_count == Wflag)
+				trigger_file_count = 0;
+			open_new_dump_file(dump_info);
+			ring_flush(dump_info);
+		}
+	}
+
+	if (dump_info->pdd != NULL) {
+		pcap_dump((u_char *)dump_info->pdd, h, sp);
+		if (Uflag)
+			pcap_dump_flush(dump_info->pdd);
+		if (h->ts.tv_sec >= post_trigger_end) {
+			/* End of the post-trigger window. */
+			close_old_dump_file(dump_info);
+			dump_info->pdd = NULL;
+		}
+	} else
+		ring_add(h, sp);
+
+	if (dump_info->ndo != NULL)
+		pretty_print_packet(dump_info->ndo, h, sp, packets_captured);
+
+	--infodelay;
+	if (infoprint)
+		info(0);
+}
+
+static void
+fast_filter_packet(u_char *user, const struct pcap_pkthdr *h, const u_char *sp)
+{
+	if (bpf_fast_filter(fast_fcode, sp, h->len, h->caplen) == 0)
+		return;
+	(*filtered_callback)(user, h, sp);
+	if (filtered_left > 0 && --filtered_left == 0) {
+		filtered_all = 1;
+		pcap_breakloop(pd);
+	}
+}
+
+/*
+ * --filter-bench: read the savefile a batch at a time, and time the
+ * filter on each batch with libpcap and with bpf_fast_filter().  Each
+ * batch is run through the filter enough times for the timing not to
+ * be just noise.
+ */
+#define FILTER_BENCH_BATCH	65536	/* packets in a batch */
+#define FILTER_BENCH_EVALS	1048576	/* evaluations timed per batch */
+
+struct filter_bench_batch {
+	struct pcap_pkthdr hdrs[FILTER_BENCH_BATCH];
+	size_t offsets[FILTER_BENCH_BATCH];
+	u_int count;
+	u_char *buf;
+	size_t buflen;
+	size_t bufsize;
+};
+
+static void
+filter_bench_packet(u_char *user, const struct pcap_pkthdr *h,
+    const u_char *sp)
+{
+	struct filter_bench_batch *b = (struct filter_bench_batch *)user;
+
+	if (b->buflen + h->caplen > b->bufsize) {
+		do
+			b->bufsize = b->bufsize == 0 ? 1048576 : 2 * b->bufsize;
+		while (b->buflen + h->caplen > b->bufsize);
+		b->buf = (u_char *)realloc(b->buf, b->bufsize);
+		if (b->buf == NULL)
+			error("%s: realloc", __func__);
+	}
+	b->hdrs[b->count] = *h;
+	b->offsets[b->count] = b->buflen;
+	memcpy(b->buf + b->buflen, sp, h->caplen);
+	b->buflen += h->caplen;
+	b->count++;
+}
+
+static uint64_t
+filter_bench_now(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER count, freq;
+
+	QueryPerformanceCounter(&count);
+	QueryPerformanceFrequency(&freq);
+	return (uint64_t)((double)count.QuadPart * 1e9 /
+	    (double)freq.QuadPart);
+#else
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static void
+run_filter_bench(const struct bpf_program *fcode, int max_packets)
+{
+	struct filter_bench_batch *b;
+	struct bpf_fast *prog;
+	uint64_t packets = 0, evals = 0, matched = 0, differ = 0;
+	uint64_t pcap_ns = 0, fast_ns = 0, start;
+	u_int n, rounds, r, i, m;
+	int status;
+
+	b = (struct filter_bench_batch *)calloc(1, sizeof(*b));
+	if (b == NULL)
+		error("%s: calloc", __func__);
+	prog = bpf_fast_compile(fcode);
+	do {
+		b->count = 0;
+		b->buflen = 0;
+		n = FILTER_BENCH_BATCH;
+		if (max_packets != -1 && (uint64_t)max_packets - packets < n)
+			n = (u_int)((uint64_t)max_packets - packets);
+		if (n == 0)
+			break;
+		status = pcap_loop(pd, (int)n, filter_bench_packet,
+		    (u_char *)b);
+		if (status == -1)
+			error("%s", pcap_geterr(pd));
+		if (b->count == 0)
+			break;
+		packets += b->count;
+
+		rounds = (FILTER_BENCH_EVALS + b->count - 1) / b->count;
+		evals += (uint64_t)rounds * b->count;
+		m = 0;
+		start = filter_bench_now();
+		for (r = 0; r < rounds; r++)
+			for (i = 0; i < b->count; i++)
+				m += pcap_offline_filter(fcode, &b->hdrs[i],
+				    b->buf + b->offsets[i]) != 0;
+		pcap_ns += filter_bench_now() - start;
+		matched += m / rounds;
+		if (prog == NULL)
+			continue;
+		m = 0;
+		start = filter_bench_now();
+		for (r = 0; r < rounds; r++)
+			for (i = 0; i < b->count; i++)
+				m += bpf_fast_filter(prog,
+				    b->buf + b->offsets[i], b->hdrs[i].len,
+				    b->hdrs[i].caplen) != 0;
+		fast_ns += filter_bench_now() - start;
+
+		/* The two had better agree. */
+		for (i = 0; i < b->count; i++)
+			if ((pcap_offline_filter(fcode, &b->hdrs[i],
+			    b->buf + b->offsets[i]) != 0) !=
+			    (bpf_fast_filter(prog, b->buf + b->offsets[i],
+			    b->hdrs[i].len, b->hdrs[i].caplen) != 0))
+				differ++;
+	} while (status != -2 && b->count == n);
+
+	printf("%u instructions, %" PRIu64 " packets, %" PRIu64 " matched\n",
+	    fcode->bf_len, packets, matched);
+	if (evals != 0)
+		printf("libpcap: %.1f ns/packet\n",
+		    (double)pcap_ns / (double)evals);
+	if (prog == NULL)
+		printf("tcpdump: not used, the program is left to libpcap\n");
+	else if (evals != 0) {
+		printf("tcpdump: %.1f ns/packet", (double)fast_ns / (double)evals);
+		if (fast_ns != 0)
+			printf(", %.2f times as fast",
+			    (double)pcap_ns / (double)fast_ns);
+		printf("\n");
+		if (differ != 0)
+			printf("%" PRIu64 " packets filtered differently\n",
+			    differ);
+	}
+	bpf_fast_free(prog);
+	free(b->buf);
+	free(b);
+}
+
+/*
+ * --filter-check: run the filter on each packet of the savefile with
+ * libpcap and with bpf_fast_filter(), and report the packets on which
+ * they disagree.  Unlike --filter-bench, the output doesn't depend on
+ * the machine, so the test suite can use it.
+ */
+struct filter_check {
+	const struct bpf_program *fcode;
+	struct bpf_fast *prog;
+	uint64_t packets;
+	uint64_t matched;
+	uint64_t differ;
+};
+
+static void
+filter_check_packet(u_char *user, const struct pcap_pkthdr *h,
+    const u_char *sp)
+{
+	struct filter_check *fc = (struct filter_check *)user;
+	int pcap_match, fast_match;
+
+	fc->packets++;
+	pcap_match = pcap_offline_filter(fc->fcode, h, sp) != 0;
+	fast_match = bpf_fast_filter(fc->prog, sp, h->len, h->caplen) != 0;
+	fc->matched += pcap_match;
+	if (pcap_match != fast_match) {
+		fc->differ++;
+		printf("packet %" PRIu64 ": libpcap %s, tcpdump %s\n",
+		    fc->packets, pcap_match ? "matches" : "doesn't match",
+		    fast_match ? "matches" : "doesn't match");
+	}
+}
+
+static int
+run_filter_check(const struct bpf_program *fcode, int max_packets)
+{
+	struct filter_check fc;
+	int status;
+
+	memset(&fc, 0, sizeof(fc));
+	fc.fcode = fcode;
+	fc.prog = bpf_fast_compile(fcode);
+	if (fc.prog == NULL) {
+		printf("not checked, the program is left to libpcap\n");
+		return S_SUCCESS;
+	}
+	status = pcap_loop(pd, max_packets, filter_check_packet,
+	    (u_char *)&fc);
+	bpf_fast_free(fc.prog);
+
+	/* Report the packets read before any error. */
+	printf("%" PRIu64 " packets, %" PRIu64 " matched\n",
+	    fc.packets, fc.matched);
+	if (fc.differ != 0)
+		printf("%" PRIu64 " packets filtered differently\n",
+		    fc.differ);
+	if (status == -1)
+		error("%s", pcap_geterr(pd));
+	return fc.differ != 0 ? S_ERR_HOST_PROGRAM : S_SUCCESS;
+}
+
 static void
 print_packet(u_char *user, const struct pcap_pkthdr *h, const u_char *sp)
 {
@@ -3444,7 +4185,13 @@ requestinfo(int signo _U_)
 static void
 flushpcap(int signo _U_)
 {
-	if (pdd != NULL)
+	/*
+	 * With --ring-buffer, this signal is a trigger; it's acted on
+	 * when the next packet arrives.
+	 */
+	if (ring_size != 0)
+		trigger_requested = 1;
+	else if (pdd != NULL)
 		pcap_dump_flush(pdd);
 }
 #endif
@@ -3514,9 +4261,17 @@ print_usage(FILE *f)
 "Usage: %s [-AbdDefghHI" J_FLAG "KlLnNOpqStuUvxX#] [ -B size ] [ -c count ] [--count]\n",
 	    executable_name);
 	(void)fprintf(f,
-"\t\t[ -C file_size ] " E_FLAG_USAGE "[ -F file ] [ -G seconds ]\n");
+"\t\t[ --bgp-prefix-counts ] [ -C file_size ]\n");
+	(void)fprintf(f,
+"\t\t[ --decode-depth l2|l3|l4|tunnel|all ] [ --dns-stats ]\n");
 	(void)fprintf(f,
-"\t\t[ -i interface ]" IMMEDIATE_MODE_USAGE j_FLAG_USAGE "\n");
+"\t\t" E_FLAG_USAGE "[ -F file ] [ --filter-bench ]\n");
+	(void)fprintf(f,
+"\t\t[ --filter-check ] [ --flow-collector csv|json ]\n");
+	(void)fprintf(f,
+"\t\t[ --flow-report-interval seconds ] [ --flow-sampling nth ]\n");
+	(void)fprintf(f,
+"\t\t[ -G seconds ] [ -i interface ]" IMMEDIATE_MODE_USAGE j_FLAG_USAGE "\n");
 	(void)fprintf(f,
 "\t\t[ --lengths ]" LIST_REMOTE_INTERFACES_USAGE "\n");
 #ifdef USE_LIBSMI
@@ -3524,11 +4279,23 @@ print_usage(FILE *f)
 "\t\t" m_FLAG_USAGE "\n");
 #endif
 	(void)fprintf(f,
-"\t\t" M_FLAG_USAGE "[ --number ] [ --print ]\n");
+"\t\t" M_FLAG_USAGE "[ --nfs-latency ] [ --no-fast-filter ] [ --number ]\n");
+	(void)fprintf(f,
+"\t\t[ --output-format text|json|csv ] [ --overlay-stats csv|json ]\n");
+	(void)fprintf(f,
+"\t\t[ --print ]\n");
+	(void)fprintf(f,
+"\t\t[ --print-sampling nth ] [ --protocol-stats ] [ -Q in|out|inout ]\n");
+	(void)fprintf(f,
+"\t\t[ -r file ] [ --rpc-xid-table-size size ] [ --rx-cache-size size ]\n");
+	(void)fprintf(f,
+"\t\t[ --ring-buffer size ] [ --ring-seconds seconds ]\n");
+	(void)fprintf(f,
+"\t\t[ -s snaplen ] [ --skip count ] [ -T type ]\n");
 	(void)fprintf(f,
-"\t\t[ --print-sampling nth ] [ -Q in|out|inout ] [ -r file ]\n");
+"\t\t[ --trigger expression ] [ --trigger-count count ]\n");
 	(void)fprintf(f,
-"\t\t[ -s snaplen ] [ --skip count ] [ -T type ] [ --version ]\n");
+"\t\t[ --post-trigger seconds ] [ --version ]\n");
 	(void)fprintf(f,
 "\t\t[ -V file ] [ -w file ] [ -W filecount ] [ -y datalinktype ]\n");
 #ifdef HAVE_PCAP_SET_TSTAMP_PRECISION
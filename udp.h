@@ -152,6 +152,9 @@ struct udphdr {
 #ifndef HSRP_PORT
 #define HSRP_PORT			1985	/*XXX*/
 #endif
+#ifndef NETFLOW_PORT
+#define NETFLOW_PORT			2055	/* customary, not assigned */
+#endif
 #ifndef ZEPHYR_SRV_PORT
 #define ZEPHYR_SRV_PORT			2103	/*XXX*/
 #endif
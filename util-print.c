@@ -41,11 +41,13 @@
 
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "netdissect-ctype.h"
 
 #include "netdissect.h"
+#include "netdissect-alloc.h"
 #include "extract.h"
 #include "ascii_strcasecmp.h"
 #include "timeval-operations.h"
@@ -72,6 +74,28 @@ fn_print_char(netdissect_options *ndo, u_char c)
 	ND_PRINT("%c", c);
 }
 
+/*
+ * Put what fn_print_char() prints for c in buf, which must have room
+ * for FN_CHAR_MAXLEN characters, and return its length.
+ */
+u_int
+fn_format_char(char *buf, u_char c)
+{
+	u_int len = 0;
+
+	if (!ND_ISASCII(c)) {
+		c = ND_TOASCII(c);
+		buf[len++] = 'M';
+		buf[len++] = '-';
+	}
+	if (!ND_ASCII_ISPRINT(c)) {
+		c ^= 0x40;	/* DEL to ?, others to alpha */
+		buf[len++] = '^';
+	}
+	buf[len++] = (char)c;
+	return len;
+}
+
 /*
  * Print a null-terminated string, filtering out non-printable characters.
  * DON'T USE IT with a pointer on the packet buffer because there is no
@@ -202,6 +226,65 @@ nd_printjnp(netdissect_options *ndo, const u_char *s, u_int n)
 	}
 }
 
+/*
+ * Code unit masks for nd_ucs2le_to_ascii(): four little-endian UCS-2
+ * code units, in a 64-bit word, are all printable ASCII if none has
+ * a bit above 0x7F set, adding 0x60 to each sets its 0x80 bit (it's
+ * at least 0x20) and adding 0x01 to each doesn't (it's not 0x7F).
+ */
+#define UCS2_NOT_ASCII	0xFF80FF80FF80FF80ULL
+#define UCS2_BIT_7	0x0080008000800080ULL
+#define UCS2_PLUS_60	0x0060006000600060ULL
+#define UCS2_PLUS_01	0x0001000100010001ULL
+
+/*
+ * Convert n UCS-2LE code units at s, which must all be in the captured
+ * data, into ASCII in buf, stopping at a null code unit.  Printable
+ * ASCII characters are copied and any other code unit becomes a '.'.
+ * At most bufsize - 1 characters are put in buf, which is always
+ * null-terminated.
+ * Return the number of code units before the null, or n if there's no
+ * null.
+ */
+u_int
+nd_ucs2le_to_ascii(const u_char *s, u_int n, char *buf, size_t bufsize)
+{
+	size_t l = 0, max = bufsize - 1;
+	uint64_t w;
+	u_int c, i = 0;
+
+	while (i < n) {
+		if (n - i >= 4) {
+			w = EXTRACT_LE_U_8(s + 2 * i);
+			if ((w & UCS2_NOT_ASCII) == 0 &&
+			    ((w + UCS2_PLUS_60) & UCS2_BIT_7) == UCS2_BIT_7 &&
+			    ((w + UCS2_PLUS_01) & UCS2_BIT_7) == 0) {
+				/* Four printable characters. */
+				if (max - l >= 4) {
+					buf[l] = (char)w;
+					buf[l + 1] = (char)(w >> 16);
+					buf[l + 2] = (char)(w >> 32);
+					buf[l + 3] = (char)(w >> 48);
+					l += 4;
+				} else {
+					for (; l < max; w >>= 16)
+						buf[l++] = (char)w;
+				}
+				i += 4;
+				continue;
+			}
+		}
+		c = EXTRACT_LE_U_2(s + 2 * i);
+		if (c == 0)
+			break;
+		if (l < max)
+			buf[l++] = ND_ASCII_ISPRINT(c) ? (char)c : '.';
+		i++;
+	}
+	buf[l] = '\0';
+	return i;
+}
+
 /*
  * Print the timestamp .FRAC part (Microseconds/nanoseconds)
  */
@@ -307,7 +390,6 @@ void
 ts_print(netdissect_options *ndo,
          const struct timeval *tvp)
 {
-	static struct timeval tv_ref;
 	struct timeval tv_result;
 	int negative_offset;
 	int nano_prec;
@@ -344,21 +426,23 @@ ts_print(netdissect_options *ndo,
 #else
 		nano_prec = 0;
 #endif
-		if (!(netdissect_timevalisset(&tv_ref)))
-			tv_ref = *tvp; /* set timestamp for first packet */
+		if (!(netdissect_timevalisset(&ndo->ndo_ts_ref)))
+			ndo->ndo_ts_ref = *tvp; /* set timestamp for first packet */
 
-		negative_offset = netdissect_timevalcmp(tvp, &tv_ref, <);
+		negative_offset = netdissect_timevalcmp(tvp, &ndo->ndo_ts_ref, <);
 		if (negative_offset)
-			netdissect_timevalsub(&tv_ref, tvp, &tv_result, nano_prec);
+			netdissect_timevalsub(&ndo->ndo_ts_ref, tvp, &tv_result,
+			    nano_prec);
 		else
-			netdissect_timevalsub(tvp, &tv_ref, &tv_result, nano_prec);
+			netdissect_timevalsub(tvp, &ndo->ndo_ts_ref, &tv_result,
+			    nano_prec);
 
 		ND_PRINT((negative_offset ? "-" : " "));
 		ts_date_hmsfrac_print(ndo, &tv_result, WITHOUT_DATE, UTC_TIME);
 		ND_PRINT(" ");
 
                 if (ndo->ndo_tflag == 3)
-			tv_ref = *tvp; /* set timestamp for previous packet */
+			ndo->ndo_ts_ref = *tvp; /* set timestamp for previous packet */
 		break;
 
 	case 4: /* Date + Default */
@@ -514,18 +598,274 @@ print_unknown_data(netdissect_options *ndo, const u_char *cp,
 	return(1); /* everything is ok */
 }
 
+/*
+ * Token tables are scanned linearly up to TOK_INDEX_MIN entries, or
+ * TOK_BITS_INDEX_MIN for bittok2str(); the first time a longer table is
+ * looked up, an index of it is built, and kept in a hash table keyed on
+ * the address of the table, which is expected to be constant.  If
+ * memory runs out, the table is scanned.
+ */
+#define TOK_INDEX_MIN		8
+#define TOK_BITS_INDEX_MIN	16
+#define TOK_BITS_MAX_WORDS	4	/* longer tables are scanned */
+
+struct tok_index {
+	const struct tok *table;
+	u_int ntoks;
+
+	/*
+	 * For tok2str(): either a dense array of the strings for the
+	 * values from min to min + range - 1, or, if the values are too
+	 * spread out, an open addressing hash table of the first token
+	 * of each value.
+	 */
+	int values_built;
+	u_int min;
+	u_int range;			/* 0 if the tokens are hashed */
+	const char **dense;
+	struct tok *hashed;		/* NULL strings for empty slots */
+	u_int hash_shift;		/* 32 - log2 of the size */
+
+	/*
+	 * For bittok2str(): for each bit, a bitmap of the positions in
+	 * the table of the tokens of that single bit, in nwords 64-bit
+	 * words, and the positions of the tokens of several bits.
+	 */
+	int bits_built;
+	u_int nwords;
+	uint64_t *bit_toks;		/* 32 * nwords words */
+	u_int *multi_pos;
+	u_int nmulti;
+};
+
+/*
+ * The indexes of the tables looked up through a netdissect_options
+ * structure are kept in it; the deprecated functions that don't take
+ * one scan the tables.
+ */
+struct nd_tok_indexes {
+	struct tok_index **slots;
+	u_int size;			/* a power of 2 */
+	u_int count;
+};
+
+static u_int
+tok_index_hash(const struct nd_tok_indexes *tis, const struct tok *table)
+{
+	uint64_t h = (uint64_t)(uintptr_t)table;
+
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	return (u_int)h & (tis->size - 1);
+}
+
+static int
+tok_indexes_grow(struct nd_tok_indexes *tis)
+{
+	struct tok_index **old = tis->slots;
+	u_int oldsize = tis->size, i, h;
+
+	tis->size = oldsize != 0 ? oldsize * 2 : 256;
+	tis->slots = (struct tok_index **)calloc(tis->size,
+	    sizeof(*tis->slots));
+	if (tis->slots == NULL) {
+		tis->slots = old;
+		tis->size = oldsize;
+		return -1;
+	}
+	for (i = 0; i < oldsize; i++) {
+		if (old[i] == NULL)
+			continue;
+		for (h = tok_index_hash(tis, old[i]->table);
+		     tis->slots[h] != NULL; h = (h + 1) & (tis->size - 1))
+			;
+		tis->slots[h] = old[i];
+	}
+	free(old);
+	return 0;
+}
+
+/*
+ * Return the index of a table, creating an empty one the first time,
+ * or NULL if out of memory.
+ */
+static struct tok_index *
+tok_index_get(struct nd_tok_indexes *tis, const struct tok *table)
+{
+	struct tok_index *ti;
+	u_int h;
+
+	if (tis->size != 0) {
+		for (h = tok_index_hash(tis, table); tis->slots[h] != NULL;
+		     h = (h + 1) & (tis->size - 1)) {
+			if (tis->slots[h]->table == table)
+				return tis->slots[h];
+		}
+	}
+	/* Keep the load factor under 1/2. */
+	if ((tis->count + 1) * 2 > tis->size && tok_indexes_grow(tis) == -1)
+		return NULL;
+	ti = (struct tok_index *)calloc(1, sizeof(*ti));
+	if (ti == NULL)
+		return NULL;
+	ti->table = table;
+	while (table[ti->ntoks].s != NULL)
+		ti->ntoks++;
+	for (h = tok_index_hash(tis, table); tis->slots[h] != NULL;
+	     h = (h + 1) & (tis->size - 1))
+		;
+	tis->slots[h] = ti;
+	tis->count++;
+	return ti;
+}
+
+/*
+ * Return the indexes of the tables looked up through ndo, allocating
+ * them the first time.
+ */
+static struct nd_tok_indexes *
+nd_tok_indexes(netdissect_options *ndo)
+{
+	if (ndo->ndo_tok_indexes == NULL) {
+		ndo->ndo_tok_indexes = (struct nd_tok_indexes *)calloc(1,
+		    sizeof(*ndo->ndo_tok_indexes));
+		if (ndo->ndo_tok_indexes == NULL)
+			(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
+			    "%s: calloc", __func__);
+	}
+	return ndo->ndo_tok_indexes;
+}
+
+void
+nd_free_tok_indexes(netdissect_options *ndo)
+{
+	struct nd_tok_indexes *tis = ndo->ndo_tok_indexes;
+	struct tok_index *ti;
+	u_int i;
+
+	if (tis == NULL)
+		return;
+	for (i = 0; i < tis->size; i++) {
+		ti = tis->slots[i];
+		if (ti == NULL)
+			continue;
+		free(ti->dense);
+		free(ti->hashed);
+		free(ti->bit_toks);
+		free(ti->multi_pos);
+		free(ti);
+	}
+	free(tis->slots);
+	free(tis);
+	ndo->ndo_tok_indexes = NULL;
+}
+
+#define TOK_VALUE_HASH(ti, v)	(((v) * 0x9e3779b1U) >> (ti)->hash_shift)
+
+static int
+tok_index_build_values(struct tok_index *ti)
+{
+	const struct tok *lp = ti->table;
+	u_int i, h, min, max, bits, mask;
+
+	min = max = lp[0].v;
+	for (i = 1; i < ti->ntoks; i++) {
+		if (lp[i].v < min)
+			min = lp[i].v;
+		if (lp[i].v > max)
+			max = lp[i].v;
+	}
+	ti->min = min;
+	if (max - min < 4 * ti->ntoks) {
+		ti->range = max - min + 1;
+		ti->dense = (const char **)calloc(ti->range,
+		    sizeof(*ti->dense));
+		if (ti->dense == NULL)
+			return -1;
+		/* Backwards, so the first token of a value wins. */
+		for (i = ti->ntoks; i-- != 0;)
+			ti->dense[lp[i].v - min] = lp[i].s;
+	} else {
+		/* At most half full. */
+		for (bits = 1; (1U << bits) < 2 * ti->ntoks; bits++)
+			;
+		mask = (1U << bits) - 1;
+		ti->hash_shift = 32 - bits;
+		ti->hashed = (struct tok *)calloc(mask + 1,
+		    sizeof(*ti->hashed));
+		if (ti->hashed == NULL)
+			return -1;
+		for (i = 0; i < ti->ntoks; i++) {
+			for (h = TOK_VALUE_HASH(ti, lp[i].v);
+			     ti->hashed[h].s != NULL && ti->hashed[h].v != lp[i].v;
+			     h = (h + 1) & mask)
+				;
+			if (ti->hashed[h].s == NULL)
+				ti->hashed[h] = lp[i];
+		}
+	}
+	ti->values_built = 1;
+	return 0;
+}
+
+/*
+ * Look v up in a table of more than TOK_INDEX_MIN tokens; returns
+ * NULL if not found, or -1 cast to a pointer if the table can't be
+ * indexed.
+ */
+#define TOK_NO_INDEX	((const char *)(uintptr_t)-1)
+
+static const char *
+tok_index_lookup(struct nd_tok_indexes *tis, const struct tok *lp,
+		 const u_int v)
+{
+	struct tok_index *ti;
+	u_int h, mask;
+
+	if (tis == NULL)
+		return TOK_NO_INDEX;
+	ti = tok_index_get(tis, lp);
+	if (ti == NULL)
+		return TOK_NO_INDEX;
+	if (!ti->values_built && tok_index_build_values(ti) == -1)
+		return TOK_NO_INDEX;
+	if (ti->range != 0) {
+		if (v - ti->min < ti->range)
+			return ti->dense[v - ti->min];
+		return NULL;
+	}
+	mask = (1U << (32 - ti->hash_shift)) - 1;
+	for (h = TOK_VALUE_HASH(ti, v); ti->hashed[h].s != NULL;
+	     h = (h + 1) & mask) {
+		if (ti->hashed[h].v == v)
+			return ti->hashed[h].s;
+	}
+	return NULL;
+}
+
 /*
  * Convert a token value to a string; use "fmt" if not found.
  */
 static const char *
-tok2strbuf(const struct tok *lp, const char *fmt,
+tok2strbuf(struct nd_tok_indexes *tis, const struct tok *lp, const char *fmt,
 	   const u_int v, char *buf, const size_t bufsize)
 {
+	const char *s;
+	u_int i;
+
 	if (lp != NULL) {
-		while (lp->s != NULL) {
-			if (lp->v == v)
-				return (lp->s);
-			++lp;
+		for (i = 0; lp[i].s != NULL; i++) {
+			if (lp[i].v == v)
+				return (lp[i].s);
+			if (i == TOK_INDEX_MIN) {
+				s = tok_index_lookup(tis, lp, v);
+				if (s == TOK_NO_INDEX)
+					continue;
+				if (s != NULL)
+					return (s);
+				break;
+			}
 		}
 	}
 	if (fmt == NULL)
@@ -537,19 +877,152 @@ tok2strbuf(const struct tok *lp, const char *fmt,
 
 /*
  * Convert a token value to a string; use "fmt" if not found.
- * Uses tok2strbuf() on one of four local static buffers of size TOKBUFSIZE
+ * Uses tok2strbuf() on one of four per-thread buffers of size TOKBUFSIZE
  * in round-robin fashion.
+ *
+ * The name is in parentheses, here and below, as netdissect.h defines
+ * a macro of that name for the printers.
  */
 const char *
-tok2str(const struct tok *lp, const char *fmt, const u_int v)
+(tok2str)(const struct tok *lp, const char *fmt, const u_int v)
 {
-	static char buf[4][TOKBUFSIZE];
-	static int idx = 0;
+	static ND_THREAD_LOCAL char buf[4][TOKBUFSIZE];
+	static ND_THREAD_LOCAL int idx = 0;
 	char *ret;
 
 	ret = buf[idx];
 	idx = (idx+1) & 3;
-	return tok2strbuf(lp, fmt, v, ret, sizeof(buf[0]));
+	return tok2strbuf(NULL, lp, fmt, v, ret, sizeof(buf[0]));
+}
+
+/*
+ * Copy a string into the scratch space of ndo, which is emptied after
+ * each packet.
+ */
+char *
+nd_scratch_strdup(netdissect_options *ndo, const char *s)
+{
+	return nd_arena_strdup(ndo, &ndo->ndo_scratch, s);
+}
+
+const char *
+nd_tok2str(netdissect_options *ndo, const struct tok *lp, const char *fmt,
+	   const u_int v)
+{
+	char buf[TOKBUFSIZE];
+	const char *s;
+
+	s = tok2strbuf(nd_tok_indexes(ndo), lp, fmt, v, buf, sizeof(buf));
+	return s == buf ? nd_scratch_strdup(ndo, buf) : s;
+}
+
+static int
+tok_index_build_bits(struct tok_index *ti)
+{
+	const struct tok *lp = ti->table;
+	u_int i, b;
+
+	ti->nwords = (ti->ntoks + 63) / 64;
+	ti->bit_toks = (uint64_t *)calloc(32 * ti->nwords,
+	    sizeof(*ti->bit_toks));
+	ti->multi_pos = (u_int *)malloc(ti->ntoks * sizeof(*ti->multi_pos));
+	if (ti->bit_toks == NULL || ti->multi_pos == NULL) {
+		free(ti->bit_toks);
+		free(ti->multi_pos);
+		ti->bit_toks = NULL;
+		ti->multi_pos = NULL;
+		return -1;
+	}
+	for (i = 0; i < ti->ntoks; i++) {
+		if (lp[i].v == 0)
+			continue;	/* never matches */
+		if ((lp[i].v & (lp[i].v - 1)) == 0) {
+			for (b = 0; (lp[i].v >> b) != 1; b++)
+				;
+			ti->bit_toks[b * ti->nwords + i / 64] |=
+			    (uint64_t)1 << (i % 64);
+		} else
+			ti->multi_pos[ti->nmulti++] = i;
+	}
+	ti->bits_built = 1;
+	return 0;
+}
+
+/*
+ * Number of the lowest bit set in w, which isn't 0, found without
+ * looping (and mispredicting branches) through a de Bruijn sequence.
+ */
+static u_int
+tok_lowest_bit(uint64_t w)
+{
+	static const u_char debruijn_bits[64] = {
+		 0,  1, 48,  2, 57, 49, 28,  3, 61, 58, 50, 42, 38, 29, 17,  4,
+		62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12,  5,
+		63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+		46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19,  9, 13,  8,  7,  6
+	};
+
+	return debruijn_bits[((w & (~w + 1)) * 0x03f79d71b4cb0a89ULL) >> 58];
+}
+
+/*
+ * Set in found[] the positions of the tokens of a table of more than
+ * TOK_BITS_INDEX_MIN tokens matching v, and return the number of words
+ * of found[], or 0 if the table must be scanned.
+ */
+static u_int
+tok_index_bits(struct nd_tok_indexes *tis, const struct tok *lp,
+	       const u_int v, uint64_t found[TOK_BITS_MAX_WORDS])
+{
+	struct tok_index *ti;
+	const uint64_t *row;
+	u_int bits, b, i;
+
+	ti = tok_index_get(tis, lp);
+	if (ti == NULL || ti->ntoks > 64 * TOK_BITS_MAX_WORDS)
+		return 0;
+	if (!ti->bits_built && tok_index_build_bits(ti) == -1)
+		return 0;
+	memset(found, 0, ti->nwords * sizeof(*found));
+	for (bits = v; bits != 0; bits &= bits - 1) {
+		b = tok_lowest_bit(bits);
+		row = &ti->bit_toks[b * ti->nwords];
+		for (i = 0; i < ti->nwords; i++)
+			found[i] |= row[i];
+	}
+	for (i = 0; i < ti->nmulti; i++) {
+		if ((v & lp[ti->multi_pos[i]].v) == lp[ti->multi_pos[i]].v)
+			found[ti->multi_pos[i] / 64] |=
+			    (uint64_t)1 << (ti->multi_pos[i] % 64);
+	}
+	return ti->nwords;
+}
+
+/*
+ * Append sep, unless this is the first string, and s to the buffer;
+ * returns -1 if it is full.
+ */
+static int
+bittok_append(char **bufp, size_t *space_left, const char *sep,
+	      const char *s)
+{
+	size_t string_size;
+
+	if (*space_left <= 1)
+		return -1; /* only enough room left for NUL, if that */
+	string_size = strlcpy(*bufp, sep, *space_left);
+	if (string_size >= *space_left)
+		return -1;    /* we ran out of room */
+	*bufp += string_size;
+	*space_left -= string_size;
+	if (*space_left <= 1)
+		return -1; /* only enough room left for NUL, if that */
+	string_size = strlcpy(*bufp, s, *space_left);
+	if (string_size >= *space_left)
+		return -1;    /* we ran out of room */
+	*bufp += string_size;
+	*space_left -= string_size;
+	return 0;
 }
 
 /*
@@ -561,48 +1034,72 @@ tok2str(const struct tok *lp, const char *fmt, const u_int v)
  * in the token is set in v. Consequently, a 0 token never matches.
  */
 static char *
-bittok2str_internal(const struct tok *lp, const char *fmt,
-		    const u_int v, const char *sep)
+bittok2strbuf(struct nd_tok_indexes *tis, const struct tok *lp,
+	      const char *fmt, const u_int v, const char *sep, char *buf,
+	      const size_t bufsize)
 {
-        static char buf[1024+1]; /* our string buffer */
         char *bufp = buf;
-        size_t space_left = sizeof(buf), string_size;
+        size_t space_left = bufsize;
         const char * sepstr = "";
+        uint64_t found[TOK_BITS_MAX_WORDS], word;
+        u_int i, nwords = 0, pos;
+
+        /* Index the long tables. */
+        if (lp != NULL) {
+            for (i = 0; i <= TOK_BITS_INDEX_MIN; i++)
+                if (lp[i].s == NULL)
+                    break;
+            if (i > TOK_BITS_INDEX_MIN && tis != NULL)
+                nwords = tok_index_bits(tis, lp, v, found);
+        }
 
-        while (lp != NULL && lp->s != NULL) {
-            if (lp->v && (v & lp->v) == lp->v) {
-                /* ok we have found something */
-                if (space_left <= 1)
-                    return (buf); /* only enough room left for NUL, if that */
-                string_size = strlcpy(bufp, sepstr, space_left);
-                if (string_size >= space_left)
-                    return (buf);    /* we ran out of room */
-                bufp += string_size;
-                space_left -= string_size;
-                if (space_left <= 1)
-                    return (buf); /* only enough room left for NUL, if that */
-                string_size = strlcpy(bufp, lp->s, space_left);
-                if (string_size >= space_left)
-                    return (buf);    /* we ran out of room */
-                bufp += string_size;
-                space_left -= string_size;
-                sepstr = sep;
+        if (nwords != 0) {
+            /* Go through the matches in table order. */
+            for (i = 0; i < nwords; i++) {
+                for (word = found[i]; word != 0; word &= word - 1) {
+                    pos = i * 64 + tok_lowest_bit(word);
+                    if (bittok_append(&bufp, &space_left, sepstr,
+                                      lp[pos].s) == -1)
+                        return (buf);
+                    sepstr = sep;
+                }
+            }
+        } else {
+            while (lp != NULL && lp->s != NULL) {
+                if (lp->v && (v & lp->v) == lp->v) {
+                    /* ok we have found something */
+                    if (bittok_append(&bufp, &space_left, sepstr,
+                                      lp->s) == -1)
+                        return (buf);
+                    sepstr = sep;
+                }
+                lp++;
             }
-            lp++;
         }
 
         if (bufp == buf)
             /* bummer - lets print the "unknown" message as advised in the fmt string if we got one */
-            (void)snprintf(buf, sizeof(buf), fmt == NULL ? "#%08x" : fmt, v);
+            (void)snprintf(buf, bufsize, fmt == NULL ? "#%08x" : fmt, v);
         return (buf);
 }
 
+#define BITTOKBUFSIZE	(1024+1)
+
+static char *
+bittok2str_internal(const struct tok *lp, const char *fmt,
+		    const u_int v, const char *sep)
+{
+        static ND_THREAD_LOCAL char buf[BITTOKBUFSIZE]; /* our string buffer */
+
+        return (bittok2strbuf(NULL, lp, fmt, v, sep, buf, sizeof(buf)));
+}
+
 /*
  * Convert a bit token value to a string; use "fmt" if not found.
  * this is useful for parsing bitfields, the output strings are not separated.
  */
 char *
-bittok2str_nosep(const struct tok *lp, const char *fmt, const u_int v)
+(bittok2str_nosep)(const struct tok *lp, const char *fmt, const u_int v)
 {
     return (bittok2str_internal(lp, fmt, v, ""));
 }
@@ -612,11 +1109,31 @@ bittok2str_nosep(const struct tok *lp, const char *fmt, const u_int v)
  * this is useful for parsing bitfields, the output strings are comma separated.
  */
 char *
-bittok2str(const struct tok *lp, const char *fmt, const u_int v)
+(bittok2str)(const struct tok *lp, const char *fmt, const u_int v)
 {
     return (bittok2str_internal(lp, fmt, v, ", "));
 }
 
+const char *
+nd_bittok2str_nosep(netdissect_options *ndo, const struct tok *lp,
+		    const char *fmt, const u_int v)
+{
+	char buf[BITTOKBUFSIZE];
+
+	return nd_scratch_strdup(ndo, bittok2strbuf(nd_tok_indexes(ndo), lp,
+	    fmt, v, "", buf, sizeof(buf)));
+}
+
+const char *
+nd_bittok2str(netdissect_options *ndo, const struct tok *lp,
+	      const char *fmt, const u_int v)
+{
+	char buf[BITTOKBUFSIZE];
+
+	return nd_scratch_strdup(ndo, bittok2strbuf(nd_tok_indexes(ndo), lp,
+	    fmt, v, ", ", buf, sizeof(buf)));
+}
+
 /*
  * Convert a value to a string using an array; the macro
  * tok2strary() in <netdissect.h> is the public interface to
@@ -626,7 +1143,7 @@ bittok2str(const struct tok *lp, const char *fmt, const u_int v)
 const char *
 tok2strary_internal(const char **lp, int n, const char *fmt, const int v)
 {
-	static char buf[TOKBUFSIZE];
+	static ND_THREAD_LOCAL char buf[TOKBUFSIZE];
 
 	if (v >= 0 && v < n && lp[v] != NULL)
 		return lp[v];
@@ -636,6 +1153,20 @@ tok2strary_internal(const char **lp, int n, const char *fmt, const int v)
 	return (buf);
 }
 
+const char *
+nd_tok2strary_internal(netdissect_options *ndo, const char **lp, int n,
+		       const char *fmt, const int v)
+{
+	char buf[TOKBUFSIZE];
+
+	if (v >= 0 && v < n && lp[v] != NULL)
+		return lp[v];
+	if (fmt == NULL)
+		fmt = "#%d";
+	(void)snprintf(buf, sizeof(buf), fmt, v);
+	return nd_scratch_strdup(ndo, buf);
+}
+
 const struct tok *
 uint2tokary_internal(const struct uint_tokary dict[], const size_t size,
                      const u_int val)